@@ -18,6 +18,7 @@
 /* MMC/SD command (SPI mode) */
 #define CMD0   (0)         /* GO_IDLE_STATE */
 #define CMD1   (1)         /* SEND_OP_COND */
+#define CMD6   (6)         /* SWITCH_FUNC */
 #define ACMD41 (0x80 + 41) /* SEND_OP_COND (SDC) */
 #define CMD8   (8)         /* SEND_IF_COND */
 #define CMD9   (9)         /* SEND_CSD */
@@ -45,8 +46,45 @@
 #define CT_SDC   (CT_SD1 | CT_SD2) /* SD */
 #define CT_BLOCK 0x08              /* Block addressing */
 
+/* SPI clock must be lower than 400 kHz in init mode */
+#define INIT_CLOCK_HZ 400000UL
+
+/* Max time for erase operation, cards may take up to 250 ms per erase unit */
+#define ERASE_TIMEOUT_MS 30000UL
+
+/* CMD6 arguments for access mode function group, other groups unchanged */
+#define SWITCH_CHECK_HS 0x00FFFFF1UL
+#define SWITCH_SET_HS   0x80FFFFF1UL
+
+/* Asynchronous transfer states */
+#define ASYNC_IDLE       0
+#define ASYNC_READ_TOKEN 1 /* Waiting for data token */
+#define ASYNC_READ_DATA  2 /* Receiving data block */
+#define ASYNC_WRITE_BUSY 3 /* Waiting for card to accept next block */
+#define ASYNC_WRITE_DATA 4 /* Sending data block */
+#define ASYNC_WRITE_STOP 5 /* Waiting for card to finish after stop token */
+
+/* Amount of bytes to poll for data token before giving up till next process call */
+#define ASYNC_TOKEN_POLLS 8
+
 #define timed_out(timeout) ((millis() - start_ts) > (timeout))
 
+/**
+ * Transfer data over SPI using DMA, wait for completion
+ *
+ * @param desc  Card descriptor
+ * @param tx    Data to send or NULL to send 0xff
+ * @param rx    Buffer for received data or NULL
+ * @param len   Amount of bytes to transfer
+ */
+static void transfer(const sdspi_desc_t *desc, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+    SPId_TransferDma(desc->device, tx, rx, len);
+    while (SPId_DmaBusy(desc->device)) {
+        ;
+    }
+}
+
 /**
  * Wait for card to become ready
  *
@@ -118,7 +156,7 @@ static bool readData(const sdspi_desc_t *desc, uint8_t *buf, uint32_t bytes)
         return false; // data token not valid -> error
     }
 
-    SPId_Receive(desc->device, buf, bytes);
+    transfer(desc, NULL, buf, bytes);
     /* discard CRC */
     (void)SPId_Transceive(desc->device, 0xff);
     (void)SPId_Transceive(desc->device, 0xff);
@@ -146,7 +184,7 @@ static bool writeData(const sdspi_desc_t *desc, const uint8_t *buff, uint8_t tok
     SPId_Transceive(desc->device, token);
     // Data token
     if (token != 0xFD) {
-        SPId_Send(desc->device, buff, 512);
+        transfer(desc, buff, NULL, 512);
         // dummy crc
         SPId_Transceive(desc->device, 0xff);
         SPId_Transceive(desc->device, 0xff);
@@ -220,16 +258,157 @@ static uint8_t writeCmd(const sdspi_desc_t *desc, uint8_t cmd, uint32_t arg)
     return resp;
 }
 
+/**
+ * Convert TRAN_SPEED field of CSD register to frequency
+ *
+ * @param tran_speed    TRAN_SPEED field
+ * @return Max clock frequency in Hz
+ */
+static uint32_t parseTranSpeed(uint8_t tran_speed)
+{
+    /* Time values multiplied by 10 */
+    static const uint8_t value[] = {
+        0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80,
+    };
+    /* Transfer rate units 100 kbit/s to 100 Mbit/s divided by 10 */
+    static const uint32_t unit[] = { 10000UL, 100000UL, 1000000UL, 10000000UL };
+
+    if ((tran_speed & 0x07) >= sizeof(unit) / sizeof(unit[0])) {
+        return 0;
+    }
+    return unit[tran_speed & 0x07] * value[(tran_speed >> 3) & 0x0f];
+}
+
+/**
+ * Read CSD register, store card capacity and max clock to descriptor
+ *
+ * @param desc  Card descriptor
+ * @param ccc   Card command classes supported (bitmask)
+ * @return True if successful
+ */
+static bool readCsd(sdspi_desc_t *desc, uint16_t *ccc)
+{
+    uint8_t csd[16];
+    uint32_t sectors;
+
+    if (writeCmd(desc, CMD9, 0) != 0 || !readData(desc, csd, 16)) {
+        deselect(desc);
+        return false;
+    }
+    deselect(desc);
+
+    if ((csd[0] >> 6) == 1) {
+        // SDC ver 2.00
+        sectors = csd[9] + ((uint16_t)csd[8] << 8) + ((uint32_t)(csd[7] & 63) << 16) + 1;
+        sectors <<= 10;
+    } else {
+        // SDC ver 1.XX or MMC
+        uint8_t n = (csd[5] & 15) + ((csd[10] & 128) >> 7) + ((csd[9] & 3) << 1) + 2;
+        sectors = (csd[8] >> 6) + ((uint16_t)csd[7] << 2) + ((uint16_t)(csd[6] & 3) << 10) + 1;
+        sectors <<= (n - 9);
+    }
+    desc->sectors = sectors;
+    desc->max_clock = parseTranSpeed(csd[3]);
+    *ccc = ((uint16_t)csd[4] << 4) | (csd[5] >> 4);
+    return true;
+}
+
+/**
+ * Read CID register and store parsed content to descriptor
+ *
+ * @param desc  Card descriptor
+ * @return True if successful
+ */
+static bool readCid(sdspi_desc_t *desc)
+{
+    uint8_t cid[16];
+    uint16_t date;
+
+    if (writeCmd(desc, CMD10, 0) != 0 || !readData(desc, cid, 16)) {
+        deselect(desc);
+        return false;
+    }
+    deselect(desc);
+
+    desc->cid.manufacturer = cid[0];
+    desc->cid.oem[0] = (char)cid[1];
+    desc->cid.oem[1] = (char)cid[2];
+    desc->cid.oem[2] = '\0';
+    for (uint8_t i = 0; i < 5; i++) {
+        desc->cid.product[i] = (char)cid[3 + i];
+    }
+    desc->cid.product[5] = '\0';
+    desc->cid.revision = cid[8];
+    desc->cid.serial = ((uint32_t)cid[9] << 24) | ((uint32_t)cid[10] << 16) |
+                       ((uint32_t)cid[11] << 8) | cid[12];
+    date = ((uint16_t)(cid[13] & 0x0f) << 8) | cid[14];
+    desc->cid.year = 2000 + (date >> 4);
+    desc->cid.month = date & 0x0f;
+    return true;
+}
+
+/**
+ * Switch the card to high speed mode (CMD6) if supported
+ *
+ * @param desc  Card descriptor
+ * @return True if switched
+ */
+static bool switchHighSpeed(sdspi_desc_t *desc)
+{
+    uint8_t status[64];
+    bool ret;
+
+    // Check function group 1 supports high speed
+    ret = writeCmd(desc, CMD6, SWITCH_CHECK_HS) == 0 && readData(desc, status, 64);
+    deselect(desc);
+    if (!ret || !(status[13] & 0x02)) {
+        return false;
+    }
+
+    ret = writeCmd(desc, CMD6, SWITCH_SET_HS) == 0 && readData(desc, status, 64);
+    deselect(desc);
+    // Selected function of group 1 in bits 379:376
+    return ret && (status[16] & 0x0f) == 1;
+}
+
+/**
+ * Discover card capabilities and set the fastest SPI clock allowed
+ *
+ * @param desc  Card descriptor
+ * @return True if successful
+ */
+static bool setupCard(sdspi_desc_t *desc)
+{
+    uint16_t ccc;
+
+    if (!readCsd(desc, &ccc) || !readCid(desc)) {
+        return false;
+    }
+
+    // Command class 10 (switch) supported
+    if ((desc->card_type & CT_SDC) && (ccc & (1U << 10)) && switchHighSpeed(desc)) {
+        desc->high_speed = true;
+        // TRAN_SPEED changes after switching
+        if (!readCsd(desc, &ccc)) {
+            return false;
+        }
+    }
+
+    SPId_SetPrescaler(desc->device, SPId_GetPrescalerForClock(desc->device, desc->max_clock));
+    return true;
+}
+
 bool SDSPI_InitCard(sdspi_desc_t *desc)
 {
-    spid_prescaler_t prescaler;
     uint32_t start_ts;
     uint8_t type = 0;
     uint8_t cmd, buf[4];
+    spid_prescaler_t prescaler = SPId_GetPrescaler(desc->device);
 
-    // SPI clock must be lower than 400 kHz in init mode
-    prescaler = SPId_GetPrescaler(desc->device);
-    SPId_SetPrescaler(desc->device, SPID_PRESC_256);
+    desc->high_speed = false;
+    desc->sectors = 0;
+    desc->max_clock = 0;
+    SPId_SetPrescaler(desc->device, SPId_GetPrescalerForClock(desc->device, INIT_CLOCK_HZ));
 
     IOd_SetLine(desc->cs_port, desc->cs_pad, true);
     // Apply 80 dummy clocks to the card gets ready to receive commands
@@ -276,14 +455,24 @@ bool SDSPI_InitCard(sdspi_desc_t *desc)
     desc->card_type = type;
     deselect(desc);
 
-    SPId_SetPrescaler(desc->device, prescaler);
-    return type != 0;
+    if (type != 0 && !setupCard(desc)) {
+        desc->card_type = 0;
+    }
+    // Other devices on the bus keep their clock if there is no usable card
+    if (desc->card_type == 0) {
+        SPId_SetPrescaler(desc->device, prescaler);
+    }
+    return desc->card_type != 0;
 }
 
 bool SDSPI_ReadSector(sdspi_desc_t *desc, uint8_t *buff, uint32_t sector, uint32_t count)
 {
     uint8_t cmd;
 
+    if (desc->async.state != ASYNC_IDLE) {
+        return false;
+    }
+
     if (!(desc->card_type & CT_BLOCK)) {
         sector *= 512; // Convert LBA to byte address
     }
@@ -309,6 +498,9 @@ bool SDSPI_ReadSector(sdspi_desc_t *desc, uint8_t *buff, uint32_t sector, uint32
 
 bool SDSPI_WriteSector(sdspi_desc_t *desc, const uint8_t *buff, uint32_t sector, uint32_t count)
 {
+    if (desc->async.state != ASYNC_IDLE) {
+        return false;
+    }
     if (!(desc->card_type & CT_BLOCK)) {
         sector *= 512; // Convert LBA to byte address if needed
     }
@@ -338,32 +530,276 @@ bool SDSPI_WriteSector(sdspi_desc_t *desc, const uint8_t *buff, uint32_t sector,
     return count == 0;
 }
 
+/**
+ * Finish the asynchronous transfer and report the result
+ *
+ * @param desc      Card descriptor
+ * @param success   Transfer result
+ */
+static void asyncFinish(sdspi_desc_t *desc, bool success)
+{
+    sdspi_async_t *async = &desc->async;
+
+    if (async->multi &&
+        (async->state == ASYNC_READ_TOKEN || async->state == ASYNC_READ_DATA))
+    {
+        writeCmd(desc, CMD12, 0); // STOP_TRANSMISSION
+    } else if (async->multi &&
+               (async->state == ASYNC_WRITE_BUSY || async->state == ASYNC_WRITE_DATA))
+    {
+        // Failed write, STOP_TRAN token leaves the card write state
+        writeData(desc, 0, 0xFD);
+    }
+    deselect(desc);
+    async->state = ASYNC_IDLE;
+    if (async->cb != NULL) {
+        async->cb(success ? async->buf - 512 : NULL, success ? 0 : async->count, success);
+    }
+}
+
+/**
+ * Poll for data token, start receiving the block if found
+ *
+ * @param desc  Card descriptor
+ * @return False if wrong token received or timed out
+ */
+static bool asyncReadToken(sdspi_desc_t *desc)
+{
+    sdspi_async_t *async = &desc->async;
+    uint32_t start_ts = async->start_ts;
+    uint8_t resp = 0xff;
+
+    for (uint8_t i = 0; i < ASYNC_TOKEN_POLLS && resp == 0xff; i++) {
+        resp = SPId_Transceive(desc->device, 0xff);
+    }
+    if (resp == 0xff) {
+        return !timed_out(100);
+    }
+    if (resp != 0xFE) {
+        return false;
+    }
+
+    SPId_TransferDma(desc->device, NULL, async->buf, 512);
+    async->state = ASYNC_READ_DATA;
+    return true;
+}
+
+bool SDSPI_ReadSectorAsync(sdspi_desc_t *desc, uint8_t *buff, uint32_t sector, uint32_t count,
+    sdspi_cb_t cb)
+{
+    sdspi_async_t *async = &desc->async;
+
+    ASSERT_NOT(buff == NULL || count == 0);
+    if (async->state != ASYNC_IDLE) {
+        return false;
+    }
+    if (!(desc->card_type & CT_BLOCK)) {
+        sector *= 512; // Convert LBA to byte address
+    }
+
+    async->multi = count > 1;
+    if (writeCmd(desc, async->multi ? CMD18 : CMD17, sector) != 0) {
+        deselect(desc);
+        return false;
+    }
+
+    async->buf = buff;
+    async->count = count;
+    async->cb = cb;
+    async->state = ASYNC_READ_TOKEN;
+    async->start_ts = millis();
+    return true;
+}
+
+bool SDSPI_WriteSectorAsync(sdspi_desc_t *desc, const uint8_t *buff, uint32_t sector,
+    uint32_t count, sdspi_cb_t cb)
+{
+    sdspi_async_t *async = &desc->async;
+    uint8_t resp;
+
+    ASSERT_NOT(buff == NULL || count == 0);
+    if (async->state != ASYNC_IDLE) {
+        return false;
+    }
+    if (!(desc->card_type & CT_BLOCK)) {
+        sector *= 512; // Convert LBA to byte address
+    }
+
+    async->multi = count > 1;
+    if (async->multi) {
+        if (desc->card_type & CT_SDC) {
+            writeCmd(desc, ACMD23, count);
+        }
+        resp = writeCmd(desc, CMD25, sector);
+    } else {
+        resp = writeCmd(desc, CMD24, sector);
+    }
+    if (resp != 0) {
+        deselect(desc);
+        return false;
+    }
+
+    /* Data are only read by the DMA */
+    async->buf = (uint8_t *)buff;
+    async->count = count;
+    async->cb = cb;
+    async->state = ASYNC_WRITE_BUSY;
+    async->start_ts = millis();
+    return true;
+}
+
+bool SDSPI_Process(sdspi_desc_t *desc)
+{
+    sdspi_async_t *async = &desc->async;
+    uint32_t start_ts = async->start_ts;
+    const uint8_t *done;
+    uint8_t resp;
+
+    switch (async->state) {
+        case ASYNC_READ_TOKEN:
+            if (!asyncReadToken(desc)) {
+                asyncFinish(desc, false);
+            }
+            break;
+
+        case ASYNC_READ_DATA:
+            if (SPId_DmaBusy(desc->device)) {
+                break;
+            }
+            /* discard CRC */
+            (void)SPId_Transceive(desc->device, 0xff);
+            (void)SPId_Transceive(desc->device, 0xff);
+            async->buf += 512;
+            if (--async->count == 0) {
+                asyncFinish(desc, true);
+                break;
+            }
+
+            /* Start the next block before processing the finished one */
+            done = async->buf - 512;
+            async->state = ASYNC_READ_TOKEN;
+            async->start_ts = millis();
+            if (!asyncReadToken(desc)) {
+                asyncFinish(desc, false);
+                break;
+            }
+            if (async->cb != NULL) {
+                async->cb(done, async->count, true);
+            }
+            break;
+
+        case ASYNC_WRITE_BUSY:
+            if (SPId_Transceive(desc->device, 0xff) != 0xff) {
+                if (timed_out(500)) {
+                    asyncFinish(desc, false);
+                }
+                break;
+            }
+            if (async->count == 0) {
+                // STOP_TRAN token, card gets busy again
+                SPId_Transceive(desc->device, 0xFD);
+                async->state = ASYNC_WRITE_STOP;
+                async->start_ts = millis();
+                break;
+            }
+            SPId_Transceive(desc->device, async->multi ? 0xFC : 0xFE);
+            SPId_TransferDma(desc->device, async->buf, NULL, 512);
+            async->state = ASYNC_WRITE_DATA;
+            break;
+
+        case ASYNC_WRITE_DATA:
+            if (SPId_DmaBusy(desc->device)) {
+                break;
+            }
+            // dummy crc
+            SPId_Transceive(desc->device, 0xff);
+            SPId_Transceive(desc->device, 0xff);
+            resp = SPId_Transceive(desc->device, 0xff);
+            if ((resp & 0x1F) != 0x05) {
+                asyncFinish(desc, false);
+                break;
+            }
+            async->buf += 512;
+            async->count--;
+            async->start_ts = millis();
+            if (async->count == 0 && !async->multi) {
+                async->state = ASYNC_WRITE_STOP;
+                break;
+            }
+            async->state = ASYNC_WRITE_BUSY;
+            /* Last block is reported once the card finishes writing */
+            if (async->count != 0 && async->cb != NULL) {
+                async->cb(async->buf - 512, async->count, true);
+            }
+            break;
+
+        case ASYNC_WRITE_STOP:
+            if (SPId_Transceive(desc->device, 0xff) == 0xff) {
+                asyncFinish(desc, true);
+            } else if (timed_out(500)) {
+                asyncFinish(desc, false);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return async->state != ASYNC_IDLE;
+}
+
+bool SDSPI_Erase(sdspi_desc_t *desc, uint32_t start, uint32_t end)
+{
+    uint32_t start_ts;
+    uint8_t resp = 0;
+
+    if (!(desc->card_type & CT_SDC) || desc->async.state != ASYNC_IDLE || end < start) {
+        return false;
+    }
+    if (!(desc->card_type & CT_BLOCK)) {
+        start *= 512; // Convert LBA to byte address if needed
+        end *= 512;
+    }
+
+    if (writeCmd(desc, CMD32, start) == 0 && writeCmd(desc, CMD33, end) == 0 &&
+        writeCmd(desc, CMD38, 0) == 0)
+    {
+        // Card holds DO low until the erase is finished
+        start_ts = millis();
+        do {
+            resp = SPId_Transceive(desc->device, 0xff);
+        } while (!timed_out(ERASE_TIMEOUT_MS) && resp != 0xff);
+    }
+    deselect(desc);
+    return resp == 0xff;
+}
+
 bool SDSPI_Sync(sdspi_desc_t *desc)
 {
-    bool ret = select(desc);
+    bool ret;
+
+    if (desc->async.state != ASYNC_IDLE) {
+        return false;
+    }
+    ret = select(desc);
     deselect(desc);
     return ret;
 }
 
 uint32_t SDSPI_GetSectorsCount(sdspi_desc_t *desc)
 {
-    uint8_t csd[16];
-    uint32_t sectors = 0;
-
-    if ((writeCmd(desc, CMD9, 0) == 0) && readData(desc, csd, 16)) {
-        if ((csd[0] >> 6) == 1) {
-            // SDC ver 2.00
-            sectors = csd[9] + ((uint16_t)csd[8] << 8) + ((uint32_t)(csd[7] & 63) << 16) + 1;
-            sectors <<= 10;
-        } else {
-            // SDC ver 1.XX or MMC
-            uint8_t n = (csd[5] & 15) + ((csd[10] & 128) >> 7) + ((csd[9] & 3) << 1) + 2;
-            sectors = (csd[8] >> 6) + ((uint16_t)csd[7] << 2) + ((uint16_t)(csd[6] & 3) << 10) + 1;
-            sectors <<= (n - 9);
-        }
+    if (desc->card_type == 0) {
+        return 0;
     }
-    deselect(desc);
-    return sectors;
+    return desc->sectors;
+}
+
+const sdspi_cid_t *SDSPI_GetCid(sdspi_desc_t *desc)
+{
+    if (desc->card_type == 0) {
+        return NULL;
+    }
+    return &desc->cid;
 }
 
 void SDSPI_SetInserted(sdspi_desc_t *desc, bool present)
@@ -371,6 +807,7 @@ void SDSPI_SetInserted(sdspi_desc_t *desc, bool present)
     desc->present = present;
     if (!present) {
         desc->card_type = 0;
+        desc->async.state = ASYNC_IDLE;
     }
 }
 
@@ -391,4 +828,5 @@ void SDSPI_Init(sdspi_desc_t *desc, uint8_t spi, uint32_t cs_port, uint8_t cs_pa
     desc->cs_pad = cs_pad;
     desc->present = false;
     desc->card_type = 0;
+    desc->async.state = ASYNC_IDLE;
 }
@@ -11,18 +11,61 @@
 /** Card sector size in bytes */
 #define SDSPI_SECTOR_SIZE_B 512
 
+/**
+ * Callback for asynchronous transfers, called for each block transferred
+ *
+ * For reads, transfer of the next block is already running while the
+ * callback is called, so the data can be processed meanwhile. For writes,
+ * the block buffer can be reused once the callback is called.
+ *
+ * @param buf       Block transferred or NULL if the transfer failed
+ * @param remaining Amount of blocks remaining, 0 when the transfer finished
+ * @param success   False if the transfer failed and was aborted
+ */
+typedef void (*sdspi_cb_t)(const uint8_t *buf, uint32_t remaining, bool success);
+
+/** State of the asynchronous transfer */
+typedef struct {
+    uint8_t state;     /**< Transfer state, 0 if no transfer is running */
+    bool multi;        /**< Multiple block command used */
+    uint8_t *buf;      /**< Buffer for the current block */
+    uint32_t count;    /**< Amount of blocks remaining */
+    uint32_t start_ts; /**< Time the current state was entered */
+    sdspi_cb_t cb;     /**< Callback for transferred blocks */
+} sdspi_async_t;
+
+/** Card identification read from CID register */
+typedef struct {
+    uint8_t manufacturer; /**< Manufacturer ID */
+    char oem[3];          /**< OEM/Application ID, null terminated */
+    char product[6];      /**< Product name, null terminated */
+    uint8_t revision;     /**< Product revision, BCD coded n.m */
+    uint32_t serial;      /**< Product serial number */
+    uint16_t year;        /**< Manufacturing year */
+    uint8_t month;        /**< Manufacturing month */
+} sdspi_cid_t;
+
 /** SD Card device descriptor */
 typedef struct {
-    uint8_t device;    /**< SPI device */
-    uint32_t cs_port;  /**< Port of CS pin */
-    uint32_t cs_pad;   /**< Pad of CS pin */
-    bool present;      /**< True if card is inserted */
-    uint8_t card_type; /**< Type of the inserted SD card, 0 for no card present */
+    uint8_t device;      /**< SPI device */
+    uint32_t cs_port;    /**< Port of CS pin */
+    uint32_t cs_pad;     /**< Pad of CS pin */
+    bool present;        /**< True if card is inserted */
+    uint8_t card_type;   /**< Type of the inserted SD card, 0 for no card present */
+    bool high_speed;     /**< Card switched to high speed mode */
+    uint32_t max_clock;  /**< Max clock supported by the card in Hz (from CSD) */
+    uint32_t sectors;    /**< Amount of sectors on the card (from CSD) */
+    sdspi_cid_t cid;     /**< Card identification */
+    sdspi_async_t async; /**< Asynchronous transfer in progress */
 } sdspi_desc_t;
 
 /**
  * Initialize new device and put it into ready state
  *
+ * Card registers are read and cached, the card is switched to high speed
+ * mode if supported and the SPI clock is set to the fastest one allowed
+ * by the card. The clock change affects all devices on the same SPI bus.
+ *
  * @param desc	Card descriptor
  * @return True if initialized, false if not responding, not found...
  */
@@ -50,6 +93,58 @@ bool SDSPI_ReadSector(sdspi_desc_t *desc, uint8_t *buff, uint32_t sector, uint32
  */
 bool SDSPI_WriteSector(sdspi_desc_t *desc, const uint8_t *buff, uint32_t sector, uint32_t count);
 
+/**
+ * Start reading data from storage device, the transfer runs in background
+ *
+ * The card stays selected until the transfer is finished, SDSPI_Process
+ * must be called periodically to advance it.
+ *
+ * @param desc	    Card descriptor
+ * @param buff		Read data buffer, must be valid until the transfer finishes
+ * @param sector	Start sector number
+ * @param count		Number of sectors to read
+ * @param cb        Callback called for each block read
+ * @return True if started, false if not responding or other transfer running
+ */
+bool SDSPI_ReadSectorAsync(sdspi_desc_t *desc, uint8_t *buff, uint32_t sector, uint32_t count,
+    sdspi_cb_t cb);
+
+/**
+ * Start writing data to storage device, the transfer runs in background
+ *
+ * The card stays selected until the transfer is finished, SDSPI_Process
+ * must be called periodically to advance it.
+ *
+ * @param desc	    Card descriptor
+ * @param buff		Write data buffer, must be valid until the transfer finishes
+ * @param sector	Start sector number
+ * @param count		Number of sectors to write
+ * @param cb        Callback called for each block written
+ * @return True if started, false if not responding or other transfer running
+ */
+bool SDSPI_WriteSectorAsync(sdspi_desc_t *desc, const uint8_t *buff, uint32_t sector,
+    uint32_t count, sdspi_cb_t cb);
+
+/**
+ * Advance the asynchronous transfer, never blocks for long
+ *
+ * @param desc	    Card descriptor
+ * @return True if the transfer is still running
+ */
+bool SDSPI_Process(sdspi_desc_t *desc);
+
+/**
+ * Erase range of sectors, erased sectors give faster and more predictable writes
+ *
+ * Only SD cards are supported, MMC uses different commands.
+ *
+ * @param desc	    Card descriptor
+ * @param start     First sector to erase
+ * @param end       Last sector to erase (inclusive)
+ * @return True on success, false if not supported, not responding, timed out,...
+ */
+bool SDSPI_Erase(sdspi_desc_t *desc, uint32_t start, uint32_t end);
+
 /**
  * Make sure there's no pending write process
  *
@@ -66,6 +161,14 @@ bool SDSPI_Sync(sdspi_desc_t *desc);
  */
 uint32_t SDSPI_GetSectorsCount(sdspi_desc_t *desc);
 
+/**
+ * Get identification of the card
+ *
+ * @param desc	    Card descriptor
+ * @return Card identification or NULL if card not initialized
+ */
+const sdspi_cid_t *SDSPI_GetCid(sdspi_desc_t *desc);
+
 /**
  * Mark the card as present or removed
  *
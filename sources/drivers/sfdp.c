@@ -0,0 +1,293 @@
+/**
+ * @file    drivers/sfdp.c
+ * @brief   Serial Flash Discoverable Parameters (JESD216) parser
+ */
+
+#include <string.h>
+#include <types.h>
+#include "drivers/sfdp.h"
+
+#define SFDP_SIGNATURE   0x50444653
+#define SFDP_MAJOR       1
+#define SFDP_BFPT_ID_LSB 0x00
+#define SFDP_BFPT_ID_MSB 0xff
+/** JESD216 defines at least 9 DWORDs of basic flash parameter table */
+#define SFDP_BFPT_MIN    9
+
+/** Memories up to 16 MB can be addressed by 3 bytes */
+#define ADDR3_MAX_SIZE (16UL * 1024 * 1024)
+
+#define CMD_FAST_READ 0x0b
+#define CMD_ENTER_4B  0xb7
+#define DEFAULT_PAGE  256
+
+/** DWORD 1 - address bytes field */
+enum {
+    ADDR_3_ONLY = 0,
+    ADDR_3_OR_4 = 1,
+    ADDR_4_ONLY = 2,
+};
+
+/** DWORD 16 - methods to enter 4 byte addressing */
+enum {
+    ENTER_4B_B7 = 0x01,      /** Issue 0xb7 */
+    ENTER_4B_WREN_B7 = 0x02, /** Issue write enable and 0xb7 */
+};
+
+/**
+ * Get DWORD from parameter table
+ *
+ * @param table     Parameter table
+ * @param n         DWORD number, starting from 1 as in JESD216
+ */
+static uint32_t Sfdpi_Dword(const uint8_t *table, uint8_t n)
+{
+    const uint8_t *p = &table[(n - 1) * 4];
+
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Get memory size in bytes from density DWORD
+ *
+ * @param density   DWORD 2 of basic table
+ * @return Size in bytes, 0 if not supported
+ */
+static uint32_t Sfdpi_GetSize(uint32_t density)
+{
+    uint32_t exp;
+
+    if ((density & 0x80000000) == 0) {
+        /* Density in bits minus one */
+        return density / 8 + 1;
+    }
+    exp = density & 0x7fffffff;
+    if (exp < 3 || exp - 3 >= 32) {
+        return 0;
+    }
+    return 1UL << (exp - 3);
+}
+
+/**
+ * Get max erase time from DWORD 10
+ *
+ * @param dword10   DWORD 10 of basic table
+ * @param type      Erase type index, starting from 0
+ * @return Max erase time in ms
+ */
+static uint32_t Sfdpi_GetEraseTime(uint32_t dword10, uint8_t type)
+{
+    static const uint16_t units_ms[] = { 1, 16, 128, 1000 };
+    uint8_t field = (dword10 >> (4 + 7 * type)) & 0x7f;
+    uint32_t typical = ((field & 0x1f) + 1) * units_ms[field >> 5];
+
+    /* max time is 2 * (multiplier + 1) * typical time */
+    return 2 * ((dword10 & 0x0f) + 1) * typical;
+}
+
+/**
+ * Get max page program time from DWORD 11
+ *
+ * @param dword11   DWORD 11 of basic table
+ * @return Max page program time in ms, rounded up
+ */
+static uint32_t Sfdpi_GetProgramTime(uint32_t dword11)
+{
+    uint8_t field = (dword11 >> 8) & 0x3f;
+    uint32_t typical_us = ((field & 0x1f) + 1) * ((field & 0x20) ? 64 : 8);
+    uint32_t max_us = 2 * ((dword11 & 0x0f) + 1) * typical_us;
+
+    return (max_us + 999) / 1000;
+}
+
+/**
+ * Get max chip erase time from DWORD 11
+ *
+ * @param dword10   DWORD 10 of basic table, contains max to typical time multiplier
+ * @param dword11   DWORD 11 of basic table
+ * @return Max chip erase time in ms
+ */
+static uint32_t Sfdpi_GetChipEraseTime(uint32_t dword10, uint32_t dword11)
+{
+    static const uint32_t units_ms[] = { 16, 256, 4000, 64000 };
+    uint8_t field = (dword11 >> 24) & 0x7f;
+    uint32_t typical = ((field & 0x1f) + 1) * units_ms[field >> 5];
+
+    return 2 * ((dword10 & 0x0f) + 1) * typical;
+}
+
+/**
+ * Read erase types from DWORDs 8 to 10, sort them by size
+ *
+ * Memories with non-uniform block layout (e.g. SST26) use the same command
+ * for several block sizes, such types are ignored as the block size at given
+ * address is unknown without sector map.
+ *
+ * @param bfpt          Basic flash parameter table
+ * @param dwords        Length of the table in DWORDs
+ * @param [out] params  Parameters to fill erase types to
+ */
+static void Sfdpi_GetErase(const uint8_t *bfpt, uint8_t dwords, sfdp_params_t *params)
+{
+    uint32_t dword;
+    sfdp_erase_t tmp;
+    uint8_t count = 0;
+    uint8_t cmd[SFDP_ERASE_TYPES] = { 0 };
+    bool unique;
+
+    for (uint8_t i = 0; i < SFDP_ERASE_TYPES; i++) {
+        dword = Sfdpi_Dword(bfpt, 8 + i / 2) >> (16 * (i % 2));
+        if ((dword & 0xff) != 0 && (dword & 0xff) < 32) {
+            cmd[i] = dword >> 8;
+        }
+    }
+
+    for (uint8_t i = 0; i < SFDP_ERASE_TYPES; i++) {
+        if (cmd[i] == 0) {
+            continue;
+        }
+        unique = true;
+        for (uint8_t j = 0; j < SFDP_ERASE_TYPES; j++) {
+            if (i != j && cmd[i] == cmd[j]) {
+                unique = false;
+            }
+        }
+        if (!unique) {
+            continue;
+        }
+
+        dword = Sfdpi_Dword(bfpt, 8 + i / 2) >> (16 * (i % 2));
+        params->erase[count].size = 1UL << (dword & 0xff);
+        params->erase[count].cmd = cmd[i];
+        params->erase[count].timeout_ms = SFDP_ERASE_TIMEOUT_MS;
+        if (dwords >= 10) {
+            params->erase[count].timeout_ms = Sfdpi_GetEraseTime(Sfdpi_Dword(bfpt, 10), i);
+        }
+        count++;
+    }
+
+    /* insertion sort, only few items */
+    for (uint8_t i = 1; i < count; i++) {
+        for (uint8_t j = i; j > 0 && params->erase[j - 1].size > params->erase[j].size; j--) {
+            tmp = params->erase[j];
+            params->erase[j] = params->erase[j - 1];
+            params->erase[j - 1] = tmp;
+        }
+    }
+}
+
+bool Sfdp_ParseHeader(const uint8_t *header, uint32_t *addr, uint8_t *dwords)
+{
+    uint32_t signature = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+
+    if (signature != SFDP_SIGNATURE || header[5] != SFDP_MAJOR) {
+        return false;
+    }
+    /* First parameter header always describes the basic table */
+    if (header[8] != SFDP_BFPT_ID_LSB || header[15] != SFDP_BFPT_ID_MSB ||
+        header[10] != SFDP_MAJOR || header[11] < SFDP_BFPT_MIN) {
+        return false;
+    }
+
+    *addr = header[12] | header[13] << 8 | (uint32_t)header[14] << 16;
+    *dwords = header[11];
+    return true;
+}
+
+bool Sfdp_ParseBfpt(const uint8_t *bfpt, uint8_t dwords, sfdp_params_t *params)
+{
+    uint32_t dword1;
+    uint8_t addr_mode, enter;
+
+    if (dwords < SFDP_BFPT_MIN) {
+        return false;
+    }
+    memset(params, 0, sizeof(sfdp_params_t));
+
+    params->size = Sfdpi_GetSize(Sfdpi_Dword(bfpt, 2));
+    if (params->size == 0) {
+        return false;
+    }
+
+    dword1 = Sfdpi_Dword(bfpt, 1);
+    Sfdpi_GetErase(bfpt, dwords, params);
+    if (params->erase[0].size == 0) {
+        /* Older tables without erase types, 4 kB erase only */
+        if ((dword1 & 0x03) != 0x01) {
+            return false;
+        }
+        params->erase[0].size = 4096;
+        params->erase[0].cmd = (dword1 >> 8) & 0xff;
+        params->erase[0].timeout_ms = SFDP_ERASE_TIMEOUT_MS;
+    }
+
+    params->page_size = DEFAULT_PAGE;
+    params->program_timeout_ms = SFDP_PROGRAM_TIMEOUT_MS;
+    params->chip_erase_timeout_ms = SFDP_CHIP_ERASE_TIMEOUT_MS;
+    if (dwords >= 11) {
+        params->page_size = 1U << ((Sfdpi_Dword(bfpt, 11) >> 4) & 0x0f);
+        params->program_timeout_ms = Sfdpi_GetProgramTime(Sfdpi_Dword(bfpt, 11));
+        params->chip_erase_timeout_ms = Sfdpi_GetChipEraseTime(Sfdpi_Dword(bfpt, 10),
+                                                               Sfdpi_Dword(bfpt, 11));
+    }
+
+    /* DWORD 12 bit 31 cleared if suspend is supported */
+    if (dwords >= 13 && (Sfdpi_Dword(bfpt, 12) & 0x80000000) == 0) {
+        params->suspend_cmd = Sfdpi_Dword(bfpt, 13) >> 24;
+        params->resume_cmd = Sfdpi_Dword(bfpt, 13) >> 16;
+    }
+
+    /* Fast read 1-1-1 is supported by all SFDP memories, 8 dummy clocks */
+    params->read_cmd = CMD_FAST_READ;
+    params->read_dummy = 1;
+
+    addr_mode = (dword1 >> 17) & 0x03;
+    switch (addr_mode) {
+        case ADDR_3_ONLY:
+            params->addr_bytes = 3;
+            break;
+        case ADDR_4_ONLY:
+            params->addr_bytes = 4;
+            break;
+        case ADDR_3_OR_4:
+            params->addr_bytes = 3;
+            if (params->size <= ADDR3_MAX_SIZE) {
+                break;
+            }
+            /* Older tables do not describe the method, 0xb7 is most common */
+            enter = ENTER_4B_B7;
+            if (dwords >= 16) {
+                enter = Sfdpi_Dword(bfpt, 16) >> 24;
+            }
+            if (enter & ENTER_4B_B7) {
+                params->addr4_cmd = CMD_ENTER_4B;
+            } else if (enter & ENTER_4B_WREN_B7) {
+                params->addr4_cmd = CMD_ENTER_4B;
+                params->addr4_wren = true;
+            }
+            if (params->addr4_cmd != 0) {
+                params->addr_bytes = 4;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    /* No supported way to address upper part, use what is reachable */
+    if (params->addr_bytes == 3 && params->size > ADDR3_MAX_SIZE) {
+        params->size = ADDR3_MAX_SIZE;
+    }
+    return true;
+}
+
+const sfdp_erase_t *Sfdp_GetErase(const sfdp_params_t *params, uint32_t addr, uint32_t len)
+{
+    for (int8_t i = SFDP_ERASE_TYPES - 1; i >= 0; i--) {
+        const sfdp_erase_t *erase = &params->erase[i];
+
+        if (erase->size != 0 && erase->size <= len && addr % erase->size == 0) {
+            return erase;
+        }
+    }
+    return NULL;
+}
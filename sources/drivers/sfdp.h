@@ -0,0 +1,95 @@
+/**
+ * @file    drivers/sfdp.h
+ * @brief   Serial Flash Discoverable Parameters (JESD216) parser
+ */
+
+#ifndef __DRIVERS_SFDP_H
+#define __DRIVERS_SFDP_H
+
+#include <types.h>
+
+/** SFDP header with first parameter header, enough to locate basic table */
+#define SFDP_HEADER_SIZE 16
+
+/** Basic flash parameter table DWORDs used by the parser (JESD216B) */
+#define SFDP_BFPT_DWORDS 16
+
+/** Max amount of erase types described in basic flash parameter table */
+#define SFDP_ERASE_TYPES 4
+
+/** Erase time used if not described by SFDP */
+#ifndef SFDP_ERASE_TIMEOUT_MS
+#define SFDP_ERASE_TIMEOUT_MS 2000
+#endif
+
+/** Page program time used if not described by SFDP */
+#ifndef SFDP_PROGRAM_TIMEOUT_MS
+#define SFDP_PROGRAM_TIMEOUT_MS 10
+#endif
+
+/** Chip erase time used if not described by SFDP, large memories take minutes */
+#ifndef SFDP_CHIP_ERASE_TIMEOUT_MS
+#define SFDP_CHIP_ERASE_TIMEOUT_MS 400000
+#endif
+
+/** Erase operation supported by the memory */
+typedef struct {
+    uint32_t size;       /**< Size of erased area in bytes, 0 if not supported */
+    uint32_t timeout_ms; /**< Max erase time */
+    uint8_t cmd;         /**< Erase command */
+} sfdp_erase_t;
+
+/** Flash parameters discovered from SFDP */
+typedef struct {
+    uint32_t size;       /**< Memory size in bytes */
+    uint16_t page_size;  /**< Program page size in bytes */
+    uint8_t addr_bytes;  /**< Address length to use, 3 or 4 */
+    uint8_t addr4_cmd;   /**< Command entering 4 byte address mode, 0 if not needed */
+    bool addr4_wren;     /**< Write enable must precede addr4_cmd */
+    uint8_t read_cmd;    /**< Read command to use */
+    uint8_t read_dummy;  /**< Dummy bytes to send after address in read command */
+    uint8_t suspend_cmd; /**< Erase suspend command, 0 if not supported */
+    uint8_t resume_cmd;  /**< Erase resume command */
+    uint32_t program_timeout_ms;    /**< Max page program time */
+    uint32_t chip_erase_timeout_ms; /**< Max chip erase time */
+    sfdp_erase_t erase[SFDP_ERASE_TYPES]; /**< Erase types, sorted by size ascending */
+} sfdp_params_t;
+
+/**
+ * Locate basic flash parameter table in SFDP header
+ *
+ * @param header        First SFDP_HEADER_SIZE bytes of SFDP area
+ * @param [out] addr    Address of the basic parameter table in SFDP area
+ * @param [out] dwords  Length of the table in DWORDs
+ * @return False if SFDP signature or basic parameter header not found
+ */
+bool Sfdp_ParseHeader(const uint8_t *header, uint32_t *addr, uint8_t *dwords);
+
+/**
+ * Parse basic flash parameter table and select commands usable on single line SPI
+ *
+ * Fast read with dummy byte is used when available as the normal read is
+ * usually limited to much lower clock. 4 byte addressing is selected for
+ * memories bigger than 16 MB.
+ *
+ * @param bfpt          Basic flash parameter table
+ * @param dwords        Length of the table in DWORDs
+ * @param [out] params  Discovered parameters
+ * @return False if the table is malformed or the memory cannot be used
+ */
+bool Sfdp_ParseBfpt(const uint8_t *bfpt, uint8_t dwords, sfdp_params_t *params);
+
+/**
+ * Select the largest erase operation usable at given address
+ *
+ * Used to cover a range with the fewest erase commands, the erased area must
+ * be aligned to its size and fit into the range.
+ *
+ * @param params    Memory parameters
+ * @param addr      Start of area to be erased
+ * @param len       Length of area to be erased
+ * @return Erase operation or NULL if none fits
+ */
+const sfdp_erase_t *Sfdp_GetErase(const sfdp_params_t *params, uint32_t addr, uint32_t len);
+
+#endif
@@ -1,8 +1,9 @@
 /**
- * @file    drivers/spi_flash.h
- * @brief   Driver for SST26 SPI flash memories
+ * @file    drivers/spi_flash.c
+ * @brief   Driver for SPI NOR flash memories, parameters discovered by SFDP
  */
 
+#include <string.h>
 #include <types.h>
 #include "utils/time.h"
 #include "hal/io.h"
@@ -11,9 +12,9 @@
 #include "drivers/spi_flash.h"
 
 #define PAGE_BYTES         256
-#define CHIP_ERASE_TIME_MS 40
-#define PAGE_ERASE_TIME_MS 20
-#define WRITE_PAGE_TIME_MS 2
+#define SECTOR_BYTES       4096
+/* Max time to suspend erase, datasheets state tens of us */
+#define SUSPEND_TIME_MS    2
 
 #define cs_set()   IOd_SetLine(desc->cs_port, desc->cs_pad, 0)
 #define cs_unset() IOd_SetLine(desc->cs_port, desc->cs_pad, 1)
@@ -37,6 +38,7 @@ typedef enum {
     CMD_EQIO = 0x38,   /** enable quad io */
     CMD_RSTQIO = 0xff, /** reset quad io */
     CMD_RDSR = 0x05,   /** read status reg */
+    CMD_EN4B = 0xb7,   /** enter 4 byte address mode */
 
     /* read */
     CMD_READ = 0x03,   /** read memory */
@@ -47,6 +49,7 @@ typedef enum {
     /* Identification */
     CMD_JEDEC = 0x9f, /** read jedec id */
     CMD_QJID = 0xaf,  /** read quad IO J-ID */
+    CMD_SFDP = 0x5a,  /** read serial flash discoverable parameters */
 
     /* write */
     CMD_WREN = 0x06, /** write enable */
@@ -72,24 +75,28 @@ typedef enum {
  *
  * @param desc      The device descriptor
  * @param cmd       Command
- * @param addr      24 bytes of address
+ * @param addr      Address, 3 or 4 bytes are sent according to memory mode
  * @param dummy     Amount (up to 4) of dummy bytes to send after address
  * @param release_cs    Release cs pin after sending data
  */
 static void SpiFlashi_CmdWithAddr(const spiflash_desc_t *desc, spiflash_cmd_t cmd, uint32_t addr,
     uint8_t dummy, bool release_cs)
 {
-    uint8_t data[8] = { 0 };
+    uint8_t data[9] = { 0 };
+    uint8_t len = 0;
 
     ASSERT_NOT(dummy > 4);
 
-    data[0] = cmd;
-    data[1] = addr >> 16;
-    data[2] = addr >> 8;
-    data[3] = addr;
+    data[len++] = cmd;
+    if (desc->param.addr_bytes == 4) {
+        data[len++] = addr >> 24;
+    }
+    data[len++] = addr >> 16;
+    data[len++] = addr >> 8;
+    data[len++] = addr;
 
     cs_set();
-    SPId_Send(desc->spi_device, data, 4 + dummy);
+    SPId_Send(desc->spi_device, data, len + dummy);
 
     if (release_cs) {
         cs_unset();
@@ -109,28 +116,155 @@ static void SpiFlashi_Cmd(const spiflash_desc_t *desc, spiflash_cmd_t cmd)
     cs_unset();
 }
 
+/**
+ * Read status register
+ *
+ * @param desc      The device descriptor
+ * @return Status register value
+ */
+static uint8_t SpiFlashi_ReadStatus(const spiflash_desc_t *desc)
+{
+    const uint8_t cmd = CMD_RDSR;
+    uint8_t status;
+
+    cs_set();
+    SPId_Send(desc->spi_device, &cmd, 1);
+    status = SPId_Transceive(desc->spi_device, 0xff);
+    cs_unset();
+    return status;
+}
+
 /**
  * Wait for flash operation to finish
  *
  * @param desc      The device descriptor
  * @param timeout_ms    Time to wait for op to finish
+ * @return False if the memory is still busy after the timeout
  */
-static void SpiFlashi_WaitReady(const spiflash_desc_t *desc, uint32_t timeout_ms)
+static bool SpiFlashi_WaitReady(const spiflash_desc_t *desc, uint32_t timeout_ms)
 {
     const uint8_t cmd = CMD_RDSR;
     uint32_t start = millis();
+    bool ready = false;
 
     cs_set();
     SPId_Send(desc->spi_device, &cmd, 1);
 
-    while ((millis() - start) < timeout_ms) {
+    /* Timer tick may come right after the start, the whole timeout elapses */
+    while ((millis() - start) <= timeout_ms) {
         /* continuously read status register, command send only once */
         if ((SPId_Transceive(desc->spi_device, 0xff) & STATUS_BUSY) == 0) {
+            ready = true;
             break;
         }
     }
 
     cs_unset();
+    return ready;
+}
+
+/**
+ * Read SFDP area, always uses 3 byte address and 8 dummy clocks
+ *
+ * @param desc      The device descriptor
+ * @param addr      Address in SFDP area
+ * @param [out] buf Buffer to read data to
+ * @param len       Amount of bytes to read
+ */
+static void SpiFlashi_ReadSfdp(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf,
+    size_t len)
+{
+    uint8_t data[5] = { CMD_SFDP, addr >> 16, addr >> 8, addr, 0 };
+
+    cs_set();
+    SPId_Send(desc->spi_device, data, sizeof(data));
+    SPId_Receive(desc->spi_device, buf, len);
+    cs_unset();
+}
+
+/**
+ * Discover memory parameters and switch to 4 byte addressing if needed
+ *
+ * @param desc      The device descriptor
+ * @return False if SFDP is not supported
+ */
+static bool SpiFlashi_Probe(spiflash_desc_t *desc)
+{
+    uint8_t buf[SFDP_BFPT_DWORDS * 4];
+    uint32_t addr;
+    uint8_t dwords;
+
+    SpiFlashi_ReadSfdp(desc, 0, buf, SFDP_HEADER_SIZE);
+    if (!Sfdp_ParseHeader(buf, &addr, &dwords)) {
+        return false;
+    }
+
+    /* Newer revisions may add DWORDs unknown to the parser */
+    if (dwords > SFDP_BFPT_DWORDS) {
+        dwords = SFDP_BFPT_DWORDS;
+    }
+    SpiFlashi_ReadSfdp(desc, addr, buf, dwords * 4);
+    if (!Sfdp_ParseBfpt(buf, dwords, &desc->param)) {
+        return false;
+    }
+
+    if (desc->param.addr4_cmd != 0) {
+        if (desc->param.addr4_wren) {
+            SpiFlashi_Cmd(desc, CMD_WREN);
+        }
+        SpiFlashi_Cmd(desc, desc->param.addr4_cmd);
+    }
+    return true;
+}
+
+/**
+ * Find erase operation of given size
+ *
+ * @param desc      The device descriptor
+ * @param size      Size of erased area
+ * @return Erase operation or NULL if not supported
+ */
+static const sfdp_erase_t *SpiFlashi_FindErase(const spiflash_desc_t *desc, uint32_t size)
+{
+    for (uint8_t i = 0; i < SFDP_ERASE_TYPES; i++) {
+        if (desc->param.erase[i].size == size) {
+            return &desc->param.erase[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Get max time of sector erase
+ *
+ * @param desc      The device descriptor
+ * @return Sector erase timeout in ms
+ */
+static uint32_t SpiFlashi_SectorTimeout(const spiflash_desc_t *desc)
+{
+    const sfdp_erase_t *erase = SpiFlashi_FindErase(desc, SECTOR_BYTES);
+
+    if (erase == NULL) {
+        return SFDP_ERASE_TIMEOUT_MS;
+    }
+    return erase->timeout_ms;
+}
+
+/**
+ * Erase block and wait for the operation to finish
+ *
+ * @param desc      The device descriptor
+ * @param erase     Erase operation to use
+ * @param addr      Block address, aligned to block size
+ */
+static void SpiFlashi_EraseBlock(const spiflash_desc_t *desc, const sfdp_erase_t *erase,
+    uint32_t addr)
+{
+    SpiFlashi_WaitReady(desc, SpiFlashi_SectorTimeout(desc));
+    SpiFlashi_Cmd(desc, CMD_WREN);
+    SpiFlashi_CmdWithAddr(desc, erase->cmd, addr, 0, true);
+    SpiFlashi_WaitReady(desc, erase->timeout_ms);
+    SpiFlashi_Cmd(desc, CMD_WRDI);
 }
 
 /**
@@ -165,29 +299,70 @@ void SpiFlash_WriteUnlock(const spiflash_desc_t *desc)
     SpiFlashi_WriteDisable(desc);
 }
 
-void SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf, size_t len)
+bool SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf, size_t len)
 {
-    SpiFlashi_CmdWithAddr(desc, CMD_READ, addr, 0, false);
+    bool suspended = false;
+
+    /* Erase started by SpiFlash_EraseSectorStart may be running */
+    if (SpiFlashi_ReadStatus(desc) & STATUS_BUSY) {
+        if (desc->param.suspend_cmd != 0) {
+            SpiFlashi_Cmd(desc, desc->param.suspend_cmd);
+            suspended = true;
+        }
+        if (!SpiFlashi_WaitReady(desc, suspended ? SUSPEND_TIME_MS :
+                                                   SpiFlashi_SectorTimeout(desc))) {
+            /* Resume is ignored if the suspend didn't take effect */
+            if (suspended) {
+                SpiFlashi_Cmd(desc, desc->param.resume_cmd);
+            }
+            return false;
+        }
+    }
+
+    SpiFlashi_CmdWithAddr(desc, desc->param.read_cmd, addr, desc->param.read_dummy, false);
     SPId_Receive(desc->spi_device, buf, len);
     cs_unset();
+
+    if (suspended) {
+        SpiFlashi_Cmd(desc, desc->param.resume_cmd);
+    }
+    return true;
+}
+
+void SpiFlash_ReadStart(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf, size_t len)
+{
+    /* Suspended erase would have to be resumed from SpiFlash_ReadFinish, wait instead */
+    SpiFlashi_WaitReady(desc, SpiFlashi_SectorTimeout(desc));
+
+    SpiFlashi_CmdWithAddr(desc, desc->param.read_cmd, addr, desc->param.read_dummy, false);
+    SPId_TransferDma(desc->spi_device, NULL, buf, len);
+}
+
+void SpiFlash_ReadFinish(const spiflash_desc_t *desc)
+{
+    while (SPId_DmaBusy(desc->spi_device)) {
+        ;
+    }
+    cs_unset();
 }
 
 void SpiFlash_Write(const spiflash_desc_t *desc, uint32_t addr, const uint8_t *buf, size_t len)
 {
     uint16_t bytes;
 
-    /* up to 256 bytes in single write */
+    SpiFlashi_WaitReady(desc, SpiFlashi_SectorTimeout(desc));
+
+    /* Page program wraps at page boundary, never cross it */
     while (len != 0) {
-        if (len >= PAGE_BYTES) {
-            bytes = PAGE_BYTES;
-        } else {
+        bytes = desc->param.page_size - addr % desc->param.page_size;
+        if (len < bytes) {
             bytes = len;
         }
         SpiFlashi_WriteEnable(desc);
         SpiFlashi_CmdWithAddr(desc, CMD_PP, addr, 0, false);
         SPId_Send(desc->spi_device, buf, bytes);
         cs_unset();
-        SpiFlashi_WaitReady(desc, WRITE_PAGE_TIME_MS);
+        SpiFlashi_WaitReady(desc, desc->param.program_timeout_ms);
 
         buf += bytes;
         addr += bytes;
@@ -198,18 +373,65 @@ void SpiFlash_Write(const spiflash_desc_t *desc, uint32_t addr, const uint8_t *b
 
 void SpiFlash_Erase(const spiflash_desc_t *desc)
 {
+    SpiFlashi_WaitReady(desc, SpiFlashi_SectorTimeout(desc));
     SpiFlashi_WriteEnable(desc);
     SpiFlashi_Cmd(desc, CMD_CE);
-    SpiFlashi_WaitReady(desc, CHIP_ERASE_TIME_MS);
+    SpiFlashi_WaitReady(desc, desc->param.chip_erase_timeout_ms);
     SpiFlashi_WriteDisable(desc);
 }
 
 void SpiFlash_EraseSector(const spiflash_desc_t *desc, uint32_t addr)
 {
+    SpiFlash_EraseSectorStart(desc, addr);
+    SpiFlashi_WaitReady(desc, SpiFlashi_SectorTimeout(desc));
+    SpiFlashi_WriteDisable(desc);
+}
+
+void SpiFlash_EraseSectorStart(const spiflash_desc_t *desc, uint32_t addr)
+{
+    SpiFlashi_WaitReady(desc, SpiFlashi_SectorTimeout(desc));
     SpiFlashi_WriteEnable(desc);
     SpiFlashi_CmdWithAddr(desc, CMD_SE, addr, 0, true);
-    SpiFlashi_WaitReady(desc, PAGE_ERASE_TIME_MS);
-    SpiFlashi_WriteDisable(desc);
+}
+
+bool SpiFlash_EraseBlock(const spiflash_desc_t *desc, uint32_t addr, uint32_t size)
+{
+    const sfdp_erase_t *erase = SpiFlashi_FindErase(desc, size);
+
+    if (erase == NULL || addr % size != 0) {
+        return false;
+    }
+    SpiFlashi_EraseBlock(desc, erase, addr);
+    return true;
+}
+
+bool SpiFlash_EraseRange(const spiflash_desc_t *desc, uint32_t addr, uint32_t len)
+{
+    const sfdp_erase_t *erase;
+    uint32_t min_size = desc->param.erase[0].size;
+
+    if (addr % min_size != 0 || len % min_size != 0) {
+        return false;
+    }
+
+    /* Largest aligned blocks in the middle, smaller ones towards the edges */
+    while (len != 0) {
+        erase = Sfdp_GetErase(&desc->param, addr, len);
+        SpiFlashi_EraseBlock(desc, erase, addr);
+        addr += erase->size;
+        len -= erase->size;
+    }
+    return true;
+}
+
+bool SpiFlash_IsBusy(const spiflash_desc_t *desc)
+{
+    return (SpiFlashi_ReadStatus(desc) & STATUS_BUSY) != 0;
+}
+
+uint32_t SpiFlash_GetSize(const spiflash_desc_t *desc)
+{
+    return desc->param.size;
 }
 
 void SpiFlash_Init(spiflash_desc_t *desc, uint8_t spi_device, uint32_t cs_port, uint8_t cs_pad)
@@ -217,6 +439,21 @@ void SpiFlash_Init(spiflash_desc_t *desc, uint8_t spi_device, uint32_t cs_port,
     desc->spi_device = spi_device;
     desc->cs_port = cs_port;
     desc->cs_pad = cs_pad;
+
+    if (!SpiFlashi_Probe(desc)) {
+        /* Basic commands supported by all memories */
+        memset(&desc->param, 0, sizeof(desc->param));
+        desc->param.page_size = PAGE_BYTES;
+        desc->param.addr_bytes = 3;
+        desc->param.read_cmd = CMD_READ;
+        desc->param.erase[0].size = SECTOR_BYTES;
+        desc->param.erase[0].cmd = CMD_SE;
+        desc->param.erase[0].timeout_ms = SFDP_ERASE_TIMEOUT_MS;
+        desc->param.program_timeout_ms = SFDP_PROGRAM_TIMEOUT_MS;
+        desc->param.chip_erase_timeout_ms = SFDP_CHIP_ERASE_TIMEOUT_MS;
+        desc->param.suspend_cmd = CMD_WRSU;
+        desc->param.resume_cmd = CMD_WRRE;
+    }
 }
 
 /** @} */
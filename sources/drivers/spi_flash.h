@@ -1,17 +1,19 @@
 /**
  * @file    drivers/spi_flash.h
- * @brief   Driver for SST26 SPI flash memories
+ * @brief   Driver for SPI NOR flash memories, parameters discovered by SFDP
  */
 
 #ifndef __DRIVERS_SPI_FLASH_H
 #define __DRIVERS_SPI_FLASH_H
 
 #include <types.h>
+#include "drivers/sfdp.h"
 
 typedef struct {
-    uint8_t spi_device; /**< SPI device the flash is connected to */
-    uint32_t cs_port;   /**< MCU port the CS is connected to */
-    uint8_t cs_pad;     /**< MCU pin the CS is connected to */
+    uint8_t spi_device;  /**< SPI device the flash is connected to */
+    uint32_t cs_port;    /**< MCU port the CS is connected to */
+    uint8_t cs_pad;      /**< MCU pin the CS is connected to */
+    sfdp_params_t param; /**< Memory parameters, size is 0 if SFDP not available */
 } spiflash_desc_t;
 
 /**
@@ -26,16 +28,44 @@ void SpiFlash_WriteUnlock(const spiflash_desc_t *desc);
 /**
  * Read memory content
  *
+ * If a sector erase is running, it is suspended for the time of the read when
+ * supported by the memory, otherwise the read waits for the erase to finish.
+ * Data read from the sector being erased are undefined.
+ *
  * @param desc      The device descriptor
  * @param addr      Address to read from
  * @param [out] buf Buffer to read data to
  * @param len       Amount of bytes to read
+ * @return False if the erase was not suspended or finished in time, nothing is read
+ */
+bool SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf, size_t len);
+
+/**
+ * Start memory read using DMA, returns immediately
+ *
+ * Waits for running erase or write to finish first. No other memory
+ * operation can be started until SpiFlash_ReadFinish is called.
+ *
+ * @param desc      The device descriptor
+ * @param addr      Address to read from
+ * @param [out] buf Buffer to read data to, must stay valid until the read finishes
+ * @param len       Amount of bytes to read
+ */
+void SpiFlash_ReadStart(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf, size_t len);
+
+/**
+ * Wait for read started by SpiFlash_ReadStart to finish
+ *
+ * @param desc      The device descriptor
  */
-void SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf, size_t len);
+void SpiFlash_ReadFinish(const spiflash_desc_t *desc);
 
 /**
  * Write data to memory
  *
+ * The data are split on page boundaries, the address does not have to be
+ * aligned. Waits for running erase to finish first.
+ *
  * @param desc      The device descriptor
  * @param addr      Address to write to
  * @param [out] buf Data to be written
@@ -54,12 +84,67 @@ void SpiFlash_Erase(const spiflash_desc_t *desc);
  * Erase memory sector
  *
  * @param desc      The device descriptor
+ * @param addr      Address in sector to be erased
  */
 void SpiFlash_EraseSector(const spiflash_desc_t *desc, uint32_t addr);
 
+/**
+ * Start sector erase without waiting for it to finish
+ *
+ * Use SpiFlash_IsBusy to check for completion. Reads are served meanwhile,
+ * writes and erases wait for the operation to finish.
+ *
+ * @param desc      The device descriptor
+ * @param addr      Address in sector to be erased
+ */
+void SpiFlash_EraseSectorStart(const spiflash_desc_t *desc, uint32_t addr);
+
+/**
+ * Erase single block
+ *
+ * Block sizes supported by the memory are read from SFDP, usually 4, 32 and
+ * 64 kB. Memories with non-uniform layout (e.g. SST26) support 4 kB only.
+ *
+ * @param desc      The device descriptor
+ * @param addr      Block address, aligned to block size
+ * @param size      Block size in bytes
+ * @return False if block size not supported or address not aligned
+ */
+bool SpiFlash_EraseBlock(const spiflash_desc_t *desc, uint32_t addr, uint32_t size);
+
+/**
+ * Erase memory range using the fewest erase operations
+ *
+ * @param desc      The device descriptor
+ * @param addr      Range start, aligned to smallest block (usually 4 kB)
+ * @param len       Range length, multiple of smallest block
+ * @return False if the range is not aligned, nothing is erased then
+ */
+bool SpiFlash_EraseRange(const spiflash_desc_t *desc, uint32_t addr, uint32_t len);
+
+/**
+ * Check if memory is busy with write or erase operation
+ *
+ * @param desc      The device descriptor
+ * @return True if busy
+ */
+bool SpiFlash_IsBusy(const spiflash_desc_t *desc);
+
+/**
+ * Get memory size discovered from SFDP
+ *
+ * @param desc      The device descriptor
+ * @return Memory size in bytes, 0 if unknown
+ */
+uint32_t SpiFlash_GetSize(const spiflash_desc_t *desc);
+
 /**
  * Initialize the memory
  *
+ * Memory parameters are read from SFDP if available, fast read and 4 byte
+ * addressing are used when supported. The basic read command and 3 byte
+ * addresses are used otherwise.
+ *
  * @param [out] desc        The device descriptor
  * @param spi_device        The SPI device to use
  * @param cs_port           MCU port with CS pin
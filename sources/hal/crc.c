@@ -0,0 +1,168 @@
+/**
+ * @file    hal/crc.c
+ * @brief   CRC calculation unit driver
+ */
+
+#include <types.h>
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/rcc.h>
+
+#include "hal/crc.h"
+
+/* DMA1 channel for memory to CRC unit transfers, CPU is used while the channel is busy */
+#ifndef CRCD_DMA_CHANNEL
+#define CRCD_DMA_CHANNEL DMA_CHANNEL5
+#endif
+/* Buffers at least this long are fed by DMA, the CPU is used for shorter ones */
+#ifndef CRCD_DMA_THRESHOLD
+#define CRCD_DMA_THRESHOLD 256U
+#endif
+
+/** Byte access to data register, single byte is added to the crc */
+#define CRCD_DR8 MMIO8(CRC_BASE)
+
+/**
+ * Check if the DMA channel can be used, it may be running a transfer of other driver
+ *
+ * @return True if the channel is not enabled
+ */
+static bool Crcdi_DmaAvailable(void)
+{
+    return !(DMA_CCR(DMA1, CRCD_DMA_CHANNEL) & DMA_CCR_EN);
+}
+
+/**
+ * Feed data to the CRC unit by DMA, wait for the transfer to finish
+ *
+ * @param buf       Data to be fed, 4 bytes aligned for word transfers
+ * @param count     Amount of transfers
+ * @param words     True for word transfers, bytes otherwise
+ */
+static void Crcdi_Dma(const uint8_t *buf, uint32_t count, bool words)
+{
+    rcc_periph_clock_enable(RCC_DMA1);
+    while (count != 0) {
+        uint16_t transfers = count > 0xffff ? 0xffff : count;
+
+        dma_channel_reset(DMA1, CRCD_DMA_CHANNEL);
+        dma_set_number_of_data(DMA1, CRCD_DMA_CHANNEL, transfers);
+        dma_enable_mem2mem_mode(DMA1, CRCD_DMA_CHANNEL);
+
+        dma_set_peripheral_address(DMA1, CRCD_DMA_CHANNEL, (uint32_t)&CRC_DR);
+        dma_set_peripheral_size(DMA1, CRCD_DMA_CHANNEL,
+                                words ? DMA_CCR_PSIZE_32BIT : DMA_CCR_PSIZE_8BIT);
+        dma_disable_peripheral_increment_mode(DMA1, CRCD_DMA_CHANNEL);
+        dma_set_read_from_memory(DMA1, CRCD_DMA_CHANNEL);
+
+        dma_set_memory_address(DMA1, CRCD_DMA_CHANNEL, (uint32_t)buf);
+        dma_set_memory_size(DMA1, CRCD_DMA_CHANNEL,
+                            words ? DMA_CCR_MSIZE_32BIT : DMA_CCR_MSIZE_8BIT);
+        dma_enable_memory_increment_mode(DMA1, CRCD_DMA_CHANNEL);
+
+        dma_enable_channel(DMA1, CRCD_DMA_CHANNEL);
+        while (!dma_get_interrupt_flag(DMA1, CRCD_DMA_CHANNEL, DMA_TCIF)) {
+            ;
+        }
+        dma_clear_interrupt_flags(DMA1, CRCD_DMA_CHANNEL, DMA_TCIF);
+        dma_disable_channel(DMA1, CRCD_DMA_CHANNEL);
+
+        buf += words ? transfers * 4U : transfers;
+        count -= transfers;
+    }
+}
+
+/**
+ * Feed data to the CRC unit in memory order
+ *
+ * Words are processed from the most significant bit, their byte order is
+ * swapped when written by CPU. DMA can't swap bytes, words are fed for
+ * reflected crc only, with bit order of the whole word reversed by the unit.
+ *
+ * @param buf       Data to calculate crc for
+ * @param len       Length of data buffer
+ * @param reflected True to process bits of each byte from the least significant one
+ */
+static void Crcdi_Feed(const uint8_t *buf, uint32_t len, bool reflected)
+{
+    uint32_t rev_in = reflected ? CRC_CR_REV_IN_BYTE : CRC_CR_REV_IN_NONE;
+    uint32_t words;
+
+    crc_set_reverse_input(rev_in);
+    while ((len != 0) && ((uint32_t)buf & 0x3UL)) {
+        CRCD_DR8 = *buf++;
+        len--;
+    }
+
+    if (len >= CRCD_DMA_THRESHOLD && Crcdi_DmaAvailable()) {
+        if (reflected) {
+            words = len / 4;
+            crc_set_reverse_input(CRC_CR_REV_IN_WORD);
+            Crcdi_Dma(buf, words, true);
+            crc_set_reverse_input(rev_in);
+            buf += words * 4;
+            len -= words * 4;
+        } else {
+            Crcdi_Dma(buf, len, false);
+            len = 0;
+        }
+    }
+
+    while (len >= 4) {
+        CRC_DR = __builtin_bswap32(*(const uint32_t *)buf);
+        buf += 4;
+        len -= 4;
+    }
+    while (len != 0) {
+        CRCD_DR8 = *buf++;
+        len--;
+    }
+}
+
+/**
+ * Reverse bit order of a word
+ *
+ * @param value     Word to reverse
+ * @return Reversed word
+ */
+static uint32_t Crcdi_Reverse(uint32_t value)
+{
+    uint32_t reversed = 0;
+
+    for (uint8_t i = 0; i < 32; i++) {
+        reversed = (reversed << 1) | (value & 0x1);
+        value >>= 1;
+    }
+    return reversed;
+}
+
+uint32_t Crcd_Crc32(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    rcc_periph_clock_enable(RCC_CRC);
+#ifdef CRC_USE_HW_CRC16
+    crc_set_polysize(CRC_CR_POLYSIZE_32);
+    crc_set_polynomial(0x04c11db7);
+#endif
+    crc_reverse_output_enable();
+    /* Output is reversed by the unit, the initial value is not */
+    crc_set_initial(Crcdi_Reverse(~crc));
+    crc_reset();
+
+    Crcdi_Feed(buf, len, true);
+    return ~CRC_DR;
+}
+
+#ifdef CRC_USE_HW_CRC16
+uint16_t Crcd_Crc16(uint16_t crc, const uint8_t *buf, uint32_t len)
+{
+    rcc_periph_clock_enable(RCC_CRC);
+    crc_set_polysize(CRC_CR_POLYSIZE_16);
+    crc_set_polynomial(0x1021);
+    crc_reverse_output_disable();
+    crc_set_initial(crc);
+    crc_reset();
+
+    Crcdi_Feed(buf, len, false);
+    return CRC_DR & 0xffff;
+}
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file    hal/crc.h
+ * @brief   CRC calculation unit driver
+ *
+ * Used by utils/crc.c when CRC_USE_HW (and CRC_USE_HW_CRC16) is defined.
+ * Buffers of at least CRCD_DMA_THRESHOLD bytes are fed to the unit by DMA
+ * (channel CRCD_DMA_CHANNEL of DMA1) unless the channel is enabled by other
+ * driver (e.g. SPI2 transfer in progress), CPU is used then. The unit is not
+ * shared safely, the functions must not be called from interrupts and other
+ * drivers must not start transfers on the channel from interrupts.
+ */
+
+#ifndef __HAL_CRC_H
+#define __HAL_CRC_H
+
+#include <types.h>
+
+/**
+ * Calculate CRC32 (polynomial 0x04c11db7 reflected, zlib compatible)
+ *
+ * @param crc       CRC of preceding data, 0 for first data
+ * @param buf       Data to calculate crc for
+ * @param len       Length of data buffer
+ * @return CRC32 value
+ */
+uint32_t Crcd_Crc32(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#ifdef CRC_USE_HW_CRC16
+/**
+ * Calculate CRC16 (polynomial 0x1021, not reflected)
+ *
+ * Requires CRC unit with programmable polynomial.
+ *
+ * @param crc       CRC of preceding data or initial value
+ * @param buf       Data to calculate crc for
+ * @param len       Length of data buffer
+ * @return CRC16 value
+ */
+uint16_t Crcd_Crc16(uint16_t crc, const uint8_t *buf, uint32_t len);
+#endif
+
+#endif
@@ -6,6 +6,7 @@
 #include <types.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma.h>
 #include "hal/spi.h"
 
 static const uint32_t spidi_regs[] = {
@@ -28,10 +29,25 @@ static const uint32_t spidi_rcc[] = {
 #endif
 };
 
+/** DMA channels connected to SPI rx and tx requests */
+static const uint8_t spidi_dma_rx[] = {
+    DMA_CHANNEL2,
+#ifdef SPI2_BASE
+    DMA_CHANNEL4,
+#endif
+};
+
+static const uint8_t spidi_dma_tx[] = {
+    DMA_CHANNEL3,
+#ifdef SPI2_BASE
+    DMA_CHANNEL5,
+#endif
+};
+
 /**
  * Get SPI device address from device id
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  * @return Address of the device's base register
  */
 static uint32_t SPIdi_GetDevice(uint8_t device)
@@ -43,7 +59,7 @@ static uint32_t SPIdi_GetDevice(uint8_t device)
 /**
  * Get SPI device rcc register
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  * @return Address of the device's rcc register
  */
 static enum rcc_periph_clken SPIdi_GetRcc(uint8_t device)
@@ -94,12 +110,103 @@ void SPId_Receive(uint8_t device, uint8_t *buf, size_t len)
     }
 }
 
+/**
+ * Configure DMA channel for 8 bit transfers from/to SPI data register
+ *
+ * @param spi       Address of the spi peripheral
+ * @param channel   DMA channel
+ * @param mem       Memory address
+ * @param increment Increment memory address after each byte
+ * @param len       Amount of bytes to transfer
+ */
+static void SPIdi_SetupDma(uint32_t spi, uint8_t channel, uint32_t mem, bool increment, size_t len)
+{
+    dma_channel_reset(DMA1, channel);
+    dma_set_priority(DMA1, channel, DMA_CCR_PL_HIGH);
+    dma_set_number_of_data(DMA1, channel, len);
+
+    dma_set_peripheral_address(DMA1, channel, (uint32_t)&SPI_DR(spi));
+    dma_set_peripheral_size(DMA1, channel, DMA_CCR_PSIZE_8BIT);
+    dma_disable_peripheral_increment_mode(DMA1, channel);
+
+    dma_set_memory_address(DMA1, channel, mem);
+    dma_set_memory_size(DMA1, channel, DMA_CCR_MSIZE_8BIT);
+    if (increment) {
+        dma_enable_memory_increment_mode(DMA1, channel);
+    }
+}
+
+void SPId_TransferDma(uint8_t device, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+    static const uint8_t dummy_tx = 0xff;
+    static uint8_t dummy_rx;
+    uint32_t spi;
+    uint8_t rx_ch;
+    uint8_t tx_ch;
+
+    ASSERT_NOT(device == 0 || device > sizeof(spidi_dma_rx) / sizeof(spidi_dma_rx[0]));
+    spi = SPIdi_GetDevice(device);
+    rx_ch = spidi_dma_rx[device - 1];
+    tx_ch = spidi_dma_tx[device - 1];
+
+    ASSERT_NOT(len == 0 || len > 0xffff);
+
+    rcc_periph_clock_enable(RCC_DMA1);
+    SPIdi_SetupDma(spi, rx_ch, rx != NULL ? (uint32_t)rx : (uint32_t)&dummy_rx, rx != NULL, len);
+    dma_set_read_from_peripheral(DMA1, rx_ch);
+    SPIdi_SetupDma(spi, tx_ch, tx != NULL ? (uint32_t)tx : (uint32_t)&dummy_tx, tx != NULL, len);
+    dma_set_read_from_memory(DMA1, tx_ch);
+
+    /* Rx must be enabled first to not miss any data */
+    spi_enable_rx_dma(spi);
+    dma_enable_channel(DMA1, rx_ch);
+    dma_enable_channel(DMA1, tx_ch);
+    spi_enable_tx_dma(spi);
+}
+
+bool SPId_DmaBusy(uint8_t device)
+{
+    uint32_t spi;
+    uint8_t rx_ch;
+    uint8_t tx_ch;
+
+    ASSERT_NOT(device == 0 || device > sizeof(spidi_dma_rx) / sizeof(spidi_dma_rx[0]));
+    spi = SPIdi_GetDevice(device);
+    rx_ch = spidi_dma_rx[device - 1];
+    tx_ch = spidi_dma_tx[device - 1];
+
+    /* Last byte received means the transfer is finished */
+    if (DMA_CNDTR(DMA1, rx_ch) != 0) {
+        return true;
+    }
+
+    spi_disable_tx_dma(spi);
+    spi_disable_rx_dma(spi);
+    dma_disable_channel(DMA1, tx_ch);
+    dma_disable_channel(DMA1, rx_ch);
+    return false;
+}
+
 spid_prescaler_t SPId_GetPrescaler(uint8_t device)
 {
     uint32_t spi = SPIdi_GetDevice(device);
     return (SPI_CR1(spi) >> 3) & 0x07;
 }
 
+spid_prescaler_t SPId_GetPrescalerForClock(uint8_t device, uint32_t max_hz)
+{
+    spid_prescaler_t prescaler;
+
+    (void)SPIdi_GetDevice(device);
+    /* All SPI devices are clocked from APB on F0 */
+    for (prescaler = SPID_PRESC_2; prescaler < SPID_PRESC_256; prescaler++) {
+        if ((rcc_apb1_frequency >> (prescaler + 1)) <= max_hz) {
+            break;
+        }
+    }
+    return prescaler;
+}
+
 void SPId_SetPrescaler(uint8_t device, spid_prescaler_t prescaler)
 {
     uint32_t spi = SPIdi_GetDevice(device);
@@ -30,7 +30,7 @@ typedef enum {
 /**
  * Send and receive single byte over SPI
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  * @param data		Byte to send
  * @return Byte received
  */
@@ -39,7 +39,7 @@ uint8_t SPId_Transceive(uint8_t device, uint8_t data);
 /**
  * Send data over spi
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  * @param [in] buf	Pointer to data buffer with data to send
  * @param len		Amount of bytes to send
  */
@@ -48,23 +48,52 @@ void SPId_Send(uint8_t device, const uint8_t *buf, size_t len);
 /**
  * Read data from spi
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  * @param [out] buf	Pointer to data buffer where data will be stored
  * @param len		Amount of bytes to receive
  */
 void SPId_Receive(uint8_t device, uint8_t *buf, size_t len);
 
+/**
+ * Start data transfer over spi using DMA, returns immediately
+ *
+ * The SPI can't be used for other transfers until SPId_DmaBusy returns false.
+ *
+ * @param device	Device ID (1 to 2)
+ * @param [in] tx	Data to send or NULL to send 0xff bytes
+ * @param [out] rx	Buffer for received data or NULL to discard them
+ * @param len		Amount of bytes to transfer
+ */
+void SPId_TransferDma(uint8_t device, const uint8_t *tx, uint8_t *rx, size_t len);
+
+/**
+ * Check if DMA transfer is still running, finish it if not
+ *
+ * @param device	Device ID (1 to 2)
+ * @return True if transfer is in progress
+ */
+bool SPId_DmaBusy(uint8_t device);
+
 /**
  * Get currently set clock prescaler
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  */
 spid_prescaler_t SPId_GetPrescaler(uint8_t device);
 
+/**
+ * Get the smallest prescaler for SPI clock not exceeding given frequency
+ *
+ * @param device	Device ID (1 to 3)
+ * @param max_hz    Maximal SPI clock frequency in Hz
+ * @return Prescaler to use (SPID_PRESC_256 if no one is slow enough)
+ */
+spid_prescaler_t SPId_GetPrescalerForClock(uint8_t device, uint32_t max_hz);
+
 /**
  * Set clock prescaler
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  * @param prescaler Clock prescaler
  */
 void SPId_SetPrescaler(uint8_t device, spid_prescaler_t prescaler);
@@ -74,7 +103,7 @@ void SPId_SetPrescaler(uint8_t device, spid_prescaler_t prescaler);
  *
  * GPIO pins are not initialized and must be initialize separately
  *
- * @param device	Device ID (1 to 6)
+ * @param device	Device ID (1 to 3)
  * @param prescaler Clock prescaler
  * @param mode      SPI mode to use
  * @return True if init was successful
@@ -2,74 +2,93 @@
  * @file    modules/config.c
  * @brief   System configuration handling
  *
- * The data are stored at the end of the flash memory in two separate partitions,
- * each partition has a CRC at the beginning. Two copies are for fault tolerance
- * when the writing is aborted during the process.
+ * The config is stored as a single value in the key-value store placed in
+ * two flash pages at _config_part1 and _config_part2. The store appends
+ * new values and keeps the previous one until the new one is written, so
+ * an aborted write keeps the old config.
  *
- * The first partition is written and read first, second is the fallback one.
  * The linker must define _config_part1 and 2, both in different flash pages.
- * Both flash pages gets erased. The config_t should fit within one page.
+ * The config_t should fit within one page together with other stored values.
+ *
+ * Config stored by previous versions (crc followed by config_t in one or
+ * both partitions) is moved to the store when it is mounted for the first
+ * time. The page with the old config is formatted last, so it is readable
+ * until written to the store.
  */
 
-#include <string.h>
 #include <types.h>
 #include "hal/flash.h"
+#include "modules/kvstore.h"
 #include "utils/crc.h"
 #include "config.h"
 
-/** Structure of the configuration stored in flash memory */
+#if defined(CONFIG_USE_TWO_PARTITIONS) && !CONFIG_USE_TWO_PARTITIONS
+#error "Config is stored in key-value store, both _config_part1 and _config_part2 are required"
+#endif
+
+/** Config stored by previous versions */
 typedef struct {
-    uint16_t crc; /** Checksum of the config data */
+    uint16_t crc; /**< Checksum of the config data */
     config_t config;
-} config_internal_t;
+} config_legacy_t;
 
-extern const config_internal_t _config_part1;
-#if CONFIG_USE_TWO_PARTITIONS
-extern const config_internal_t _config_part2;
-#endif
+extern const config_legacy_t _config_part1;
+extern const config_legacy_t _config_part2;
 
-static const config_t *conf_valid;
+/**
+ * Check if the partition holds config in the previous format
+ *
+ * @param part      Config partition
+ * @return True if the config is valid
+ */
+static bool Configi_IsLegacy(const config_legacy_t *part)
+{
+    return CRC16((const uint8_t *)&part->config, sizeof(config_t)) == part->crc;
+}
 
 const config_t *Config_Get(void)
 {
-    return conf_valid;
+    const config_t *config;
+    uint16_t len;
+
+    /* Position in flash changes when the store is compacted */
+    config = Kv_Get(CONFIG_KV_KEY, &len);
+    if (config == NULL || len != sizeof(config_t)) {
+        return NULL;
+    }
+    return config;
 }
 
 bool Config_Read(void)
 {
-    if (CRC16((uint8_t *)&_config_part1.config, sizeof(config_t)) == _config_part1.crc) {
-        conf_valid = &_config_part1.config;
-#if CONFIG_USE_TWO_PARTITIONS
-    } else if (CRC16((uint8_t *)&_config_part2.config, sizeof(config_t)) == _config_part2.crc) {
-        conf_valid = &_config_part2.config;
-#endif
+    const config_legacy_t *legacy = NULL;
+    bool mounted;
+
+    if (Configi_IsLegacy(&_config_part1)) {
+        legacy = &_config_part1;
+    } else if (Configi_IsLegacy(&_config_part2)) {
+        legacy = &_config_part2;
+    }
+
+    /* Unformatted store formats the first page, keep the old config readable */
+    if (legacy == &_config_part1) {
+        mounted = Kv_Init(&_config_part2, &_config_part1, Flashd_GetPageSize());
     } else {
+        mounted = Kv_Init(&_config_part1, &_config_part2, Flashd_GetPageSize());
+    }
+    if (!mounted) {
         return false;
     }
-    return true;
+
+    if (Config_Get() == NULL && legacy != NULL) {
+        Config_Write(&legacy->config);
+    }
+    return Config_Get() != NULL;
 }
 
 void Config_Write(const config_t *config)
 {
     ASSERT_NOT(config == NULL);
-    config_internal_t loc_config;
-
-    memcpy(&loc_config.config, config, sizeof(config_t));
-    loc_config.crc = CRC16((uint8_t *)config, sizeof(config_t));
-
-    Flashd_WriteEnable();
-
-    if (_config_part1.crc != loc_config.crc) {
-        Flashd_ErasePage((uint32_t)&_config_part1);
-        Flashd_Write((uint32_t)&_config_part1, (uint8_t *)&loc_config, sizeof(config_internal_t));
-    }
-#if CONFIG_USE_TWO_PARTITIONS
-    if (_config_part2.crc != loc_config.crc) {
-        Flashd_ErasePage((uint32_t)&_config_part2);
-        Flashd_Write((uint32_t)&_config_part2, (uint8_t *)&loc_config, sizeof(config_internal_t));
-    }
-#endif
-    Flashd_WriteDisable();
 
-    conf_valid = &_config_part1.config;
+    Kv_Write(CONFIG_KV_KEY, config, sizeof(config_t));
 }
@@ -6,12 +6,12 @@
  * a config_t type definition, this config type will be stored to the flash.
  *
  * Additionally two linker symbols in flash memory must be defined for two
- * config partitions: _config_part1 and _config_part2. Each partition should
- * be placed in a separate flash page.
- *
- * Optionally the CONFIG_USE_TWO_PARITIONS can be defined to 0 to avoid
- * using the _config_part2 partition, in such cases, the config is stored
- * in a single partition.
+ * config partitions: _config_part1 and _config_part2. Each partition must
+ * occupy a whole flash page, the pages are used by the key-value store
+ * (modules/kvstore.h). The config is stored under CONFIG_KV_KEY, other keys
+ * can be used directly through Kv_* functions after Config_Read is called.
+ * Single partition setup (CONFIG_USE_TWO_PARTITIONS defined to 0) is not
+ * supported anymore.
  */
 
 #ifndef __MODULES_CONFIG_H
@@ -20,19 +20,23 @@
 #include <types.h>
 #include "config_struct.h"
 
-#ifndef CONFIG_USE_TWO_PARTITIONS
-#define CONFIG_USE_TWO_PARTITIONS 1
+/* Key-value store key the config is stored under */
+#ifndef CONFIG_KV_KEY
+#define CONFIG_KV_KEY 0
 #endif
 
 /**
  * Get the configuration
  *
+ * The config is read directly from flash, the pointer should not be kept
+ * over writes to the key-value store.
+ *
  * @return Pointer to config or null if no valid config found
  */
 const config_t *Config_Get(void);
 
 /**
- * Read the stored configuration
+ * Mount the config storage and read the stored configuration
  *
  * @return True if succeeded, false if no valid config found (in this case,
  *          the caller should provide default values and write them to storage)
@@ -42,6 +46,9 @@ bool Config_Read(void);
 /**
  * Write the configuration to memory
  *
+ * Only the new copy of the config is appended to flash, the page is erased
+ * once full. Nothing is written if the config did not change.
+ *
  * @param config        Config data to write
  */
 void Config_Write(const config_t *config);
@@ -7,6 +7,75 @@
 #define __MODULES_DISKIO_H
 
 #include "drivers/sd_spi.h"
+#include "drivers/spi_flash.h"
+
+/* Amount of drives available in FatFs diskio layer, should match FF_VOLUMES */
+#ifndef DISKIO_MAX_DRIVES
+#define DISKIO_MAX_DRIVES 2
+#endif
+
+/*
+ * Amount of sectors cached by FatFs diskio layer (512 B of RAM each), 0 to disable the cache.
+ * Worth enabling (e.g. 4) when several files are written at once, FAT and directory sectors
+ * are then not re-read for each file.
+ */
+#ifndef DISKIO_CACHE_SECTORS
+#define DISKIO_CACHE_SECTORS 0
+#endif
+
+/* Keep written sectors in cache until evicted or synced instead of writing them through */
+#ifndef DISKIO_CACHE_WRITE_BACK
+#define DISKIO_CACHE_WRITE_BACK 0
+#endif
+
+/** Sector size of all drives */
+#define DISKIO_SECTOR_SIZE 512
+
+/** Block device backend of FatFs diskio layer, dev is the backend specific descriptor */
+typedef struct {
+    bool (*init)(void *dev);        /**< Initialize device, return true if ready */
+    bool (*present)(void *dev);     /**< Check the device (media) is present */
+    bool (*initialized)(void *dev); /**< Check the device is initialized */
+    /** Read count sectors starting at sector */
+    bool (*read)(void *dev, uint8_t *buf, uint32_t sector, uint32_t count);
+    /** Write count sectors starting at sector */
+    bool (*write)(void *dev, const uint8_t *buf, uint32_t sector, uint32_t count);
+    bool (*sync)(void *dev);        /**< Finish all pending writes */
+    uint32_t (*sectors)(void *dev); /**< Get amount of sectors, 0 if failed */
+    /** Erase sectors from start to end (inclusive), NULL if not supported */
+    bool (*trim)(void *dev, uint32_t start, uint32_t end);
+    uint32_t block_size;            /**< Erase block size in sectors */
+} diskio_ops_t;
+
+/** Region of SPI flash memory presented as a drive with 512 B sectors */
+typedef struct {
+    const spiflash_desc_t *flash; /**< Flash memory descriptor */
+    uint32_t start;               /**< Region start address, aligned to 4 kB sector */
+    uint32_t size;                /**< Region size in bytes, multiple of 4 kB */
+} diskio_spiflash_t;
+
+/** SD card backend, dev is sdspi_desc_t */
+extern const diskio_ops_t diskio_sdspi_ops;
+
+/**
+ * SPI flash backend, dev is diskio_spiflash_t
+ *
+ * Writes are collected in a 4 kB buffer, the flash sector is erased and
+ * written when other sector is accessed or on sync.
+ *
+ * @note The buffer is statically allocated (about 4 kB of RAM) once
+ * modules/diskio_spiflash.c is linked, it is shared by all SPI flash drives.
+ */
+extern const diskio_ops_t diskio_spiflash_ops;
+
+/** Flash translation layer backend (modules/ftl.c), dev is unused */
+extern const diskio_ops_t diskio_ftl_ops;
+
+/** Sector cache statistics */
+typedef struct {
+    uint32_t hits;   /**< Sector reads served from cache */
+    uint32_t misses; /**< Sector reads passed to the card */
+} diskio_cache_stats_t;
 
 /**
  * Get current timestamp
@@ -29,9 +98,30 @@
  * }
  */
 
+/**
+ * Get sector cache statistics (FatFs only)
+ *
+ * @param [out] stats   Statistics since boot or last reset
+ * @param reset         Reset the counters after reading
+ */
+void Diskio_GetCacheStats(diskio_cache_stats_t *stats, bool reset);
+
+/**
+ * Assign block device backend to FatFs drive
+ *
+ * @note The descriptor memory must remain accessible after call
+ *
+ * @param drv       Drive ID (0 to DISKIO_MAX_DRIVES - 1)
+ * @param ops       Backend operations or NULL to remove the drive
+ * @param dev       Backend specific device descriptor
+ */
+void Diskio_SetDrive(uint8_t drv, const diskio_ops_t *ops, void *dev);
+
 /**
  * Point diskio implementation to initialized sd card driver descriptor
  *
+ * Same as Diskio_SetDrive(0, &diskio_sdspi_ops, card_desc) for FatFs.
+ *
  * @note The descriptor memory must remain accessible after call
  */
 void Diskio_SetCard(sdspi_desc_t *card_desc);
@@ -1,29 +1,213 @@
 /**
  * @file diskio_fatfs.c
- * @brief FATFS diskio layer implementation for SPI SD Cards
+ * @brief FATFS diskio layer implementation for SPI SD Cards and other block devices
  */
 
+#include <string.h>
 #include "drivers/sd_spi.h"
 #include "ff.h"
 #include "diskio.h"
 #include "diskio_common.h"
 
-static sdspi_desc_t *sdspi_desc = NULL;
+#if DISKIO_CACHE_SECTORS > 0
+/** Cached sector */
+typedef struct {
+    bool valid;         /**< Entry contains sector data */
+    bool dirty;         /**< Data not written to the card yet */
+    BYTE drv;           /**< Drive the sector belongs to */
+    DWORD sector;       /**< Sector number */
+    uint32_t used;      /**< Time of last access, for LRU eviction */
+    uint8_t data[DISKIO_SECTOR_SIZE]; /**< Sector content */
+} diskio_cache_t;
+
+static diskio_cache_t diskioi_cache[DISKIO_CACHE_SECTORS];
+/** Access counter used as timestamp for LRU eviction */
+static uint32_t diskioi_cache_time;
+#endif
+
+/** Block device assigned to the drive */
+typedef struct {
+    const diskio_ops_t *ops; /**< Backend operations, NULL if drive not available */
+    void *dev;               /**< Backend device descriptor */
+} diskio_drive_t;
+
+static diskio_cache_stats_t diskioi_cache_stats;
+static diskio_drive_t diskioi_drives[DISKIO_MAX_DRIVES];
+
+/* SD card backend, wrappers of the sd_spi driver functions */
+static bool sdspiInit(void *dev)
+{
+    return SDSPI_InitCard(dev);
+}
+
+static bool sdspiPresent(void *dev)
+{
+    return SDSPI_IsInserted(dev);
+}
+
+static bool sdspiInitialized(void *dev)
+{
+    return SDSPI_IsInitialized(dev);
+}
+
+static bool sdspiRead(void *dev, uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    return SDSPI_ReadSector(dev, buf, sector, count);
+}
+
+static bool sdspiWrite(void *dev, const uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    return SDSPI_WriteSector(dev, buf, sector, count);
+}
+
+static bool sdspiSync(void *dev)
+{
+    return SDSPI_Sync(dev);
+}
+
+static uint32_t sdspiSectors(void *dev)
+{
+    return SDSPI_GetSectorsCount(dev);
+}
+
+static bool sdspiTrim(void *dev, uint32_t start, uint32_t end)
+{
+    return SDSPI_Erase(dev, start, end);
+}
+
+const diskio_ops_t diskio_sdspi_ops = {
+    .init = sdspiInit,
+    .present = sdspiPresent,
+    .initialized = sdspiInitialized,
+    .read = sdspiRead,
+    .write = sdspiWrite,
+    .sync = sdspiSync,
+    .sectors = sdspiSectors,
+    .trim = sdspiTrim,
+    .block_size = 128,
+};
 
 /**
- * Get card descriptor from driver ID
+ * Get block device from driver ID
  *
- * @param drv	FatFS Drive ID, only 0 is available
- * @return  Descriptor or NULL if drive not available
+ * @param drv	FatFS Drive ID
+ * @return  Drive or NULL if drive not available
  */
-static sdspi_desc_t *getDrive(BYTE drv)
+static const diskio_drive_t *getDrive(BYTE drv)
 {
-    if (drv == 0) {
-        return sdspi_desc;
+    if (drv < DISKIO_MAX_DRIVES && diskioi_drives[drv].ops != NULL) {
+        return &diskioi_drives[drv];
     }
     return NULL;
 }
 
+#if DISKIO_CACHE_SECTORS > 0
+/**
+ * Find sector in cache
+ *
+ * @param drv       Drive ID
+ * @param sector    Sector number
+ * @return Cache entry or NULL if not cached
+ */
+static diskio_cache_t *cacheFind(BYTE drv, DWORD sector)
+{
+    for (uint8_t i = 0; i < DISKIO_CACHE_SECTORS; i++) {
+        if (diskioi_cache[i].valid && diskioi_cache[i].drv == drv &&
+            diskioi_cache[i].sector == sector)
+        {
+            return &diskioi_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Write dirty cache entry to the card
+ *
+ * @param entry     Cache entry
+ * @return Successfulness of the operation
+ */
+static bool cacheClean(diskio_cache_t *entry)
+{
+    const diskio_drive_t *drive = getDrive(entry->drv);
+
+    if (!entry->valid || !entry->dirty) {
+        return true;
+    }
+    if (drive == NULL || !drive->ops->write(drive->dev, entry->data, entry->sector, 1)) {
+        return false;
+    }
+    entry->dirty = false;
+    return true;
+}
+
+/**
+ * Store sector to cache, evict least recently used entry if needed
+ *
+ * @param drv       Drive ID
+ * @param sector    Sector number
+ * @param data      Sector content
+ * @param dirty     Sector not written to the card yet
+ * @return Successfulness of the operation (evicted entry written to card)
+ */
+static bool cacheStore(BYTE drv, DWORD sector, const uint8_t *data, bool dirty)
+{
+    diskio_cache_t *entry = cacheFind(drv, sector);
+
+    if (entry == NULL) {
+        entry = &diskioi_cache[0];
+        for (uint8_t i = 1; i < DISKIO_CACHE_SECTORS && entry->valid; i++) {
+            if (!diskioi_cache[i].valid || diskioi_cache[i].used < entry->used) {
+                entry = &diskioi_cache[i];
+            }
+        }
+        if (!cacheClean(entry)) {
+            return false;
+        }
+    }
+
+    memcpy(entry->data, data, DISKIO_SECTOR_SIZE);
+    entry->valid = true;
+    entry->dirty = dirty;
+    entry->drv = drv;
+    entry->sector = sector;
+    entry->used = ++diskioi_cache_time;
+    return true;
+}
+
+/**
+ * Write all dirty sectors of the drive to the card
+ *
+ * @param drv       Drive ID
+ * @return Successfulness of the operation
+ */
+static bool cacheFlush(BYTE drv)
+{
+    bool ret = true;
+
+    for (uint8_t i = 0; i < DISKIO_CACHE_SECTORS; i++) {
+        if (diskioi_cache[i].drv == drv && !cacheClean(&diskioi_cache[i])) {
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Drop all cached sectors of the drive
+ *
+ * @param drv       Drive ID
+ */
+static void cacheInvalidate(BYTE drv)
+{
+    for (uint8_t i = 0; i < DISKIO_CACHE_SECTORS; i++) {
+        if (diskioi_cache[i].drv == drv) {
+            diskioi_cache[i].valid = false;
+        }
+    }
+}
+#endif
+
 /**
  * FatFs get disk status callback
  *
@@ -31,11 +215,11 @@ static sdspi_desc_t *getDrive(BYTE drv)
  */
 DSTATUS disk_status(BYTE drv)
 {
-    sdspi_desc_t *desc = getDrive(drv);
-    if (desc == NULL || !SDSPI_IsInserted(desc)) {
+    const diskio_drive_t *drive = getDrive(drv);
+    if (drive == NULL || !drive->ops->present(drive->dev)) {
         return STA_NODISK;
     }
-    if (!SDSPI_IsInitialized(desc)) {
+    if (!drive->ops->initialized(drive->dev)) {
         return STA_NOINIT;
     }
     return 0;
@@ -48,11 +232,15 @@ DSTATUS disk_status(BYTE drv)
  */
 DSTATUS disk_initialize(BYTE drv)
 {
-    sdspi_desc_t *desc = getDrive(drv);
-    if (desc == NULL) {
+    const diskio_drive_t *drive = getDrive(drv);
+    if (drive == NULL) {
         return STA_NODISK;
     }
-    if (!SDSPI_InitCard(desc)) {
+#if DISKIO_CACHE_SECTORS > 0
+    /* The card may have been replaced */
+    cacheInvalidate(drv);
+#endif
+    if (!drive->ops->init(drive->dev)) {
         return STA_NOINIT;
     }
     return 0;
@@ -68,14 +256,47 @@ DSTATUS disk_initialize(BYTE drv)
  */
 DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
 {
-    sdspi_desc_t *desc = getDrive(drv);
-    if (desc == NULL || disk_status(drv) != 0) {
+    const diskio_drive_t *drive = getDrive(drv);
+    if (drive == NULL || disk_status(drv) != 0) {
         return RES_NOTRDY;
     }
 
-    if (!SDSPI_ReadSector(desc, buff, sector, count)) {
+#if DISKIO_CACHE_SECTORS > 0
+    if (count == 1) {
+        diskio_cache_t *entry = cacheFind(drv, sector);
+        if (entry != NULL) {
+            memcpy(buff, entry->data, DISKIO_SECTOR_SIZE);
+            entry->used = ++diskioi_cache_time;
+            diskioi_cache_stats.hits++;
+            return RES_OK;
+        }
+        diskioi_cache_stats.misses++;
+        if (!drive->ops->read(drive->dev, buff, sector, 1) ||
+            !cacheStore(drv, sector, buff, false))
+        {
+            return RES_ERROR;
+        }
+        return RES_OK;
+    }
+#endif
+
+    diskioi_cache_stats.misses += count;
+    if (!drive->ops->read(drive->dev, buff, sector, count)) {
         return RES_ERROR;
     }
+
+#if DISKIO_CACHE_SECTORS > 0
+    /* Multi sector reads bypass cache, the card may contain outdated data */
+    for (uint8_t i = 0; i < DISKIO_CACHE_SECTORS; i++) {
+        diskio_cache_t *entry = &diskioi_cache[i];
+        if (entry->valid && entry->dirty && entry->drv == drv && entry->sector >= sector &&
+            entry->sector < sector + count)
+        {
+            memcpy(&buff[(entry->sector - sector) * DISKIO_SECTOR_SIZE], entry->data,
+                DISKIO_SECTOR_SIZE);
+        }
+    }
+#endif
     return RES_OK;
 }
 
@@ -89,14 +310,29 @@ DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
  */
 DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
 {
-    sdspi_desc_t *desc = getDrive(drv);
-    if (desc == NULL || disk_status(drv) != 0) {
+    const diskio_drive_t *drive = getDrive(drv);
+    if (drive == NULL || disk_status(drv) != 0) {
         return RES_NOTRDY;
     }
 
-    if (!SDSPI_WriteSector(desc, buff, sector, count)) {
+#if DISKIO_CACHE_SECTORS > 0
+    if (DISKIO_CACHE_WRITE_BACK && count == 1) {
+        return cacheStore(drv, sector, buff, true) ? RES_OK : RES_ERROR;
+    }
+#endif
+
+    if (!drive->ops->write(drive->dev, buff, sector, count)) {
         return RES_ERROR;
     }
+
+#if DISKIO_CACHE_SECTORS > 0
+    /* Keep cached copies up to date, the data are already on the card */
+    for (DWORD i = 0; i < count; i++) {
+        if (count == 1 || cacheFind(drv, sector + i) != NULL) {
+            (void)cacheStore(drv, sector + i, &buff[i * DISKIO_SECTOR_SIZE], false);
+        }
+    }
+#endif
     return RES_OK;
 }
 
@@ -110,22 +346,27 @@ DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
 DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 {
     DRESULT res = RES_ERROR;
-    sdspi_desc_t *desc = getDrive(drv);
-    if (desc == NULL || disk_status(drv) != 0) {
+    const diskio_drive_t *drive = getDrive(drv);
+    if (drive == NULL || disk_status(drv) != 0) {
         return RES_NOTRDY;
     }
 
     switch (ctrl) {
         // Make sure that no pending write process
         case CTRL_SYNC:
-            if (SDSPI_Sync(desc)) {
+#if DISKIO_CACHE_SECTORS > 0
+            if (!cacheFlush(drv)) {
+                break;
+            }
+#endif
+            if (drive->ops->sync(drive->dev)) {
                 res = RES_OK;
             }
             break;
 
         // Get number of sectors on the disk (DWORD)
         case GET_SECTOR_COUNT: {
-            uint32_t sectors = SDSPI_GetSectorsCount(desc);
+            uint32_t sectors = drive->ops->sectors(drive->dev);
             if (sectors != 0) {
                 *(DWORD *)buff = sectors;
                 res = RES_OK;
@@ -135,10 +376,32 @@ DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 
         // Get erase block size in unit of sector (DWORD)
         case GET_BLOCK_SIZE:
-            *(DWORD *)buff = 128;
+            *(DWORD *)buff = drive->ops->block_size;
             res = RES_OK;
             break;
 
+        // Erase sectors no longer used, first and last sector of range (DWORD[2])
+        case CTRL_TRIM: {
+            DWORD *range = (DWORD *)buff;
+            if (drive->ops->trim == NULL) {
+                res = RES_PARERR;
+                break;
+            }
+#if DISKIO_CACHE_SECTORS > 0
+            for (uint8_t i = 0; i < DISKIO_CACHE_SECTORS; i++) {
+                if (diskioi_cache[i].drv == drv && diskioi_cache[i].sector >= range[0] &&
+                    diskioi_cache[i].sector <= range[1])
+                {
+                    diskioi_cache[i].valid = false;
+                }
+            }
+#endif
+            if (drive->ops->trim(drive->dev, range[0], range[1])) {
+                res = RES_OK;
+            }
+            break;
+        }
+
         default:
             res = RES_PARERR;
             break;
@@ -167,7 +430,27 @@ DWORD __attribute__((weak)) get_fattime(void)
     return timestamp;
 }
 
+void Diskio_GetCacheStats(diskio_cache_stats_t *stats, bool reset)
+{
+    *stats = diskioi_cache_stats;
+    if (reset) {
+        diskioi_cache_stats.hits = 0;
+        diskioi_cache_stats.misses = 0;
+    }
+}
+
+void Diskio_SetDrive(uint8_t drv, const diskio_ops_t *ops, void *dev)
+{
+    ASSERT_NOT(drv >= DISKIO_MAX_DRIVES);
+
+    diskioi_drives[drv].ops = ops;
+    diskioi_drives[drv].dev = dev;
+#if DISKIO_CACHE_SECTORS > 0
+    cacheInvalidate(drv);
+#endif
+}
+
 void Diskio_SetCard(sdspi_desc_t *card_desc)
 {
-    sdspi_desc = card_desc;
+    Diskio_SetDrive(0, &diskio_sdspi_ops, card_desc);
 }
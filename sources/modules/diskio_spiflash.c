@@ -0,0 +1,232 @@
+/**
+ * @file diskio_spiflash.c
+ * @brief SPI flash block device backend for FatFs diskio layer
+ *
+ * The flash can be erased in 4 kB sectors only, the 512 B sectors are
+ * collected in a buffer and the flash sector is rewritten once the buffer
+ * is needed for other sector or on sync. The erase is skipped if the
+ * written data only clear bits.
+ */
+
+#include <string.h>
+#include "utils/math.h"
+#include "drivers/spi_flash.h"
+#include "diskio_common.h"
+
+/** Smallest erasable unit of the flash */
+#define ERASE_SIZE 4096U
+/** Flash program page size */
+#define PAGE_SIZE 256U
+
+/** Flash erase sector being modified, takes ERASE_SIZE (4 kB) of RAM */
+static struct {
+    const diskio_spiflash_t *dev; /**< Drive the sector belongs to, NULL if empty */
+    uint32_t addr;                /**< Address of the erase sector */
+    bool erase;                   /**< Some bits were set, sector must be erased */
+    uint16_t dirty;               /**< Bitmap of modified pages */
+    uint8_t data[ERASE_SIZE];     /**< Sector content */
+} diskioi_flash_buf;
+
+/**
+ * Write buffered sector to the flash
+ */
+static void spiflashFlush(void)
+{
+    const diskio_spiflash_t *dev = diskioi_flash_buf.dev;
+
+    if (dev == NULL || diskioi_flash_buf.dirty == 0) {
+        return;
+    }
+
+    if (diskioi_flash_buf.erase) {
+        SpiFlash_EraseSector(dev->flash, diskioi_flash_buf.addr);
+    }
+    for (uint8_t page = 0; page < ERASE_SIZE / PAGE_SIZE; page++) {
+        const uint8_t *data = &diskioi_flash_buf.data[page * PAGE_SIZE];
+        bool blank = true;
+
+        if (!diskioi_flash_buf.erase && !(diskioi_flash_buf.dirty & (1U << page))) {
+            continue;
+        }
+        /* Erased page contains 0xff already */
+        for (uint16_t i = 0; i < PAGE_SIZE && blank; i++) {
+            blank = data[i] == 0xff;
+        }
+        if (!blank) {
+            SpiFlash_Write(dev->flash, diskioi_flash_buf.addr + page * PAGE_SIZE, data, PAGE_SIZE);
+        }
+    }
+    diskioi_flash_buf.erase = false;
+    diskioi_flash_buf.dirty = 0;
+}
+
+/**
+ * Discard buffered sector without writing it to the flash
+ */
+static void spiflashDrop(void)
+{
+    diskioi_flash_buf.dev = NULL;
+    diskioi_flash_buf.erase = false;
+    diskioi_flash_buf.dirty = 0;
+}
+
+/**
+ * Load flash erase sector to buffer, flush previous one if needed
+ *
+ * @param dev       Drive descriptor
+ * @param addr      Address of the erase sector
+ * @return False if the flash read failed
+ */
+static bool spiflashLoad(const diskio_spiflash_t *dev, uint32_t addr)
+{
+    if (diskioi_flash_buf.dev == dev && diskioi_flash_buf.addr == addr) {
+        return true;
+    }
+    spiflashFlush();
+    if (!SpiFlash_Read(dev->flash, addr, diskioi_flash_buf.data, ERASE_SIZE)) {
+        /* Buffer content must never be written back */
+        spiflashDrop();
+        return false;
+    }
+    diskioi_flash_buf.dev = dev;
+    diskioi_flash_buf.addr = addr;
+    return true;
+}
+
+/**
+ * Check sectors are within the drive
+ *
+ * @param dev       Drive descriptor
+ * @param sector    First sector
+ * @param count     Amount of sectors
+ * @return True if valid
+ */
+static bool spiflashValid(const diskio_spiflash_t *dev, uint32_t sector, uint32_t count)
+{
+    uint32_t sectors = dev->size / DISKIO_SECTOR_SIZE;
+    return sector < sectors && count <= sectors - sector;
+}
+
+static bool spiflashInit(void *dev)
+{
+    const diskio_spiflash_t *flash = dev;
+
+    ASSERT_NOT(flash->start % ERASE_SIZE != 0 || flash->size % ERASE_SIZE != 0);
+    if (diskioi_flash_buf.dev == flash) {
+        spiflashDrop();
+    }
+    return true;
+}
+
+static bool spiflashPresent(void *dev)
+{
+    (void)dev;
+    return true;
+}
+
+static bool spiflashInitialized(void *dev)
+{
+    (void)dev;
+    return true;
+}
+
+static bool spiflashRead(void *dev, uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    const diskio_spiflash_t *flash = dev;
+    uint32_t addr = flash->start + sector * DISKIO_SECTOR_SIZE;
+
+    if (!spiflashValid(flash, sector, count)) {
+        return false;
+    }
+
+    if (!SpiFlash_Read(flash->flash, addr, buf, count * DISKIO_SECTOR_SIZE)) {
+        return false;
+    }
+    /* Buffered data are newer than flash content */
+    if (diskioi_flash_buf.dev == flash && diskioi_flash_buf.dirty != 0) {
+        for (uint32_t i = 0; i < count; i++, addr += DISKIO_SECTOR_SIZE) {
+            if (addr - diskioi_flash_buf.addr < ERASE_SIZE) {
+                memcpy(&buf[i * DISKIO_SECTOR_SIZE],
+                    &diskioi_flash_buf.data[addr - diskioi_flash_buf.addr], DISKIO_SECTOR_SIZE);
+            }
+        }
+    }
+    return true;
+}
+
+static bool spiflashWrite(void *dev, const uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    const diskio_spiflash_t *flash = dev;
+    uint32_t addr = flash->start + sector * DISKIO_SECTOR_SIZE;
+
+    if (!spiflashValid(flash, sector, count)) {
+        return false;
+    }
+
+    for (; count != 0; count--, addr += DISKIO_SECTOR_SIZE, buf += DISKIO_SECTOR_SIZE) {
+        uint32_t offset = addr % ERASE_SIZE;
+        uint8_t *data = &diskioi_flash_buf.data[offset];
+
+        if (!spiflashLoad(flash, addr - offset)) {
+            return false;
+        }
+        for (uint16_t i = 0; i < DISKIO_SECTOR_SIZE; i++) {
+            /* Programming can only clear bits */
+            if ((data[i] & buf[i]) != buf[i]) {
+                diskioi_flash_buf.erase = true;
+            }
+        }
+        memcpy(data, buf, DISKIO_SECTOR_SIZE);
+        diskioi_flash_buf.dirty |= ((1U << (DISKIO_SECTOR_SIZE / PAGE_SIZE)) - 1)
+                                   << (offset / PAGE_SIZE);
+    }
+    return true;
+}
+
+static bool spiflashSync(void *dev)
+{
+    if (diskioi_flash_buf.dev == dev) {
+        spiflashFlush();
+    }
+    return true;
+}
+
+static uint32_t spiflashSectors(void *dev)
+{
+    const diskio_spiflash_t *flash = dev;
+    return flash->size / DISKIO_SECTOR_SIZE;
+}
+
+static bool spiflashTrim(void *dev, uint32_t start, uint32_t end)
+{
+    const diskio_spiflash_t *flash = dev;
+    const uint32_t per_erase = ERASE_SIZE / DISKIO_SECTOR_SIZE;
+
+    if (end < start || !spiflashValid(flash, start, end - start + 1)) {
+        return false;
+    }
+
+    /* Only whole erase sectors within the range can be erased */
+    for (uint32_t sector = ceil_div(start, per_erase) * per_erase; sector + per_erase - 1 <= end;
+         sector += per_erase)
+    {
+        uint32_t addr = flash->start + sector * DISKIO_SECTOR_SIZE;
+        if (diskioi_flash_buf.dev == flash && diskioi_flash_buf.addr == addr) {
+            spiflashDrop();
+        }
+        SpiFlash_EraseSector(flash->flash, addr);
+    }
+    return true;
+}
+
+const diskio_ops_t diskio_spiflash_ops = {
+    .init = spiflashInit,
+    .present = spiflashPresent,
+    .initialized = spiflashInitialized,
+    .read = spiflashRead,
+    .write = spiflashWrite,
+    .sync = spiflashSync,
+    .sectors = spiflashSectors,
+    .trim = spiflashTrim,
+    .block_size = ERASE_SIZE / DISKIO_SECTOR_SIZE,
+};
@@ -0,0 +1,493 @@
+/**
+ * @file    modules/flashlog.c
+ * @brief   Circular log of timestamped records in SPI flash
+ *
+ * Sector layout (4 kB):
+ *  - header (magic, sequence number, time of the first record), the magic
+ *    is programmed last when the sector is opened
+ *  - fixed size records (time, crc, data), the time is programmed after
+ *    the data and marks the record as written
+ *
+ * Sectors are used as a ring, the oldest one is erased once the region is
+ * full. Record times never decrease, so the records for given time are
+ * found by binary search over sector headers and then over the records in
+ * the sector. A record interrupted by power loss can only be at the end of
+ * the newest sector, the mount checks this sector only and continues in a
+ * new one if the record is damaged.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "utils/crc.h"
+#include "modules/flashlog.h"
+
+#define SECTOR_SIZE  4096U
+#define HEADER_MAGIC 0x474f4c46UL /* FLOG */
+#define TIME_ERASED  0xffffffffUL
+
+/** Sector header stored at sector start */
+typedef struct {
+    uint32_t magic; /**< HEADER_MAGIC if the sector is in use */
+    uint32_t seq;   /**< Order in which sectors were opened */
+    uint32_t first; /**< Time of the first record in sector */
+    uint32_t reserved;
+} flashlog_header_t;
+
+/** Record header followed by data */
+typedef struct {
+    uint32_t time;     /**< Record timestamp, TIME_ERASED if not written */
+    uint16_t crc;      /**< CRC16 of time and data */
+    uint16_t reserved;
+} flashlog_record_t;
+
+/** Log state */
+static struct {
+    const spiflash_desc_t *flash; /**< Flash memory */
+    uint32_t start;               /**< Region start address */
+    uint32_t sectors;             /**< Amount of sectors in region */
+    uint16_t record_size;         /**< Record size including record header */
+    uint16_t slots;               /**< Amount of records in sector */
+    uint32_t count;               /**< Amount of sectors in use, 0 if empty */
+    uint32_t head;                /**< Sector with the newest records */
+    uint32_t head_seq;            /**< Sequence number of the head sector */
+    uint16_t head_used;           /**< Amount of valid records in head sector */
+    bool head_closed;             /**< No more records can be written to head */
+    uint32_t last_time;           /**< Time of the newest record */
+    bool ready;                   /**< Log mounted */
+    bool read_error;              /**< Flash read failed during current operation */
+} flashlogi_state;
+
+/**
+ * Read data from flash, failure is recorded in the state
+ *
+ * @param addr      Flash address
+ * @param [out] buf Buffer to read data to, erased content on failure
+ * @param len       Amount of bytes to read
+ */
+static void FlashLogi_Read(uint32_t addr, void *buf, uint16_t len)
+{
+    if (!SpiFlash_Read(flashlogi_state.flash, addr, buf, len)) {
+        memset(buf, 0xff, len);
+        flashlogi_state.read_error = true;
+    }
+}
+
+/**
+ * Get flash address of the record
+ *
+ * @param sector    Sector number in region
+ * @param slot      Record number in sector
+ * @return Flash address
+ */
+static uint32_t FlashLogi_Addr(uint32_t sector, uint16_t slot)
+{
+    return flashlogi_state.start + sector * SECTOR_SIZE + sizeof(flashlog_header_t) +
+           slot * flashlogi_state.record_size;
+}
+
+/**
+ * Get sector number from position in the ring
+ *
+ * @param index     Position, 0 is the oldest sector
+ * @return Sector number in region
+ */
+static uint32_t FlashLogi_Sector(uint32_t index)
+{
+    return (flashlogi_state.head + flashlogi_state.sectors - flashlogi_state.count + 1 + index) %
+           flashlogi_state.sectors;
+}
+
+/**
+ * Read sector header
+ *
+ * @param sector        Sector number in region
+ * @param [out] header  Header read
+ * @return True if the sector is in use
+ */
+static bool FlashLogi_ReadHeader(uint32_t sector, flashlog_header_t *header)
+{
+    FlashLogi_Read(flashlogi_state.start + sector * SECTOR_SIZE, header,
+        sizeof(flashlog_header_t));
+    return header->magic == HEADER_MAGIC;
+}
+
+/**
+ * Read timestamp of the record
+ *
+ * @param sector    Sector number in region
+ * @param slot      Record number in sector
+ * @return Timestamp, TIME_ERASED if not written
+ */
+static uint32_t FlashLogi_ReadTime(uint32_t sector, uint16_t slot)
+{
+    uint32_t time;
+
+    FlashLogi_Read(FlashLogi_Addr(sector, slot), &time, sizeof(time));
+    return time;
+}
+
+/**
+ * Read record and check its CRC
+ *
+ * @param sector        Sector number in region
+ * @param slot          Record number in sector
+ * @param [out] time    Record timestamp
+ * @param [out] data    Record data, NULL to check the record only
+ * @return True if the record is valid
+ */
+static bool FlashLogi_ReadRecord(uint32_t sector, uint16_t slot, uint32_t *time, uint8_t *data)
+{
+    flashlog_record_t record;
+    uint8_t chunk[16];
+    uint32_t addr = FlashLogi_Addr(sector, slot);
+    uint16_t len = flashlogi_state.record_size - sizeof(record);
+    uint16_t crc, bytes;
+
+    FlashLogi_Read(addr, &record, sizeof(record));
+    crc = CRC16_Update(CRC16_INITIAL_VALUE, (const uint8_t *)&record.time, sizeof(record.time));
+    addr += sizeof(record);
+
+    if (data != NULL) {
+        FlashLogi_Read(addr, data, len);
+        crc = CRC16_Update(crc, data, len);
+    } else {
+        while (len != 0) {
+            bytes = len < sizeof(chunk) ? len : sizeof(chunk);
+            FlashLogi_Read(addr, chunk, bytes);
+            crc = CRC16_Update(crc, chunk, bytes);
+            addr += bytes;
+            len -= bytes;
+        }
+    }
+
+    *time = record.time;
+    return record.time != TIME_ERASED && record.crc == crc;
+}
+
+/**
+ * Check the record was never written to
+ *
+ * @param sector    Sector number in region
+ * @param slot      Record number in sector
+ * @return True if erased
+ */
+static bool FlashLogi_IsErased(uint32_t sector, uint16_t slot)
+{
+    uint8_t chunk[16];
+    uint32_t addr = FlashLogi_Addr(sector, slot);
+    uint16_t len = flashlogi_state.record_size;
+    uint16_t bytes;
+
+    while (len != 0) {
+        bytes = len < sizeof(chunk) ? len : sizeof(chunk);
+        FlashLogi_Read(addr, chunk, bytes);
+        for (uint16_t i = 0; i < bytes; i++) {
+            if (chunk[i] != 0xff) {
+                return false;
+            }
+        }
+        addr += bytes;
+        len -= bytes;
+    }
+    return true;
+}
+
+/**
+ * Get amount of valid records in sector
+ *
+ * Records are written in order, the first unwritten one is found by binary
+ * search. The last written record might be damaged by power loss.
+ *
+ * @param sector    Sector number in region
+ * @return Amount of valid records
+ */
+static uint16_t FlashLogi_GetUsed(uint32_t sector)
+{
+    uint16_t low = 0, high = flashlogi_state.slots, mid;
+    uint32_t time;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (FlashLogi_ReadTime(sector, mid) != TIME_ERASED) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low != 0 && !FlashLogi_ReadRecord(sector, low - 1, &time, NULL)) {
+        low--;
+    }
+    return low;
+}
+
+/**
+ * Erase the sector after head and start writing to it
+ *
+ * @param time      Time of the first record written to the sector
+ */
+static void FlashLogi_Open(uint32_t time)
+{
+    uint32_t sector = (flashlogi_state.head + 1) % flashlogi_state.sectors;
+    uint32_t addr = flashlogi_state.start + sector * SECTOR_SIZE;
+    flashlog_header_t header = {
+        .magic = HEADER_MAGIC,
+        .seq = flashlogi_state.count == 0 ? 0 : flashlogi_state.head_seq + 1,
+        .first = time,
+        .reserved = 0xffffffffUL,
+    };
+
+    /* Oldest sector is overwritten */
+    if (flashlogi_state.count == flashlogi_state.sectors) {
+        flashlogi_state.count--;
+    }
+
+    SpiFlash_EraseSector(flashlogi_state.flash, addr);
+    SpiFlash_Write(flashlogi_state.flash, addr + offsetof(flashlog_header_t, seq),
+        (const uint8_t *)&header.seq, sizeof(header) - offsetof(flashlog_header_t, seq));
+    SpiFlash_Write(flashlogi_state.flash, addr, (const uint8_t *)&header.magic,
+        sizeof(header.magic));
+
+    flashlogi_state.head = sector;
+    flashlogi_state.head_seq = header.seq;
+    flashlogi_state.head_used = 0;
+    flashlogi_state.head_closed = false;
+    flashlogi_state.count++;
+}
+
+/**
+ * Find the newest sector and recover it after power loss
+ */
+static void FlashLogi_Mount(void)
+{
+    flashlog_header_t header;
+    uint32_t time, sector;
+    uint16_t used;
+    bool found = false;
+
+    flashlogi_state.count = 0;
+    flashlogi_state.head = flashlogi_state.sectors - 1;
+    flashlogi_state.last_time = 0;
+
+    for (uint32_t i = 0; i < flashlogi_state.sectors; i++) {
+        if (FlashLogi_ReadHeader(i, &header) &&
+            (!found || header.seq > flashlogi_state.head_seq)) {
+            flashlogi_state.head = i;
+            flashlogi_state.head_seq = header.seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        return;
+    }
+
+    /* Sectors in use precede the head in sequence */
+    flashlogi_state.count = 1;
+    while (flashlogi_state.count < flashlogi_state.sectors) {
+        sector = flashlogi_state.head + flashlogi_state.sectors - flashlogi_state.count;
+        sector %= flashlogi_state.sectors;
+        if (!FlashLogi_ReadHeader(sector, &header) ||
+            header.seq != flashlogi_state.head_seq - flashlogi_state.count) {
+            break;
+        }
+        flashlogi_state.count++;
+    }
+
+    /* Write interrupted in the head sector leaves damaged record */
+    FlashLogi_ReadHeader(flashlogi_state.head, &header);
+    used = FlashLogi_GetUsed(flashlogi_state.head);
+    flashlogi_state.head_used = used;
+    flashlogi_state.head_closed = used < flashlogi_state.slots &&
+                                  !FlashLogi_IsErased(flashlogi_state.head, used);
+    flashlogi_state.last_time = header.first;
+    if (used != 0) {
+        FlashLogi_ReadRecord(flashlogi_state.head, used - 1, &time, NULL);
+        flashlogi_state.last_time = time;
+    }
+}
+
+bool FlashLog_Append(uint32_t time, const uint8_t *data)
+{
+    flashlog_record_t record = {
+        .time = time,
+        .reserved = 0xffff,
+    };
+    uint16_t data_len = flashlogi_state.record_size - sizeof(record);
+    uint32_t addr;
+
+    if (!flashlogi_state.ready || time == TIME_ERASED) {
+        return false;
+    }
+    if (flashlogi_state.count != 0 && time < flashlogi_state.last_time) {
+        return false;
+    }
+
+    if (flashlogi_state.count == 0 || flashlogi_state.head_closed ||
+        flashlogi_state.head_used == flashlogi_state.slots) {
+        FlashLogi_Open(time);
+    }
+
+    record.crc = CRC16_Update(CRC16_INITIAL_VALUE, (const uint8_t *)&record.time,
+        sizeof(record.time));
+    record.crc = CRC16_Update(record.crc, data, data_len);
+
+    /* Time marks the record as written, must be programmed last */
+    addr = FlashLogi_Addr(flashlogi_state.head, flashlogi_state.head_used);
+    SpiFlash_Write(flashlogi_state.flash, addr + sizeof(record), data, data_len);
+    SpiFlash_Write(flashlogi_state.flash, addr + offsetof(flashlog_record_t, crc),
+        (const uint8_t *)&record.crc, sizeof(record) - offsetof(flashlog_record_t, crc));
+    SpiFlash_Write(flashlogi_state.flash, addr, (const uint8_t *)&record.time,
+        sizeof(record.time));
+
+    flashlogi_state.head_used++;
+    flashlogi_state.last_time = time;
+    return true;
+}
+
+bool FlashLog_Find(uint32_t from, flashlog_cursor_t *cursor)
+{
+    flashlog_header_t header;
+    uint32_t low = 0, high = flashlogi_state.count, mid, sector;
+    uint16_t slot_low, slot_high, slot_mid;
+
+    if (!flashlogi_state.ready) {
+        return false;
+    }
+
+    flashlogi_state.read_error = false;
+    cursor->seq = flashlogi_state.head_seq - flashlogi_state.count + 1;
+    cursor->slot = 0;
+    cursor->used = 0;
+
+    /* Amount of sectors starting at or before given time */
+    while (low < high) {
+        mid = (low + high) / 2;
+        FlashLogi_ReadHeader(FlashLogi_Sector(mid), &header);
+        if (header.first <= from) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == 0) {
+        return !flashlogi_state.read_error;
+    }
+
+    sector = FlashLogi_Sector(low - 1);
+    cursor->seq += low - 1;
+    cursor->used = FlashLogi_GetUsed(sector);
+
+    /* First record not older than given time */
+    slot_low = 0;
+    slot_high = cursor->used;
+    while (slot_low < slot_high) {
+        slot_mid = (slot_low + slot_high) / 2;
+        if (FlashLogi_ReadTime(sector, slot_mid) < from) {
+            slot_low = slot_mid + 1;
+        } else {
+            slot_high = slot_mid;
+        }
+    }
+    cursor->slot = slot_low;
+    if (sector == flashlogi_state.head) {
+        /* Still growing, the amount of records is taken from the state */
+        cursor->used = 0;
+    }
+    return !flashlogi_state.read_error;
+}
+
+bool FlashLog_ReadNext(flashlog_cursor_t *cursor, uint32_t *time, uint8_t *data)
+{
+    uint32_t oldest, sector;
+    uint16_t used;
+
+    if (!flashlogi_state.ready) {
+        return false;
+    }
+
+    flashlogi_state.read_error = false;
+    while (flashlogi_state.count != 0) {
+        oldest = flashlogi_state.head_seq - flashlogi_state.count + 1;
+        if (cursor->seq < oldest) {
+            /* Overwritten meanwhile */
+            cursor->seq = oldest;
+            cursor->slot = 0;
+            cursor->used = 0;
+        }
+        if (cursor->seq > flashlogi_state.head_seq) {
+            return false;
+        }
+
+        sector = FlashLogi_Sector(cursor->seq - oldest);
+        if (cursor->seq == flashlogi_state.head_seq) {
+            used = flashlogi_state.head_used;
+        } else {
+            if (cursor->used == 0) {
+                cursor->used = FlashLogi_GetUsed(sector);
+                if (flashlogi_state.read_error) {
+                    cursor->used = 0;
+                    return false;
+                }
+            }
+            used = cursor->used;
+        }
+
+        if (cursor->slot < used) {
+            if (FlashLogi_ReadRecord(sector, cursor->slot, time, data)) {
+                cursor->slot++;
+                return true;
+            }
+            /* Record is read again by the next call */
+            if (flashlogi_state.read_error) {
+                return false;
+            }
+            cursor->slot++;
+            continue;
+        }
+        if (cursor->seq == flashlogi_state.head_seq) {
+            return false;
+        }
+        cursor->seq++;
+        cursor->slot = 0;
+        cursor->used = 0;
+    }
+    return false;
+}
+
+bool FlashLog_GetRange(uint32_t *first, uint32_t *last)
+{
+    flashlog_header_t header;
+
+    if (!flashlogi_state.ready || flashlogi_state.count == 0) {
+        return false;
+    }
+    flashlogi_state.read_error = false;
+    FlashLogi_ReadHeader(FlashLogi_Sector(0), &header);
+    *first = header.first;
+    *last = flashlogi_state.last_time;
+    return !flashlogi_state.read_error;
+}
+
+bool FlashLog_Init(const spiflash_desc_t *flash, uint32_t start, uint32_t sectors,
+    uint16_t data_len)
+{
+    uint32_t record_size = sizeof(flashlog_record_t) + data_len;
+
+    flashlogi_state.ready = false;
+    if (sectors < 2 || data_len == 0 ||
+        record_size > SECTOR_SIZE - sizeof(flashlog_header_t)) {
+        return false;
+    }
+
+    flashlogi_state.flash = flash;
+    flashlogi_state.start = start;
+    flashlogi_state.sectors = sectors;
+    flashlogi_state.record_size = record_size;
+    flashlogi_state.slots = (SECTOR_SIZE - sizeof(flashlog_header_t)) / record_size;
+
+    flashlogi_state.read_error = false;
+    FlashLogi_Mount();
+    /* Sectors taken as unused would be overwritten */
+    flashlogi_state.ready = !flashlogi_state.read_error;
+    return flashlogi_state.ready;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file    modules/flashlog.h
+ * @brief   Circular log of timestamped records in SPI flash
+ */
+
+#ifndef __MODULES_FLASHLOG_H
+#define __MODULES_FLASHLOG_H
+
+#include <types.h>
+#include "drivers/spi_flash.h"
+
+/** Position in the log for reading records */
+typedef struct {
+    uint32_t seq;  /**< Sequence number of the sector */
+    uint16_t slot; /**< Record in the sector */
+    uint16_t used; /**< Amount of records in the sector, internal */
+} flashlog_cursor_t;
+
+/**
+ * Append record to the log
+ *
+ * The oldest records are erased once the log region is full.
+ *
+ * @param time      Record timestamp, must not be lower than the previous one
+ * @param data      Record data, length given to FlashLog_Init
+ * @return False if not initialized or the timestamp is invalid
+ */
+bool FlashLog_Append(uint32_t time, const uint8_t *data);
+
+/**
+ * Find the first record with timestamp equal or greater than given time
+ *
+ * @param from          Timestamp to search for
+ * @param [out] cursor  Position of the record, use with FlashLog_ReadNext
+ * @return False if not initialized or flash read failed
+ */
+bool FlashLog_Find(uint32_t from, flashlog_cursor_t *cursor);
+
+/**
+ * Read record at cursor position and move cursor to the next one
+ *
+ * Records damaged by power loss are skipped. If the records at cursor were
+ * erased by new ones meanwhile, reading continues from the oldest record.
+ *
+ * @param cursor        Cursor from FlashLog_Find
+ * @param [out] time    Record timestamp
+ * @param [out] data    Record data, length given to FlashLog_Init
+ * @return False if there are no more records or flash read failed
+ */
+bool FlashLog_ReadNext(flashlog_cursor_t *cursor, uint32_t *time, uint8_t *data);
+
+/**
+ * Get time range of stored records
+ *
+ * @param [out] first   Timestamp of the oldest record
+ * @param [out] last    Timestamp of the newest record
+ * @return False if the log is empty or flash read failed
+ */
+bool FlashLog_GetRange(uint32_t *first, uint32_t *last);
+
+/**
+ * Mount the log on flash region, recover from power loss if needed
+ *
+ * @param flash     Flash memory descriptor, must remain valid
+ * @param start     Region start address, aligned to 4 kB
+ * @param sectors   Amount of 4 kB flash sectors in region, at least 2
+ * @param data_len  Length of data in each record
+ * @return False if parameters are invalid or flash read failed
+ */
+bool FlashLog_Init(const spiflash_desc_t *flash, uint32_t start, uint32_t sectors,
+    uint16_t data_len);
+
+#endif
@@ -0,0 +1,499 @@
+/**
+ * @file    modules/ftl.c
+ * @brief   Flash translation layer with wear levelling for SPI flash
+ *
+ * Logical 512 B sectors are never rewritten in place, each write goes to
+ * the next free slot of the currently open flash sector (block) and the
+ * older copy becomes invalid. Blocks with the least valid slots are
+ * reclaimed by garbage collection once free blocks run out.
+ *
+ * Block layout (4 kB):
+ *  - header (magic, erase count, sequence number), written after erase
+ *    and sequence with its inverted copy programmed when the block is
+ *    opened for writing
+ *  - tag for each slot (logical sector number), programmed after the data
+ *  - 7 data slots of 512 B from offset 512
+ *
+ * The newest copy of the sector is found by block sequence and slot
+ * position when mounting. A write interrupted by power loss leaves no
+ * valid tag, so the previous copy is used.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "modules/diskio_common.h"
+#include "modules/ftl.h"
+
+#define BLOCK_SIZE      4096U
+#define SLOTS_PER_BLOCK 7U
+#define SLOTS_OFFSET    512U
+#define HEADER_MAGIC    0x4c544641UL /* AFTL */
+#define SEQ_NONE        0xffffffffUL /* Block not opened yet */
+#define UNMAPPED        0xffffU
+
+#define MAX_SLOTS (FTL_MAX_BLOCKS * SLOTS_PER_BLOCK)
+
+#if FTL_SPARE_BLOCKS < 3
+#error "FTL needs at least 3 spare blocks for garbage collection"
+#endif
+
+/** Block header stored at block start */
+typedef struct {
+    uint32_t magic;       /**< HEADER_MAGIC if the block is formatted */
+    uint32_t erase_count; /**< Amount of block erases */
+    uint32_t seq;         /**< Order in which blocks were opened, SEQ_NONE if free */
+    uint32_t seq_check;   /**< Inverted sequence number, detects interrupted seq write */
+} ftl_header_t;
+
+/** Slot tag, identifies logical sector stored in the slot */
+typedef struct {
+    uint32_t sector; /**< Logical sector number */
+    uint32_t check;  /**< Inverted sector number, detects interrupted tag write */
+} ftl_tag_t;
+
+/** Block metadata, header and tags are read at once */
+typedef struct {
+    ftl_header_t header;
+    ftl_tag_t tags[SLOTS_PER_BLOCK];
+} ftl_meta_t;
+
+/** Block state kept in RAM */
+typedef struct {
+    uint32_t erase_count; /**< Amount of block erases */
+    uint32_t seq;         /**< Sequence number of the block, SEQ_NONE if free */
+    uint8_t valid;        /**< Amount of slots with current sector data */
+} ftl_block_t;
+
+/** FTL state */
+static struct {
+    const spiflash_desc_t *flash; /**< Flash memory */
+    uint32_t start;               /**< Region start address */
+    uint32_t blocks;              /**< Amount of blocks in region */
+    uint32_t sectors;             /**< Amount of logical sectors */
+    uint32_t seq;                 /**< Sequence number for the next opened block */
+    uint32_t free;                /**< Amount of free (erased) blocks */
+    uint32_t head;                /**< Block open for writing, blocks if none */
+    uint8_t head_slot;            /**< Next free slot in head block */
+    bool collecting;              /**< Garbage collection in progress */
+} ftli_state;
+
+/** Block states */
+static ftl_block_t ftli_blocks[FTL_MAX_BLOCKS];
+/** Map of logical sectors to physical slots (block * SLOTS_PER_BLOCK + slot) */
+static uint16_t ftli_map[MAX_SLOTS];
+
+/**
+ * Get flash address of block
+ *
+ * @param block     Block number
+ * @return Flash address
+ */
+static uint32_t Ftli_BlockAddr(uint32_t block)
+{
+    return ftli_state.start + block * BLOCK_SIZE;
+}
+
+/**
+ * Get flash address of slot data
+ *
+ * @param slot      Physical slot number
+ * @return Flash address
+ */
+static uint32_t Ftli_SlotAddr(uint16_t slot)
+{
+    return Ftli_BlockAddr(slot / SLOTS_PER_BLOCK) + SLOTS_OFFSET +
+           (slot % SLOTS_PER_BLOCK) * FTL_SECTOR_SIZE;
+}
+
+/**
+ * Erase block and write header with incremented erase count
+ *
+ * @param block         Block number
+ * @param erase_count   Erase count before this erase
+ */
+static void Ftli_Erase(uint32_t block, uint32_t erase_count)
+{
+    ftl_header_t header = {
+        .magic = HEADER_MAGIC,
+        .erase_count = erase_count + 1,
+        .seq = SEQ_NONE,
+        .seq_check = SEQ_NONE,
+    };
+
+    SpiFlash_EraseSector(ftli_state.flash, Ftli_BlockAddr(block));
+    SpiFlash_Write(ftli_state.flash, Ftli_BlockAddr(block), (const uint8_t *)&header,
+        sizeof(header));
+
+    ftli_blocks[block].erase_count = header.erase_count;
+    ftli_blocks[block].seq = SEQ_NONE;
+    ftli_blocks[block].valid = 0;
+    ftli_state.free++;
+}
+
+/**
+ * Open free block with the lowest erase count for writing
+ *
+ * @return False if no free block available
+ */
+static bool Ftli_OpenHead(void)
+{
+    uint32_t best = ftli_state.blocks;
+    uint32_t seq[2] = { ftli_state.seq, ~ftli_state.seq };
+    uint32_t addr;
+
+    for (uint32_t i = 0; i < ftli_state.blocks; i++) {
+        if (ftli_blocks[i].seq != SEQ_NONE) {
+            continue;
+        }
+        if (best == ftli_state.blocks ||
+            ftli_blocks[i].erase_count < ftli_blocks[best].erase_count)
+        {
+            best = i;
+        }
+    }
+    if (best == ftli_state.blocks) {
+        return false;
+    }
+
+    /* Sequence fields are blank after erase, can be programmed now */
+    addr = Ftli_BlockAddr(best) + offsetof(ftl_header_t, seq);
+    SpiFlash_Write(ftli_state.flash, addr, (const uint8_t *)seq, sizeof(seq));
+    ftli_blocks[best].seq = ftli_state.seq++;
+    ftli_state.free--;
+    ftli_state.head = best;
+    ftli_state.head_slot = 0;
+    return true;
+}
+
+static bool Ftli_Collect(void);
+
+/**
+ * Check the head block has no free slot
+ *
+ * @return True if new block must be opened before writing
+ */
+static bool Ftli_HeadFull(void)
+{
+    return ftli_state.head >= ftli_state.blocks || ftli_state.head_slot >= SLOTS_PER_BLOCK;
+}
+
+/**
+ * Write sector data to next free slot and update the map
+ *
+ * @param sector    Logical sector number
+ * @param buf       Sector data
+ * @return False if out of space
+ */
+static bool Ftli_Program(uint32_t sector, const uint8_t *buf)
+{
+    ftl_tag_t tag = { .sector = sector, .check = ~sector };
+    uint16_t slot;
+    uint32_t addr;
+
+    /*
+     * Two free blocks are kept when idle, collection interrupted by power
+     * loss leaves at least one for the collection after reboot
+     */
+    if (!ftli_state.collecting && Ftli_HeadFull()) {
+        while (ftli_state.free < FTL_SPARE_BLOCKS && Ftli_Collect()) {
+            ;
+        }
+    }
+    if (Ftli_HeadFull() && !Ftli_OpenHead()) {
+        return false;
+    }
+
+    slot = ftli_state.head * SLOTS_PER_BLOCK + ftli_state.head_slot;
+    SpiFlash_Write(ftli_state.flash, Ftli_SlotAddr(slot), buf, FTL_SECTOR_SIZE);
+    /* Tag written after data marks the slot valid */
+    addr = Ftli_BlockAddr(ftli_state.head) + offsetof(ftl_meta_t, tags) +
+           ftli_state.head_slot * sizeof(ftl_tag_t);
+    SpiFlash_Write(ftli_state.flash, addr, (const uint8_t *)&tag, sizeof(tag));
+    ftli_state.head_slot++;
+
+    if (ftli_map[sector] != UNMAPPED) {
+        ftli_blocks[ftli_map[sector] / SLOTS_PER_BLOCK].valid--;
+    }
+    ftli_map[sector] = slot;
+    ftli_blocks[ftli_state.head].valid++;
+    return true;
+}
+
+/**
+ * Reclaim a block, move its valid slots to the head block and erase it
+ *
+ * The block with the least valid slots is selected, unless erase counts
+ * differ too much - then the least erased block is reclaimed so its
+ * rarely changing data move to more worn block.
+ *
+ * @return True if a block was erased
+ */
+static bool Ftli_Collect(void)
+{
+    uint32_t victim = ftli_state.blocks;
+    uint32_t coldest = ftli_state.blocks;
+    uint32_t max_erase = 0;
+    uint8_t buf[FTL_SECTOR_SIZE];
+    ftl_meta_t meta;
+
+    for (uint32_t i = 0; i < ftli_state.blocks; i++) {
+        if (ftli_blocks[i].erase_count > max_erase) {
+            max_erase = ftli_blocks[i].erase_count;
+        }
+        if (ftli_blocks[i].seq == SEQ_NONE || i == ftli_state.head) {
+            continue;
+        }
+        if (victim == ftli_state.blocks || ftli_blocks[i].valid < ftli_blocks[victim].valid) {
+            victim = i;
+        }
+        if (coldest == ftli_state.blocks ||
+            ftli_blocks[i].erase_count < ftli_blocks[coldest].erase_count)
+        {
+            coldest = i;
+        }
+    }
+    if (victim == ftli_state.blocks) {
+        return false;
+    }
+    if (max_erase - ftli_blocks[coldest].erase_count > FTL_WEAR_LEVEL_THRESHOLD) {
+        victim = coldest;
+    }
+
+    if (!SpiFlash_Read(ftli_state.flash, Ftli_BlockAddr(victim), (uint8_t *)&meta,
+                       sizeof(meta))) {
+        return false;
+    }
+    ftli_state.collecting = true;
+    for (uint8_t i = 0; i < SLOTS_PER_BLOCK && ftli_blocks[victim].valid != 0; i++) {
+        uint32_t sector = meta.tags[i].sector;
+        if (sector >= ftli_state.sectors ||
+            ftli_map[sector] != victim * SLOTS_PER_BLOCK + i)
+        {
+            continue;
+        }
+        if (!SpiFlash_Read(ftli_state.flash, Ftli_SlotAddr(ftli_map[sector]), buf,
+                           FTL_SECTOR_SIZE) ||
+            !Ftli_Program(sector, buf)) {
+            break;
+        }
+    }
+    ftli_state.collecting = false;
+
+    /* Data are safe in the new location, the old copies may be erased now */
+    if (ftli_blocks[victim].valid != 0) {
+        return false;
+    }
+    Ftli_Erase(victim, ftli_blocks[victim].erase_count);
+    return true;
+}
+
+/**
+ * Check the sequence number was programmed completely or not at all
+ *
+ * @param header    Block header
+ * @return True if the block is free or the sequence number is valid
+ */
+static bool Ftli_IsSeqValid(const ftl_header_t *header)
+{
+    if (header->seq == SEQ_NONE) {
+        return header->seq_check == SEQ_NONE;
+    }
+    return header->seq_check == ~header->seq;
+}
+
+/**
+ * Check the slot holds newer copy of the sector than the mapped one
+ *
+ * @param sector    Logical sector number
+ * @param slot      Physical slot number
+ * @return True if newer
+ */
+static bool Ftli_IsNewer(uint32_t sector, uint16_t slot)
+{
+    uint16_t mapped = ftli_map[sector];
+    uint32_t seq, mapped_seq;
+
+    if (mapped == UNMAPPED) {
+        return true;
+    }
+    seq = ftli_blocks[slot / SLOTS_PER_BLOCK].seq;
+    mapped_seq = ftli_blocks[mapped / SLOTS_PER_BLOCK].seq;
+    return seq > mapped_seq || (seq == mapped_seq && slot > mapped);
+}
+
+bool Ftl_Read(uint32_t sector, uint8_t *buf)
+{
+    ASSERT_NOT(buf == NULL);
+
+    if (sector >= ftli_state.sectors) {
+        return false;
+    }
+    if (ftli_map[sector] == UNMAPPED) {
+        memset(buf, 0xff, FTL_SECTOR_SIZE);
+        return true;
+    }
+    return SpiFlash_Read(ftli_state.flash, Ftli_SlotAddr(ftli_map[sector]), buf,
+                         FTL_SECTOR_SIZE);
+}
+
+bool Ftl_Write(uint32_t sector, const uint8_t *buf)
+{
+    ASSERT_NOT(buf == NULL);
+
+    if (sector >= ftli_state.sectors) {
+        return false;
+    }
+    return Ftli_Program(sector, buf);
+}
+
+uint32_t Ftl_GetSectors(void)
+{
+    return ftli_state.sectors;
+}
+
+void Ftl_GetWear(uint32_t *min, uint32_t *max)
+{
+    *min = 0;
+    *max = 0;
+    for (uint32_t i = 0; i < ftli_state.blocks; i++) {
+        if (i == 0 || ftli_blocks[i].erase_count < *min) {
+            *min = ftli_blocks[i].erase_count;
+        }
+        if (ftli_blocks[i].erase_count > *max) {
+            *max = ftli_blocks[i].erase_count;
+        }
+    }
+}
+
+bool Ftl_Init(const spiflash_desc_t *flash, uint32_t start, uint32_t blocks)
+{
+    ftl_meta_t meta;
+
+    ASSERT_NOT(flash == NULL || start % BLOCK_SIZE != 0);
+    if (blocks > FTL_MAX_BLOCKS || blocks <= FTL_SPARE_BLOCKS) {
+        return false;
+    }
+
+    memset(&ftli_state, 0, sizeof(ftli_state));
+    memset(ftli_map, 0xff, sizeof(ftli_map));
+    ftli_state.flash = flash;
+    ftli_state.start = start;
+    ftli_state.blocks = blocks;
+    ftli_state.sectors = (blocks - FTL_SPARE_BLOCKS) * SLOTS_PER_BLOCK;
+    ftli_state.head = blocks;
+
+    /* Block states first, sequence numbers are needed to resolve sector copies */
+    for (uint32_t i = 0; i < blocks; i++) {
+        if (!SpiFlash_Read(flash, Ftli_BlockAddr(i), (uint8_t *)&meta.header,
+                           sizeof(meta.header))) {
+            /* Formatted blocks would be erased if taken as garbage */
+            ftli_state.sectors = 0;
+            return false;
+        }
+        if (meta.header.magic != HEADER_MAGIC) {
+            /* Not formatted or erase interrupted, erase count is lost */
+            Ftli_Erase(i, 0);
+            continue;
+        }
+        if (!Ftli_IsSeqValid(&meta.header)) {
+            /* Opening interrupted by power loss, no data were written to the block yet */
+            Ftli_Erase(i, meta.header.erase_count);
+            continue;
+        }
+        ftli_blocks[i].erase_count = meta.header.erase_count;
+        ftli_blocks[i].seq = meta.header.seq;
+        ftli_blocks[i].valid = 0;
+        if (meta.header.seq == SEQ_NONE) {
+            ftli_state.free++;
+        } else if (meta.header.seq >= ftli_state.seq) {
+            ftli_state.seq = meta.header.seq + 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        if (ftli_blocks[i].seq == SEQ_NONE) {
+            continue;
+        }
+        if (!SpiFlash_Read(flash, Ftli_BlockAddr(i), (uint8_t *)&meta, sizeof(meta))) {
+            ftli_state.sectors = 0;
+            return false;
+        }
+        for (uint8_t j = 0; j < SLOTS_PER_BLOCK; j++) {
+            uint32_t sector = meta.tags[j].sector;
+            uint16_t slot = i * SLOTS_PER_BLOCK + j;
+            if (meta.tags[j].check != ~sector || sector >= ftli_state.sectors) {
+                continue;
+            }
+            if (Ftli_IsNewer(sector, slot)) {
+                ftli_map[sector] = slot;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < ftli_state.sectors; i++) {
+        if (ftli_map[i] != UNMAPPED) {
+            ftli_blocks[ftli_map[i] / SLOTS_PER_BLOCK].valid++;
+        }
+    }
+    /* Partially written block is not reused, data of interrupted write may be there */
+    return true;
+}
+
+/* Block device backend for diskio layer, writes are synchronous */
+static bool Ftli_DiskInit(void *dev)
+{
+    (void)dev;
+    return ftli_state.sectors != 0;
+}
+
+static bool Ftli_DiskRead(void *dev, uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    (void)dev;
+    for (; count != 0; count--, sector++, buf += FTL_SECTOR_SIZE) {
+        if (!Ftl_Read(sector, buf)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Ftli_DiskWrite(void *dev, const uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    (void)dev;
+    for (; count != 0; count--, sector++, buf += FTL_SECTOR_SIZE) {
+        if (!Ftl_Write(sector, buf)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Ftli_DiskPresent(void *dev)
+{
+    (void)dev;
+    return true;
+}
+
+static bool Ftli_DiskSync(void *dev)
+{
+    (void)dev;
+    return true;
+}
+
+static uint32_t Ftli_DiskSectors(void *dev)
+{
+    (void)dev;
+    return Ftl_GetSectors();
+}
+
+const diskio_ops_t diskio_ftl_ops = {
+    .init = Ftli_DiskInit,
+    .present = Ftli_DiskPresent,
+    .initialized = Ftli_DiskInit,
+    .read = Ftli_DiskRead,
+    .write = Ftli_DiskWrite,
+    .sync = Ftli_DiskSync,
+    .sectors = Ftli_DiskSectors,
+    .trim = NULL,
+    .block_size = 1,
+};
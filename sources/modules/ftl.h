@@ -0,0 +1,78 @@
+/**
+ * @file    modules/ftl.h
+ * @brief   Flash translation layer with wear levelling for SPI flash
+ */
+
+#ifndef __MODULES_FTL_H
+#define __MODULES_FTL_H
+
+#include <types.h>
+#include "drivers/spi_flash.h"
+
+/* Max amount of 4 kB flash sectors managed, determines RAM usage */
+#ifndef FTL_MAX_BLOCKS
+#define FTL_MAX_BLOCKS 32
+#endif
+
+/* Amount of flash sectors not used for logical data, at least 3 */
+#ifndef FTL_SPARE_BLOCKS
+#define FTL_SPARE_BLOCKS 3
+#endif
+
+/* Difference in erase counts triggering move of rarely written data */
+#ifndef FTL_WEAR_LEVEL_THRESHOLD
+#define FTL_WEAR_LEVEL_THRESHOLD 16
+#endif
+
+/** Logical sector size */
+#define FTL_SECTOR_SIZE 512
+
+/**
+ * Read logical sector
+ *
+ * Sectors never written read as 0xff.
+ *
+ * @param sector    Logical sector number
+ * @param [out] buf Buffer for FTL_SECTOR_SIZE bytes
+ * @return False if sector is out of range, FTL not initialized or flash read failed
+ */
+bool Ftl_Read(uint32_t sector, uint8_t *buf);
+
+/**
+ * Write logical sector
+ *
+ * The data are written to a new place in flash, the write is finished
+ * (power loss safe) when the function returns.
+ *
+ * @param sector    Logical sector number
+ * @param buf       FTL_SECTOR_SIZE bytes to write
+ * @return False if sector is out of range, FTL not initialized or out of space
+ */
+bool Ftl_Write(uint32_t sector, const uint8_t *buf);
+
+/**
+ * Get amount of logical sectors available
+ *
+ * @return Amount of sectors, 0 if not initialized
+ */
+uint32_t Ftl_GetSectors(void);
+
+/**
+ * Get lowest and highest erase count of managed flash sectors
+ *
+ * @param [out] min     Lowest erase count
+ * @param [out] max     Highest erase count
+ */
+void Ftl_GetWear(uint32_t *min, uint32_t *max);
+
+/**
+ * Mount FTL on flash region, format the region if not formatted yet
+ *
+ * @param flash     Flash memory descriptor, must remain valid
+ * @param start     Region start address, aligned to 4 kB
+ * @param blocks    Amount of 4 kB flash sectors in region (up to FTL_MAX_BLOCKS)
+ * @return True if mounted, false if the flash couldn't be read
+ */
+bool Ftl_Init(const spiflash_desc_t *flash, uint32_t start, uint32_t blocks);
+
+#endif
@@ -3,11 +3,26 @@
  * @brief   Firmware upgrade module
  */
 
+#include <stddef.h>
+#include <string.h>
 #include <types.h>
 #include "hal/flash.h"
+#include "hal/power.h"
 #include "hal/reloc.h"
 #include "utils/crc.h"
 #include "fw.h"
+#ifdef FW_USE_LZSS
+#include "utils/lzss.h"
+#endif
+#ifdef FW_USE_DELTA
+#include "utils/delta.h"
+#endif
+#ifdef FW_USE_SPI_SLOT
+#include "drivers/spi_flash.h"
+#endif
+#ifdef FW_USE_RESUME
+#include "modules/kvstore.h"
+#endif
 
 /* These symbols are to be defined in a linker file */
 extern const char *_fw_runtime_addr;
@@ -23,10 +38,66 @@ extern const char *_fw_upgrade_addr;
 /** Address of the upgrade slot */
 #ifdef FW_USE_DUALSLOT
 #define FW_UPGRADE_ADDR ((uint32_t)&_fw_upgrade_addr)
+#elif defined(FW_USE_SPI_SLOT)
+#define FW_UPGRADE_ADDR (spi_slot.addr)
 #else
 #define FW_UPGRADE_ADDR ((uint32_t)&_fw_runtime_addr)
 #endif
 
+/** Image data are LZSS compressed, window size (log2), 0 if not compressed */
+#define FW_FLAG_LZSS_BITS 0x000fU
+/** Image data are patch for the runtime image (applied after decompression) */
+#define FW_FLAG_DELTA     0x0010U
+
+/** Value of the validated field once the image passed full check */
+#define FW_VALIDATED 0xa55aU
+
+#ifdef FW_USE_LZSS
+/* Largest supported compression window (log2), determines RAM usage */
+#ifndef FW_LZSS_WINDOW_BITS
+#define FW_LZSS_WINDOW_BITS 10
+#endif
+#endif
+
+#ifdef FW_USE_SPI_SLOT
+/** Erase unit of the SPI flash */
+#define FW_SPI_SECTOR_SIZE 4096U
+/** Size of the upgrade slot in SPI flash, whole sectors */
+#define FW_SPI_SLOT_SIZE                                                                         \
+    ((FW_SLOT_SIZE + FW_SPI_SECTOR_SIZE - 1) & ~(FW_SPI_SECTOR_SIZE - 1))
+/* Amount of data read from SPI flash at once, two buffers are kept in RAM */
+#ifndef FW_SPI_CHUNK_SIZE
+#define FW_SPI_CHUNK_SIZE 256U
+#endif
+#endif
+
+#ifdef FW_USE_RESUME
+/* Key-value store key of the update progress record */
+#ifndef FW_RESUME_KV_KEY
+#define FW_RESUME_KV_KEY 1
+#endif
+/* Progress is saved each time this amount of image data is written, multiple of erase unit */
+#ifndef FW_RESUME_INTERVAL
+#define FW_RESUME_INTERVAL 4096U
+#endif
+#endif
+
+#if defined(FW_USE_RESUME) && defined(FW_USE_SPI_SLOT) && (FW_RESUME_INTERVAL % 4096U) != 0
+#error "FW_RESUME_INTERVAL must be multiple of the SPI flash sector size"
+#endif
+
+#if defined(FW_USE_SPI_SLOT) && defined(FW_USE_DUALSLOT)
+#error "FW_USE_SPI_SLOT replaces the internal upgrade slot, don't define FW_USE_DUALSLOT"
+#endif
+
+#if defined(FW_USE_DELTA) && !defined(FW_USE_DUALSLOT) && !defined(FW_USE_SPI_SLOT)
+#error "Delta updates read the runtime image, FW_USE_DUALSLOT or FW_USE_SPI_SLOT is needed"
+#endif
+
+#if defined(FW_USE_DELTA) && !defined(FW_USE_LZSS)
+#error "Delta update images are always compressed, FW_USE_LZSS is needed"
+#endif
+
 #ifndef FW_MAGIC
 #error "Define FW_MAGIC macro to identify compatible fw images"
 #endif
@@ -37,6 +108,9 @@ typedef struct __attribute__((__packed__)) {
     uint32_t len;   /**< Length of the firmware image */
     uint16_t crc;   /**< Checksum of the firmware image */
     fw_meta_t meta; /**< Firmware image metadata */
+    uint16_t flags; /**< Format of the image data in update image, 0 in slot */
+    /** FW_VALIDATED if image crc was checked, 0xffff in the image, description in legacy ones */
+    uint16_t validated;
 } fw_hdr_t;
 
 /* Header must fit max header size */
@@ -45,13 +119,53 @@ _Static_assert(sizeof(fw_hdr_t) == FW_HDR_SIZE, "fw_hdr_t must be FW_HDR_SIZE lo
 /** Upgrade progress monitoring */
 static struct {
     bool running;         /**< If true, upgrade is in progress */
+    bool error;           /**< Flash read back failed or image is invalid */
+    bool unordered;       /**< Data were written out of order, crc can't be streamed */
     uint32_t erase_addr;  /**< First unerased address */
     uint32_t write_addr;  /**< Address to write incoming data to */
     uint32_t written;     /**< Amount of bytes written */
+    uint32_t received;    /**< Amount of update data received, offset in the update image */
+    uint16_t crc;         /**< CRC of the image data received so far */
     uint8_t pending_byte; /**< Writes to flash must be 2 byte aligned, pending off byte to write
                              from prev write */
+    fw_hdr_t hdr;         /**< Image header, written to flash once the image is complete */
+#ifdef FW_USE_LZSS
+    lzss_t lz; /**< Decompression state */
+#endif
+#ifdef FW_USE_DELTA
+    delta_t delta; /**< Patch decoder state */
+#endif
 } update_state;
 
+#ifdef FW_USE_RESUME
+/** Update progress, saved at FW_RESUME_INTERVAL boundaries of the image */
+typedef struct {
+    uint32_t received; /**< Amount of update data received */
+    uint32_t written;  /**< Amount of image bytes written, multiple of FW_RESUME_INTERVAL */
+    uint16_t crc;      /**< CRC of the image data written */
+#ifdef FW_USE_LZSS
+    lzss_t lz; /**< Decompression state, the window is restored from flash */
+#endif
+    fw_hdr_t hdr; /**< Image header */
+} fw_progress_t;
+#endif
+
+#ifdef FW_USE_LZSS
+/** History buffer for decompression */
+static uint8_t update_window[1U << FW_LZSS_WINDOW_BITS];
+#endif
+
+#ifdef FW_USE_SPI_SLOT
+/** Upgrade slot location, set by Fw_InitSpiSlot */
+static struct {
+    const spiflash_desc_t *flash; /**< Memory with the slot, NULL if not set */
+    uint32_t addr;                /**< Address of the slot */
+} spi_slot;
+
+/** Double buffer for reading the SPI slot, one is filled by DMA while the other is processed */
+static uint8_t spi_chunk[2][FW_SPI_CHUNK_SIZE];
+#endif
+
 /**
  * Check if the given address contains a valid image (crc, magic,...)
  *
@@ -73,6 +187,330 @@ static bool isImgValid(uint32_t addr)
     return hdr->crc == crc;
 }
 
+/**
+ * Check if the image passed the full check before and was not changed since
+ *
+ * @param addr  Address of the image header
+ */
+static bool isImgValidated(uint32_t addr)
+{
+    const fw_hdr_t *hdr = (const fw_hdr_t *)addr;
+
+    return hdr->magic == FW_MAGIC && hdr->validated == FW_VALIDATED &&
+           (hdr->len + FW_HDR_SIZE) <= FW_SLOT_SIZE;
+}
+
+/**
+ * Mark the image as validated, the full check can be skipped on next boot
+ *
+ * @param addr  Address of the image header
+ */
+static void markImgValidated(uint32_t addr)
+{
+    const uint16_t validated = FW_VALIDATED;
+
+    Flashd_WriteEnable();
+    Flashd_Write(addr + offsetof(fw_hdr_t, validated), (const uint8_t *)&validated,
+                 sizeof(validated));
+    Flashd_WriteDisable();
+}
+
+#ifdef FW_USE_SPI_SLOT
+/**
+ * Process image in the SPI slot chunk by chunk
+ *
+ * Next chunk is read by DMA while the current one is processed, the SPI
+ * transfer runs in background even when the CPU is stalled by internal
+ * flash erase or program.
+ *
+ * @param target    Address in internal flash to copy the image to, 0 to calculate crc only
+ * @param len       Length of the image including header
+ * @return CRC16 of the image data following the header
+ */
+static uint16_t processSpiImage(uint32_t target, uint32_t len)
+{
+    uint32_t page_size = Flashd_GetPageSize();
+    uint16_t crc = CRC16_INITIAL_VALUE;
+    uint32_t offset = 0;
+    uint8_t current = 0;
+
+    SpiFlash_ReadStart(spi_slot.flash, FW_UPGRADE_ADDR, spi_chunk[current], FW_SPI_CHUNK_SIZE);
+    while (offset < len) {
+        uint32_t bytes = len - offset;
+        const uint8_t *buf = spi_chunk[current];
+        if (bytes > FW_SPI_CHUNK_SIZE) {
+            bytes = FW_SPI_CHUNK_SIZE;
+        }
+
+        SpiFlash_ReadFinish(spi_slot.flash);
+        current ^= 1;
+        if ((offset + bytes) < len) {
+            SpiFlash_ReadStart(spi_slot.flash, FW_UPGRADE_ADDR + offset + bytes,
+                               spi_chunk[current], FW_SPI_CHUNK_SIZE);
+        }
+
+        if (target != 0) {
+            if (((target + offset) % page_size) == 0) {
+                Flashd_ErasePage(target + offset);
+            }
+            Flashd_Write(target + offset, buf, bytes);
+        }
+        if ((offset + bytes) > FW_HDR_SIZE) {
+            uint32_t skip = offset < FW_HDR_SIZE ? FW_HDR_SIZE - offset : 0;
+            crc = CRC16_Update(crc, &buf[skip], bytes - skip);
+        }
+        offset += bytes;
+    }
+    return crc;
+}
+#endif
+
+/**
+ * Calculate CRC16 of the image data in the upgrade slot
+ *
+ * @param len       Length of the image data
+ */
+static uint16_t getUpgradeCrc(uint32_t len)
+{
+#ifdef FW_USE_SPI_SLOT
+    return processSpiImage(0, FW_HDR_SIZE + len);
+#else
+    return CRC16((const uint8_t *)(FW_UPGRADE_ADDR + FW_HDR_SIZE), len);
+#endif
+}
+
+/**
+ * Erase the upgrade slot up to given address
+ *
+ * @param end       First address that doesn't have to be erased
+ */
+static void eraseUpgrade(uint32_t end)
+{
+#ifdef FW_USE_SPI_SLOT
+    /* Next sector is erased in background while the following data arrive */
+    end += FW_SPI_SECTOR_SIZE;
+    if (end > (FW_UPGRADE_ADDR + FW_SPI_SLOT_SIZE)) {
+        end = FW_UPGRADE_ADDR + FW_SPI_SLOT_SIZE;
+    }
+    while (update_state.erase_addr < end) {
+        SpiFlash_EraseSectorStart(spi_slot.flash, update_state.erase_addr);
+        update_state.erase_addr += FW_SPI_SECTOR_SIZE;
+    }
+#else
+    while (update_state.erase_addr < end) {
+        Flashd_ErasePage(update_state.erase_addr);
+        update_state.erase_addr += Flashd_GetPageSize();
+    }
+#endif
+}
+
+/**
+ * Write data to the upgrade slot and read them back
+ *
+ * @param addr      Address to write to
+ * @param buf       Data to be written
+ * @param len       Length of the data
+ * @return False if the flash content doesn't match the data
+ */
+static bool writeVerify(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+#ifdef FW_USE_SPI_SLOT
+    uint8_t check[32];
+    uint32_t bytes;
+
+    SpiFlash_Write(spi_slot.flash, addr, buf, len);
+    while (len != 0) {
+        bytes = len < sizeof(check) ? len : sizeof(check);
+        if (!SpiFlash_Read(spi_slot.flash, addr, check, bytes) ||
+            (memcmp(check, buf, bytes) != 0)) {
+            return false;
+        }
+        addr += bytes;
+        buf += bytes;
+        len -= bytes;
+    }
+    return true;
+#else
+    Flashd_Write(addr, buf, len);
+    return memcmp((const void *)addr, buf, len) == 0;
+#endif
+}
+
+#ifdef FW_USE_RESUME
+/**
+ * Check if the update can be resumed from the progress record
+ *
+ * Patch decoder state depends on all the data received so far, out of order
+ * updates have no single resume offset.
+ */
+static bool isResumable(void)
+{
+    return !update_state.unordered && !(update_state.hdr.flags & FW_FLAG_DELTA);
+}
+#endif
+
+/**
+ * Limit amount of image data written at once to end at the next progress save point
+ *
+ * @param len       Amount of data to be written
+ * @return Amount of data that can be written
+ */
+static uint32_t limitToSavePoint(uint32_t len)
+{
+#ifdef FW_USE_RESUME
+    uint32_t bytes = FW_RESUME_INTERVAL - (update_state.written % FW_RESUME_INTERVAL);
+
+    if (isResumable() && bytes < len) {
+        return bytes;
+    }
+#endif
+    return len;
+}
+
+#ifdef FW_USE_RESUME
+/**
+ * Store progress record, flash stays unlocked for the update
+ *
+ * @param progress  Progress record, NULL to remove it
+ * @param len       Length of the record
+ */
+static void writeProgress(const fw_progress_t *progress, uint16_t len)
+{
+    Kv_Write(FW_RESUME_KV_KEY, progress, len);
+#ifndef FW_USE_SPI_SLOT
+    /* Flash is locked by the key-value store */
+    Flashd_WriteEnable();
+#endif
+}
+#endif
+
+/**
+ * Save update progress if image data written so far end at the save point
+ *
+ * Data up to the save point are never erased when the update is resumed.
+ */
+static void saveProgress(void)
+{
+#ifdef FW_USE_RESUME
+    fw_progress_t progress;
+
+    if (((update_state.written % FW_RESUME_INTERVAL) != 0) || !isResumable()) {
+        return;
+    }
+    progress.received = update_state.received;
+    progress.written = update_state.written;
+    progress.crc = update_state.crc;
+#ifdef FW_USE_LZSS
+    progress.lz = update_state.lz;
+#endif
+    progress.hdr = update_state.hdr;
+    writeProgress(&progress, sizeof(progress));
+#endif
+}
+
+/**
+ * Remove progress record, the update can't be resumed anymore
+ */
+static void discardProgress(void)
+{
+#ifdef FW_USE_RESUME
+    uint16_t len;
+
+    if ((Kv_Get(FW_RESUME_KV_KEY, &len) != NULL) && (len != 0)) {
+        writeProgress(NULL, 0);
+    }
+#endif
+}
+
+/**
+ * Write image data to the upgrade slot, calculate crc on the fly
+ *
+ * @param buf       Data following the image header
+ * @param len       Length of the data
+ * @return False if the image doesn't fit or the flash write failed
+ */
+static bool writeImage(const uint8_t *buf, uint32_t len)
+{
+    uint32_t addr = FW_UPGRADE_ADDR + update_state.written;
+    uint32_t data_end = FW_UPGRADE_ADDR + FW_HDR_SIZE + update_state.hdr.len;
+
+    if ((addr + len) > (FW_UPGRADE_ADDR + FW_SLOT_SIZE)) {
+        return false;
+    }
+    eraseUpgrade(addr + len);
+
+    /* Data beyond the image length (e.g. padding) are not part of the crc */
+    if (addr < data_end) {
+        update_state.crc = CRC16_Update(update_state.crc, buf,
+                                        (data_end - addr) < len ? (data_end - addr) : len);
+    }
+
+    // There's a pending byte to be written from previous call, 2 byte aligned flash writes
+    if ((len != 0) && (update_state.written & 0x1UL)) {
+        uint8_t payload[2];
+        payload[0] = update_state.pending_byte;
+        payload[1] = buf[0];
+        if (!writeVerify(update_state.write_addr, payload, 2)) {
+            return false;
+        }
+
+        len--;
+        buf++;
+        update_state.written++;
+        update_state.write_addr += 2;
+    }
+    if (len & 0x1UL) {
+        update_state.pending_byte = buf[len - 1];
+        update_state.written++;
+        len--;
+    }
+    if (!writeVerify(update_state.write_addr, buf, len)) {
+        return false;
+    }
+    update_state.written += len;
+    update_state.write_addr += len;
+    return true;
+}
+
+/**
+ * Write image data to given offset of the upgrade slot
+ *
+ * Pages are erased up to the end of the data as everything written so far
+ * lies below the first unerased address.
+ *
+ * @param offset    Offset of the data in the image (including header)
+ * @param buf       Data to be written
+ * @param len       Length of the data
+ * @return False if the image doesn't fit, is not 2 bytes aligned or the flash write failed
+ */
+static bool writeImageAt(uint32_t offset, const uint8_t *buf, uint32_t len)
+{
+    uint8_t *hdr = (uint8_t *)&update_state.hdr;
+    uint32_t addr;
+    uint32_t bytes;
+
+    if (offset < FW_HDR_SIZE) {
+        bytes = FW_HDR_SIZE - offset;
+        if (bytes > len) {
+            bytes = len;
+        }
+        memcpy(&hdr[offset], buf, bytes);
+        offset += bytes;
+        buf += bytes;
+        len -= bytes;
+    }
+    if (len == 0) {
+        return true;
+    }
+
+    addr = FW_UPGRADE_ADDR + offset;
+    if ((addr & 0x1UL) || ((addr + len) > (FW_UPGRADE_ADDR + FW_SLOT_SIZE))) {
+        return false;
+    }
+    eraseUpgrade(addr + len);
+    return writeVerify(addr, buf, len);
+}
+
 #ifdef FW_USE_DUALSLOT
 /**
  * Copy firmware image from one flash address to another one
@@ -89,15 +527,15 @@ static void copyImage(uint32_t target, uint32_t source)
     uint32_t end = target + FW_HDR_SIZE + hdr->len;
 
     Flashd_WriteEnable();
-    while (source < end) {
-        uint32_t remaining = end - source;
+    while (target < end) {
+        uint32_t remaining = end - target;
         uint32_t bytes = page_size;
         if (remaining < page_size) {
             bytes = remaining;
         }
 
         Flashd_ErasePage(target);
-        Flashd_Write(target, source, bytes);
+        Flashd_Write(target, (const uint8_t *)source, bytes);
         source += bytes;
         target += bytes;
     }
@@ -105,21 +543,254 @@ static void copyImage(uint32_t target, uint32_t source)
 }
 #endif
 
-bool Fw_Run(void)
+#ifdef FW_USE_DELTA
+/**
+ * Apply patch to the runtime image and write result to the upgrade slot
+ *
+ * @param buf       Patch data
+ * @param len       Length of the data
+ * @return False if the patch is invalid or the flash write failed
+ */
+static bool writePatched(const uint8_t *buf, uint32_t len)
+{
+    uint8_t out[64];
+    uint32_t bytes;
+
+    do {
+        bytes = Delta_Decode(&update_state.delta, &buf, &len, out, sizeof(out));
+        if (!writeImage(out, bytes)) {
+            return false;
+        }
+    } while (bytes != 0);
+    return len == 0;
+}
+#endif
+
+/**
+ * Write uncompressed image data or patch
+ *
+ * @param buf       Data to be written
+ * @param len       Length of the data
+ * @return False if the image doesn't fit or the flash write failed
+ */
+static bool writeData(const uint8_t *buf, uint32_t len)
+{
+#ifdef FW_USE_DELTA
+    if (update_state.hdr.flags & FW_FLAG_DELTA) {
+        return writePatched(buf, len);
+    }
+#endif
+    return writeImage(buf, len);
+}
+
+#ifdef FW_USE_LZSS
+/**
+ * Decompress image data and write them to the upgrade slot
+ *
+ * @param buf       Compressed data
+ * @param len       Length of the data
+ * @return False if the image doesn't fit or the flash write failed
+ */
+static bool writeCompressed(const uint8_t *buf, uint32_t len)
+{
+    uint8_t out[64];
+    uint32_t bytes;
+
+    do {
+        uint32_t remaining = len;
+
+        bytes = Lzss_Decode(&update_state.lz, &buf, &len, out, limitToSavePoint(sizeof(out)));
+        update_state.received += remaining - len;
+        if (!writeData(out, bytes)) {
+            return false;
+        }
+        if (bytes != 0) {
+            saveProgress();
+        }
+    } while (bytes != 0);
+    return true;
+}
+#endif
+
+/**
+ * Prepare decoding of the image data according to header flags
+ *
+ * @return False if the image format is not supported
+ */
+static bool initDecoder(void)
+{
+    uint16_t flags = update_state.hdr.flags;
+#ifdef FW_USE_LZSS
+    uint8_t bits = flags & FW_FLAG_LZSS_BITS;
+
+    if (bits != 0) {
+        if (bits > FW_LZSS_WINDOW_BITS || !Lzss_Init(&update_state.lz, update_window, bits)) {
+            return false;
+        }
+        flags &= ~FW_FLAG_LZSS_BITS;
+    }
+#endif
+#ifdef FW_USE_DELTA
+    if (flags & FW_FLAG_DELTA) {
+        uint32_t len;
+        const uint8_t *runtime = Fw_GetImageAddr(&len);
+
+        if (runtime == NULL || len > FW_SLOT_SIZE) {
+            return false;
+        }
+        Delta_Init(&update_state.delta, runtime + FW_HDR_SIZE, len - FW_HDR_SIZE,
+                   ((const fw_hdr_t *)runtime)->crc);
+        flags &= ~FW_FLAG_DELTA;
+    }
+#endif
+    return flags == 0;
+}
+
+/**
+ * Check the whole image data were decoded
+ */
+static bool isDecoderComplete(void)
+{
+#ifdef FW_USE_LZSS
+    if ((update_state.hdr.flags & FW_FLAG_LZSS_BITS) && !Lzss_IsComplete(&update_state.lz)) {
+        return false;
+    }
+#endif
+#ifdef FW_USE_DELTA
+    if ((update_state.hdr.flags & FW_FLAG_DELTA) && !Delta_IsComplete(&update_state.delta)) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+#if defined(FW_USE_RESUME) && defined(FW_USE_LZSS)
+/**
+ * Read data from the upgrade slot
+ *
+ * @param addr      Address to read from
+ * @param [out] buf Buffer to read data to
+ * @param len       Amount of bytes to read
+ * @return False if the flash read failed
+ */
+static bool readUpgrade(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+#ifdef FW_USE_SPI_SLOT
+    return SpiFlash_Read(spi_slot.flash, addr, buf, len);
+#else
+    memcpy(buf, (const void *)addr, len);
+    return true;
+#endif
+}
+#endif
+
+#ifdef FW_USE_RESUME
+/**
+ * Restore update state from the progress record
+ *
+ * @return False if there is no usable record
+ */
+static bool loadProgress(void)
+{
+    fw_progress_t progress;
+
+    if ((Kv_Read(FW_RESUME_KV_KEY, &progress, sizeof(progress)) != sizeof(progress)) ||
+        (progress.hdr.magic != FW_MAGIC) || (progress.hdr.flags & FW_FLAG_DELTA) ||
+        (progress.written == 0) || ((progress.written % FW_RESUME_INTERVAL) != 0) ||
+        ((progress.hdr.len + FW_HDR_SIZE) > FW_SLOT_SIZE) || (progress.written > FW_SLOT_SIZE)) {
+        return false;
+    }
+#ifdef FW_USE_SPI_SLOT
+    if (spi_slot.flash == NULL) {
+        return false;
+    }
+#endif
+    update_state.hdr = progress.hdr;
+    if (!initDecoder()) {
+        return false;
+    }
+    update_state.received = progress.received;
+    update_state.written = progress.written;
+    update_state.crc = progress.crc;
+    update_state.write_addr = FW_UPGRADE_ADDR + progress.written;
+    /* Data following the record were lost, the rest of the slot is erased again */
+    update_state.erase_addr = FW_UPGRADE_ADDR + progress.written;
+    update_state.error = false;
+    update_state.unordered = false;
+#ifdef FW_USE_LZSS
+    if (update_state.hdr.flags & FW_FLAG_LZSS_BITS) {
+        uint32_t size = update_state.lz.mask + 1U;
+        uint32_t end = progress.written - FW_HDR_SIZE;
+        uint32_t pos = end > size ? end - size : 0;
+
+        if (progress.lz.window_bits != update_state.lz.window_bits) {
+            return false;
+        }
+        update_state.lz = progress.lz;
+        update_state.lz.window = update_window;
+        /* Window contains the last decompressed data, these are in the slot already */
+        while (pos < end) {
+            uint32_t index = pos & update_state.lz.mask;
+            uint32_t bytes = end - pos;
+            if (bytes > (size - index)) {
+                bytes = size - index;
+            }
+            if (!readUpgrade(FW_UPGRADE_ADDR + FW_HDR_SIZE + pos, &update_window[index], bytes)) {
+                return false;
+            }
+            pos += bytes;
+        }
+    }
+#endif
+    update_state.running = true;
+#ifndef FW_USE_SPI_SLOT
+    Flashd_WriteEnable();
+#endif
+    return true;
+}
+#endif
+
+bool Fw_Run(powerd_rst_t reset)
 {
-    bool runtime_valid = isImgValid(FW_RUNTIME_ADDR);
-#ifdef FW_USE_DUALSLOT
     const fw_hdr_t *runtime = (const fw_hdr_t *)FW_RUNTIME_ADDR;
+    /* Code might have been damaged, e.g. watchdog kicked in due to corrupted flash */
+    bool verify = (reset == POWERD_RST_WDG) || (reset == POWERD_RST_LOW_POWER);
+    bool runtime_valid = !verify && isImgValidated(FW_RUNTIME_ADDR);
+
+    if (!runtime_valid) {
+        runtime_valid = isImgValid(FW_RUNTIME_ADDR);
+    }
+#ifdef FW_USE_DUALSLOT
     const fw_hdr_t *upgrade = (const fw_hdr_t *)FW_UPGRADE_ADDR;
-    bool upgrade_valid = isImgValid(FW_UPGRADE_ADDR);
 
-    if (upgrade_valid && ((runtime->crc != upgrade->crc) || !runtime_valid)) {
+    /* Upgrade image is checked only if it differs from the runtime one */
+    if ((!runtime_valid || (runtime->crc != upgrade->crc)) && isImgValid(FW_UPGRADE_ADDR)) {
         copyImage(FW_RUNTIME_ADDR, FW_UPGRADE_ADDR);
+        runtime_valid = isImgValid(FW_RUNTIME_ADDR);
+    }
+#elif defined(FW_USE_SPI_SLOT)
+    fw_hdr_t upgrade;
+
+    if ((spi_slot.flash != NULL) &&
+        SpiFlash_Read(spi_slot.flash, FW_UPGRADE_ADDR, (uint8_t *)&upgrade, sizeof(upgrade))) {
+        /* Upgrade image is checked only if it differs from the runtime one */
+        if ((!runtime_valid || (runtime->crc != upgrade.crc)) && (upgrade.magic == FW_MAGIC) &&
+            ((upgrade.len + FW_HDR_SIZE) <= FW_SLOT_SIZE) &&
+            (processSpiImage(0, FW_HDR_SIZE + upgrade.len) == upgrade.crc)) {
+            Flashd_WriteEnable();
+            processSpiImage(FW_RUNTIME_ADDR, FW_HDR_SIZE + upgrade.len);
+            Flashd_WriteDisable();
+            runtime_valid = isImgValid(FW_RUNTIME_ADDR);
+        }
     }
 #endif
     if (!runtime_valid) {
         return false;
     }
+    /* Legacy images have description there, they are checked on every boot */
+    if (runtime->validated == 0xffff) {
+        markImgValidated(FW_RUNTIME_ADDR);
+    }
     Reloc_RunFwBinary(FW_RUNTIME_ADDR + FW_HDR_SIZE);
     return true; // just to make compiler happy
 }
@@ -129,71 +800,160 @@ bool Fw_UpdateInit(void)
     if (update_state.running) {
         return false;
     }
+#ifdef FW_USE_SPI_SLOT
+    if (spi_slot.flash == NULL) {
+        return false;
+    }
+#endif
     update_state.erase_addr = FW_UPGRADE_ADDR;
-    update_state.write_addr = FW_UPGRADE_ADDR;
+    update_state.write_addr = FW_UPGRADE_ADDR + FW_HDR_SIZE;
     update_state.written = 0;
+    update_state.received = 0;
+    update_state.crc = CRC16_INITIAL_VALUE;
+    update_state.error = false;
+    update_state.unordered = false;
+    memset(&update_state.hdr, 0, sizeof(update_state.hdr));
+    discardProgress();
     update_state.running = true;
+#ifndef FW_USE_SPI_SLOT
     Flashd_WriteEnable();
+#endif
     return true;
 }
 
 bool Fw_Update(const uint8_t *buf, uint32_t len)
 {
-    if (!update_state.running) {
-        return false;
-    }
-    if ((update_state.write_addr + len) > (FW_UPGRADE_ADDR + FW_SLOT_SIZE)) {
+    uint8_t *hdr = (uint8_t *)&update_state.hdr;
+    uint32_t bytes;
+
+    if (!update_state.running || update_state.error) {
         return false;
     }
-    if ((update_state.written == 0) && (len >= sizeof(uint32_t))) {
-        // Validate image starts with a valid magic constant
-        uint32_t *magic = (uint32_t *)buf;
-        if (*magic != FW_MAGIC) {
+
+    // Header is kept in RAM and written after the image is verified
+    if (update_state.written < FW_HDR_SIZE) {
+        bytes = FW_HDR_SIZE - update_state.written;
+        if (bytes > len) {
+            bytes = len;
+        }
+        memcpy(&hdr[update_state.written], buf, bytes);
+        update_state.written += bytes;
+        update_state.received += bytes;
+        buf += bytes;
+        len -= bytes;
+
+        if (update_state.written >= sizeof(uint32_t) && update_state.hdr.magic != FW_MAGIC) {
+            update_state.error = true;
+            return false;
+        }
+        if (update_state.written < FW_HDR_SIZE) {
+            return true;
+        }
+        if (((update_state.hdr.len + FW_HDR_SIZE) > FW_SLOT_SIZE) || !initDecoder()) {
+            update_state.error = true;
             return false;
         }
     }
 
-    while (update_state.erase_addr < (update_state.write_addr + len)) {
-        Flashd_ErasePage(update_state.erase_addr);
-        update_state.erase_addr += Flashd_GetPageSize();
+#ifdef FW_USE_LZSS
+    if (update_state.hdr.flags & FW_FLAG_LZSS_BITS) {
+        if (!writeCompressed(buf, len)) {
+            update_state.error = true;
+            return false;
+        }
+        return true;
     }
+#endif
+    while (len != 0) {
+        bytes = limitToSavePoint(len);
+        if (!writeData(buf, bytes)) {
+            update_state.error = true;
+            return false;
+        }
+        update_state.received += bytes;
+        buf += bytes;
+        len -= bytes;
+        saveProgress();
+    }
+    return true;
+}
 
-    // There's a pending byte to be written from previous call, 2 byte aligned flash writes
-    if ((len != 0) && (update_state.written & 0x1UL)) {
-        uint8_t payload[2];
-        payload[0] = update_state.pending_byte;
-        payload[1] = buf[0];
-        Flashd_Write(update_state.write_addr, payload, 2);
-
-        len--;
-        buf++;
-        update_state.written++;
-        update_state.write_addr++;
+bool Fw_UpdateWriteAt(uint32_t offset, const uint8_t *buf, uint32_t len)
+{
+    if (!update_state.running || update_state.error) {
+        return false;
     }
-    if (len & 0x1UL) {
-        update_state.pending_byte = buf[len - 1];
-        update_state.written++;
-        len--;
+    if (!update_state.unordered) {
+        if (offset == update_state.received) {
+            return Fw_Update(buf, len);
+        }
+        // Compressed data can't be placed, neither can the pending byte
+        if ((update_state.written & 0x1UL) ||
+            ((update_state.written >= FW_HDR_SIZE) && (update_state.hdr.flags != 0))) {
+            update_state.error = true;
+            return false;
+        }
+        update_state.unordered = true;
+        discardProgress();
+    }
+    if (!writeImageAt(offset, buf, len)) {
+        update_state.error = true;
+        return false;
     }
-    Flashd_Write(update_state.write_addr, buf, len);
-    update_state.written += len;
-
     return true;
 }
 
 bool Fw_UpdateFinish(void)
 {
+    bool valid;
+
     if (!update_state.running) {
         return false;
     }
-    // 2 byte aligned writes, one pending byte remaining
-    if (update_state.written & 0x1UL) {
-        Flashd_Write(update_state.write_addr, &update_state.pending_byte, 1);
+    if (update_state.unordered) {
+        // Raw image data, read back from flash
+        valid = !update_state.error && (update_state.hdr.magic == FW_MAGIC) &&
+                (update_state.hdr.flags == 0) &&
+                ((update_state.hdr.len + FW_HDR_SIZE) <= FW_SLOT_SIZE) &&
+                (getUpgradeCrc(update_state.hdr.len) == update_state.hdr.crc);
+    } else {
+        // 2 byte aligned writes, one pending byte remaining
+        if (!update_state.error && (update_state.written & 0x1UL)) {
+            update_state.error = !writeVerify(update_state.write_addr, &update_state.pending_byte,
+                                              1);
+        }
+        valid = !update_state.error &&
+                (update_state.written >= FW_HDR_SIZE + update_state.hdr.len) &&
+                (update_state.crc == update_state.hdr.crc) && isDecoderComplete();
+    }
+    // Image is usable once the header is written, shall be validated by Fw_Run again
+    if (valid) {
+        update_state.hdr.flags = 0;
+        update_state.hdr.validated = 0xffff;
+        valid = writeVerify(FW_UPGRADE_ADDR, (const uint8_t *)&update_state.hdr, FW_HDR_SIZE);
     }
 
+    discardProgress();
     update_state.running = false;
+#ifndef FW_USE_SPI_SLOT
     Flashd_WriteDisable();
-    return isImgValid(FW_UPGRADE_ADDR);
+#endif
+    return valid;
+}
+
+uint32_t Fw_UpdateResume(void)
+{
+    if (update_state.running && !update_state.error && !update_state.unordered) {
+        return update_state.received;
+    }
+    update_state.running = false;
+#ifdef FW_USE_RESUME
+    if (loadProgress()) {
+        return update_state.received;
+    }
+#endif
+    Fw_UpdateInit();
+    return 0;
 }
 
 bool Fw_UpdateIsRunning(void)
@@ -206,7 +966,7 @@ bool Fw_IsUpdateNeeded(const uint8_t *buf, uint32_t len)
     const fw_hdr_t *update = (const fw_hdr_t *)buf;
     const fw_hdr_t *runtime = (const fw_hdr_t *)FW_RUNTIME_ADDR;
 
-    if (len < (sizeof(fw_hdr_t) - sizeof(fw_meta_t))) {
+    if (len < offsetof(fw_hdr_t, meta)) {
         // not enough data
         return false;
     }
@@ -214,7 +974,7 @@ bool Fw_IsUpdateNeeded(const uint8_t *buf, uint32_t len)
         return false;
     }
 
-    if (!isImgValid(FW_RUNTIME_ADDR)) {
+    if (!isImgValidated(FW_RUNTIME_ADDR) && !isImgValid(FW_RUNTIME_ADDR)) {
         return true;
     }
     return runtime->crc != update->crc;
@@ -241,3 +1001,17 @@ const uint8_t *Fw_GetImageAddr(uint32_t *len)
     }
     return (uint8_t *)FW_RUNTIME_ADDR;
 }
+
+#ifdef FW_USE_SPI_SLOT
+bool Fw_InitSpiSlot(const spiflash_desc_t *flash, uint32_t addr)
+{
+    uint32_t size = SpiFlash_GetSize(flash);
+
+    if ((addr % FW_SPI_SECTOR_SIZE) != 0 || ((size != 0) && (addr + FW_SPI_SLOT_SIZE) > size)) {
+        return false;
+    }
+    spi_slot.flash = flash;
+    spi_slot.addr = addr;
+    return true;
+}
+#endif
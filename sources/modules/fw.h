@@ -19,6 +19,25 @@
  *      - define FW_USE_DUALSLOT (e.g. in makefile)
  *      - define linker symbol _fw_upgrade_addr
  *      - runtime slot must be at least as long as the upgrade one
+ *   - If compressed update images are needed (tools/fw.py --lzss)
+ *      - define FW_USE_LZSS
+ *      - optionally define FW_LZSS_WINDOW_BITS to the largest supported window (log2, 10 by
+ *        default), the window is kept in RAM
+ *   - If the upgrade slot shall be in SPI flash instead of the internal one
+ *      - define FW_USE_SPI_SLOT instead of FW_USE_DUALSLOT, _fw_upgrade_addr is not used
+ *      - call Fw_InitSpiSlot after SpiFlash_Init in both bootloader and firmware, the
+ *        firmware shall also call SpiFlash_WriteUnlock
+ *      - the slot takes _fw_slot_size rounded up to 4 kB sectors
+ *      - optionally define FW_SPI_CHUNK_SIZE (256 by default, must divide the internal flash
+ *        page size), two buffers of this size are used to copy the image
+ *   - If interrupted updates shall be resumable after reset (see Fw_UpdateResume)
+ *      - define FW_USE_RESUME, the progress is stored in the key-value store
+ *        (modules/kvstore.h) which has to be mounted before the update
+ *      - optionally define FW_RESUME_KV_KEY (1 by default) and FW_RESUME_INTERVAL (amount of
+ *        image data between progress records, 4096 by default, multiple of the erase unit)
+ *   - If delta update images are needed (tools/fw.py --delta), define FW_USE_DELTA, requires
+ *     FW_USE_DUALSLOT or FW_USE_SPI_SLOT as the patch is applied to the runtime image, and
+ *     FW_USE_LZSS as the tool generates compressed patches only
  *
  * Example linker header for bootloader (for single slot, drop upgrade section)
  *
@@ -53,6 +72,10 @@
 #define __MODULES_FW_H
 
 #include <types.h>
+#include "hal/power.h"
+#ifdef FW_USE_SPI_SLOT
+#include "drivers/spi_flash.h"
+#endif
 
 /** Metadata of the firmware/bootloader image */
 typedef struct __attribute__((__packed__)) {
@@ -60,15 +83,22 @@ typedef struct __attribute__((__packed__)) {
     uint8_t minor;     /**< Minor FW version, 0 for devel */
     uint8_t patch;     /**< Patch FW version, 0 for devel */
     char git_hash[47]; /**< Git has from which this fw was built 40 B + 6B dirty + trailing zero */
-    char description[68]; /**< Textual description of the binary */
+    char description[64]; /**< Textual description of the binary */
 } fw_meta_t;
 
 /**
  * Run firmware (to be used from bootloader)
  *
+ * The image crc is checked only on first boot after the update, the image is
+ * marked as validated afterwards. The check is forced after watchdog and low
+ * power resets as the image might have been damaged. Images created before the
+ * validated marker was added to the header can't be marked, those are checked
+ * on every boot.
+ *
+ * @param reset     Reason of the system reset (see Powerd_GetResetSource)
  * @return False if no valid image found. Otherwise never returns.
  */
-bool Fw_Run(void);
+bool Fw_Run(powerd_rst_t reset);
 
 /**
  * Initialize FW update
@@ -80,6 +110,9 @@ bool Fw_UpdateInit(void);
 /**
  * Write chunk of the update data
  *
+ * The crc is calculated as data arrive and written data are read back, the
+ * header is written by Fw_UpdateFinish once the image is complete.
+ *
  * @note The fw image data shall start with proper header (see sources)
  *
  * @param buf       Data to be written
@@ -89,9 +122,40 @@ bool Fw_UpdateInit(void);
  */
 bool Fw_Update(const uint8_t *buf, uint32_t len);
 
+/**
+ * Write chunk of the update data to given offset
+ *
+ * Chunks written in order are processed by Fw_Update. Once a chunk comes
+ * out of order, the image must not be compressed, chunks must be 2 bytes
+ * aligned and each written only once. The crc is then calculated from
+ * flash by Fw_UpdateFinish.
+ *
+ * @param offset    Offset of the data in the image (including header)
+ * @param buf       Data to be written
+ * @param len       Length of the data
+ *
+ * @return True if succeeded, False otherwise
+ */
+bool Fw_UpdateWriteAt(uint32_t offset, const uint8_t *buf, uint32_t len);
+
+/**
+ * Continue interrupted FW update or start a new one
+ *
+ * Update still running continues at the amount of data received so far.
+ * Otherwise the update is restored from the progress record (FW_USE_RESUME),
+ * the record is saved each FW_RESUME_INTERVAL bytes of the image, data
+ * written up to this point are kept. Delta images and updates written out of
+ * order are not resumable, a new update is initialized then.
+ *
+ * @return Offset in the update image to continue sending data from
+ */
+uint32_t Fw_UpdateResume(void);
+
 /**
  * Finish the FW update - check final CRC, lock flash,...
  *
+ * The progress record is discarded, the update can't be resumed anymore.
+ *
  * @note Shall be called even if the Fw_Update call fails
  *
  * @return true if succeeded (crc matches,...)
@@ -126,4 +190,19 @@ const fw_meta_t *Fw_GetFwMeta(void);
  */
 const uint8_t *Fw_GetImageAddr(uint32_t *len);
 
+#ifdef FW_USE_SPI_SLOT
+/**
+ * Set location of the upgrade slot in SPI flash
+ *
+ * Shall be called before Fw_Run or Fw_UpdateInit. While the update is
+ * written, next sector is erased in background. Fw_Run reads the image by
+ * DMA while the runtime slot is programmed.
+ *
+ * @param flash     Initialized SPI flash memory descriptor
+ * @param addr      Address of the slot, aligned to 4 kB sector
+ * @return False if the address is not aligned or the slot doesn't fit the memory
+ */
+bool Fw_InitSpiSlot(const spiflash_desc_t *flash, uint32_t addr);
+#endif
+
 #endif
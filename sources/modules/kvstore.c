@@ -0,0 +1,301 @@
+/**
+ * @file    modules/kvstore.c
+ * @brief   Log structured key-value store in internal flash
+ *
+ * Records (key, length, crc, value) are appended to the active page, the
+ * newest record of the key holds its current value. Once the page is full,
+ * the current values are copied to the second page which becomes active
+ * after its header is written. The header carries a sequence number, the
+ * page with the higher one is active if both are valid.
+ *
+ * The crc is programmed last and marks the record as written. A record
+ * interrupted by power loss can only be at the end of the active page,
+ * such page is compacted when mounted. Position of the newest record of
+ * each key is kept in RAM for constant time lookup.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <types.h>
+#include "hal/flash.h"
+#include "utils/crc.h"
+#include "modules/kvstore.h"
+
+#define PAGE_MAGIC 0x564bU /* KV */
+#define KEY_FREE   0xffffU
+#define NOT_FOUND  0x0000U /* Page header is at offset 0, never a record */
+
+/** Page header */
+typedef struct {
+    uint16_t seq;   /**< Incremented with each compaction */
+    uint16_t magic; /**< PAGE_MAGIC if page is valid, written last */
+    uint32_t reserved;
+} kv_page_t;
+
+/** Record header followed by value */
+typedef struct {
+    uint16_t key; /**< KEY_FREE if not written */
+    uint16_t len; /**< Length of the value */
+    uint16_t crc; /**< CRC16 of key, length and value */
+    uint16_t reserved;
+} kv_record_t;
+
+/** Store state */
+static struct {
+    const uint8_t *pages[2]; /**< Flash pages */
+    uint32_t page_size;      /**< Size of the flash page */
+    uint8_t active;          /**< Active page */
+    uint16_t seq;            /**< Sequence number of the active page */
+    uint32_t pos;            /**< Free space offset in active page */
+    bool ready;              /**< Store mounted */
+} kvi_state;
+
+/** Offset of the newest record of each key in active page */
+static uint16_t kvi_index[KV_MAX_KEYS];
+
+/**
+ * Get size of the record in flash, records are 4 bytes aligned
+ *
+ * @param len       Length of the value
+ * @return Record size
+ */
+static uint32_t Kvi_RecordSize(uint16_t len)
+{
+    return sizeof(kv_record_t) + ((len + 3U) & ~3U);
+}
+
+/**
+ * Calculate CRC of the record
+ *
+ * @param key       Record key
+ * @param len       Length of the value
+ * @param value     Value data
+ * @return CRC 16
+ */
+static uint16_t Kvi_Crc(uint16_t key, uint16_t len, const uint8_t *value)
+{
+    uint16_t crc = CRC16_INITIAL_VALUE;
+
+    crc = CRC16_Add(key & 0xff, crc);
+    crc = CRC16_Add(key >> 8, crc);
+    crc = CRC16_Add(len & 0xff, crc);
+    crc = CRC16_Add(len >> 8, crc);
+    return CRC16_Update(crc, value, len);
+}
+
+/**
+ * Write data to flash
+ *
+ * @param dst       Destination in flash memory
+ * @param buf       Data to write
+ * @param len       Amount of bytes to write
+ */
+static void Kvi_Write(const uint8_t *dst, const void *buf, uint32_t len)
+{
+    Flashd_Write((uint32_t)(uintptr_t)dst, buf, len);
+}
+
+/**
+ * Erase the page and write its header
+ *
+ * @param page      Page to format
+ * @param seq       Sequence number of the page
+ */
+static void Kvi_Format(uint8_t page, uint16_t seq)
+{
+    const uint8_t *addr = kvi_state.pages[page];
+    const uint16_t magic = PAGE_MAGIC;
+
+    Flashd_ErasePage((uint32_t)(uintptr_t)addr);
+    Kvi_Write(addr, &seq, sizeof(seq));
+    Kvi_Write(addr + offsetof(kv_page_t, magic), &magic, sizeof(magic));
+}
+
+/**
+ * Build index of the active page
+ *
+ * @return False if the page ends with damaged record or data
+ */
+static bool Kvi_Scan(void)
+{
+    const uint8_t *page = kvi_state.pages[kvi_state.active];
+    const kv_record_t *record;
+    uint32_t pos = sizeof(kv_page_t);
+    uint32_t size;
+
+    for (uint16_t i = 0; i < KV_MAX_KEYS; i++) {
+        kvi_index[i] = NOT_FOUND;
+    }
+
+    while (pos + sizeof(kv_record_t) <= kvi_state.page_size) {
+        record = (const kv_record_t *)(page + pos);
+        if (record->key == KEY_FREE) {
+            break;
+        }
+        size = Kvi_RecordSize(record->len);
+        if (record->key >= KV_MAX_KEYS || pos + size > kvi_state.page_size ||
+            record->crc != Kvi_Crc(record->key, record->len, (const uint8_t *)(record + 1))) {
+            kvi_state.pos = pos;
+            return false;
+        }
+        kvi_index[record->key] = pos;
+        pos += size;
+    }
+    kvi_state.pos = pos;
+
+    /* Interrupted write may leave data after the last record */
+    for (; pos < kvi_state.page_size; pos++) {
+        if (page[pos] != 0xff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Copy current values to the other page and make it active
+ */
+static void Kvi_Compact(void)
+{
+    uint8_t target = kvi_state.active ^ 1;
+    const uint8_t *src = kvi_state.pages[kvi_state.active];
+    const uint8_t *dst = kvi_state.pages[target];
+    const uint16_t magic = PAGE_MAGIC;
+    uint16_t seq = kvi_state.seq + 1;
+    uint32_t pos = sizeof(kv_page_t);
+    uint32_t size;
+
+    Flashd_ErasePage((uint32_t)(uintptr_t)dst);
+    for (uint16_t key = 0; key < KV_MAX_KEYS; key++) {
+        if (kvi_index[key] == NOT_FOUND) {
+            continue;
+        }
+        size = Kvi_RecordSize(((const kv_record_t *)(src + kvi_index[key]))->len);
+        Kvi_Write(dst + pos, src + kvi_index[key], size);
+        kvi_index[key] = pos;
+        pos += size;
+    }
+
+    /* Page valid from now on */
+    Kvi_Write(dst, &seq, sizeof(seq));
+    Kvi_Write(dst + offsetof(kv_page_t, magic), &magic, sizeof(magic));
+
+    kvi_state.active = target;
+    kvi_state.seq = seq;
+    kvi_state.pos = pos;
+}
+
+bool Kv_Write(uint16_t key, const void *value, uint16_t len)
+{
+    const uint8_t *current;
+    const uint8_t *dst;
+    uint16_t current_len;
+    uint32_t size = Kvi_RecordSize(len);
+    uint32_t needed = sizeof(kv_page_t) + size;
+    kv_record_t record = {
+        .key = key,
+        .len = len,
+        .crc = Kvi_Crc(key, len, value),
+        .reserved = 0xffff,
+    };
+
+    if (!kvi_state.ready || key >= KV_MAX_KEYS) {
+        return false;
+    }
+
+    current = Kv_Get(key, &current_len);
+    if (current != NULL && current_len == len && memcmp(current, value, len) == 0) {
+        return true;
+    }
+
+    /* Old value is kept until the new one is written */
+    if (kvi_state.pos + size > kvi_state.page_size) {
+        for (uint16_t i = 0; i < KV_MAX_KEYS; i++) {
+            if (kvi_index[i] != NOT_FOUND) {
+                current = kvi_state.pages[kvi_state.active] + kvi_index[i];
+                needed += Kvi_RecordSize(((const kv_record_t *)current)->len);
+            }
+        }
+        if (needed > kvi_state.page_size) {
+            return false;
+        }
+        Flashd_WriteEnable();
+        Kvi_Compact();
+    } else {
+        Flashd_WriteEnable();
+    }
+
+    /* The crc is written last, marks the record as valid */
+    dst = kvi_state.pages[kvi_state.active] + kvi_state.pos;
+    Kvi_Write(dst, &record, offsetof(kv_record_t, crc));
+    Kvi_Write(dst + sizeof(record), value, len);
+    Kvi_Write(dst + offsetof(kv_record_t, crc), &record.crc, sizeof(record.crc));
+    Flashd_WriteDisable();
+
+    kvi_index[key] = kvi_state.pos;
+    kvi_state.pos += size;
+    return true;
+}
+
+const void *Kv_Get(uint16_t key, uint16_t *len)
+{
+    const kv_record_t *record;
+
+    if (!kvi_state.ready || key >= KV_MAX_KEYS || kvi_index[key] == NOT_FOUND) {
+        return NULL;
+    }
+    record = (const kv_record_t *)(kvi_state.pages[kvi_state.active] + kvi_index[key]);
+    *len = record->len;
+    return record + 1;
+}
+
+int Kv_Read(uint16_t key, void *buf, uint16_t size)
+{
+    const void *value;
+    uint16_t len;
+
+    value = Kv_Get(key, &len);
+    if (value == NULL) {
+        return -1;
+    }
+    memcpy(buf, value, len < size ? len : size);
+    return len;
+}
+
+bool Kv_Init(const void *page1, const void *page2, uint32_t page_size)
+{
+    const kv_page_t *headers[2] = { page1, page2 };
+    bool valid[2];
+
+    kvi_state.ready = false;
+    /* Record offsets are stored in 16 bits */
+    if (page_size <= sizeof(kv_page_t) || page_size > 0x10000UL) {
+        return false;
+    }
+    kvi_state.pages[0] = page1;
+    kvi_state.pages[1] = page2;
+    kvi_state.page_size = page_size;
+
+    valid[0] = headers[0]->magic == PAGE_MAGIC;
+    valid[1] = headers[1]->magic == PAGE_MAGIC;
+    if (!valid[0] && !valid[1]) {
+        Flashd_WriteEnable();
+        Kvi_Format(0, 0);
+        Flashd_WriteDisable();
+        kvi_state.active = 0;
+    } else if (valid[0] && valid[1]) {
+        kvi_state.active = (int16_t)(headers[1]->seq - headers[0]->seq) > 0 ? 1 : 0;
+    } else {
+        kvi_state.active = valid[0] ? 0 : 1;
+    }
+    kvi_state.seq = headers[kvi_state.active]->seq;
+
+    if (!Kvi_Scan()) {
+        /* Damaged record dropped by copying the valid ones */
+        Flashd_WriteEnable();
+        Kvi_Compact();
+        Flashd_WriteDisable();
+    }
+    kvi_state.ready = true;
+    return true;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file    modules/kvstore.h
+ * @brief   Log structured key-value store in internal flash
+ */
+
+#ifndef __MODULES_KVSTORE_H
+#define __MODULES_KVSTORE_H
+
+#include <types.h>
+
+/* Amount of keys (0 to KV_MAX_KEYS - 1), determines RAM usage */
+#ifndef KV_MAX_KEYS
+#define KV_MAX_KEYS 16
+#endif
+
+/**
+ * Store value of the key
+ *
+ * The value is appended to the active flash page, the page is erased only
+ * when full and the current values are moved to the second page.
+ *
+ * @param key       Key to store value for
+ * @param value     Value data
+ * @param len       Length of the value
+ * @return False if not initialized, key is invalid or out of space
+ */
+bool Kv_Write(uint16_t key, const void *value, uint16_t len);
+
+/**
+ * Get value of the key stored in flash
+ *
+ * The value is 4 bytes aligned, the pointer is valid until next Kv_Write.
+ *
+ * @param key       Key to get value for
+ * @param [out] len Length of the value
+ * @return Pointer to the value or NULL if not found
+ */
+const void *Kv_Get(uint16_t key, uint16_t *len);
+
+/**
+ * Read value of the key
+ *
+ * @param key       Key to read value for
+ * @param [out] buf Buffer to copy the value to
+ * @param size      Size of the buffer, longer values are truncated
+ * @return Length of the value or -1 if not found
+ */
+int Kv_Read(uint16_t key, void *buf, uint16_t size);
+
+/**
+ * Mount the store, format the pages if not formatted yet
+ *
+ * @param page1     First flash page, aligned to page size
+ * @param page2     Second flash page, aligned to page size
+ * @param page_size Flash page size in bytes
+ * @return True if mounted
+ */
+bool Kv_Init(const void *page1, const void *page2, uint32_t page_size);
+
+#endif
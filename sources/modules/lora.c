@@ -23,6 +23,12 @@ static const uint8_t *lorai_DevAddr;
 static const uint8_t *lorai_NwkSkey;
 /** Application Session key, 16 bytes */
 static const uint8_t *lorai_AppSkey;
+/** Key schedule of the Network Session key */
+static aes128_ctx_t lorai_nwk_ctx;
+/** CMAC subkeys of the Network Session key */
+static uint8_t lorai_nwk_k1[16], lorai_nwk_k2[16];
+/** Key schedule of the Application Session key */
+static aes128_ctx_t lorai_app_ctx;
 /** Callback used to send data - tied to RF driver */
 static lora_send_cb_t lorai_send_cb;
 
@@ -62,7 +68,7 @@ static void Lorai_PayloadEncrypt(uint8_t *data, uint8_t len, uint32_t frame_cnt,
         block[14] = 0x00;
         block[15] = i;
 
-        AES128_Encrypt(block, lorai_AppSkey);
+        AES128_EncryptCtx(block, &lorai_app_ctx);
 
         for (j = 0; j < 16 && j < len; j++) {
             *data ^= block[j];
@@ -83,10 +89,11 @@ static void Lorai_PayloadEncrypt(uint8_t *data, uint8_t len, uint32_t frame_cnt,
  */
 static void Lorai_GetMIC(uint8_t *mic, uint8_t *data, uint8_t len, uint32_t frame_cnt, bool tx)
 {
-    uint8_t k1[16], k2[16];
     uint8_t tag[16];
     uint8_t i;
 
+    ASSERT_NOT(lorai_NwkSkey == NULL);
+
     /*
      * Lora encryption schema is strange, AES128_CMAC is run on payload with
      * following data prepended
@@ -109,34 +116,33 @@ static void Lorai_GetMIC(uint8_t *mic, uint8_t *data, uint8_t len, uint32_t fram
     tag[15] = len;
 
     /* Run the cmac algorithm */
-    AES128_CMACGetKeys(k1, k2, lorai_NwkSkey);
-    AES128_Encrypt(tag, lorai_NwkSkey);
+    AES128_EncryptCtx(tag, &lorai_nwk_ctx);
 
     /* First process n-1 blocks */
     while (len > 16) {
         for (i = 0; i < 16; i++) {
             tag[i] ^= *data++;
         }
-        AES128_Encrypt(tag, lorai_NwkSkey);
+        AES128_EncryptCtx(tag, &lorai_nwk_ctx);
         len -= 16;
     }
 
     if (len == 16) {
         /* complete block */
         for (i = 0; i < len; i++) {
-            tag[i] ^= (*data++) ^ k1[i];
+            tag[i] ^= (*data++) ^ lorai_nwk_k1[i];
         }
     } else {
         /* incomplete block */
         for (i = 0; i < len; i++) {
-            tag[i] ^= (*data++) ^ k2[i];
+            tag[i] ^= (*data++) ^ lorai_nwk_k2[i];
         }
-        tag[i] ^= 0x80 ^ k2[i];
+        tag[i] ^= 0x80 ^ lorai_nwk_k2[i];
         for (i += 1; i < 16; i++) {
-            tag[i] ^= k2[i];
+            tag[i] ^= lorai_nwk_k2[i];
         }
     }
-    AES128_Encrypt(tag, lorai_NwkSkey);
+    AES128_EncryptCtx(tag, &lorai_nwk_ctx);
 
     memcpy(mic, tag, 4);
 }
@@ -205,6 +211,15 @@ void Lora_SetAbpKeys(const uint8_t *DevAddr, const uint8_t *NwkSkey, const uint8
     lorai_NwkSkey = NwkSkey;
     lorai_AppSkey = AppSkey;
     lorai_DevAddr = DevAddr;
+
+    /* Keys are used for every block of every packet, precompute key schedules */
+    if (NwkSkey != NULL) {
+        AES128_Init(&lorai_nwk_ctx, NwkSkey);
+        AES128_CMACGetKeysCtx(lorai_nwk_k1, lorai_nwk_k2, &lorai_nwk_ctx);
+    }
+    if (AppSkey != NULL) {
+        AES128_Init(&lorai_app_ctx, AppSkey);
+    }
 }
 
 void Lora_InitAbp(lora_send_cb_t send)
@@ -61,7 +61,8 @@ void Lora_GetCounters(uint32_t *frame_rx, uint32_t *frame_tx);
  *
  * CAUTION - all memory addresses (device key,...) supplied to the function must
  * remain accessible during the runtime, the library stores only pointer to
- * these values!
+ * these values! Key schedules are precomputed here, keys changed in place
+ * require calling this function again.
  *
  * @param DevAddr   4 bytes of the Device Address
  * @param NwkSkey   16 bytes of the Network Session Key
@@ -122,6 +122,7 @@ typedef struct {
     uint32_t blocks_processed; /**< Amount of blocks already processed */
 
     uint8_t msd_buf[512]; /**< Buffer for reading/writing LBA */
+    const uint8_t *data;  /**< Data being sent to host, msd_buf or block in memory */
 
     uint8_t csw_sent; /**< Amount of bytes sent for CSW packet */
     msc_csw_t csw;    /**< The CSW packet data */
@@ -141,6 +142,7 @@ typedef struct {
     uint32_t block_count;
 
     msc_read_block_t read_block;
+    msc_read_block_ptr_t read_block_ptr;
     msc_write_block_t write_block;
 
     msc_transaction_t trans; /**< Currently running transaction state */
@@ -220,6 +222,24 @@ static void scsi_set_status_good(msc_desc_t *ms)
     scsi_set_status(ms, SENSE_KEY_NO_SENSE, ASC_NO_ADDITIONAL_SENSE_INFORMATION, ASCQ_NA);
 }
 
+/**
+ * Read next block of the transaction to be sent to host
+ *
+ * @param ms         MSC device descriptor
+ */
+static void scsi_read_block(msc_desc_t *ms)
+{
+    uint32_t lba = ms->trans.lba_start + ms->trans.blocks_processed;
+
+    if (ms->read_block_ptr != NULL) {
+        ms->trans.data = ms->read_block_ptr(lba, ms->trans.msd_buf);
+    } else {
+        ms->read_block(lba, ms->trans.msd_buf);
+        ms->trans.data = ms->trans.msd_buf;
+    }
+    ms->trans.blocks_processed++;
+}
+
 static void scsi_finish_transaction(msc_transaction_t *trans)
 {
     trans->lba_start = 0xffffffff;
@@ -403,6 +423,7 @@ static void scsi_command(msc_desc_t *ms)
     ms->trans.bytes_to_read = 0;
     ms->trans.bytes_processed = 0;
     ms->trans.blocks_processed = 0;
+    ms->trans.data = ms->trans.msd_buf;
 
     switch (ms->trans.cbw.CBWCB[0]) {
         case SCSI_TEST_UNIT_READY:
@@ -496,15 +517,13 @@ static void msci_data_rx(usbd_device *usbd_dev, uint8_t ep)
         }
         /* data writing, fill tx buffer here, rest will be done in tx function */
     } else if (trans->bytes_processed < trans->bytes_to_write) {
-        if (trans->block_count > 0 && (trans->bytes_processed && 0x1ff) == 0) {
-            lba = trans->lba_start + trans->blocks_processed;
-            (*ms->read_block)(lba, trans->msd_buf);
-            trans->blocks_processed++;
+        if (trans->block_count > 0 && (trans->bytes_processed & 0x1ff) == 0) {
+            scsi_read_block(ms);
         }
 
         left = MIN(trans->bytes_to_write - trans->bytes_processed, ms->ep_out_size);
         trans->bytes_processed += usbd_ep_write_packet(usbd_dev, ms->ep_in,
-            &trans->msd_buf[0x1ff & trans->bytes_processed], left);
+            &trans->data[0x1ff & trans->bytes_processed], left);
         /* everything written/readed or nothing to read/write */
     } else {
         if (trans->block_count > 0 && trans->blocks_processed == trans->block_count) {
@@ -532,20 +551,18 @@ static void msci_data_rx(usbd_device *usbd_dev, uint8_t ep)
  */
 static void msci_data_tx(usbd_device *usbd_dev, uint8_t ep)
 {
-    uint32_t lba, left;
+    uint32_t left;
     msc_desc_t *ms = &msci_desc;
     msc_transaction_t *trans = &ms->trans;
 
     /* have some bytes to send */
     if (trans->bytes_processed < trans->bytes_to_write) {
         if (trans->block_count != 0 && (0x1ff & trans->bytes_processed) == 0) {
-            lba = trans->lba_start + trans->blocks_processed;
-            ms->read_block(lba, trans->msd_buf);
-            trans->blocks_processed++;
+            scsi_read_block(ms);
         }
         left = MIN(trans->bytes_to_write - trans->bytes_processed, ms->ep_out_size);
         trans->bytes_processed += usbd_ep_write_packet(usbd_dev, ep,
-            &trans->msd_buf[0x1ff & trans->bytes_processed], left);
+            &trans->data[0x1ff & trans->bytes_processed], left);
         return;
     }
 
@@ -651,3 +668,8 @@ void Msc_Init(usbd_device *usbd_dev, uint8_t ep_in, uint8_t ep_in_size, uint8_t
 
     usbd_register_set_config_callback(usbd_dev, msci_set_config);
 }
+
+void Msc_RegisterReadPtrCb(msc_read_block_ptr_t read_block_ptr)
+{
+    msci_desc.read_block_ptr = read_block_ptr;
+}
@@ -15,6 +15,13 @@
 typedef int (*msc_read_block_t)(uint32_t lba, uint8_t *buf);
 typedef int (*msc_write_block_t)(uint32_t lba, const uint8_t *buf);
 
+/**
+ * @param lba - Logical block address - 1 = 512, 2 = 1024,...
+ * @param buf - Buffer to copy 512 bytes to if the block is not available in memory
+ * @return Pointer to the block data (512 bytes), either buf or other memory
+ */
+typedef const uint8_t *(*msc_read_block_ptr_t)(uint32_t lba, uint8_t *buf);
+
 /**
  * Initialize the USB Mass Storage
  *
@@ -35,4 +42,14 @@ void Msc_Init(usbd_device *usbd_dev, uint8_t ep_in, uint8_t ep_in_size, uint8_t
     const char *product_revision_level, msc_read_block_t read_block, msc_write_block_t write_block,
     uint32_t block_count);
 
+/**
+ * Register function to read blocks without copying them to internal buffer
+ *
+ * When set, used instead of read_block passed to Msc_Init. The returned data
+ * must stay valid until the next call.
+ *
+ * @param read_block_ptr    Function to call when host request read of a LBA block or NULL
+ */
+void Msc_RegisterReadPtrCb(msc_read_block_ptr_t read_block_ptr);
+
 #endif
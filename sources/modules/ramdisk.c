@@ -1,9 +1,10 @@
 /**
  * @file    modules/ramdisk.h
- * @brief   RAMdisk emulation with on the fly file creation, uses FAT16
+ * @brief   RAMdisk emulation with on the fly file creation, uses FAT16 or FAT32
  *
  * FAT16 description http://www.maverick-os.dk/FileSystemFormats/FAT16_FileSystem.html
  * http://www.tavi.co.uk/phobos/fat.html
+ * FAT32 description https://en.wikipedia.org/wiki/Design_of_the_FAT_file_system
  */
 
 #include <string.h>
@@ -25,12 +26,36 @@
 
 /* FAT16 has to have at least this amount of clusters to be recognized as fat16 */
 #define FAT16_MIN_CLUSTERS 4095
+/* FAT32 is used for volumes with more clusters than this */
+#define FAT16_MAX_CLUSTERS 65524
+/* FAT32 has to have at least this amount of clusters to be recognized as fat32 */
+#define FAT32_MIN_CLUSTERS 65525
 
-/* First sector of the root directory */
-#define FAT1_START_SECTOR 1U /* first sector is boot sector, followed by fat1 */
+/* FAT32 reserved area layout */
+#define FAT32_RESERVED_SECTORS   32U
+#define FAT32_FSINFO_SECTOR      1U
+#define FAT32_BACKUP_BOOT_SECTOR 6U
+
+/* Marks the end of the cluster chain in extents table */
+#define FAT_CHAIN_END 0xffffffffUL
+
+/* Directory entry attributes */
+#define FAT_ATTR_VOLUME_LABEL 0x08
+#define FAT_ATTR_DIRECTORY    0x10
+/* First filename byte of the deleted directory entry */
+#define FAT_ENTRY_DELETED     0xe5
+
+/* Reserved area (boot sector,...) is followed by fat1 */
+#define FAT1_START_SECTOR ((uint32_t)ramdiski_info.reserved_sectors)
 #define FAT2_START_SECTOR (FAT1_START_SECTOR + ramdiski_info.fat_sectors)
+/* First sector of the root directory */
 #define ROOT_START_SECTOR (FAT2_START_SECTOR + ramdiski_info.fat_sectors)
-#define DATA_START_SECTOR (ROOT_START_SECTOR + ceil_div(ROOT_ENTRIES * DIR_ENTRY_SIZE, SECTOR_SIZE))
+#define ROOT_END_SECTOR   (ROOT_START_SECTOR + ramdiski_info.root_sectors)
+/* FAT32 stores root directory in data area, starting at cluster 2 */
+#define DATA_START_SECTOR (ramdiski_info.fat32 ? ROOT_START_SECTOR : ROOT_END_SECTOR)
+/* First cluster available for files */
+#define FILES_START_CLUSTER \
+    (2U + (ramdiski_info.fat32 ? ramdiski_info.root_sectors / SECTORS_PER_CLUSTER : 0))
 
 #define FAT_2BYTES(x) ((x) & 0xFF), (((x) >> 8) & 0xFF)
 #define FAT_4BYTES(x) ((x) & 0xFF), (((x) >> 8) & 0xFF), (((x) >> 16) & 0xFF), (((x) >> 24) & 0xFF)
@@ -40,7 +65,7 @@
 #error Too many files for ramdisk defined
 #endif
 
-/** Directory entry FAT16 structure */
+/** Directory entry FAT16/FAT32 structure */
 typedef struct {
     char filename[8]; /**< Filename, zero padded, [0]=0x00 stop search */
     char extension[3];
@@ -50,7 +75,7 @@ typedef struct {
     uint16_t creation_time;
     uint16_t creation_date;
     uint16_t last_access_date;
-    uint16_t reserved2;
+    uint16_t start_cluster_hi; /**< High word of start cluster, FAT32 only */
     uint16_t last_write_time;
     uint16_t last_write_date;
     uint16_t start_cluster;
@@ -59,40 +84,29 @@ typedef struct {
 
 /** Type for virtual files */
 typedef struct {
-    uint8_t name[8];      /**< File name (padded with spaces) */
-    uint8_t extension[3]; /**< File extension */
-    uint8_t time[2];      /**< Time created in fat format */
-    uint8_t date[2];      /**< Date created in fat format */
-    uint8_t attr;         /**< File attributes */
-    uint32_t size;        /**< File size in bytes */
-    uint16_t cluster;     /**< First cluster of the file */
-    ramdisk_read_t read;  /**< Function called upon read requests or NULL */
-    const char *content;  /**< Text content of the file when read is NULL */
+    uint8_t name[8];        /**< File name (padded with spaces) */
+    uint8_t extension[3];   /**< File extension */
+    uint8_t time[2];        /**< Time created in fat format */
+    uint8_t date[2];        /**< Date created in fat format */
+    uint8_t attr;           /**< File attributes */
+    uint32_t size;          /**< File size in bytes */
+    uint32_t cluster;       /**< First cluster of the file */
+    ramdisk_read_t read;     /**< Function called upon read requests or NULL */
+#ifdef RAMDISK_USE_STREAM
+    ramdisk_stream_t stream; /**< Function generating streamed content or NULL */
+#endif
+    const uint8_t *content;  /**< Content of the file in memory when read is NULL */
 } ramdisk_file_t;
 
-/** Ramdisk parameters */
-typedef struct {
-    uint32_t sectors_count; /**< Size of volume in sectors */
-    uint16_t fat_sectors;   /**< Size of fat table in sectors */
-    char name[11];          /**< Volume label */
-} ramdisk_info_t;
-
-/** Info about a new file being written to ramdisk */
+#ifdef RAMDISK_USE_STREAM
+/** Resume points of the streamed file */
 typedef struct {
-    char name[9];      /**< File name including termination character */
-    char extension[4]; /**< File extension including termination character */
-    uint32_t size;     /**< File size in bytes */
-    uint16_t cluster;  /**< Start cluster */
-} ramdisk_write_file_t;
-
-/** Files shown in ramdisk, if name starts with 0, file is ignored */
-static ramdisk_file_t ramdiski_files[RAMDISK_MAX_FILES];
-
-/** Parameters of the ramdisk that are calculated during runtime */
-static ramdisk_info_t ramdiski_info;
-
-/** Write file callback */
-static ramdisk_write_file_cb_t ramdiski_write_file_cb;
+    uint32_t interval;       /**< Distance between checkpoints in bytes */
+    ramdisk_cursor_t cursor; /**< Position following the last read */
+    /** First position found in each interval, offset 0 if unknown */
+    ramdisk_cursor_t checkpoints[RAMDISK_STREAM_CHECKPOINTS];
+} ramdisk_stream_info_t;
+#endif
 
 /** FAT16 Boot sector header */
 static const uint8_t fat16i_boot_sector[] = {
@@ -120,6 +134,100 @@ static const uint8_t fat16i_boot_sector[] = {
     'F', 'A', 'T', '1', '6', ' ', ' ', ' '                 /* Filesystem type */
 };
 
+/** FAT32 Boot sector header */
+static const uint8_t fat32i_boot_sector[] = {
+    0xeb, 0x58, 0x90,                        /* bootstrap program */
+    'm', 'k', 'd', 'o', 's', 'f', 's', 0x00, /* OEM ID */
+    /* Bios parameters block */
+    FAT_2BYTES(512),                    /* sector size */
+    SECTORS_PER_CLUSTER,                /* sectors per cluster */
+    FAT_2BYTES(FAT32_RESERVED_SECTORS), /* reserved sectors, boot sector, fsinfo, backup,... */
+    2,                                  /* Number of FAT copies, usually 2 to prevent data loss */
+    FAT_2BYTES(0),                      /* Number of root entries, 0 for FAT32 */
+    FAT_2BYTES(0),                      /* Small number of sectors, 0 for FAT32 */
+    0xf8,                               /* Media descriptor, non-formated disk */
+    FAT_2BYTES(0),                      /* Size of FAT table in sectors, 0 for FAT32 */
+    FAT_2BYTES(63),                     /* Sectors per track, for physical disk geometry */
+    FAT_2BYTES(255),                    /* Number of heads */
+    FAT_4BYTES(0),                      /* Hidden sectors */
+    FAT_4BYTES(0),                      /* Large number of sectors, overridden in code */
+    /* FAT32 extended bios parameters block */
+    FAT_4BYTES(0),                        /* Size of FAT table in sectors, overridden in code */
+    FAT_2BYTES(0),                        /* Flags, FAT mirroring enabled */
+    FAT_2BYTES(0),                        /* Version */
+    FAT_4BYTES(2),                        /* First cluster of the root directory */
+    FAT_2BYTES(FAT32_FSINFO_SECTOR),      /* FS information sector */
+    FAT_2BYTES(FAT32_BACKUP_BOOT_SECTOR), /* Boot sector copy */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* Reserved */
+    0x80,                                                  /* Drive number */
+    0x00,                                                  /* Reserved */
+    0x29,                                                  /* Extended boot signature */
+    FAT_4BYTES(0xdeadbeef),                                /* Volume serial number */
+    'r', 'a', 'm', 'd', 'i', 's', 'k', ' ', ' ', ' ', ' ', /* Volume label, overridden in code */
+    'F', 'A', 'T', '3', '2', ' ', ' ', ' '                 /* Filesystem type */
+};
+
+/** Ramdisk parameters */
+typedef struct {
+    uint32_t sectors_count;                          /**< Size of volume in sectors */
+    uint32_t fat_sectors;                            /**< Size of fat table in sectors */
+    uint32_t clusters;                               /**< Amount of clusters in data area */
+    uint16_t reserved_sectors;                       /**< Sectors before the first FAT */
+    uint16_t root_sectors;                           /**< Size of root directory in sectors */
+    bool fat32;                                      /**< FAT32 is used instead of FAT16 */
+    char name[11];                                   /**< Volume label */
+    uint32_t generation;                             /**< Incremented on files layout change */
+    uint8_t boot_sector[sizeof(fat32i_boot_sector)]; /**< Boot sector header filled in init */
+} ramdisk_info_t;
+
+/** Generated metadata sector stored in cache */
+typedef struct {
+    uint32_t lba;              /**< Address of the sector (FAT2 sectors are stored as FAT1) */
+    uint32_t generation;       /**< Files layout generation the data were generated for */
+    uint8_t data[SECTOR_SIZE]; /**< Sector content */
+} ramdisk_cache_t;
+
+/** File written by the host, found in root directory writes */
+typedef struct {
+    ramdisk_write_file_t file; /**< File info, cluster is 0 if unused */
+    uint16_t entry;            /**< Index of the entry in root directory */
+} ramdisk_host_file_t;
+
+/** Run of contiguous clusters of host written files found in FAT writes */
+typedef struct {
+    uint32_t start; /**< First cluster of the run */
+    uint32_t count; /**< Amount of clusters in the run, 0 if unused */
+    uint32_t next;  /**< Cluster following the last cluster of the run or FAT_CHAIN_END */
+} ramdisk_extent_t;
+
+/** Files shown in ramdisk, if name starts with 0, file is ignored */
+static ramdisk_file_t ramdiski_files[RAMDISK_MAX_FILES];
+
+#ifdef RAMDISK_USE_STREAM
+/** Resume points of streamed files, indexed as ramdiski_files */
+static ramdisk_stream_info_t ramdiski_streams[RAMDISK_MAX_FILES];
+#endif
+
+/** Parameters of the ramdisk that are calculated during runtime */
+static ramdisk_info_t ramdiski_info;
+
+/** Write file callback */
+static ramdisk_write_file_cb_t ramdiski_write_file_cb;
+
+/** Files found in root directory written by the host */
+static ramdisk_host_file_t ramdiski_host_files[RAMDISK_MAX_WRITE_FILES];
+
+/** Cluster chains of the host written files */
+static ramdisk_extent_t ramdiski_extents[RAMDISK_MAX_EXTENTS];
+
+#if RAMDISK_CACHE_SECTORS > 0
+/** Recently generated FAT and root directory sectors */
+static ramdisk_cache_t ramdiski_cache[RAMDISK_CACHE_SECTORS];
+
+/** Cache entry to be replaced next */
+static uint8_t ramdiski_cache_next;
+#endif
+
 /**
  * Set two bytes value in little endian
  *
@@ -147,22 +255,325 @@ static void Ramdiski_To4Bytes(uint32_t num, uint8_t *buf)
 }
 
 /**
- * Helper for generating text file, return one sector worth of file data
+ * Read two bytes value in little endian
+ *
+ * @param buf       Buffer to read value from
+ * @return Decoded value
+ */
+static uint16_t Ramdiski_From2Bytes(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+/**
+ * Read four bytes value in little endian
+ *
+ * @param buf       Buffer to read value from
+ * @return Decoded value
+ */
+static uint32_t Ramdiski_From4Bytes(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * Copy space padded fat name to null terminated string
+ *
+ * @param dest      Destination buffer (at least len + 1 bytes long)
+ * @param src       Space padded name
+ * @param len       Length of the src
+ */
+static void Ramdiski_CopyName(char *dest, const char *src, size_t len)
+{
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+    while (len > 0 && dest[len - 1] == ' ') {
+        dest[--len] = '\0';
+    }
+}
+
+/**
+ * Get amount of clusters reserved for a virtual file
+ *
+ * @param size      File size
+ * @return Cluster count, empty files occupy one cluster too
+ */
+static uint32_t Ramdiski_ClusterCount(uint32_t size)
+{
+    uint32_t count = ceil_div(size, CLUSTER_SIZE);
+
+    return count != 0 ? count : 1;
+}
+
+/**
+ * Get first cluster that is not occupied by virtual files
+ *
+ * @return Cluster number
+ */
+static uint32_t Ramdiski_GetFreeCluster(void)
+{
+    uint32_t free_cluster = FILES_START_CLUSTER;
+    uint32_t end_cluster;
+
+    for (uint16_t id = 0; id < RAMDISK_MAX_FILES; id++) {
+        if (ramdiski_files[id].name[0] == 0x00) {
+            break;
+        }
+
+        end_cluster = ramdiski_files[id].cluster + Ramdiski_ClusterCount(ramdiski_files[id].size);
+        if (end_cluster > free_cluster) {
+            free_cluster = end_cluster;
+        }
+    }
+    return free_cluster;
+}
+
+/**
+ * Calculate FAT size and amount of data clusters from the volume size
+ */
+static void Ramdiski_CalcLayout(void)
+{
+    uint8_t entry_size = ramdiski_info.fat32 ? 4 : 2;
+    uint32_t sectors;
+
+    /* Estimate, the reserved area, FATs and root directory are not part of the data area */
+    ramdiski_info.clusters = ceil_div(ramdiski_info.sectors_count, SECTORS_PER_CLUSTER) + 2;
+    ramdiski_info.fat_sectors =
+        ceil_div((uint64_t)ramdiski_info.clusters * entry_size, SECTOR_SIZE);
+
+    sectors = ramdiski_info.sectors_count - ramdiski_info.reserved_sectors -
+              2 * ramdiski_info.fat_sectors;
+    if (!ramdiski_info.fat32) {
+        sectors -= ramdiski_info.root_sectors;
+    }
+    ramdiski_info.clusters = sectors / SECTORS_PER_CLUSTER;
+}
+
+/**
+ * Find the cluster run containing given cluster
+ *
+ * @param cluster   Cluster number
+ * @return Cluster run or NULL if not found
+ */
+static ramdisk_extent_t *Ramdiski_ExtentFind(uint32_t cluster)
+{
+    for (uint8_t i = 0; i < RAMDISK_MAX_EXTENTS; i++) {
+        ramdisk_extent_t *run = &ramdiski_extents[i];
+        if (run->count != 0 && cluster >= run->start && cluster < run->start + run->count) {
+            return run;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Get unused cluster run entry
+ *
+ * @return Unused entry or NULL if table is full
+ */
+static ramdisk_extent_t *Ramdiski_ExtentAlloc(void)
+{
+    for (uint8_t i = 0; i < RAMDISK_MAX_EXTENTS; i++) {
+        if (ramdiski_extents[i].count == 0) {
+            return &ramdiski_extents[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Forget cluster links in given range, e.g. when FAT sector is rewritten
+ *
+ * @param first     First cluster of the range
+ * @param last      Cluster following the last cluster of the range
+ */
+static void Ramdiski_ExtentsRemove(uint32_t first, uint32_t last)
+{
+    for (uint8_t i = 0; i < RAMDISK_MAX_EXTENTS; i++) {
+        ramdisk_extent_t *run = &ramdiski_extents[i];
+        uint32_t end = run->start + run->count;
+
+        if (run->count == 0 || end <= first || run->start >= last) {
+            continue;
+        }
+
+        if (run->start < first && end > last) {
+            /* Range is in the middle of the run, split it */
+            ramdisk_extent_t *tail = Ramdiski_ExtentAlloc();
+            if (tail != NULL) {
+                tail->start = last;
+                tail->count = end - last;
+                tail->next = run->next;
+            }
+        }
+        if (run->start < first) {
+            run->count = first - run->start;
+            run->next = first;
+        } else if (end > last) {
+            run->count = end - last;
+            run->start = last;
+        } else {
+            run->count = 0;
+        }
+    }
+}
+
+/**
+ * Add cluster link found in FAT table
+ *
+ * @param cluster   Cluster number
+ * @param next      Following cluster in chain or FAT_CHAIN_END
+ * @return False if there's no space left in extents table
+ */
+static bool Ramdiski_ExtentsAdd(uint32_t cluster, uint32_t next)
+{
+    ramdisk_extent_t *run = NULL;
+
+    /* Append to the run that continues with this cluster */
+    for (uint8_t i = 0; i < RAMDISK_MAX_EXTENTS; i++) {
+        ramdisk_extent_t *cur = &ramdiski_extents[i];
+        if (cur->count != 0 && cur->start + cur->count == cluster && cur->next == cluster) {
+            run = cur;
+            break;
+        }
+    }
+
+    if (run == NULL) {
+        run = Ramdiski_ExtentAlloc();
+        if (run == NULL) {
+            return false;
+        }
+        run->start = cluster;
+        run->count = 0;
+    }
+    run->count++;
+    run->next = next;
+
+    /* Join with the run following this cluster */
+    if (next == cluster + 1) {
+        for (uint8_t i = 0; i < RAMDISK_MAX_EXTENTS; i++) {
+            ramdisk_extent_t *cur = &ramdiski_extents[i];
+            if (cur != run && cur->count != 0 && cur->start == next) {
+                run->count += cur->count;
+                run->next = cur->next;
+                cur->count = 0;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Find position of the cluster in the host written file
+ *
+ * If the FAT for the file was not written yet, contiguous allocation is assumed.
+ *
+ * @param file          File to search the cluster in
+ * @param cluster       Cluster to be found
+ * @param [out] index   Index of the cluster from the file start
+ * @return True if cluster belongs to the file
+ */
+static bool Ramdiski_GetClusterIndex(const ramdisk_write_file_t *file, uint32_t cluster,
+    uint32_t *index)
+{
+    uint32_t cur = file->cluster;
+    uint32_t pos = 0;
+    ramdisk_extent_t *run = Ramdiski_ExtentFind(cur);
+
+    if (run == NULL) {
+        if (cluster >= cur && cluster < cur + ceil_div(file->size, CLUSTER_SIZE)) {
+            *index = cluster - cur;
+            return true;
+        }
+        return false;
+    }
+
+    /* Each run can be visited once at most, protects from looped chains */
+    for (uint8_t i = 0; i < RAMDISK_MAX_EXTENTS && run != NULL; i++) {
+        uint32_t end = run->start + run->count;
+        if (cluster >= cur && cluster < end) {
+            *index = pos + cluster - cur;
+            return true;
+        }
+        pos += end - cur;
+        cur = run->next;
+        run = Ramdiski_ExtentFind(cur);
+    }
+    return false;
+}
+
+/**
+ * Helper for files stored in memory, return one sector worth of file data
  *
  * @param id        File id (from internal structure)
  * @param offset    Offset in bytes to the file
  * @param buf       Buffer to store one sector to
  */
-static void Ramdiski_ReadTextFile(int id, uint32_t offset, uint8_t *buf)
+static void Ramdiski_ReadMemFile(int id, uint32_t offset, uint8_t *buf)
 {
+    uint32_t size;
+
     ASSERT_NOT(ramdiski_files[id].content == NULL);
 
     if (offset >= ramdiski_files[id].size) {
         return;
     }
 
-    strncpy((char *)buf, &ramdiski_files[id].content[offset], SECTOR_SIZE);
+    size = ramdiski_files[id].size - offset;
+    if (size > SECTOR_SIZE) {
+        size = SECTOR_SIZE;
+    }
+    memcpy(buf, &ramdiski_files[id].content[offset], size);
+    memset(&buf[size], 0x00, SECTOR_SIZE - size);
 }
+#ifdef RAMDISK_USE_STREAM
+
+/**
+ * Helper for streamed files, return one sector worth of file data
+ *
+ * Content generation is resumed from the closest known position before offset
+ *
+ * @param id        File id (from internal structure)
+ * @param offset    Offset in bytes to the file
+ * @param buf       Buffer to store data to
+ * @param len       Amount of bytes to read
+ */
+static void Ramdiski_ReadStreamFile(int id, uint32_t offset, uint8_t *buf, size_t len)
+{
+    ramdisk_stream_info_t *info = &ramdiski_streams[id];
+    ramdisk_cursor_t cursor = { 0 };
+    uint32_t slot = offset / info->interval;
+
+    if (slot >= RAMDISK_STREAM_CHECKPOINTS) {
+        slot = RAMDISK_STREAM_CHECKPOINTS - 1;
+    }
+    /* Closest checkpoint before offset, offset 0 marks unused one */
+    do {
+        if (info->checkpoints[slot].offset != 0 && info->checkpoints[slot].offset <= offset) {
+            cursor = info->checkpoints[slot];
+            break;
+        }
+    } while (slot-- > 0);
+
+    /* Sequential reads continue where the previous one ended */
+    if (info->cursor.offset <= offset && info->cursor.offset > cursor.offset) {
+        cursor = info->cursor;
+    }
+
+    ramdiski_files[id].stream(&cursor, offset, buf, len);
+    ASSERT_NOT(cursor.offset > offset + len);
+    info->cursor = cursor;
+
+    /* Keep the first position found in each interval */
+    slot = cursor.offset / info->interval;
+    if (slot < RAMDISK_STREAM_CHECKPOINTS &&
+        (info->checkpoints[slot].offset == 0 || info->checkpoints[slot].offset > cursor.offset))
+    {
+        info->checkpoints[slot] = cursor;
+    }
+}
+#endif
 
 /**
  * Create a new file in ramdisk
@@ -172,16 +583,16 @@ static void Ramdiski_ReadTextFile(int id, uint32_t offset, uint8_t *buf)
  * @param time          Created timestamp
  * @param size          File size in bytes
  * @param read          Function to read data from file or NULL
- * @param content       String content of the file if read is NULL
+ * @param content       Content of the file in memory if read is NULL
  *
  * @return  id of the file added or -1 if failed
  */
 static int Ramdiski_AddFile(const char *filename, const char *extension, time_t time, size_t size,
-    ramdisk_read_t read, const char *content)
+    ramdisk_read_t read, const uint8_t *content)
 {
     uint16_t id;
     struct tm *s_tm;
-    uint32_t cluster = 2;
+    uint32_t cluster = FILES_START_CLUSTER;
 
     ASSERT_NOT(filename == NULL || extension == NULL);
 
@@ -190,14 +601,14 @@ static int Ramdiski_AddFile(const char *filename, const char *extension, time_t
         if (ramdiski_files[id].name[0] == 0x00) {
             break;
         }
-        cluster = (uint32_t)ramdiski_files[id].cluster + ramdiski_files[id].size / CLUSTER_SIZE + 1;
+        cluster = ramdiski_files[id].cluster + Ramdiski_ClusterCount(ramdiski_files[id].size);
     }
     if (id >= RAMDISK_MAX_FILES) {
         return -1;
     }
 
     /* check if there's enough clusters for the file */
-    if (cluster + size / CLUSTER_SIZE >= 0xffef) {
+    if (cluster + Ramdiski_ClusterCount(size) > ramdiski_info.clusters + 2) {
         return -1;
     }
 
@@ -231,6 +642,7 @@ static int Ramdiski_AddFile(const char *filename, const char *extension, time_t
     if (read == NULL) {
         ramdiski_files[id].content = content;
     }
+    ramdiski_info.generation++;
     return id;
 }
 
@@ -280,11 +692,60 @@ static void Ramdiski_GetRootDirectory(uint8_t *buf, uint32_t block)
         memcpy(&entry->last_write_time, ramdiski_files[id].time, 2);
         memcpy(&entry->last_write_date, ramdiski_files[id].date, 2);
         Ramdiski_To2Bytes(ramdiski_files[id].cluster, (uint8_t *)&entry->start_cluster);
+        Ramdiski_To2Bytes(ramdiski_files[id].cluster >> 16, (uint8_t *)&entry->start_cluster_hi);
         Ramdiski_To4Bytes(ramdiski_files[id].size, (uint8_t *)&entry->file_size);
         entry++;
     }
 }
 
+/**
+ * Write FAT entry
+ *
+ * @param buf       FAT sector buffer
+ * @param index     Index of the entry in the sector
+ * @param value     Entry value
+ */
+static void Ramdiski_SetFATEntry(uint8_t *buf, uint32_t index, uint32_t value)
+{
+    if (ramdiski_info.fat32) {
+        Ramdiski_To4Bytes(value & 0x0fffffff, &buf[index * 4]);
+    } else {
+        Ramdiski_To2Bytes(value, &buf[index * 2]);
+    }
+}
+
+/**
+ * Fill FAT sector entries of the contiguous cluster chain
+ *
+ * @param buf       FAT sector buffer
+ * @param first     Cluster described by the first entry of the sector
+ * @param start     First cluster of the chain
+ * @param count     Amount of clusters in chain
+ */
+static void Ramdiski_SetFATChain(uint8_t *buf, uint32_t first, uint32_t start, uint32_t count)
+{
+    uint32_t last = first + SECTOR_SIZE / (ramdiski_info.fat32 ? 4 : 2);
+    uint32_t from = start;
+    uint32_t to = start + count;
+
+    /* Only part of the chain described by this sector */
+    if (from < first) {
+        from = first;
+    }
+    if (to > last) {
+        to = last;
+    }
+
+    for (uint32_t cluster = from; cluster < to; cluster++) {
+        if (cluster == start + count - 1) {
+            /* Last cluster of the chain */
+            Ramdiski_SetFATEntry(buf, cluster - first, 0xffffffff);
+        } else {
+            Ramdiski_SetFATEntry(buf, cluster - first, cluster + 1);
+        }
+    }
+}
+
 /**
  * Generate FAT table for existing files
  *
@@ -293,54 +754,137 @@ static void Ramdiski_GetRootDirectory(uint8_t *buf, uint32_t block)
  * @param buf   Destination for generated data (512 bytes)
  * @param block Block offset relative to the first block of FAT table (0-...)
  */
-static void Ramdiski_GetFAT16(uint8_t *buf, uint32_t block)
+static void Ramdiski_GetFAT(uint8_t *buf, uint32_t block)
 {
-    uint32_t i;
-    uint16_t id;
-    uint16_t offset;  /* Offset to buf */
-    uint16_t cluster; /* address of current cluster */
+    uint32_t first = block * (SECTOR_SIZE / (ramdiski_info.fat32 ? 4 : 2));
+    uint32_t count;
 
     memset(buf, 0x00, SECTOR_SIZE);
     if (block == 0) {
-        /* Required initial header */
-        buf[0] = 0xf8;
-        buf[1] = 0xff;
-        buf[2] = 0xff;
-        buf[3] = 0xff;
-        offset = 4;
-        cluster = 2;
-    } else {
-        offset = 0;
-        cluster = block * SECTOR_SIZE / 2;
+        /* Required initial header, media descriptor and end of chain marker */
+        Ramdiski_SetFATEntry(buf, 0, 0xfffffff8);
+        Ramdiski_SetFATEntry(buf, 1, 0xffffffff);
+    }
+    if (ramdiski_info.fat32) {
+        Ramdiski_SetFATChain(buf, first, 2, FILES_START_CLUSTER - 2);
     }
 
-    for (id = 0; id < RAMDISK_MAX_FILES && offset < SECTOR_SIZE; id++) {
+    for (uint16_t id = 0; id < RAMDISK_MAX_FILES; id++) {
         if (ramdiski_files[id].name[0] == 0x00) {
             break;
         }
-        /* Skip files which were stored to FAT in previous blocks */
-        if (ramdiski_files[id].cluster + ramdiski_files[id].size / CLUSTER_SIZE < cluster) {
-            continue;
+
+        count = Ramdiski_ClusterCount(ramdiski_files[id].size);
+        Ramdiski_SetFATChain(buf, first, ramdiski_files[id].cluster, count);
+    }
+}
+
+/**
+ * Generate boot sector
+ *
+ * @param buf   Destination for generated data (512 bytes)
+ */
+static void Ramdiski_GetBootSector(uint8_t *buf)
+{
+    memset(buf, 0, SECTOR_SIZE);
+    memcpy(buf, ramdiski_info.boot_sector, sizeof(ramdiski_info.boot_sector));
+    /* boot sector signature */
+    buf[SECTOR_SIZE - 2] = 0x55;
+    buf[SECTOR_SIZE - 1] = 0xAA;
+}
+
+/**
+ * Generate sectors of reserved area following the boot sector (FAT32 only)
+ *
+ * @param buf   Destination for generated data (512 bytes)
+ * @param lba   Sector address between 1 and FAT1_START_SECTOR
+ */
+static void Ramdiski_GetReserved(uint8_t *buf, uint32_t lba)
+{
+    if (lba == FAT32_BACKUP_BOOT_SECTOR) {
+        Ramdiski_GetBootSector(buf);
+        return;
+    }
+
+    memset(buf, 0, SECTOR_SIZE);
+    if (lba == FAT32_FSINFO_SECTOR || lba == FAT32_BACKUP_BOOT_SECTOR + FAT32_FSINFO_SECTOR) {
+        /* FS information sector, free clusters count and next free cluster unknown */
+        Ramdiski_To4Bytes(0x41615252, &buf[0]);
+        Ramdiski_To4Bytes(0x61417272, &buf[484]);
+        Ramdiski_To4Bytes(0xffffffff, &buf[488]);
+        Ramdiski_To4Bytes(0xffffffff, &buf[492]);
+        Ramdiski_To4Bytes(0xaa550000, &buf[508]);
+    }
+}
+
+/**
+ * Generate FAT or root directory sector, cached data are used if available
+ *
+ * @param buf   Destination for generated data (512 bytes)
+ * @param lba   Sector address between FAT1_START_SECTOR and ROOT_END_SECTOR
+ */
+static void Ramdiski_GetMetadata(uint8_t *buf, uint32_t lba)
+{
+    /* Both FAT copies are identical, share the cache entries */
+    if (lba >= FAT2_START_SECTOR && lba < ROOT_START_SECTOR) {
+        lba -= ramdiski_info.fat_sectors;
+    }
+
+#if RAMDISK_CACHE_SECTORS > 0
+    for (uint8_t i = 0; i < RAMDISK_CACHE_SECTORS; i++) {
+        if (ramdiski_cache[i].lba == lba &&
+            ramdiski_cache[i].generation == ramdiski_info.generation)
+        {
+            memcpy(buf, ramdiski_cache[i].data, SECTOR_SIZE);
+            return;
         }
+    }
+#endif
 
-        if (ramdiski_files[id].size != CLUSTER_SIZE) {
-            for (i = cluster - ramdiski_files[id].cluster;
-                i < ramdiski_files[id].size / CLUSTER_SIZE && offset < SECTOR_SIZE;
-                i++)
-            {
-                Ramdiski_To2Bytes(cluster + 1, &buf[offset]);
-                offset += 2;
-                cluster += 1;
-            }
+    if (lba < ROOT_START_SECTOR) {
+        Ramdiski_GetFAT(buf, lba - FAT1_START_SECTOR);
+    } else {
+        Ramdiski_GetRootDirectory(buf, lba - ROOT_START_SECTOR);
+    }
+
+#if RAMDISK_CACHE_SECTORS > 0
+    ramdiski_cache[ramdiski_cache_next].lba = lba;
+    ramdiski_cache[ramdiski_cache_next].generation = ramdiski_info.generation;
+    memcpy(ramdiski_cache[ramdiski_cache_next].data, buf, SECTOR_SIZE);
+    ramdiski_cache_next = (ramdiski_cache_next + 1) % RAMDISK_CACHE_SECTORS;
+#endif
+}
+
+/**
+ * Find virtual file stored at given block address
+ *
+ * @param block         Block offset relative to the first block of data area (0-...)
+ * @param [out] offset  Offset of the block from the file start in bytes
+ * @return File id or -1 if the block doesn't belong to any file
+ */
+static int Ramdiski_FindFile(uint32_t block, uint32_t *offset)
+{
+    uint16_t id;
+    uint32_t cluster = block / SECTORS_PER_CLUSTER + 2;
+
+    for (id = 0; id < RAMDISK_MAX_FILES; id++) {
+        if (ramdiski_files[id].name[0] == 0x00) {
+            return -1;
         }
-        /* Last cluster of the file */
-        if (offset < SECTOR_SIZE) {
-            buf[offset] = 0xff;
-            buf[offset + 1] = 0xff;
-            offset += 2;
-            cluster++;
+        if (cluster < ramdiski_files[id].cluster ||
+            cluster >= ramdiski_files[id].cluster + Ramdiski_ClusterCount(ramdiski_files[id].size))
+        {
+            continue;
+        }
+
+        *offset = block - (ramdiski_files[id].cluster - 2) * SECTORS_PER_CLUSTER;
+        *offset *= SECTOR_SIZE;
+        if (*offset >= ramdiski_files[id].size) {
+            continue;
         }
+        return id;
     }
+    return -1;
 }
 
 /**
@@ -351,79 +895,172 @@ static void Ramdiski_GetFAT16(uint8_t *buf, uint32_t block)
  */
 static void Ramdiski_GetFile(uint8_t *buf, uint32_t block)
 {
-    uint16_t id;
-    uint16_t cluster = block / SECTORS_PER_CLUSTER + 2;
     uint32_t offset;
+    int id = Ramdiski_FindFile(block, &offset);
 
-    for (id = 0; id < RAMDISK_MAX_FILES; id++) {
-        if (ramdiski_files[id].name[0] == 0x00) {
+    if (id < 0) {
+        return;
+    }
+
+    if (ramdiski_files[id].content != NULL) {
+        Ramdiski_ReadMemFile(id, offset, buf);
+    } else {
+        uint32_t size = ramdiski_files[id].size - offset;
+        if (size > SECTOR_SIZE) {
+            size = SECTOR_SIZE;
+        }
+#ifdef RAMDISK_USE_STREAM
+        if (ramdiski_files[id].stream != NULL) {
+            Ramdiski_ReadStreamFile(id, offset, buf, size);
             return;
         }
-        if (cluster < ramdiski_files[id].cluster ||
-            cluster > ramdiski_files[id].cluster + ramdiski_files[id].size / CLUSTER_SIZE)
+#endif
+        ramdiski_files[id].read(offset, buf, size);
+    }
+}
+
+/**
+ * Process host write to the root directory, track newly created files
+ *
+ * @param buf   Data written (512 bytes)
+ * @param block Block offset relative to the first block of root entries (0-...)
+ */
+static void Ramdiski_WriteRootDirectory(const uint8_t *buf, uint32_t block)
+{
+    const fat_dir_entry_t *entry = (const fat_dir_entry_t *)buf;
+    uint16_t first = block * (SECTOR_SIZE / DIR_ENTRY_SIZE);
+    uint32_t free_cluster = Ramdiski_GetFreeCluster();
+    uint32_t cluster;
+    uint16_t id;
+
+    /* Sector content was replaced, forget files found there previously */
+    for (id = 0; id < RAMDISK_MAX_WRITE_FILES; id++) {
+        if (ramdiski_host_files[id].entry >= first &&
+            ramdiski_host_files[id].entry < first + SECTOR_SIZE / DIR_ENTRY_SIZE)
         {
-            continue;
+            ramdiski_host_files[id].file.cluster = 0;
         }
+    }
 
-        offset = block - (ramdiski_files[id].cluster - 2) * SECTORS_PER_CLUSTER;
-        offset *= SECTOR_SIZE;
-        if (offset >= ramdiski_files[id].size) {
+    for (uint16_t i = 0; i < SECTOR_SIZE / DIR_ENTRY_SIZE; i++, entry++) {
+        if (entry->filename[0] == 0x00) {
+            /* No more entries in directory */
+            break;
+        }
+        /* Long file names have volume label attribute set too */
+        if ((uint8_t)entry->filename[0] == FAT_ENTRY_DELETED ||
+            (entry->attribute & (FAT_ATTR_VOLUME_LABEL | FAT_ATTR_DIRECTORY)) != 0)
+        {
+            continue;
+        }
+        /* Empty file or one of the virtual files */
+        cluster = Ramdiski_From2Bytes((const uint8_t *)&entry->start_cluster);
+        if (ramdiski_info.fat32) {
+            cluster |= (uint32_t)Ramdiski_From2Bytes((const uint8_t *)&entry->start_cluster_hi)
+                << 16;
+        }
+        if (cluster < free_cluster) {
             continue;
         }
 
-        if (ramdiski_files[id].read != NULL) {
-            uint32_t size = ramdiski_files[id].size - offset;
-            if (size > SECTOR_SIZE) {
-                size = SECTOR_SIZE;
+        for (id = 0; id < RAMDISK_MAX_WRITE_FILES; id++) {
+            if (ramdiski_host_files[id].file.cluster == 0) {
+                break;
             }
-            ramdiski_files[id].read(offset, buf, size);
+        }
+        if (id >= RAMDISK_MAX_WRITE_FILES) {
+            return;
+        }
+
+        Ramdiski_CopyName(ramdiski_host_files[id].file.name, entry->filename, 8);
+        Ramdiski_CopyName(ramdiski_host_files[id].file.extension, entry->extension, 3);
+        ramdiski_host_files[id].file.size =
+            Ramdiski_From4Bytes((const uint8_t *)&entry->file_size);
+        ramdiski_host_files[id].file.cluster = cluster;
+        ramdiski_host_files[id].entry = first + i;
+    }
+}
+
+/**
+ * Process host write to the FAT table, track cluster chains of new files
+ *
+ * @param buf   Data written (512 bytes)
+ * @param block Block offset relative to the first block of FAT table (0-...)
+ */
+static void Ramdiski_WriteFAT(const uint8_t *buf, uint32_t block)
+{
+    uint8_t entry_size = ramdiski_info.fat32 ? 4 : 2;
+    uint32_t cluster = block * (SECTOR_SIZE / entry_size);
+    uint32_t free_cluster = Ramdiski_GetFreeCluster();
+    uint32_t bad = ramdiski_info.fat32 ? 0x0ffffff7 : 0xfff7;
+    uint32_t next;
+
+    Ramdiski_ExtentsRemove(cluster, cluster + SECTOR_SIZE / entry_size);
+    for (uint16_t i = 0; i < SECTOR_SIZE; i += entry_size, cluster++) {
+        if (ramdiski_info.fat32) {
+            next = Ramdiski_From4Bytes(&buf[i]) & 0x0fffffff;
         } else {
-            Ramdiski_ReadTextFile(id, offset, buf);
+            next = Ramdiski_From2Bytes(&buf[i]);
         }
-        return;
+        /* Ignore virtual files, free and bad clusters */
+        if (cluster < free_cluster || next == 0 || next == bad) {
+            continue;
+        }
+        if (next > bad) {
+            next = FAT_CHAIN_END;
+        }
+        Ramdiski_ExtentsAdd(cluster, next);
     }
 }
 
 /**
  * Writing to data area
  *
- * As the data are written before root directory file entry, assume all
- * data written in first empty cluster belong to a file being written.
+ * The file the data belongs to is found by cluster chains from FAT and
+ * root directory writes. If not found (host didn't write FAT and root
+ * directory yet), assume the data belong to a file starting at the first
+ * empty cluster.
  *
  * @param buf   Data to be written
  * @param block Block offset relative to the first block of data area (0-...)
  */
 static void Ramdiski_WriteData(const uint8_t *buf, uint32_t block)
 {
-    uint16_t cur_cluster = block / SECTORS_PER_CLUSTER + 2;
-    uint16_t last_cluster = 0;
-    uint16_t end_cluster;
-    uint16_t id;
+    uint32_t cluster = block / SECTORS_PER_CLUSTER + 2;
+    uint32_t free_cluster = Ramdiski_GetFreeCluster();
+    const ramdisk_write_file_t *file;
+    uint32_t size = SECTOR_SIZE;
     uint32_t offset;
+    uint32_t index;
 
-    /* Calculate cluster where the last virtual file ends */
-    for (id = 0; id < RAMDISK_MAX_FILES; id++) {
-        if (ramdiski_files[id].name[0] == 0x00) {
-            break;
-        }
+    if (cluster < free_cluster || ramdiski_write_file_cb == NULL) {
+        /* Trying to write to virtual files area */
+        return;
+    }
 
-        end_cluster = ramdiski_files[id].cluster + ramdiski_files[id].size / CLUSTER_SIZE;
-        if (end_cluster > last_cluster) {
-            last_cluster = end_cluster;
+    for (uint16_t id = 0; id < RAMDISK_MAX_WRITE_FILES; id++) {
+        file = &ramdiski_host_files[id].file;
+        if (file->cluster == 0 || !Ramdiski_GetClusterIndex(file, cluster, &index)) {
+            continue;
         }
-    }
 
-    if (last_cluster >= cur_cluster) {
-        /* Trying to write to virtual files area */
+        offset = index * CLUSTER_SIZE + (block % SECTORS_PER_CLUSTER) * SECTOR_SIZE;
+        if (file->size != 0) {
+            if (offset >= file->size) {
+                /* Slack space after the end of file */
+                return;
+            }
+            if (file->size - offset < size) {
+                size = file->size - offset;
+            }
+        }
+        ramdiski_write_file_cb(file, buf, size, offset);
         return;
     }
 
-    offset = block - (last_cluster + 1 - 2) * SECTORS_PER_CLUSTER;
+    offset = block - (free_cluster - 2) * SECTORS_PER_CLUSTER;
     offset *= SECTOR_SIZE;
-
-    if (ramdiski_write_file_cb != NULL) {
-        ramdiski_write_file_cb(buf, SECTOR_SIZE, offset);
-    }
+    ramdiski_write_file_cb(NULL, buf, SECTOR_SIZE, offset);
 }
 
 int Ramdisk_Read(uint32_t lba, uint8_t *buf)
@@ -431,47 +1068,51 @@ int Ramdisk_Read(uint32_t lba, uint8_t *buf)
     ASSERT_NOT(buf == NULL);
 
     if (lba == 0) {
-        memset(buf, 0, SECTOR_SIZE);
-        memcpy(buf, fat16i_boot_sector, sizeof(fat16i_boot_sector));
-        if (ramdiski_info.sectors_count < 65535) {
-            /* Small number of sectors */
-            Ramdiski_To2Bytes(ramdiski_info.sectors_count, &buf[0x13]);
-        } else {
-            /* Large number of sectors */
-            Ramdiski_To4Bytes(ramdiski_info.sectors_count, &buf[0x20]);
-        }
-        /* Sectors per FAT */
-        Ramdiski_To2Bytes(ramdiski_info.fat_sectors, &buf[0x16]);
-        /* Disk name */
-        memcpy(&buf[0x2b], ramdiski_info.name, 11);
-        /* boot sector signature */
-        buf[SECTOR_SIZE - 2] = 0x55;
-        buf[SECTOR_SIZE - 1] = 0xAA;
-    } else if (lba >= FAT1_START_SECTOR && lba < FAT2_START_SECTOR) {
-        Ramdiski_GetFAT16(buf, lba - FAT1_START_SECTOR);
-    } else if (lba >= FAT2_START_SECTOR && lba < ROOT_START_SECTOR) {
-        Ramdiski_GetFAT16(buf, lba - FAT2_START_SECTOR);
-    } else if (lba >= ROOT_START_SECTOR && lba < DATA_START_SECTOR) {
-        Ramdiski_GetRootDirectory(buf, lba - ROOT_START_SECTOR);
-    } else if (lba >= DATA_START_SECTOR) {
+        Ramdiski_GetBootSector(buf);
+    } else if (lba < FAT1_START_SECTOR) {
+        Ramdiski_GetReserved(buf, lba);
+    } else if (lba < ROOT_END_SECTOR) {
+        Ramdiski_GetMetadata(buf, lba);
+    } else {
         Ramdiski_GetFile(buf, lba - DATA_START_SECTOR);
     }
     return 0;
 }
 
+const uint8_t *Ramdisk_ReadPtr(uint32_t lba, uint8_t *buf)
+{
+    uint32_t offset;
+    int id;
+
+    ASSERT_NOT(buf == NULL);
+
+    if (lba >= ROOT_END_SECTOR) {
+        id = Ramdiski_FindFile(lba - DATA_START_SECTOR, &offset);
+        /* Whole sector available in memory, no need to copy it */
+        if (id >= 0 && ramdiski_files[id].content != NULL &&
+            ramdiski_files[id].size - offset >= SECTOR_SIZE)
+        {
+            return &ramdiski_files[id].content[offset];
+        }
+    }
+
+    Ramdisk_Read(lba, buf);
+    return buf;
+}
+
 int Ramdisk_Write(uint32_t lba, const uint8_t *buf)
 {
     ASSERT_NOT(buf == NULL);
 
-    if (lba == 0) {
-        /* Boot sector writes are ignored */
-    } else if (lba >= FAT1_START_SECTOR && lba < FAT2_START_SECTOR) {
-        /* FAT writes are ignored */
-    } else if (lba >= FAT2_START_SECTOR && lba < ROOT_START_SECTOR) {
-        /* FAT writes are ignored */
-    } else if (lba >= ROOT_START_SECTOR && lba < DATA_START_SECTOR) {
-        /* Root directory writes are ignored */
-    } else if (lba >= DATA_START_SECTOR) {
+    if (lba < FAT1_START_SECTOR) {
+        /* Boot sector and reserved area writes are ignored */
+    } else if (lba < FAT2_START_SECTOR) {
+        Ramdiski_WriteFAT(buf, lba - FAT1_START_SECTOR);
+    } else if (lba < ROOT_START_SECTOR) {
+        /* Second FAT copy has the same content, ignored */
+    } else if (lba < ROOT_END_SECTOR) {
+        Ramdiski_WriteRootDirectory(buf, lba - ROOT_START_SECTOR);
+    } else {
         Ramdiski_WriteData(buf, lba - DATA_START_SECTOR);
     }
     return 0;
@@ -484,10 +1125,39 @@ int Ramdisk_AddFile(const char *filename, const char *extension, time_t time, si
     return Ramdiski_AddFile(filename, extension, time, size, read, NULL);
 }
 
+#ifdef RAMDISK_USE_STREAM
+int Ramdisk_AddStreamFile(const char *filename, const char *extension, time_t time, size_t size,
+    ramdisk_stream_t stream)
+{
+    int id;
+
+    ASSERT_NOT(stream == NULL);
+    id = Ramdiski_AddFile(filename, extension, time, size, NULL, NULL);
+    if (id < 0) {
+        return id;
+    }
+
+    ramdiski_files[id].stream = stream;
+    memset(&ramdiski_streams[id], 0x00, sizeof(ramdisk_stream_info_t));
+    ramdiski_streams[id].interval = ceil_div(size, RAMDISK_STREAM_CHECKPOINTS);
+    if (ramdiski_streams[id].interval == 0) {
+        ramdiski_streams[id].interval = 1;
+    }
+    return id;
+}
+#endif
+
 int Ramdisk_AddTextFile(const char *filename, const char *extension, time_t time, const char *text)
 {
     ASSERT_NOT(text == NULL);
-    return Ramdiski_AddFile(filename, extension, time, strlen(text), NULL, text);
+    return Ramdiski_AddFile(filename, extension, time, strlen(text), NULL, (const uint8_t *)text);
+}
+
+int Ramdisk_AddMemFile(const char *filename, const char *extension, time_t time,
+    const uint8_t *data, size_t size)
+{
+    ASSERT_NOT(data == NULL);
+    return Ramdiski_AddFile(filename, extension, time, size, NULL, data);
 }
 
 bool Ramdisk_RenameFile(int handle, const char *filename, const char *extension)
@@ -507,12 +1177,19 @@ bool Ramdisk_RenameFile(int handle, const char *filename, const char *extension)
     for (size_t i = 2; i >= strlen(extension); i--) {
         ramdiski_files[handle].extension[i] = ' ';
     }
+    ramdiski_info.generation++;
     return true;
 }
 
 void Ramdisk_Clear(void)
 {
     memset(ramdiski_files, 0x00, sizeof(ramdiski_files));
+#ifdef RAMDISK_USE_STREAM
+    memset(ramdiski_streams, 0x00, sizeof(ramdiski_streams));
+#endif
+    memset(ramdiski_host_files, 0x00, sizeof(ramdiski_host_files));
+    memset(ramdiski_extents, 0x00, sizeof(ramdiski_extents));
+    ramdiski_info.generation++;
 }
 
 uint32_t Ramdisk_GetSectors(void)
@@ -525,23 +1202,66 @@ void Ramdisk_RegisterWriteCb(ramdisk_write_file_cb_t cb)
     ramdiski_write_file_cb = cb;
 }
 
-void Ramdisk_Init(size_t size, const char *name)
+void Ramdisk_Init(uint64_t size, const char *name)
 {
-    uint32_t clusters;
-
-    ASSERT_NOT(size / CLUSTER_SIZE >= 65524);
     /* Increase size to achieve minimal required cluster count for fat 16 */
     if (size < FAT16_MIN_CLUSTERS * CLUSTER_SIZE) {
         size = FAT16_MIN_CLUSTERS * CLUSTER_SIZE;
     }
+    /* Sectors count must fit 32 bits even after increasing to fat32 minimal size */
+    ASSERT_NOT(size / SECTOR_SIZE >= 0xffffffffULL - FAT32_MIN_CLUSTERS * SECTORS_PER_CLUSTER);
 
     ramdiski_info.sectors_count = ceil_div(size, SECTOR_SIZE);
-    clusters = ceil_div(ramdiski_info.sectors_count, SECTORS_PER_CLUSTER) + 2;
-    ramdiski_info.fat_sectors = ceil_div(clusters, SECTOR_SIZE / 2);
+    ramdiski_info.fat32 = false;
+    ramdiski_info.reserved_sectors = 1;
+    ramdiski_info.root_sectors = ceil_div(ROOT_ENTRIES * DIR_ENTRY_SIZE, SECTOR_SIZE);
+    Ramdiski_CalcLayout();
+
+    if (ramdiski_info.clusters > FAT16_MAX_CLUSTERS) {
+        /* Too large for FAT16, root directory is then stored in whole clusters */
+        ramdiski_info.fat32 = true;
+        ramdiski_info.reserved_sectors = FAT32_RESERVED_SECTORS;
+        ramdiski_info.root_sectors =
+            ceil_div(ROOT_ENTRIES * DIR_ENTRY_SIZE, CLUSTER_SIZE) * SECTORS_PER_CLUSTER;
+        Ramdiski_CalcLayout();
+
+        /* Increase size to achieve minimal required cluster count for fat 32 */
+        while (ramdiski_info.clusters < FAT32_MIN_CLUSTERS) {
+            ramdiski_info.sectors_count +=
+                (FAT32_MIN_CLUSTERS - ramdiski_info.clusters) * SECTORS_PER_CLUSTER;
+            Ramdiski_CalcLayout();
+        }
+    }
 
     /* set volume label, pad with spaces */
     strncpy(ramdiski_info.name, name, sizeof(ramdiski_info.name));
     for (uint8_t i = strlen(name); i < sizeof(ramdiski_info.name); i++) {
         ramdiski_info.name[i] = ' ';
     }
+
+    /* Boot sector content doesn't change until next init, prepare it now */
+    memset(ramdiski_info.boot_sector, 0x00, sizeof(ramdiski_info.boot_sector));
+    if (ramdiski_info.fat32) {
+        memcpy(ramdiski_info.boot_sector, fat32i_boot_sector, sizeof(fat32i_boot_sector));
+        Ramdiski_To4Bytes(ramdiski_info.sectors_count, &ramdiski_info.boot_sector[0x20]);
+        /* Sectors per FAT */
+        Ramdiski_To4Bytes(ramdiski_info.fat_sectors, &ramdiski_info.boot_sector[0x24]);
+        /* Disk name */
+        memcpy(&ramdiski_info.boot_sector[0x47], ramdiski_info.name, 11);
+    } else {
+        memcpy(ramdiski_info.boot_sector, fat16i_boot_sector, sizeof(fat16i_boot_sector));
+        if (ramdiski_info.sectors_count < 65535) {
+            /* Small number of sectors */
+            Ramdiski_To2Bytes(ramdiski_info.sectors_count, &ramdiski_info.boot_sector[0x13]);
+        } else {
+            /* Large number of sectors */
+            Ramdiski_To4Bytes(ramdiski_info.sectors_count, &ramdiski_info.boot_sector[0x20]);
+        }
+        /* Sectors per FAT */
+        Ramdiski_To2Bytes(ramdiski_info.fat_sectors, &ramdiski_info.boot_sector[0x16]);
+        /* Disk name */
+        memcpy(&ramdiski_info.boot_sector[0x2b], ramdiski_info.name, 11);
+    }
+
+    ramdiski_info.generation++;
 }
@@ -1,6 +1,6 @@
 /**
  * @file    modules/ramdisk.h
- * @brief   RAMdisk emulation with on the fly file creation, uses FAT16
+ * @brief   RAMdisk emulation with on the fly file creation, uses FAT16 or FAT32
  */
 
 #ifndef __MODULES_RAMDISK_H
@@ -12,6 +12,32 @@
 /* Amount of files that can be stored in ramdisk root directory */
 #define RAMDISK_MAX_FILES 4
 
+/* Amount of generated FAT/root directory sectors kept in RAM (512 B each), 0 to disable */
+#ifndef RAMDISK_CACHE_SECTORS
+#define RAMDISK_CACHE_SECTORS 0
+#endif
+
+/*
+ * Define RAMDISK_USE_STREAM to enable Ramdisk_AddStreamFile, resume points
+ * are then kept in RAM for each file (RAMDISK_MAX_FILES)
+ */
+#ifdef RAMDISK_USE_STREAM
+/* Amount of resume points remembered for each streamed file */
+#ifndef RAMDISK_STREAM_CHECKPOINTS
+#define RAMDISK_STREAM_CHECKPOINTS 8
+#endif
+#endif
+
+/* Amount of files written by the host that can be tracked at once */
+#ifndef RAMDISK_MAX_WRITE_FILES
+#define RAMDISK_MAX_WRITE_FILES 4
+#endif
+
+/* Amount of contiguous cluster runs of host written files that can be tracked */
+#ifndef RAMDISK_MAX_EXTENTS
+#define RAMDISK_MAX_EXTENTS 16
+#endif
+
 /**
  * Type for function to read data from virtual file
  * @param offset    Offset in bytes to read data from
@@ -20,17 +46,53 @@
  */
 typedef void (*ramdisk_read_t)(uint32_t offset, uint8_t *buf, size_t len);
 
+#ifdef RAMDISK_USE_STREAM
+/** Position in the streamed file the content generation can be resumed from */
+typedef struct {
+    uint32_t offset; /**< Offset in bytes from the file start */
+    uint32_t record; /**< Position in the source data (e.g. record index), user defined */
+} ramdisk_cursor_t;
+
+/**
+ * Type for function to generate content of streamed file
+ *
+ * The content is generated from the cursor position, data before offset are
+ * skipped. The cursor must be updated to the position following the last
+ * complete record generated, which must not be after offset + len.
+ *
+ * @param cursor    Position to resume generation from, updated on return
+ * @param offset    Offset in bytes to read data from, never before cursor
+ * @param buf       Buffer to read data to
+ * @param len       Amount of bytes to read
+ */
+typedef void (*ramdisk_stream_t)(ramdisk_cursor_t *cursor, uint32_t offset, uint8_t *buf,
+    size_t len);
+#endif
+
+/** Info about a new file being written to ramdisk by the host */
+typedef struct {
+    char name[9];      /**< File name including termination character */
+    char extension[4]; /**< File extension including termination character */
+    uint32_t size;     /**< File size in bytes, 0 if not known yet */
+    uint32_t cluster;  /**< Start cluster */
+} ramdisk_write_file_t;
+
 /**
  * Type for function to write a data to ramdisk virtual file
  *
- * @param name      File name
- * @param extension File name extension
- * @param file_size File size
+ * The file is identified from the root directory and FAT writes of the host,
+ * the data can be delivered in any order. If the host writes the data before
+ * the file can be identified (FAT and directory entry not written yet), the
+ * file is NULL and the offset is relative to the first cluster after the
+ * virtual files (valid for single contiguous file only).
+ *
+ * @param file      File the data belong to or NULL if not known
  * @param buf       Data to be written (usually 512 bytes)
  * @param size      Size of the buf
  * @param offset    Offset from file start
  */
-typedef void (*ramdisk_write_file_cb_t)(const uint8_t *buf, size_t size, uint32_t offset);
+typedef void (*ramdisk_write_file_cb_t)(const ramdisk_write_file_t *file, const uint8_t *buf,
+    size_t size, uint32_t offset);
 
 /**
  * Read data from ramdisk
@@ -42,6 +104,19 @@ typedef void (*ramdisk_write_file_cb_t)(const uint8_t *buf, size_t size, uint32_
  */
 int Ramdisk_Read(uint32_t lba, uint8_t *buf);
 
+/**
+ * Read data from ramdisk without copying them if possible
+ *
+ * Sectors fully covered by a file content stored in memory (text and memory
+ * files) are returned directly, other sectors are generated to buf.
+ *
+ * @param lba   Logical Block Address, address of the sector (512 Bytes long)
+ * @param buf   Buffer 512 bytes long used if the data must be generated
+ *
+ * @return Pointer to the sector data (512 bytes)
+ */
+const uint8_t *Ramdisk_ReadPtr(uint32_t lba, uint8_t *buf);
+
 /**
  * Write data to ramdisk
  *
@@ -65,6 +140,26 @@ int Ramdisk_Write(uint32_t lba, const uint8_t *buf);
 int Ramdisk_AddFile(const char *filename, const char *extension, time_t time, size_t size,
     ramdisk_read_t read);
 
+#ifdef RAMDISK_USE_STREAM
+/**
+ * Create a new file with content generated on the fly from a source data
+ *
+ * Unlike Ramdisk_AddFile, the read function gets a cursor to resume the
+ * generation from. The ramdisk remembers the cursor of the last read and
+ * some checkpoints along the file, so the data doesn't have to be generated
+ * from the file start for each read.
+ *
+ * @param filename      Up to 8 characters of file name
+ * @param extension     3 characters extension
+ * @param time          Created timestamp
+ * @param size          File size in bytes
+ * @param stream        Function to generate file content
+ * @return  -1 or non negative file handle
+ */
+int Ramdisk_AddStreamFile(const char *filename, const char *extension, time_t time, size_t size,
+    ramdisk_stream_t stream);
+#endif
+
 /**
  * Add a simple text file with static content
  *
@@ -76,6 +171,19 @@ int Ramdisk_AddFile(const char *filename, const char *extension, time_t time, si
  */
 int Ramdisk_AddTextFile(const char *filename, const char *extension, time_t time, const char *text);
 
+/**
+ * Add a file with static content stored in memory (e.g. image in flash)
+ *
+ * @param filename      Up to 8 characters of file name
+ * @param extension     3 characters extension
+ * @param time          Created timestamp
+ * @param data          File content, must be valid while the file exists
+ * @param size          File size in bytes
+ * @return  -1 or non negative file handle
+ */
+int Ramdisk_AddMemFile(const char *filename, const char *extension, time_t time,
+    const uint8_t *data, size_t size);
+
 /**
  * Rename the existing file
  *
@@ -112,9 +220,11 @@ void Ramdisk_RegisterWriteCb(ramdisk_write_file_cb_t cb);
 /**
  * Initialize ramdisk of given size
  *
- * @param size  Ramdisk size in bytes or zero for default (may be increased for minimum fat16 size)
+ * FAT16 is used for volumes up to ~256 MB, FAT32 for larger ones
+ *
+ * @param size  Ramdisk size in bytes or zero for default (may be increased for minimum fat size)
  * @param name  Volume name (up to 11 characters are used)
  */
-void Ramdisk_Init(size_t size, const char *name);
+void Ramdisk_Init(uint64_t size, const char *name);
 
 #endif
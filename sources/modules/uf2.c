@@ -6,6 +6,7 @@
  */
 
 #include <string.h>
+#include "utils/crc.h"
 #include "fw.h"
 #include "uf2.h"
 
@@ -20,6 +21,11 @@
 
 #define UF2_CHUNK_SIZE 256
 
+/* Max amount of blocks in written image, 1 bit of RAM per block */
+#ifndef UF2_MAX_BLOCKS
+#define UF2_MAX_BLOCKS 1024
+#endif
+
 /** Structure of the UF2 block */
 typedef struct {
     uint32_t magicStart0;
@@ -34,6 +40,33 @@ typedef struct {
     uint32_t magicEnd;
 } UF2_block_t;
 
+/** Blocks of the image being written */
+static struct {
+    uint32_t numBlocks;                        /**< Amount of blocks in image */
+    uint32_t fileSize;                         /**< Size of the image */
+    uint32_t received;                         /**< Amount of unique blocks received */
+    uint16_t first_crc;                        /**< Checksum of the first block payload */
+    uint8_t bitmap[(UF2_MAX_BLOCKS + 7) / 8]; /**< Received blocks */
+} uf2i_state;
+
+/**
+ * Check if the block was already received and mark it as received
+ *
+ * @param blockNo   Block number
+ * @return True if received before
+ */
+static bool UF2i_MarkReceived(uint32_t blockNo)
+{
+    uint8_t mask = 1U << (blockNo % 8);
+
+    if (uf2i_state.bitmap[blockNo / 8] & mask) {
+        return true;
+    }
+    uf2i_state.bitmap[blockNo / 8] |= mask;
+    uf2i_state.received++;
+    return false;
+}
+
 bool UF2_Write(const uint8_t *data)
 {
     UF2_block_t *block = (UF2_block_t *)data;
@@ -46,21 +79,44 @@ bool UF2_Write(const uint8_t *data)
     if (block->flags & (UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FILE_CONTAINER)) {
         return true;
     }
+    if (block->numBlocks > UF2_MAX_BLOCKS || block->blockNo >= block->numBlocks ||
+        block->payloadSize > sizeof(block->data)) {
+        return false;
+    }
     if (!Fw_UpdateIsRunning()) {
-        if (block->blockNo == 0) {
-            Fw_UpdateInit();
-        } else {
-            return false;
+        /* Blocks repeated by host after the image was written, new image starts by first block */
+        if (uf2i_state.received == uf2i_state.numBlocks &&
+            block->numBlocks == uf2i_state.numBlocks && block->fileSize == uf2i_state.fileSize &&
+            (block->blockNo != 0 ||
+             CRC16(block->data, block->payloadSize) == uf2i_state.first_crc)) {
+            return true;
         }
+        memset(&uf2i_state, 0, sizeof(uf2i_state));
+        uf2i_state.numBlocks = block->numBlocks;
+        uf2i_state.fileSize = block->fileSize;
+        Fw_UpdateInit();
+    } else if (block->numBlocks != uf2i_state.numBlocks) {
+        /* Block of another image */
+        Fw_UpdateFinish();
+        memset(&uf2i_state, 0, sizeof(uf2i_state));
+        return false;
     }
 
-    /* let's assume we are sending block in correct order */
-    if (!Fw_Update(block->data, block->payloadSize)) {
+    /* Blocks might come in any order or repeated, target address is offset in image */
+    if (UF2i_MarkReceived(block->blockNo)) {
+        return true;
+    }
+    if (block->blockNo == 0) {
+        uf2i_state.first_crc = CRC16(block->data, block->payloadSize);
+    }
+    if (!Fw_UpdateWriteAt(block->targetAddr, block->data, block->payloadSize)) {
         Fw_UpdateFinish();
+        memset(&uf2i_state, 0, sizeof(uf2i_state));
         return false;
     }
-    if (block->blockNo == block->numBlocks - 1) {
-        Fw_UpdateFinish();
+    if (uf2i_state.received == uf2i_state.numBlocks && !Fw_UpdateFinish()) {
+        memset(&uf2i_state, 0, sizeof(uf2i_state));
+        return false;
     }
     return true;
 }
@@ -11,6 +11,11 @@
 /**
  * Process write request of UF2 data block
  *
+ * Blocks can come in any order and repeated, the target address is an offset
+ * in the image (see tools/bin2uf2.py). The update is finished once all blocks
+ * are received. Blocks repeated afterwards are ignored, the first block with
+ * different content starts update of a new image.
+ *
  * @param block     UF2 block (512 bytes) to be written
  * @return Successfulness of the operation
  */
@@ -4,6 +4,12 @@
  *
  * WARNING - this library was written without side channels attacks in mind,
  * it can be attacked easily by timing attacks, etc.
+ *
+ * Functions taking the key derive round keys for each block, which needs
+ * least RAM. Encrypting multiple blocks with the same key is faster with
+ * aes128_ctx_t holding the precomputed key schedule (176 B), define
+ * AES_USE_TTABLE (and optionally AES_TTABLE_SMALL) to speed it up further
+ * using lookup tables in flash.
  */
 
 #ifndef __UTILS_AES_H
@@ -11,6 +17,15 @@
 
 #include <types.h>
 
+/** AES128 encryption context with precomputed key schedule */
+typedef struct {
+#ifdef AES_USE_TTABLE
+    uint32_t round_key[44]; /**< Round key columns, little endian */
+#else
+    uint8_t round_key[11][16]; /**< Round keys */
+#endif
+} aes128_ctx_t;
+
 /**
  * Encrypt 16 bytes of data by AES128
  *
@@ -48,4 +63,29 @@ void AES128_CMACGetKeys(uint8_t *k1, uint8_t *k2, const uint8_t *key);
  */
 void AES128_CMAC(const uint8_t *data, size_t len, const uint8_t *key, uint8_t *tag);
 
+/**
+ * Precompute key schedule for encryption
+ *
+ * @param ctx   Context to initialize
+ * @param key   128bit encryption key
+ */
+void AES128_Init(aes128_ctx_t *ctx, const uint8_t *key);
+
+/**
+ * Encrypt 16 bytes of data by AES128 using precomputed key schedule
+ *
+ * @param data  16 bytes to encrypt, result is stored here
+ * @param ctx   Context initialized by AES128_Init
+ */
+void AES128_EncryptCtx(uint8_t *data, const aes128_ctx_t *ctx);
+
+/**
+ * Generate k1 and k2 keys for AES128 CMAC computation using precomputed key schedule
+ *
+ * @param k1        16 bytes buffer for k1
+ * @param k2        16 bytes buffer for k2
+ * @param ctx       Context initialized by AES128_Init
+ */
+void AES128_CMACGetKeysCtx(uint8_t *k1, uint8_t *k2, const aes128_ctx_t *ctx);
+
 #endif
@@ -1,6 +1,15 @@
 /**
  * @file    crc.c
  * @brief   CRC calculations
+ *
+ * Table driven software implementation by default. CRC16 buffers of at least
+ * CRC16_SLICE_THRESHOLD (16) bytes are processed CRC16_SLICES (4 by default)
+ * bytes at once, define CRC16_SLICES to 8 for more speed or to 1 to save
+ * 1.5 kB of flash (e.g. bootloader). Buffer functions can use the MCU CRC
+ * unit (see hal/crc.h) instead:
+ *  - define CRC_USE_HW for CRC32
+ *  - define also CRC_USE_HW_CRC16 for CRC16, requires CRC unit with programmable
+ *    polynomial (e.g. STM32F07x/F09x, L0, L4, G0, not STM32F03x/F05x)
  */
 
 #ifndef __UTILS_CRC_H
@@ -12,6 +21,8 @@
 #define CRC16_INITIAL_VALUE 0xFFFFU
 /** Initial value for CRC8 calculation */
 #define CRC8_INITIAL_VALUE  0xFFU
+/** Initial value for CRC32 calculation, CRC32 of no data */
+#define CRC32_INITIAL_VALUE 0x00000000U
 
 /**
  * Calculate CRC from initial value and single byte
@@ -23,6 +34,17 @@
  */
 uint16_t CRC16_Add(uint8_t buf, uint16_t crc);
 
+/**
+ * Calculate CRC from initial value and buffer
+ *
+ * @param [in] crc  Initial CRC value (CRC16_INITIAL_VALUE or CRC of preceding data)
+ * @param [in] buf  Data to calculate crc for
+ * @param [in] len  Length of data buffer
+ *
+ * @return CRC 16 (polynomial 0x1021 16)
+ */
+uint16_t CRC16_Update(uint16_t crc, const uint8_t *buf, uint32_t len);
+
 /**
  * Calculate CRC for buffer
  *
@@ -53,4 +75,35 @@ uint16_t CRC8_Add(uint8_t buf, uint8_t crc);
  */
 uint8_t CRC8(const uint8_t *buf, uint32_t len);
 
+/**
+ * Calculate CRC from initial value and single byte
+ *
+ * @param [in] buf  Byte to calculate crc for
+ * @param [in] crc  Initial CRC value (CRC32_INITIAL_VALUE or CRC of preceding data)
+ *
+ * @return CRC 32 (polynomial 0x04c11db7 reflected, as used by zlib, Ethernet,...)
+ */
+uint32_t CRC32_Add(uint8_t buf, uint32_t crc);
+
+/**
+ * Calculate CRC from initial value and buffer
+ *
+ * @param [in] crc  Initial CRC value (CRC32_INITIAL_VALUE or CRC of preceding data)
+ * @param [in] buf  Data to calculate crc for
+ * @param [in] len  Length of data buffer
+ *
+ * @return CRC 32 (polynomial 0x04c11db7 reflected)
+ */
+uint32_t CRC32_Update(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+/**
+ * Calculate CRC for buffer
+ *
+ * @param [in] buf  Data to calculate crc for
+ * @param [in] len  Length of data buffer
+ *
+ * @return CRC 32 (polynomial 0x04c11db7 reflected)
+ */
+uint32_t CRC32(const uint8_t *buf, uint32_t len);
+
 #endif
@@ -0,0 +1,161 @@
+/**
+ * @file    utils/delta.c
+ * @brief   Streaming binary patch (delta) decoder
+ */
+
+#include "delta.h"
+
+/** Field of the patch being decoded */
+typedef enum {
+    DELTAI_BASE_CRC,
+    DELTAI_BASE_LEN,
+    DELTAI_DIFF_LEN,
+    DELTAI_DIFF,
+    DELTAI_EXTRA_LEN,
+    DELTAI_EXTRA,
+    DELTAI_SEEK,
+} deltai_state_t;
+
+/**
+ * Add byte to the little endian number being parsed
+ *
+ * @param delta     Decoder state
+ * @param data      Patch byte
+ * @param bytes     Length of the number
+ * @return True if the number is complete
+ */
+static bool Deltai_Fixed(delta_t *delta, uint8_t data, uint8_t bytes)
+{
+    delta->value |= (uint32_t)data << delta->shift;
+    delta->shift += 8;
+    if (delta->shift < bytes * 8) {
+        return false;
+    }
+    delta->shift = 0;
+    return true;
+}
+
+/**
+ * Add byte to the varint being parsed
+ *
+ * @param delta     Decoder state
+ * @param data      Patch byte
+ * @return True if the varint is complete
+ */
+static bool Deltai_Varint(delta_t *delta, uint8_t data)
+{
+    if (delta->shift > 28) {
+        delta->error = true;
+        return false;
+    }
+    delta->value |= (uint32_t)(data & 0x7f) << delta->shift;
+    if (data & 0x80) {
+        delta->shift += 7;
+        return false;
+    }
+    delta->shift = 0;
+    return true;
+}
+
+/**
+ * Process length of diff or extra part
+ *
+ * @param delta     Decoder state
+ * @param data      State for the data part
+ * @param next      State if no data follow
+ */
+static void Deltai_Length(delta_t *delta, deltai_state_t data, deltai_state_t next)
+{
+    delta->remaining = delta->value;
+    delta->state = delta->remaining != 0 ? data : next;
+    if (data == DELTAI_DIFF && delta->remaining > delta->old_len - delta->pos) {
+        delta->error = true;
+    }
+}
+
+uint32_t Delta_Decode(delta_t *delta, const uint8_t **in, uint32_t *len, uint8_t *out,
+                      uint32_t size)
+{
+    uint32_t produced = 0;
+    uint32_t seek;
+    uint8_t data;
+
+    while (produced < size && *len != 0 && !delta->error) {
+        data = **in;
+        (*in)++;
+        (*len)--;
+
+        switch (delta->state) {
+            case DELTAI_BASE_CRC:
+                if (Deltai_Fixed(delta, data, 2)) {
+                    delta->error = delta->value != delta->old_crc;
+                    delta->value = 0;
+                    delta->state = DELTAI_BASE_LEN;
+                }
+                break;
+            case DELTAI_BASE_LEN:
+                if (Deltai_Fixed(delta, data, 4)) {
+                    delta->error = delta->value != delta->old_len;
+                    delta->value = 0;
+                    delta->state = DELTAI_DIFF_LEN;
+                }
+                break;
+            case DELTAI_DIFF_LEN:
+                if (Deltai_Varint(delta, data)) {
+                    Deltai_Length(delta, DELTAI_DIFF, DELTAI_EXTRA_LEN);
+                    delta->value = 0;
+                }
+                break;
+            case DELTAI_DIFF:
+                out[produced++] = delta->old[delta->pos++] + data;
+                if (--delta->remaining == 0) {
+                    delta->state = DELTAI_EXTRA_LEN;
+                }
+                break;
+            case DELTAI_EXTRA_LEN:
+                if (Deltai_Varint(delta, data)) {
+                    Deltai_Length(delta, DELTAI_EXTRA, DELTAI_SEEK);
+                    delta->value = 0;
+                }
+                break;
+            case DELTAI_EXTRA:
+                out[produced++] = data;
+                if (--delta->remaining == 0) {
+                    delta->state = DELTAI_SEEK;
+                }
+                break;
+            case DELTAI_SEEK:
+                if (Deltai_Varint(delta, data)) {
+                    /* Zigzag encoding, 0, -1, 1, -2,... */
+                    seek = (delta->value >> 1) ^ -(delta->value & 0x1);
+                    delta->pos += seek;
+                    delta->error = delta->pos > delta->old_len;
+                    delta->value = 0;
+                    delta->state = DELTAI_DIFF_LEN;
+                }
+                break;
+            default:
+                delta->error = true;
+                break;
+        }
+    }
+    return produced;
+}
+
+bool Delta_IsComplete(const delta_t *delta)
+{
+    return !delta->error && delta->state == DELTAI_DIFF_LEN && delta->shift == 0;
+}
+
+void Delta_Init(delta_t *delta, const uint8_t *old, uint32_t old_len, uint16_t old_crc)
+{
+    delta->old = old;
+    delta->old_len = old_len;
+    delta->old_crc = old_crc;
+    delta->pos = 0;
+    delta->remaining = 0;
+    delta->value = 0;
+    delta->shift = 0;
+    delta->state = DELTAI_BASE_CRC;
+    delta->error = false;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file    utils/delta.h
+ * @brief   Streaming binary patch (delta) decoder
+ *
+ * Patch reconstructs new data from old ones, bsdiff style. It starts with
+ * the base image identification (crc16 and length, little endian) followed
+ * by records:
+ *  - diff length followed by diff bytes added to the old data at current
+ *    position
+ *  - extra length followed by extra bytes copied to output
+ *  - seek, position in old data is moved by this signed number
+ *
+ * Numbers are varints (7 bits per byte, LSB first, MSB set if more bytes
+ * follow), seek is zigzag encoded.
+ *
+ * Each patch byte produces at most one output byte, no buffers needed.
+ * Patches are generated by tools/delta.py.
+ */
+
+#ifndef __UTILS_DELTA_H
+#define __UTILS_DELTA_H
+
+#include <types.h>
+
+/** Decoder state, data can be fed in chunks of any size */
+typedef struct {
+    const uint8_t *old; /**< Old data */
+    uint32_t old_len;   /**< Length of old data */
+    uint16_t old_crc;   /**< CRC16 of old data */
+    uint32_t pos;       /**< Position in old data */
+    uint32_t remaining; /**< Remaining diff or extra bytes of the record */
+    uint32_t value;     /**< Varint being parsed */
+    uint8_t shift;      /**< Bit position in the varint being parsed */
+    uint8_t state;      /**< Decoded field */
+    bool error;         /**< Invalid patch or base */
+} delta_t;
+
+/**
+ * Apply patch
+ *
+ * Input is consumed until the output buffer is full, the rest shall be
+ * passed in next call. Decoding stops if the patch is invalid.
+ *
+ * @param delta         Decoder state
+ * @param [in,out] in   Patch data, moved past the consumed bytes
+ * @param [in,out] len  Length of patch data, decreased by consumed bytes
+ * @param [out] out     Buffer for new data
+ * @param size          Size of the output buffer
+ * @return Amount of bytes written to out
+ */
+uint32_t Delta_Decode(delta_t *delta, const uint8_t **in, uint32_t *len, uint8_t *out,
+                      uint32_t size);
+
+/**
+ * Check if the patch is valid and ended at record boundary
+ *
+ * @param delta     Decoder state
+ * @return True if the whole patch was applied
+ */
+bool Delta_IsComplete(const delta_t *delta);
+
+/**
+ * Initialize decoder
+ *
+ * @param delta     Decoder state
+ * @param old       Old data to apply the patch to
+ * @param old_len   Length of old data
+ * @param old_crc   CRC16 of old data, patch is refused if generated for other data
+ */
+void Delta_Init(delta_t *delta, const uint8_t *old, uint32_t old_len, uint16_t old_crc);
+
+#endif
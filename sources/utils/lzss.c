@@ -0,0 +1,78 @@
+/**
+ * @file    utils/lzss.c
+ * @brief   Streaming LZSS decompression
+ */
+
+#include <string.h>
+#include "lzss.h"
+
+/**
+ * Store decompressed byte to output and history
+ *
+ * @param lz        Decoder state
+ * @param out       Output buffer position
+ * @param data      Decompressed byte
+ */
+static void Lzssi_Put(lzss_t *lz, uint8_t *out, uint8_t data)
+{
+    *out = data;
+    lz->window[lz->pos] = data;
+    lz->pos = (lz->pos + 1) & lz->mask;
+}
+
+uint32_t Lzss_Decode(lzss_t *lz, const uint8_t **in, uint32_t *len, uint8_t *out, uint32_t size)
+{
+    uint32_t produced = 0;
+    uint16_t ref;
+    uint8_t data;
+
+    while (produced < size) {
+        if (lz->remaining != 0) {
+            data = lz->window[(lz->pos - lz->distance) & lz->mask];
+            Lzssi_Put(lz, &out[produced++], data);
+            lz->remaining--;
+            continue;
+        }
+        if (*len == 0) {
+            break;
+        }
+        data = **in;
+        (*in)++;
+        (*len)--;
+
+        if (lz->flags == 1) {
+            lz->flags = 0x100 | data;
+        } else if (lz->flags & 0x1) {
+            Lzssi_Put(lz, &out[produced++], data);
+            lz->flags >>= 1;
+        } else if (!lz->has_first) {
+            lz->first = data;
+            lz->has_first = true;
+        } else {
+            ref = (lz->first << 8) | data;
+            lz->distance = (ref >> (16 - lz->window_bits)) + 1;
+            lz->remaining = (ref & (0xffff >> lz->window_bits)) + LZSS_MIN_MATCH;
+            lz->has_first = false;
+            lz->flags >>= 1;
+        }
+    }
+    return produced;
+}
+
+bool Lzss_IsComplete(const lzss_t *lz)
+{
+    return lz->remaining == 0 && !lz->has_first;
+}
+
+bool Lzss_Init(lzss_t *lz, uint8_t *window, uint8_t window_bits)
+{
+    if (window_bits < LZSS_MIN_BITS || window_bits > LZSS_MAX_BITS) {
+        return false;
+    }
+    memset(lz, 0, sizeof(*lz));
+    lz->window = window;
+    lz->window_bits = window_bits;
+    lz->mask = (1U << window_bits) - 1;
+    lz->flags = 1;
+    return true;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file    utils/lzss.h
+ * @brief   Streaming LZSS decompression
+ *
+ * Compressed stream is a sequence of groups, each starting with a flags
+ * byte followed by up to 8 items. Flags are read from LSB, 1 is a literal
+ * byte, 0 is a back reference stored in two bytes (big endian) - upper
+ * window_bits hold distance - 1, remaining bits hold length - LZSS_MIN_MATCH.
+ *
+ * Back references never reach before the start of the stream. Compressed
+ * by tools/lzss.py.
+ */
+
+#ifndef __UTILS_LZSS_H
+#define __UTILS_LZSS_H
+
+#include <types.h>
+
+/** Shortest encoded back reference */
+#define LZSS_MIN_MATCH 3
+/** Supported range of window sizes (log2) */
+#define LZSS_MIN_BITS  8
+#define LZSS_MAX_BITS  12
+
+/** Decoder state, data can be fed in chunks of any size */
+typedef struct {
+    uint8_t *window;     /**< History buffer, 2^window_bits long */
+    uint16_t mask;       /**< Window size - 1 */
+    uint16_t pos;        /**< Position of the next byte in window */
+    uint8_t window_bits; /**< log2 of the window size */
+    uint16_t flags;      /**< Remaining item flags with sentinel bit, 1 if empty */
+    bool has_first;      /**< First byte of back reference was received */
+    uint8_t first;       /**< First byte of back reference */
+    uint16_t distance;   /**< Distance of the back reference being copied */
+    uint16_t remaining;  /**< Amount of bytes remaining to copy from reference */
+} lzss_t;
+
+/**
+ * Decompress data
+ *
+ * Input is consumed until the output buffer is full, the rest shall be
+ * passed in next call.
+ *
+ * @param lz            Decoder state
+ * @param [in,out] in   Compressed data, moved past the consumed bytes
+ * @param [in,out] len  Length of compressed data, decreased by consumed bytes
+ * @param [out] out     Buffer for decompressed data
+ * @param size          Size of the output buffer
+ * @return Amount of bytes written to out
+ */
+uint32_t Lzss_Decode(lzss_t *lz, const uint8_t **in, uint32_t *len, uint8_t *out, uint32_t size);
+
+/**
+ * Check if the stream ended at item boundary (not in middle of reference)
+ *
+ * @param lz        Decoder state
+ * @return True if no decoded data are pending
+ */
+bool Lzss_IsComplete(const lzss_t *lz);
+
+/**
+ * Initialize decoder
+ *
+ * @param lz            Decoder state
+ * @param window        History buffer, at least 2^window_bits long
+ * @param window_bits   log2 of the window size used by compressor
+ * @return False if window size is not supported
+ */
+bool Lzss_Init(lzss_t *lz, uint8_t *window, uint8_t window_bits);
+
+#endif
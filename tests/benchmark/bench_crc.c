@@ -0,0 +1,71 @@
+/**
+ * @file    benchmark/bench_crc.c
+ * @brief   Host benchmark of CRC16 buffer processing against byte wise loop
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "utils/crc.c"
+
+#define BENCH_SIZE   4096
+#define BENCH_ROUNDS 20000
+
+/**
+ * Byte wise CRC16, implementation without slicing tables
+ */
+static uint16_t Bench_ByteWise(uint16_t crc, const uint8_t *buf, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        crc = CRC16_Add(buf[i], crc);
+    }
+    return crc;
+}
+
+/**
+ * Measure throughput of CRC function over buffer
+ *
+ * @param name  Printed name
+ * @param func  CRC function
+ * @param buf   Data
+ * @param len   Length of data
+ * @return Last computed CRC
+ */
+static uint16_t Bench_Run(const char *name, uint16_t (*func)(uint16_t, const uint8_t *, uint32_t),
+                          const uint8_t *buf, uint32_t len)
+{
+    struct timespec start, end;
+    volatile uint16_t crc = 0;
+    double elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        crc = func(CRC16_INITIAL_VALUE, buf, len);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%-10s %4u B: %8.1f MB/s\n", name, len, (double)len * BENCH_ROUNDS / elapsed / 1e6);
+    return crc;
+}
+
+int main(void)
+{
+    static uint8_t buf[BENCH_SIZE];
+    const uint32_t lens[] = { 16, 64, 256, BENCH_SIZE };
+    int ret = 0;
+
+    for (uint32_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = i * 7919 >> 3;
+    }
+
+    printf("CRC16_SLICES %d\n", CRC16_SLICES);
+    for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        uint16_t ref = Bench_Run("byte wise", Bench_ByteWise, buf, lens[i]);
+        uint16_t crc = Bench_Run("CRC16", CRC16_Update, buf, lens[i]);
+
+        if (crc != ref) {
+            printf("CRC mismatch %04x != %04x\n", crc, ref);
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,16 @@
+/**
+ * @file    config_struct.h
+ * @brief   Configuration stored by modules/config.c in tests
+ */
+
+#ifndef __CONFIG_STRUCT_H
+#define __CONFIG_STRUCT_H
+
+#include <types.h>
+
+typedef struct {
+    uint32_t id;
+    char name[10];
+} config_t;
+
+#endif
@@ -0,0 +1,291 @@
+/**
+ * @file    delta_fixture.h
+ * @brief   Firmware update images with delta patches for tests
+ *
+ * The binaries are builds of sources/utils, version 1.1.0 adds utils/delta.c
+ * in the middle of the code, so the following functions are moved. Images were
+ * generated by tools/fw.py (patch by tools/delta.py compressed by tools/lzss.py):
+ *
+ *   fw.py 0x46574931 new.bin upgrade.img --image --lzss 10 --delta old.bin
+ *   fw.py 0x46574931 old.bin downgrade.img --image --lzss 10 --delta new.bin
+ */
+
+#ifndef __DELTA_FIXTURE_H
+#define __DELTA_FIXTURE_H
+
+#include <types.h>
+
+/** Binary of version 1.0.0 */
+static const uint8_t delta_fixture_old[828] = {
+    0x8a, 0x4f, 0x09, 0x8a, 0x47, 0x0a, 0xb2, 0xff, 0x38, 0xc1, 0x74, 0x1e,
+    0x0f, 0xb6, 0x47, 0x09, 0x48, 0x8b, 0x17, 0x8a, 0x14, 0x02, 0x8a, 0x47,
+    0x09, 0xff, 0xc0, 0x88, 0x47, 0x09, 0x8a, 0x47, 0x09, 0x3a, 0x47, 0x08,
+    0x72, 0x04, 0xc6, 0x47, 0x09, 0x00, 0x89, 0xd0, 0xc3, 0x8a, 0x47, 0x0a,
+    0xff, 0xc0, 0x3a, 0x47, 0x08, 0x72, 0x02, 0x31, 0xc0, 0x8a, 0x57, 0x09,
+    0x38, 0xc2, 0x0f, 0x94, 0xc0, 0xc3, 0xe8, 0xe6, 0xff, 0xff, 0xff, 0x89,
+    0xc2, 0x31, 0xc0, 0x84, 0xd2, 0x75, 0x24, 0x0f, 0xb6, 0x47, 0x0a, 0x48,
+    0x8b, 0x17, 0x40, 0x88, 0x34, 0x02, 0x8a, 0x47, 0x0a, 0xff, 0xc0, 0x88,
+    0x47, 0x0a, 0x8a, 0x47, 0x0a, 0x3a, 0x47, 0x08, 0x73, 0x03, 0xb0, 0x01,
+    0xc3, 0xc6, 0x47, 0x0a, 0x00, 0xeb, 0xf7, 0xc3, 0x8a, 0x57, 0x09, 0x8a,
+    0x47, 0x0a, 0x38, 0xc2, 0x0f, 0x94, 0xc0, 0xc3, 0x8a, 0x57, 0x09, 0x8a,
+    0x47, 0x0a, 0x38, 0xc2, 0x74, 0x07, 0xe8, 0x71, 0xff, 0xff, 0xff, 0xeb,
+    0xef, 0xc3, 0xc6, 0x47, 0x0a, 0x00, 0x48, 0x89, 0x37, 0x88, 0x57, 0x08,
+    0xc6, 0x47, 0x09, 0x00, 0xc3, 0x41, 0x55, 0x48, 0x89, 0xf8, 0x49, 0x89,
+    0xd1, 0x48, 0x89, 0xf7, 0x41, 0x54, 0x49, 0x89, 0xca, 0x31, 0xf6, 0x41,
+    0xbb, 0x10, 0x00, 0x00, 0x00, 0x55, 0x53, 0xbb, 0xff, 0xff, 0x00, 0x00,
+    0x44, 0x39, 0xc6, 0x0f, 0x83, 0xf8, 0x00, 0x00, 0x00, 0x66, 0x83, 0x78,
+    0x14, 0x00, 0x74, 0x39, 0x0f, 0xb7, 0x50, 0x0a, 0x48, 0x8b, 0x08, 0x66,
+    0x2b, 0x50, 0x12, 0x23, 0x50, 0x08, 0x0f, 0xb7, 0xd2, 0x8a, 0x14, 0x11,
+    0x89, 0xf1, 0x41, 0x88, 0x14, 0x0a, 0x0f, 0xb7, 0x48, 0x0a, 0x48, 0x8b,
+    0x28, 0x88, 0x54, 0x0d, 0x00, 0x66, 0x8b, 0x48, 0x0a, 0x66, 0xff, 0x48,
+    0x14, 0x8d, 0x51, 0x01, 0x23, 0x50, 0x08, 0x66, 0x89, 0x50, 0x0a, 0xeb,
+    0x59, 0x41, 0x8b, 0x09, 0x85, 0xc9, 0x0f, 0x84, 0xad, 0x00, 0x00, 0x00,
+    0x48, 0x8b, 0x2f, 0xff, 0xc9, 0x0f, 0xb6, 0x55, 0x00, 0x48, 0xff, 0xc5,
+    0x48, 0x89, 0x2f, 0x66, 0x8b, 0x68, 0x0e, 0x41, 0x89, 0x09, 0x66, 0x83,
+    0xfd, 0x01, 0x75, 0x09, 0x80, 0xce, 0x01, 0x66, 0x89, 0x50, 0x0e, 0xeb,
+    0x87, 0x40, 0xf6, 0xc5, 0x01, 0x74, 0x2a, 0x89, 0xf1, 0x41, 0x88, 0x14,
+    0x0a, 0x0f, 0xb7, 0x48, 0x0a, 0x48, 0x8b, 0x28, 0x88, 0x54, 0x0d, 0x00,
+    0x66, 0x8b, 0x48, 0x0a, 0x66, 0xd1, 0x68, 0x0e, 0x8d, 0x51, 0x01, 0x23,
+    0x50, 0x08, 0x66, 0x89, 0x50, 0x0a, 0xff, 0xc6, 0xe9, 0x57, 0xff, 0xff,
+    0xff, 0x80, 0x78, 0x10, 0x00, 0x75, 0x0c, 0x88, 0x50, 0x11, 0xc6, 0x40,
+    0x10, 0x01, 0xe9, 0x45, 0xff, 0xff, 0xff, 0x0f, 0xb6, 0x48, 0x11, 0x44,
+    0x0f, 0xb6, 0x68, 0x0c, 0x66, 0xd1, 0xed, 0xc6, 0x40, 0x10, 0x00, 0x66,
+    0x89, 0x68, 0x0e, 0xc1, 0xe1, 0x08, 0x09, 0xca, 0x44, 0x89, 0xd9, 0x44,
+    0x0f, 0xb7, 0xe2, 0x44, 0x29, 0xe9, 0x41, 0xd3, 0xfc, 0x44, 0x89, 0xe9,
+    0x41, 0xff, 0xc4, 0x66, 0x44, 0x89, 0x60, 0x12, 0x41, 0x89, 0xdc, 0x41,
+    0xd3, 0xfc, 0x44, 0x21, 0xe2, 0x83, 0xc2, 0x03, 0x66, 0x89, 0x50, 0x14,
+    0xe9, 0xff, 0xfe, 0xff, 0xff, 0x5b, 0x89, 0xf0, 0x5d, 0x41, 0x5c, 0x41,
+    0x5d, 0xc3, 0x31, 0xc0, 0x66, 0x83, 0x7f, 0x14, 0x00, 0x75, 0x09, 0x8a,
+    0x47, 0x10, 0x83, 0xf0, 0x01, 0x0f, 0xb6, 0xc0, 0x83, 0xe0, 0x01, 0xc3,
+    0x41, 0x54, 0x31, 0xc0, 0x55, 0x89, 0xd5, 0x83, 0xea, 0x08, 0x53, 0x80,
+    0xfa, 0x04, 0x77, 0x30, 0x49, 0x89, 0xf4, 0xba, 0x18, 0x00, 0x00, 0x00,
+    0x31, 0xf6, 0x48, 0x89, 0xfb, 0xe8, 0x7e, 0xe9, 0xff, 0xf7, 0xb8, 0x01,
+    0x00, 0x00, 0x00, 0x89, 0xe9, 0x4c, 0x89, 0x23, 0xd3, 0xe0, 0x40, 0x88,
+    0x6b, 0x0c, 0x66, 0xc7, 0x43, 0x0e, 0x01, 0x00, 0xff, 0xc8, 0x66, 0x89,
+    0x43, 0x08, 0xb0, 0x01, 0x5b, 0x5d, 0x41, 0x5c, 0xc3, 0x55, 0x53, 0x89,
+    0xfb, 0x51, 0x48, 0x0f, 0xbe, 0xeb, 0xe8, 0x4d, 0xe9, 0xff, 0xf7, 0x48,
+    0x8b, 0x00, 0x66, 0x8b, 0x14, 0x68, 0x31, 0xc0, 0xf6, 0xc6, 0x10, 0x74,
+    0x16, 0x80, 0xe6, 0x08, 0x8d, 0x43, 0xd0, 0x75, 0x0e, 0xe8, 0x32, 0xe9,
+    0xff, 0xf7, 0x48, 0x8b, 0x00, 0x8b, 0x04, 0xa8, 0x83, 0xe8, 0x57, 0x5a,
+    0x5b, 0x5d, 0xc3, 0xb0, 0x30, 0x40, 0x80, 0xff, 0x0f, 0x77, 0x0c, 0x8d,
+    0x47, 0x30, 0x40, 0x80, 0xff, 0x09, 0x76, 0x03, 0x8d, 0x47, 0x37, 0xc3,
+    0x89, 0xf9, 0x44, 0x8d, 0x46, 0xff, 0x40, 0x80, 0xfe, 0x08, 0x76, 0x04,
+    0xc6, 0x02, 0x00, 0xc3, 0x41, 0x80, 0xf8, 0xff, 0x74, 0x1c, 0x89, 0xcf,
+    0x4d, 0x0f, 0xbe, 0xc8, 0xc1, 0xe9, 0x04, 0x41, 0xff, 0xc8, 0x83, 0xe7,
+    0x0f, 0x49, 0x01, 0xd1, 0xe8, 0xbe, 0xff, 0xff, 0xff, 0x41, 0x88, 0x01,
+    0xeb, 0xde, 0x40, 0x0f, 0xb6, 0xf6, 0xc6, 0x04, 0x32, 0x00, 0xc3, 0xb9,
+    0x0a, 0x00, 0x00, 0x00, 0x49, 0x89, 0xd0, 0x89, 0xf8, 0x31, 0xd2, 0xf7,
+    0xf1, 0xb9, 0x01, 0x00, 0x00, 0x00, 0x39, 0xc1, 0x73, 0x05, 0x6b, 0xc9,
+    0x0a, 0xeb, 0xf7, 0x41, 0xb9, 0x0a, 0x00, 0x00, 0x00, 0x85, 0xc9, 0x74,
+    0x28, 0x49, 0x83, 0xf8, 0x01, 0x76, 0x22, 0x89, 0xf8, 0x31, 0xd2, 0x48,
+    0xff, 0xc6, 0x49, 0xff, 0xc8, 0xf7, 0xf1, 0x89, 0xc7, 0x89, 0xc8, 0x83,
+    0xc7, 0x30, 0x40, 0x88, 0x7e, 0xff, 0x89, 0xd7, 0x31, 0xd2, 0x41, 0xf7,
+    0xf1, 0x89, 0xc1, 0xeb, 0xd4, 0x4d, 0x85, 0xc0, 0x74, 0x03, 0xc6, 0x06,
+    0x00, 0xc3, 0x8b, 0x05, 0x34, 0x00, 0x00, 0x00, 0xff, 0xc0, 0x89, 0x05,
+    0x2c, 0x00, 0x00, 0x00, 0xc3, 0x8b, 0x05, 0x25, 0x00, 0x00, 0x00, 0xc3,
+    0x8b, 0x15, 0x1e, 0x00, 0x00, 0x00, 0x8b, 0x05, 0x18, 0x00, 0x00, 0x00,
+    0x29, 0xd0, 0x39, 0xf8, 0x72, 0xf4, 0xc3, 0x50, 0xe8, 0x4f, 0xe8, 0xff,
+    0xf7, 0xbf, 0x82, 0x17, 0x00, 0x08, 0x5a, 0xe9, 0x44, 0xe8, 0xff, 0xf7,
+};
+
+/** Binary of version 1.1.0 */
+static const uint8_t delta_fixture_new[1368] = {
+    0x8a, 0x4f, 0x09, 0x8a, 0x47, 0x0a, 0xb2, 0xff, 0x38, 0xc1, 0x74, 0x1e,
+    0x0f, 0xb6, 0x47, 0x09, 0x48, 0x8b, 0x17, 0x8a, 0x14, 0x02, 0x8a, 0x47,
+    0x09, 0xff, 0xc0, 0x88, 0x47, 0x09, 0x8a, 0x47, 0x09, 0x3a, 0x47, 0x08,
+    0x72, 0x04, 0xc6, 0x47, 0x09, 0x00, 0x89, 0xd0, 0xc3, 0x8a, 0x47, 0x0a,
+    0xff, 0xc0, 0x3a, 0x47, 0x08, 0x72, 0x02, 0x31, 0xc0, 0x8a, 0x57, 0x09,
+    0x38, 0xc2, 0x0f, 0x94, 0xc0, 0xc3, 0xe8, 0xe6, 0xff, 0xff, 0xff, 0x89,
+    0xc2, 0x31, 0xc0, 0x84, 0xd2, 0x75, 0x24, 0x0f, 0xb6, 0x47, 0x0a, 0x48,
+    0x8b, 0x17, 0x40, 0x88, 0x34, 0x02, 0x8a, 0x47, 0x0a, 0xff, 0xc0, 0x88,
+    0x47, 0x0a, 0x8a, 0x47, 0x0a, 0x3a, 0x47, 0x08, 0x73, 0x03, 0xb0, 0x01,
+    0xc3, 0xc6, 0x47, 0x0a, 0x00, 0xeb, 0xf7, 0xc3, 0x8a, 0x57, 0x09, 0x8a,
+    0x47, 0x0a, 0x38, 0xc2, 0x0f, 0x94, 0xc0, 0xc3, 0x8a, 0x57, 0x09, 0x8a,
+    0x47, 0x0a, 0x38, 0xc2, 0x74, 0x07, 0xe8, 0x71, 0xff, 0xff, 0xff, 0xeb,
+    0xef, 0xc3, 0xc6, 0x47, 0x0a, 0x00, 0x48, 0x89, 0x37, 0x88, 0x57, 0x08,
+    0xc6, 0x47, 0x09, 0x00, 0xc3, 0x8a, 0x4f, 0x1c, 0x80, 0xf9, 0x1c, 0x76,
+    0x06, 0xc6, 0x47, 0x1e, 0x01, 0xeb, 0x15, 0x89, 0xf0, 0x83, 0xe0, 0x7f,
+    0xd3, 0xe0, 0x09, 0x47, 0x18, 0x40, 0x84, 0xf6, 0x79, 0x09, 0x83, 0xc1,
+    0x07, 0x88, 0x4f, 0x1c, 0x31, 0xc0, 0xc3, 0xc6, 0x47, 0x1c, 0x00, 0xb0,
+    0x01, 0xc3, 0x49, 0x89, 0xd2, 0x31, 0xd2, 0x49, 0x89, 0xf1, 0x49, 0x89,
+    0xcb, 0x44, 0x39, 0xc2, 0x73, 0x0d, 0x41, 0x8b, 0x02, 0x85, 0xc0, 0x74,
+    0x06, 0x80, 0x7f, 0x1e, 0x00, 0x74, 0x03, 0x89, 0xd0, 0xc3, 0x53, 0x49,
+    0x8b, 0x09, 0xff, 0xc8, 0x0f, 0xb6, 0x31, 0x48, 0xff, 0xc1, 0x49, 0x89,
+    0x09, 0x41, 0x89, 0x02, 0x80, 0x7f, 0x1d, 0x06, 0x0f, 0x87, 0x1c, 0x01,
+    0x00, 0x00, 0x0f, 0xb6, 0x47, 0x1d, 0xff, 0x24, 0xc5, 0xa0, 0x19, 0x00,
+    0x08, 0x8a, 0x4f, 0x1c, 0xd3, 0xe6, 0x83, 0xc1, 0x08, 0x0b, 0x77, 0x18,
+    0x89, 0x77, 0x18, 0x80, 0xf9, 0x0f, 0x76, 0x2d, 0x0f, 0xb7, 0x47, 0x0c,
+    0x66, 0xc7, 0x47, 0x1c, 0x00, 0x01, 0x39, 0xf0, 0x0f, 0x95, 0x47, 0x1e,
+    0x31, 0xdb, 0x89, 0x5f, 0x18, 0xe9, 0xec, 0x00, 0x00, 0x00, 0x8a, 0x4f,
+    0x1c, 0xd3, 0xe6, 0x83, 0xc1, 0x08, 0x0b, 0x77, 0x18, 0x89, 0x77, 0x18,
+    0x80, 0xf9, 0x1f, 0x77, 0x08, 0x88, 0x4f, 0x1c, 0xe9, 0xd1, 0x00, 0x00,
+    0x00, 0x39, 0x77, 0x08, 0x66, 0xc7, 0x47, 0x1c, 0x00, 0x02, 0x0f, 0x95,
+    0x47, 0x1e, 0x31, 0xf6, 0x89, 0x77, 0x18, 0xe9, 0xba, 0x00, 0x00, 0x00,
+    0xe8, 0x28, 0xff, 0xff, 0xff, 0x84, 0xc0, 0x0f, 0x84, 0xad, 0x00, 0x00,
+    0x00, 0x8b, 0x47, 0x18, 0x89, 0x47, 0x14, 0x85, 0xc0, 0x75, 0x06, 0xc6,
+    0x47, 0x1d, 0x04, 0xeb, 0x4e, 0x8b, 0x4f, 0x08, 0x2b, 0x4f, 0x10, 0xc6,
+    0x47, 0x1d, 0x03, 0x39, 0xc1, 0x73, 0x40, 0xc6, 0x47, 0x1e, 0x01, 0xeb,
+    0x3a, 0x8b, 0x47, 0x10, 0x48, 0x8b, 0x1f, 0x8d, 0x48, 0x01, 0x89, 0x4f,
+    0x10, 0x89, 0xd1, 0x40, 0x02, 0x34, 0x03, 0x41, 0x88, 0x34, 0x0b, 0xff,
+    0x4f, 0x14, 0x75, 0x6c, 0xc6, 0x47, 0x1d, 0x04, 0xeb, 0x66, 0xe8, 0xd6,
+    0xfe, 0xff, 0xff, 0x84, 0xc0, 0x74, 0x5f, 0x8b, 0x47, 0x18, 0x83, 0xf8,
+    0x01, 0x89, 0x47, 0x14, 0xb0, 0x05, 0x14, 0x00, 0x88, 0x47, 0x1d, 0x31,
+    0xc9, 0x89, 0x4f, 0x18, 0xeb, 0x48, 0x89, 0xd0, 0x41, 0x88, 0x34, 0x03,
+    0xff, 0x4f, 0x14, 0x75, 0x3b, 0xc6, 0x47, 0x1d, 0x06, 0xeb, 0x35, 0xe8,
+    0xa5, 0xfe, 0xff, 0xff, 0x84, 0xc0, 0x74, 0x2e, 0x8b, 0x4f, 0x18, 0xc6,
+    0x47, 0x1d, 0x02, 0x89, 0xc8, 0xd1, 0xe9, 0x83, 0xe0, 0x01, 0xf7, 0xd8,
+    0x31, 0xc8, 0x03, 0x47, 0x10, 0x39, 0x47, 0x08, 0x89, 0x47, 0x10, 0x0f,
+    0x92, 0x47, 0x1e, 0x31, 0xc0, 0x89, 0x47, 0x18, 0xeb, 0x08, 0xc6, 0x47,
+    0x1e, 0x01, 0xeb, 0x02, 0xff, 0xc2, 0x44, 0x39, 0xc2, 0x73, 0x11, 0x41,
+    0x8b, 0x02, 0x85, 0xc0, 0x74, 0x0a, 0x80, 0x7f, 0x1e, 0x00, 0x0f, 0x84,
+    0xab, 0xfe, 0xff, 0xff, 0x89, 0xd0, 0x5b, 0xc3, 0x31, 0xc0, 0x80, 0x7f,
+    0x1e, 0x00, 0x75, 0x0b, 0x31, 0xc0, 0x66, 0x81, 0x7f, 0x1c, 0x00, 0x02,
+    0x0f, 0x94, 0xc0, 0x83, 0xe0, 0x01, 0xc3, 0x89, 0x57, 0x08, 0x31, 0xc0,
+    0x31, 0xd2, 0x48, 0x89, 0x37, 0x66, 0x89, 0x4f, 0x0c, 0x48, 0x89, 0x47,
+    0x10, 0x89, 0x57, 0x18, 0x66, 0xc7, 0x47, 0x1c, 0x00, 0x00, 0xc6, 0x47,
+    0x1e, 0x00, 0xc3, 0x41, 0x55, 0x48, 0x89, 0xf8, 0x49, 0x89, 0xd1, 0x48,
+    0x89, 0xf7, 0x41, 0x54, 0x49, 0x89, 0xca, 0x31, 0xf6, 0x41, 0xbb, 0x10,
+    0x00, 0x00, 0x00, 0x55, 0x53, 0xbb, 0xff, 0xff, 0x00, 0x00, 0x44, 0x39,
+    0xc6, 0x0f, 0x83, 0xf8, 0x00, 0x00, 0x00, 0x66, 0x83, 0x78, 0x14, 0x00,
+    0x74, 0x39, 0x0f, 0xb7, 0x50, 0x0a, 0x48, 0x8b, 0x08, 0x66, 0x2b, 0x50,
+    0x12, 0x23, 0x50, 0x08, 0x0f, 0xb7, 0xd2, 0x8a, 0x14, 0x11, 0x89, 0xf1,
+    0x41, 0x88, 0x14, 0x0a, 0x0f, 0xb7, 0x48, 0x0a, 0x48, 0x8b, 0x28, 0x88,
+    0x54, 0x0d, 0x00, 0x66, 0x8b, 0x48, 0x0a, 0x66, 0xff, 0x48, 0x14, 0x8d,
+    0x51, 0x01, 0x23, 0x50, 0x08, 0x66, 0x89, 0x50, 0x0a, 0xeb, 0x59, 0x41,
+    0x8b, 0x09, 0x85, 0xc9, 0x0f, 0x84, 0xad, 0x00, 0x00, 0x00, 0x48, 0x8b,
+    0x2f, 0xff, 0xc9, 0x0f, 0xb6, 0x55, 0x00, 0x48, 0xff, 0xc5, 0x48, 0x89,
+    0x2f, 0x66, 0x8b, 0x68, 0x0e, 0x41, 0x89, 0x09, 0x66, 0x83, 0xfd, 0x01,
+    0x75, 0x09, 0x80, 0xce, 0x01, 0x66, 0x89, 0x50, 0x0e, 0xeb, 0x87, 0x40,
+    0xf6, 0xc5, 0x01, 0x74, 0x2a, 0x89, 0xf1, 0x41, 0x88, 0x14, 0x0a, 0x0f,
+    0xb7, 0x48, 0x0a, 0x48, 0x8b, 0x28, 0x88, 0x54, 0x0d, 0x00, 0x66, 0x8b,
+    0x48, 0x0a, 0x66, 0xd1, 0x68, 0x0e, 0x8d, 0x51, 0x01, 0x23, 0x50, 0x08,
+    0x66, 0x89, 0x50, 0x0a, 0xff, 0xc6, 0xe9, 0x57, 0xff, 0xff, 0xff, 0x80,
+    0x78, 0x10, 0x00, 0x75, 0x0c, 0x88, 0x50, 0x11, 0xc6, 0x40, 0x10, 0x01,
+    0xe9, 0x45, 0xff, 0xff, 0xff, 0x0f, 0xb6, 0x48, 0x11, 0x44, 0x0f, 0xb6,
+    0x68, 0x0c, 0x66, 0xd1, 0xed, 0xc6, 0x40, 0x10, 0x00, 0x66, 0x89, 0x68,
+    0x0e, 0xc1, 0xe1, 0x08, 0x09, 0xca, 0x44, 0x89, 0xd9, 0x44, 0x0f, 0xb7,
+    0xe2, 0x44, 0x29, 0xe9, 0x41, 0xd3, 0xfc, 0x44, 0x89, 0xe9, 0x41, 0xff,
+    0xc4, 0x66, 0x44, 0x89, 0x60, 0x12, 0x41, 0x89, 0xdc, 0x41, 0xd3, 0xfc,
+    0x44, 0x21, 0xe2, 0x83, 0xc2, 0x03, 0x66, 0x89, 0x50, 0x14, 0xe9, 0xff,
+    0xfe, 0xff, 0xff, 0x5b, 0x89, 0xf0, 0x5d, 0x41, 0x5c, 0x41, 0x5d, 0xc3,
+    0x31, 0xc0, 0x66, 0x83, 0x7f, 0x14, 0x00, 0x75, 0x09, 0x8a, 0x47, 0x10,
+    0x83, 0xf0, 0x01, 0x0f, 0xb6, 0xc0, 0x83, 0xe0, 0x01, 0xc3, 0x41, 0x54,
+    0x31, 0xc0, 0x55, 0x89, 0xd5, 0x83, 0xea, 0x08, 0x53, 0x80, 0xfa, 0x04,
+    0x77, 0x30, 0x49, 0x89, 0xf4, 0xba, 0x18, 0x00, 0x00, 0x00, 0x31, 0xf6,
+    0x48, 0x89, 0xfb, 0xe8, 0xa0, 0xe7, 0xff, 0xf7, 0xb8, 0x01, 0x00, 0x00,
+    0x00, 0x89, 0xe9, 0x4c, 0x89, 0x23, 0xd3, 0xe0, 0x40, 0x88, 0x6b, 0x0c,
+    0x66, 0xc7, 0x43, 0x0e, 0x01, 0x00, 0xff, 0xc8, 0x66, 0x89, 0x43, 0x08,
+    0xb0, 0x01, 0x5b, 0x5d, 0x41, 0x5c, 0xc3, 0x55, 0x53, 0x89, 0xfb, 0x51,
+    0x48, 0x0f, 0xbe, 0xeb, 0xe8, 0x6f, 0xe7, 0xff, 0xf7, 0x48, 0x8b, 0x00,
+    0x66, 0x8b, 0x14, 0x68, 0x31, 0xc0, 0xf6, 0xc6, 0x10, 0x74, 0x16, 0x80,
+    0xe6, 0x08, 0x8d, 0x43, 0xd0, 0x75, 0x0e, 0xe8, 0x54, 0xe7, 0xff, 0xf7,
+    0x48, 0x8b, 0x00, 0x8b, 0x04, 0xa8, 0x83, 0xe8, 0x57, 0x5a, 0x5b, 0x5d,
+    0xc3, 0xb0, 0x30, 0x40, 0x80, 0xff, 0x0f, 0x77, 0x0c, 0x8d, 0x47, 0x30,
+    0x40, 0x80, 0xff, 0x09, 0x76, 0x03, 0x8d, 0x47, 0x37, 0xc3, 0x89, 0xf9,
+    0x44, 0x8d, 0x46, 0xff, 0x40, 0x80, 0xfe, 0x08, 0x76, 0x04, 0xc6, 0x02,
+    0x00, 0xc3, 0x41, 0x80, 0xf8, 0xff, 0x74, 0x1c, 0x89, 0xcf, 0x4d, 0x0f,
+    0xbe, 0xc8, 0xc1, 0xe9, 0x04, 0x41, 0xff, 0xc8, 0x83, 0xe7, 0x0f, 0x49,
+    0x01, 0xd1, 0xe8, 0xbe, 0xff, 0xff, 0xff, 0x41, 0x88, 0x01, 0xeb, 0xde,
+    0x40, 0x0f, 0xb6, 0xf6, 0xc6, 0x04, 0x32, 0x00, 0xc3, 0xb9, 0x0a, 0x00,
+    0x00, 0x00, 0x49, 0x89, 0xd0, 0x89, 0xf8, 0x31, 0xd2, 0xf7, 0xf1, 0xb9,
+    0x01, 0x00, 0x00, 0x00, 0x39, 0xc1, 0x73, 0x05, 0x6b, 0xc9, 0x0a, 0xeb,
+    0xf7, 0x41, 0xb9, 0x0a, 0x00, 0x00, 0x00, 0x85, 0xc9, 0x74, 0x28, 0x49,
+    0x83, 0xf8, 0x01, 0x76, 0x22, 0x89, 0xf8, 0x31, 0xd2, 0x48, 0xff, 0xc6,
+    0x49, 0xff, 0xc8, 0xf7, 0xf1, 0x89, 0xc7, 0x89, 0xc8, 0x83, 0xc7, 0x30,
+    0x40, 0x88, 0x7e, 0xff, 0x89, 0xd7, 0x31, 0xd2, 0x41, 0xf7, 0xf1, 0x89,
+    0xc1, 0xeb, 0xd4, 0x4d, 0x85, 0xc0, 0x74, 0x03, 0xc6, 0x06, 0x00, 0xc3,
+    0x8b, 0x05, 0x72, 0x00, 0x00, 0x00, 0xff, 0xc0, 0x89, 0x05, 0x6a, 0x00,
+    0x00, 0x00, 0xc3, 0x8b, 0x05, 0x63, 0x00, 0x00, 0x00, 0xc3, 0x8b, 0x15,
+    0x5c, 0x00, 0x00, 0x00, 0x8b, 0x05, 0x56, 0x00, 0x00, 0x00, 0x29, 0xd0,
+    0x39, 0xf8, 0x72, 0xf4, 0xc3, 0x50, 0xe8, 0x71, 0xe6, 0xff, 0xf7, 0xbf,
+    0x60, 0x19, 0x00, 0x08, 0x5a, 0xe9, 0x66, 0xe6, 0xff, 0xf7, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x95, 0x15, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00,
+    0xc2, 0x15, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0xf4, 0x15, 0x00, 0x08,
+    0x00, 0x00, 0x00, 0x00, 0x25, 0x16, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00,
+    0x46, 0x16, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x66, 0x16, 0x00, 0x08,
+    0x00, 0x00, 0x00, 0x00, 0x77, 0x16, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00,
+};
+
+/** Update image from 1.0.0 to 1.1.0, header and patch */
+static const uint8_t delta_fixture_upgrade[677] = {
+    0x31, 0x49, 0x57, 0x46, 0x58, 0x05, 0x00, 0x00, 0xbd, 0xa0, 0x01, 0x01,
+    0x00, 0x61, 0x33, 0x35, 0x37, 0x39, 0x61, 0x34, 0x65, 0x36, 0x65, 0x66,
+    0x33, 0x39, 0x37, 0x65, 0x62, 0x62, 0x32, 0x39, 0x38, 0x30, 0x66, 0x65,
+    0x39, 0x37, 0x36, 0x39, 0x36, 0x31, 0x61, 0x37, 0x62, 0x39, 0x30, 0x36,
+    0x35, 0x31, 0x39, 0x64, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x64, 0x65, 0x6c, 0x74, 0x61, 0x20, 0x66, 0x69, 0x78, 0x74, 0x75, 0x72,
+    0x65, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x1a, 0x00, 0xff, 0xff, 0xdf, 0x32, 0xdf, 0x3c,
+    0x03, 0x00, 0x00, 0x01, 0xa1, 0x01, 0xf0, 0x01, 0x82, 0x00, 0x3f, 0x00,
+    0x3f, 0x00, 0x15, 0xdc, 0x03, 0x8a, 0x4f, 0xff, 0x1c, 0x80, 0xf9, 0x1c,
+    0x76, 0x06, 0xc6, 0x47, 0xff, 0x1e, 0x01, 0xeb, 0x15, 0x89, 0xf0, 0x83,
+    0xe0, 0xff, 0x7f, 0xd3, 0xe0, 0x09, 0x47, 0x18, 0x40, 0x84, 0xff, 0xf6,
+    0x79, 0x09, 0x83, 0xc1, 0x07, 0x88, 0x4f, 0xff, 0x1c, 0x31, 0xc0, 0xc3,
+    0xc6, 0x47, 0x1c, 0x00, 0xff, 0xb0, 0x01, 0xc3, 0x49, 0x89, 0xd2, 0x31,
+    0xd2, 0xff, 0x49, 0x89, 0xf1, 0x49, 0x89, 0xcb, 0x44, 0x39, 0xff, 0xc2,
+    0x73, 0x0d, 0x41, 0x8b, 0x02, 0x85, 0xc0, 0xff, 0x74, 0x06, 0x80, 0x7f,
+    0x1e, 0x00, 0x74, 0x03, 0xff, 0x89, 0xd0, 0xc3, 0x53, 0x49, 0x8b, 0x09,
+    0xff, 0xff, 0xc8, 0x0f, 0xb6, 0x31, 0x48, 0xff, 0xc1, 0x49, 0xff, 0x89,
+    0x09, 0x41, 0x89, 0x02, 0x80, 0x7f, 0x1d, 0xef, 0x06, 0x0f, 0x87, 0x1c,
+    0x42, 0x40, 0x0f, 0xb6, 0x47, 0xff, 0x1d, 0xff, 0x24, 0xc5, 0xa0, 0x19,
+    0x00, 0x08, 0xfe, 0x1c, 0xc0, 0xd3, 0xe6, 0x83, 0xc1, 0x08, 0x0b, 0x77,
+    0xff, 0x18, 0x89, 0x77, 0x18, 0x80, 0xf9, 0x0f, 0x76, 0x7f, 0x2d, 0x0f,
+    0xb7, 0x47, 0x0c, 0x66, 0xc7, 0x19, 0x40, 0xff, 0x01, 0x39, 0xf0, 0x0f,
+    0x95, 0x47, 0x1e, 0x31, 0x3f, 0xdb, 0x89, 0x5f, 0x18, 0xe9, 0xec, 0x28,
+    0x80, 0x0b, 0x0d, 0xb7, 0x1f, 0x77, 0x08, 0x24, 0xc0, 0xe9, 0xd1, 0x06,
+    0x80, 0x39, 0xab, 0x77, 0x08, 0x0c, 0xc2, 0x02, 0x0c, 0x42, 0xf6, 0x07,
+    0x80, 0xe9, 0xfd, 0xba, 0x05, 0x80, 0xe8, 0x28, 0xff, 0xff, 0xff, 0x84,
+    0xef, 0xc0, 0x0f, 0x84, 0xad, 0x03, 0x00, 0x8b, 0x47, 0x18, 0xbf, 0x89,
+    0x47, 0x14, 0x85, 0xc0, 0x75, 0x38, 0x40, 0x1d, 0xff, 0x04, 0xeb, 0x4e,
+    0x8b, 0x4f, 0x08, 0x2b, 0x4f, 0x7d, 0x10, 0x02, 0xc0, 0x03, 0x39, 0xc1,
+    0x73, 0x40, 0x3d, 0x42, 0xff, 0x3a, 0x8b, 0x47, 0x10, 0x48, 0x8b, 0x1f,
+    0x8d, 0xff, 0x48, 0x01, 0x89, 0x4f, 0x10, 0x89, 0xd1, 0x40, 0xff, 0x02,
+    0x34, 0x03, 0x41, 0x88, 0x34, 0x0b, 0xff, 0xef, 0x4f, 0x14, 0x75, 0x6c,
+    0x0d, 0x02, 0x66, 0xe8, 0xd6, 0xed, 0xfe, 0x14, 0x41, 0x74, 0x5f, 0x13,
+    0x40, 0x83, 0xf8, 0x01, 0xfe, 0x14, 0x00, 0xb0, 0x05, 0x14, 0x00, 0x88,
+    0x47, 0x1d, 0xff, 0x31, 0xc9, 0x89, 0x4f, 0x18, 0xeb, 0x48, 0x89, 0xd5,
+    0xd0, 0x0c, 0x00, 0x03, 0x0c, 0x01, 0x3b, 0x0c, 0x00, 0x06, 0xeb, 0xf7,
+    0x35, 0xe8, 0xa5, 0x0c, 0x03, 0x2e, 0x8b, 0x4f, 0x18, 0xfe, 0x04, 0x40,
+    0x02, 0x89, 0xc8, 0xd1, 0xe9, 0x83, 0xe0, 0xff, 0x01, 0xf7, 0xd8, 0x31,
+    0xc8, 0x03, 0x47, 0x10, 0xff, 0x39, 0x47, 0x08, 0x89, 0x47, 0x10, 0x0f,
+    0x92, 0x7e, 0x2d, 0x00, 0xc0, 0x89, 0x47, 0x18, 0xeb, 0x08, 0x21, 0x82,
+    0x57, 0x02, 0xff, 0xc2, 0x55, 0x01, 0x11, 0x55, 0x03, 0x0a, 0x55, 0x01,
+    0xf7, 0x0f, 0x84, 0xab, 0x11, 0xc0, 0x89, 0xd0, 0x5b, 0xc3, 0xfb, 0x31,
+    0xc0, 0x03, 0xc1, 0x75, 0x0b, 0x31, 0xc0, 0x66, 0xdb, 0x81, 0x7f, 0x3c,
+    0x41, 0x94, 0xc0, 0x13, 0xc0, 0xc3, 0x89, 0xff, 0x57, 0x08, 0x31, 0xc0,
+    0x31, 0xd2, 0x48, 0x89, 0xbf, 0x37, 0x66, 0x89, 0x4f, 0x0c, 0x48, 0x15,
+    0x40, 0x89, 0xeb, 0x57, 0x18, 0x44, 0xc2, 0x00, 0x14, 0xc0, 0x03, 0x99,
+    0x05, 0xc0, 0x88, 0xbf, 0x00, 0x3f, 0x00, 0x3f, 0x00, 0x3f, 0x00, 0x3f,
+    0x00, 0x12, 0x22, 0xfe, 0x20, 0x0c, 0x3f, 0x12, 0xf6, 0x00, 0x3f, 0x00,
+    0x3f, 0x00, 0x02, 0x3e, 0x01, 0xcb, 0x01, 0x8a, 0xec, 0x06, 0xc5, 0x38,
+    0x87, 0xde, 0x02, 0x02, 0x81, 0x42, 0x66, 0xe6, 0x7b, 0xff, 0xf7, 0x05,
+    0x43, 0x95, 0x15, 0x00, 0x08, 0x01, 0xc1, 0xb5, 0xc2, 0x01, 0xc4, 0xf4,
+    0x01, 0xc4, 0x25, 0x16, 0x01, 0xc3, 0x46, 0x2a, 0x01, 0xc4, 0x66, 0x01,
+    0xc4, 0x77, 0x01, 0xc4, 0x00,
+};
+
+/** Update image from 1.1.0 to 1.0.0, header and patch */
+static const uint8_t delta_fixture_downgrade[199] = {
+    0x31, 0x49, 0x57, 0x46, 0x3c, 0x03, 0x00, 0x00, 0x32, 0xdf, 0x01, 0x00,
+    0x00, 0x61, 0x33, 0x35, 0x37, 0x39, 0x61, 0x34, 0x65, 0x36, 0x65, 0x66,
+    0x33, 0x39, 0x37, 0x65, 0x62, 0x62, 0x32, 0x39, 0x38, 0x30, 0x66, 0x65,
+    0x39, 0x37, 0x36, 0x39, 0x36, 0x31, 0x61, 0x37, 0x62, 0x39, 0x30, 0x36,
+    0x35, 0x31, 0x39, 0x64, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x64, 0x65, 0x6c, 0x74, 0x61, 0x20, 0x66, 0x69, 0x78, 0x74, 0x75, 0x72,
+    0x65, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x1a, 0x00, 0xff, 0xff, 0xdf, 0xbd, 0xa0, 0x58,
+    0x05, 0x00, 0x00, 0x01, 0xa1, 0x01, 0x70, 0x01, 0x82, 0x00, 0x3f, 0x00,
+    0x3f, 0x00, 0x16, 0xbc, 0x07, 0x97, 0x2b, 0x03, 0xc0, 0x00, 0x3f, 0x00,
+    0x3f, 0x00, 0x3f, 0x00, 0x3f, 0x00, 0x3f, 0x00, 0x0b, 0xde, 0x02, 0x20,
+    0x0c, 0x3f, 0x12, 0xf6, 0x00, 0x3f, 0x00, 0x3f, 0x00, 0x02, 0xc2, 0x01,
+    0xcb, 0x01, 0x8a, 0xec, 0x06, 0xc5, 0x38, 0x87, 0x22, 0xfe, 0x02, 0x81,
+    0x04, 0x44, 0xe8, 0x07, 0xff, 0xf7, 0x00,
+};
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file    fake_flash.h
+ * @brief   Flash memory fake with simulated power loss for storage tests
+ *
+ * Include after the tested module. FAKE_FLASH_SIZE and FAKE_FLASH_ERASE_SIZE
+ * must be defined, FAKE_FLASH_START (accesses below are refused) is optional.
+ *
+ * Internal flash (hal/flash.h) is faked if FAKE_FLASH_INTERNAL is defined,
+ * addresses are pointers to flash_mem and each halfword can be programmed
+ * once after erase. SPI NOR flash (drivers/spi_flash.h) is faked otherwise,
+ * addresses are offsets in flash_mem and programming only clears bits.
+ *
+ * Power is lost after flash_ops_left erase or write operations, the last
+ * write programs only half of the data, the last erase leaves 0x5a pattern.
+ * SPI flash reads fail while flash_read_fail is set (erase not suspended).
+ */
+
+#ifndef __FAKE_FLASH_H
+#define __FAKE_FLASH_H
+
+#include <string.h>
+#include <unity.h>
+
+#ifndef FAKE_FLASH_START
+#define FAKE_FLASH_START 0
+#endif
+
+static uint8_t flash_mem[FAKE_FLASH_SIZE] __attribute__((aligned(4)));
+/** Amount of flash operations before simulated power loss, 0 to disable */
+static uint32_t flash_ops_left;
+static bool flash_dead;
+static uint32_t flash_erases;
+static uint32_t flash_reads;
+static bool flash_read_fail;
+
+/**
+ * Erase the whole memory, power is restored
+ */
+static void Flash_Reset(void)
+{
+    memset(flash_mem, 0xff, sizeof(flash_mem));
+    flash_ops_left = 0;
+    flash_dead = false;
+    flash_erases = 0;
+    flash_reads = 0;
+    flash_read_fail = false;
+}
+
+/**
+ * Count flash operation, returns false once power is lost
+ */
+static bool Flash_Op(void)
+{
+    if (flash_dead) {
+        return false;
+    }
+    if (flash_ops_left != 0 && --flash_ops_left == 0) {
+        flash_dead = true;
+    }
+    return true;
+}
+
+/**
+ * Check that memory range is within the fake memory
+ */
+static void Flash_CheckRange(uint32_t offset, uint32_t len)
+{
+#if FAKE_FLASH_START > 0
+    TEST_ASSERT_GREATER_OR_EQUAL(FAKE_FLASH_START, offset);
+#endif
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(flash_mem), offset + len);
+}
+
+/**
+ * Erase block of memory, power loss leaves garbage
+ */
+static void Flash_Erase(uint32_t offset)
+{
+    Flash_CheckRange(offset, FAKE_FLASH_ERASE_SIZE);
+    TEST_ASSERT_EQUAL(0, offset % FAKE_FLASH_ERASE_SIZE);
+    if (!Flash_Op()) {
+        return;
+    }
+    memset(&flash_mem[offset], flash_dead ? 0x5a : 0xff, FAKE_FLASH_ERASE_SIZE);
+    flash_erases++;
+}
+
+#ifdef FAKE_FLASH_INTERNAL
+static bool flash_unlocked;
+
+/**
+ * Get offset in flash memory from address
+ */
+static uint32_t Flash_Offset(uint32_t addr)
+{
+    return addr - (uint32_t)(uintptr_t)flash_mem;
+}
+
+void Flashd_WriteEnable(void)
+{
+    flash_unlocked = true;
+}
+
+void Flashd_WriteDisable(void)
+{
+    flash_unlocked = false;
+}
+
+void Flashd_ErasePage(uint32_t addr)
+{
+    TEST_ASSERT_TRUE(flash_unlocked);
+    Flash_Erase(Flash_Offset(addr));
+}
+
+void Flashd_Write(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    uint32_t offset = Flash_Offset(addr);
+    uint32_t halfwords = (len + 1) / 2;
+    uint8_t *dst = &flash_mem[offset];
+
+    TEST_ASSERT_TRUE(flash_unlocked);
+    TEST_ASSERT_EQUAL(0, addr % 2);
+    Flash_CheckRange(offset, len);
+    if (!Flash_Op()) {
+        return;
+    }
+    /* Interrupted write programs only part of the data */
+    if (flash_dead) {
+        halfwords /= 2;
+    }
+    for (uint32_t i = 0; i < halfwords * 2; i += 2) {
+        /* Half word can be programmed only once after erase */
+        TEST_ASSERT_EQUAL_HEX8(0xff, dst[i]);
+        TEST_ASSERT_EQUAL_HEX8(0xff, dst[i + 1]);
+        dst[i] = buf[i];
+        dst[i + 1] = i + 1 < len ? buf[i + 1] : 0xff;
+    }
+}
+#else
+bool SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf, size_t len)
+{
+    (void)desc;
+    Flash_CheckRange(addr, len);
+    if (flash_read_fail) {
+        return false;
+    }
+    memcpy(buf, &flash_mem[addr], len);
+    flash_reads++;
+    return true;
+}
+
+void SpiFlash_Write(const spiflash_desc_t *desc, uint32_t addr, const uint8_t *buf, size_t len)
+{
+    (void)desc;
+    Flash_CheckRange(addr, len);
+    if (!Flash_Op()) {
+        return;
+    }
+    /* Interrupted write programs only part of the data */
+    for (size_t i = 0; i < (flash_dead ? len / 2 : len); i++) {
+        flash_mem[addr + i] &= buf[i];
+    }
+}
+
+void SpiFlash_EraseSector(const spiflash_desc_t *desc, uint32_t addr)
+{
+    (void)desc;
+    Flash_Erase(addr);
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @file    lzss_encoder.h
+ * @brief   LZSS compressor for tests of modules using compressed data
+ *
+ * Include after utils/lzss.c (or the module including it).
+ */
+
+#ifndef __LZSS_ENCODER_H
+#define __LZSS_ENCODER_H
+
+#include <types.h>
+
+/**
+ * Naive compressor for round trip tests, same format as tools/lzss.py
+ */
+static uint32_t Lzss_TestEncode(const uint8_t *data, uint32_t len, uint8_t bits, uint8_t *out)
+{
+    uint32_t max_match = (0xffffU >> bits) + LZSS_MIN_MATCH;
+    uint32_t pos = 0, size = 0, flags = 0, bit = 8;
+
+    while (pos < len) {
+        uint32_t best = 0, dist = 0;
+
+        if (bit == 8) {
+            flags = size++;
+            out[flags] = 0;
+            bit = 0;
+        }
+        for (uint32_t d = 1; d <= pos && d <= (1U << bits); d++) {
+            uint32_t l = 0;
+            while (l < max_match && pos + l < len && data[pos + l] == data[pos + l - d]) {
+                l++;
+            }
+            if (l > best) {
+                best = l;
+                dist = d;
+            }
+        }
+        if (best >= LZSS_MIN_MATCH) {
+            uint16_t ref = ((dist - 1) << (16 - bits)) | (best - LZSS_MIN_MATCH);
+            out[size++] = ref >> 8;
+            out[size++] = ref & 0xff;
+            pos += best;
+        } else {
+            out[flags] |= 1 << bit;
+            out[size++] = data[pos++];
+        }
+        bit++;
+    }
+    return size;
+}
+
+#endif
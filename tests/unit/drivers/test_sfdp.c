@@ -0,0 +1,295 @@
+#include <string.h>
+#include <unity.h>
+#include "drivers/sfdp.c"
+
+static uint8_t bfpt[SFDP_BFPT_DWORDS * 4];
+
+static void Sfdp_SetDword(uint8_t n, uint32_t value)
+{
+    bfpt[(n - 1) * 4] = value;
+    bfpt[(n - 1) * 4 + 1] = value >> 8;
+    bfpt[(n - 1) * 4 + 2] = value >> 16;
+    bfpt[(n - 1) * 4 + 3] = value >> 24;
+}
+
+void setUp(void)
+{
+    /* 16 MB memory, 3 byte addressing, 4/32/64 kB erase */
+    memset(bfpt, 0xff, sizeof(bfpt));
+    Sfdp_SetDword(1, 0xfff920e5);
+    Sfdp_SetDword(2, 0x07ffffff);
+    Sfdp_SetDword(8, 0x520f200c);
+    Sfdp_SetDword(9, 0xff00d810);
+    Sfdp_SetDword(11, 0xff000081);
+}
+
+void tearDown(void) {}
+
+void test_ParseHeader(void)
+{
+    uint8_t header[SFDP_HEADER_SIZE] = { 'S', 'F', 'D', 'P', 0x06, 0x01, 0x01, 0xff, 0x00, 0x06,
+        0x01, 0x10, 0x30, 0x00, 0x00, 0xff };
+    uint32_t addr;
+    uint8_t dwords;
+
+    TEST_ASSERT_TRUE(Sfdp_ParseHeader(header, &addr, &dwords));
+    TEST_ASSERT_EQUAL(0x30, addr);
+    TEST_ASSERT_EQUAL(16, dwords);
+
+    /* Basic table too short */
+    header[11] = 8;
+    TEST_ASSERT_FALSE(Sfdp_ParseHeader(header, &addr, &dwords));
+    header[11] = 9;
+    TEST_ASSERT_TRUE(Sfdp_ParseHeader(header, &addr, &dwords));
+
+    /* Not a basic table */
+    header[8] = 0x81;
+    TEST_ASSERT_FALSE(Sfdp_ParseHeader(header, &addr, &dwords));
+    header[8] = 0x00;
+
+    /* Unknown major revision */
+    header[5] = 0x02;
+    TEST_ASSERT_FALSE(Sfdp_ParseHeader(header, &addr, &dwords));
+    header[5] = 0x01;
+
+    /* No SFDP, bus reads all ones */
+    memset(header, 0xff, sizeof(header));
+    TEST_ASSERT_FALSE(Sfdp_ParseHeader(header, &addr, &dwords));
+}
+
+void test_Basic(void)
+{
+    sfdp_params_t params;
+
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 11, &params));
+    TEST_ASSERT_EQUAL(16UL * 1024 * 1024, params.size);
+    TEST_ASSERT_EQUAL(256, params.page_size);
+    TEST_ASSERT_EQUAL(3, params.addr_bytes);
+    TEST_ASSERT_EQUAL(0, params.addr4_cmd);
+    TEST_ASSERT_EQUAL_HEX8(0x0b, params.read_cmd);
+    TEST_ASSERT_EQUAL(1, params.read_dummy);
+
+    TEST_ASSERT_EQUAL(4096, params.erase[0].size);
+    TEST_ASSERT_EQUAL_HEX8(0x20, params.erase[0].cmd);
+    TEST_ASSERT_EQUAL(32768, params.erase[1].size);
+    TEST_ASSERT_EQUAL_HEX8(0x52, params.erase[1].cmd);
+    TEST_ASSERT_EQUAL(65536, params.erase[2].size);
+    TEST_ASSERT_EQUAL_HEX8(0xd8, params.erase[2].cmd);
+    TEST_ASSERT_EQUAL(0, params.erase[3].size);
+
+    /* JESD216 without page size */
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(256, params.page_size);
+
+    TEST_ASSERT_FALSE(Sfdp_ParseBfpt(bfpt, 8, &params));
+}
+
+void test_Suspend(void)
+{
+    sfdp_params_t params;
+
+    /* Not described in older tables */
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 11, &params));
+    TEST_ASSERT_EQUAL(0, params.suspend_cmd);
+
+    /* Not supported */
+    Sfdp_SetDword(13, 0xb0307a75);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 16, &params));
+    TEST_ASSERT_EQUAL(0, params.suspend_cmd);
+
+    Sfdp_SetDword(12, 0x7f000000);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 16, &params));
+    TEST_ASSERT_EQUAL_HEX8(0xb0, params.suspend_cmd);
+    TEST_ASSERT_EQUAL_HEX8(0x30, params.resume_cmd);
+}
+
+void test_Timing(void)
+{
+    sfdp_params_t params;
+
+    /* Not described in older tables */
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(SFDP_PROGRAM_TIMEOUT_MS, params.program_timeout_ms);
+    TEST_ASSERT_EQUAL(SFDP_CHIP_ERASE_TIMEOUT_MS, params.chip_erase_timeout_ms);
+
+    /* Erase multiplier 1, program 768 us typical with multiplier 2, chip erase 20 * 256 ms */
+    Sfdp_SetDword(10, 0xfffffff1);
+    Sfdp_SetDword(11, 0x33002b82);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 11, &params));
+    TEST_ASSERT_EQUAL(256, params.page_size);
+    TEST_ASSERT_EQUAL(5, params.program_timeout_ms);
+    TEST_ASSERT_EQUAL(20480, params.chip_erase_timeout_ms);
+
+    /* Shortest program time rounds up to 1 ms, longest chip erase fits */
+    Sfdp_SetDword(10, 0xffffffff);
+    Sfdp_SetDword(11, 0x7f000080);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 11, &params));
+    TEST_ASSERT_EQUAL(1, params.program_timeout_ms);
+    TEST_ASSERT_EQUAL(2UL * 16 * 32 * 64000, params.chip_erase_timeout_ms);
+}
+
+void test_EraseTypes(void)
+{
+    sfdp_params_t params;
+
+    /* Unsorted erase types */
+    Sfdp_SetDword(8, 0x200cd810);
+    Sfdp_SetDword(9, 0x0000520f);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(4096, params.erase[0].size);
+    TEST_ASSERT_EQUAL_HEX8(0x20, params.erase[0].cmd);
+    TEST_ASSERT_EQUAL(32768, params.erase[1].size);
+    TEST_ASSERT_EQUAL(65536, params.erase[2].size);
+    TEST_ASSERT_EQUAL(0, params.erase[3].size);
+
+    /* No erase types, 4 kB erase from DWORD 1 */
+    Sfdp_SetDword(8, 0);
+    Sfdp_SetDword(9, 0);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(4096, params.erase[0].size);
+    TEST_ASSERT_EQUAL_HEX8(0x20, params.erase[0].cmd);
+    TEST_ASSERT_EQUAL(0, params.erase[1].size);
+
+    /* No erase supported at all */
+    Sfdp_SetDword(1, 0xfff920e4);
+    TEST_ASSERT_FALSE(Sfdp_ParseBfpt(bfpt, 9, &params));
+}
+
+void test_FourByteAddress(void)
+{
+    sfdp_params_t params;
+
+    /* 32 MB, 3 or 4 byte addressing, entered by 0xb7 */
+    Sfdp_SetDword(1, 0xfffb20e5);
+    Sfdp_SetDword(2, 0x0fffffff);
+    Sfdp_SetDword(16, 0x01000000);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 16, &params));
+    TEST_ASSERT_EQUAL(32UL * 1024 * 1024, params.size);
+    TEST_ASSERT_EQUAL(4, params.addr_bytes);
+    TEST_ASSERT_EQUAL_HEX8(0xb7, params.addr4_cmd);
+    TEST_ASSERT_FALSE(params.addr4_wren);
+
+    /* Write enable required */
+    Sfdp_SetDword(16, 0x02000000);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 16, &params));
+    TEST_ASSERT_EQUAL(4, params.addr_bytes);
+    TEST_ASSERT_EQUAL_HEX8(0xb7, params.addr4_cmd);
+    TEST_ASSERT_TRUE(params.addr4_wren);
+
+    /* Older table, 0xb7 assumed */
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(4, params.addr_bytes);
+    TEST_ASSERT_EQUAL_HEX8(0xb7, params.addr4_cmd);
+
+    /* Unsupported method, only lower 16 MB used */
+    Sfdp_SetDword(16, 0x08000000);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 16, &params));
+    TEST_ASSERT_EQUAL(16UL * 1024 * 1024, params.size);
+    TEST_ASSERT_EQUAL(3, params.addr_bytes);
+    TEST_ASSERT_EQUAL(0, params.addr4_cmd);
+
+    /* Small memory with 4 byte support stays in 3 byte mode */
+    Sfdp_SetDword(2, 0x03ffffff);
+    Sfdp_SetDword(16, 0x01000000);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 16, &params));
+    TEST_ASSERT_EQUAL(3, params.addr_bytes);
+    TEST_ASSERT_EQUAL(0, params.addr4_cmd);
+
+    /* 4 byte only, no mode switch */
+    Sfdp_SetDword(1, 0xfffd20e5);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 16, &params));
+    TEST_ASSERT_EQUAL(4, params.addr_bytes);
+    TEST_ASSERT_EQUAL(0, params.addr4_cmd);
+
+    /* Reserved value */
+    Sfdp_SetDword(1, 0xffff20e5);
+    TEST_ASSERT_FALSE(Sfdp_ParseBfpt(bfpt, 16, &params));
+}
+
+void test_Density(void)
+{
+    sfdp_params_t params;
+
+    /* 2^34 bits */
+    Sfdp_SetDword(1, 0xfffd20e5);
+    Sfdp_SetDword(2, 0x80000022);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(2UL * 1024 * 1024 * 1024, params.size);
+
+    /* Too big to be addressed by 32 bits */
+    Sfdp_SetDword(2, 0x80000023);
+    TEST_ASSERT_FALSE(Sfdp_ParseBfpt(bfpt, 9, &params));
+
+    /* 4 Gbit in linear form */
+    Sfdp_SetDword(2, 0xffffffff);
+    TEST_ASSERT_FALSE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    Sfdp_SetDword(2, 0x7fffffff);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(256UL * 1024 * 1024, params.size);
+}
+
+void test_EraseTime(void)
+{
+    sfdp_params_t params;
+
+    /* Not described */
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(SFDP_ERASE_TIMEOUT_MS, params.erase[0].timeout_ms);
+
+    /* 4 kB 80 ms, 32 kB 2 ms, 64 kB 2 s typical, max multiplier 3 */
+    Sfdp_SetDword(10, 0x02 | 0x24 << 4 | 0x01 << 11 | 0x61 << 18);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 10, &params));
+    TEST_ASSERT_EQUAL(480, params.erase[0].timeout_ms);
+    TEST_ASSERT_EQUAL(12, params.erase[1].timeout_ms);
+    TEST_ASSERT_EQUAL(12000, params.erase[2].timeout_ms);
+}
+
+void test_NonUniform(void)
+{
+    sfdp_params_t params;
+
+    /* SST26 - 4 kB sectors, 8/32/64 kB blocks with the same command */
+    Sfdp_SetDword(8, 0xd80d200c);
+    Sfdp_SetDword(9, 0xd810d80f);
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_EQUAL(4096, params.erase[0].size);
+    TEST_ASSERT_EQUAL_HEX8(0x20, params.erase[0].cmd);
+    TEST_ASSERT_EQUAL(0, params.erase[1].size);
+}
+
+/**
+ * Count erase operations of each size needed to erase the range
+ */
+static void Sfdp_TestPlan(uint32_t addr, uint32_t len, const uint16_t expected[3])
+{
+    sfdp_params_t params;
+    const sfdp_erase_t *erase;
+    uint16_t count[3] = { 0 };
+
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    while (len != 0) {
+        erase = Sfdp_GetErase(&params, addr, len);
+        TEST_ASSERT_NOT_NULL(erase);
+        TEST_ASSERT_EQUAL(0, addr % erase->size);
+        count[erase - params.erase]++;
+        addr += erase->size;
+        len -= erase->size;
+    }
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, count, 3);
+}
+
+void test_GetErase(void)
+{
+    sfdp_params_t params;
+
+    /* 1 MB region */
+    Sfdp_TestPlan(0x100000, 0x100000, (const uint16_t[]){ 0, 0, 16 });
+    /* Unaligned edges */
+    Sfdp_TestPlan(0x1000, 0x20000, (const uint16_t[]){ 8, 1, 1 });
+    Sfdp_TestPlan(0x18000, 0x10000, (const uint16_t[]){ 0, 2, 0 });
+    Sfdp_TestPlan(0x3000, 0x2000, (const uint16_t[]){ 2, 0, 0 });
+
+    TEST_ASSERT_TRUE(Sfdp_ParseBfpt(bfpt, 9, &params));
+    TEST_ASSERT_NULL(Sfdp_GetErase(&params, 0x100, 0x1000));
+    TEST_ASSERT_NULL(Sfdp_GetErase(&params, 0x1000, 0x100));
+}
@@ -0,0 +1,94 @@
+#include <string.h>
+#include <unity.h>
+#include "utils/crc.c"
+#include "modules/kvstore.c"
+#include "modules/config.c"
+
+#define TEST_PAGE_SIZE 1024
+
+#define FAKE_FLASH_INTERNAL
+#define FAKE_FLASH_SIZE       (2 * TEST_PAGE_SIZE)
+#define FAKE_FLASH_ERASE_SIZE TEST_PAGE_SIZE
+#include "fake_flash.h"
+
+#define TEST_STR(x)  #x
+#define TEST_XSTR(x) TEST_STR(x)
+
+/* Config partitions are the fake flash pages, placed like by the linker */
+__asm__(".globl _config_part1\n.set _config_part1, flash_mem\n"
+        ".globl _config_part2\n.set _config_part2, flash_mem + " TEST_XSTR(TEST_PAGE_SIZE) "\n");
+
+uint32_t Flashd_GetPageSize(void)
+{
+    return TEST_PAGE_SIZE;
+}
+
+/**
+ * Store config in the previous format to the partition
+ */
+static void Config_TestLegacy(uint8_t part, const config_t *config)
+{
+    config_legacy_t legacy;
+
+    memset(&legacy, 0, sizeof(legacy));
+    legacy.config = *config;
+    legacy.crc = CRC16((const uint8_t *)config, sizeof(config_t));
+    memcpy(&flash_mem[part * TEST_PAGE_SIZE], &legacy, sizeof(legacy));
+}
+
+void setUp(void)
+{
+    Flash_Reset();
+}
+
+void tearDown(void) {}
+
+void test_ReadWrite(void)
+{
+    config_t config = { .id = 1234, .name = "test" };
+
+    TEST_ASSERT_FALSE(Config_Read());
+    TEST_ASSERT_NULL(Config_Get());
+
+    Config_Write(&config);
+    TEST_ASSERT_EQUAL_MEMORY(&config, Config_Get(), sizeof(config));
+    TEST_ASSERT_TRUE(Config_Read());
+    TEST_ASSERT_EQUAL_MEMORY(&config, Config_Get(), sizeof(config));
+}
+
+void test_Migrate(void)
+{
+    config_t config = { .id = 42, .name = "legacy" };
+    config_t other = { .id = 43, .name = "other" };
+
+    /* Both partitions */
+    Config_TestLegacy(0, &config);
+    Config_TestLegacy(1, &config);
+    TEST_ASSERT_TRUE(Config_Read());
+    TEST_ASSERT_EQUAL_MEMORY(&config, Config_Get(), sizeof(config));
+    TEST_ASSERT_TRUE(Config_Read());
+    TEST_ASSERT_EQUAL_MEMORY(&config, Config_Get(), sizeof(config));
+
+    /* New values replace the migrated one, also after compaction */
+    for (uint32_t i = 0; i < 100; i++) {
+        other.id = i;
+        Config_Write(&other);
+    }
+    TEST_ASSERT_TRUE(Config_Read());
+    TEST_ASSERT_EQUAL_MEMORY(&other, Config_Get(), sizeof(other));
+
+    /* Only the second partition valid, e.g. first write interrupted */
+    Flash_Reset();
+    memset(flash_mem, 0x5a, TEST_PAGE_SIZE);
+    Config_TestLegacy(1, &config);
+    TEST_ASSERT_TRUE(Config_Read());
+    TEST_ASSERT_EQUAL_MEMORY(&config, Config_Get(), sizeof(config));
+
+    /* Single partition setup */
+    Flash_Reset();
+    Config_TestLegacy(0, &config);
+    TEST_ASSERT_TRUE(Config_Read());
+    TEST_ASSERT_EQUAL_MEMORY(&config, Config_Get(), sizeof(config));
+    TEST_ASSERT_TRUE(Config_Read());
+    TEST_ASSERT_EQUAL_MEMORY(&config, Config_Get(), sizeof(config));
+}
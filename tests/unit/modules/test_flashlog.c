@@ -0,0 +1,268 @@
+#include <string.h>
+#include <unity.h>
+#include "utils/crc.c"
+#include "modules/flashlog.c"
+
+#define TEST_SECTORS  8
+#define TEST_START    8192
+#define TEST_DATA_LEN 12
+#define TEST_SLOTS    ((SECTOR_SIZE - sizeof(flashlog_header_t)) / (TEST_DATA_LEN + 8))
+
+#define FAKE_FLASH_SIZE       (TEST_START + TEST_SECTORS * SECTOR_SIZE)
+#define FAKE_FLASH_ERASE_SIZE SECTOR_SIZE
+#define FAKE_FLASH_START      TEST_START
+#include "fake_flash.h"
+
+static spiflash_desc_t flash_desc;
+
+static void FlashLog_TestPattern(uint8_t *buf, uint32_t time)
+{
+    for (uint16_t i = 0; i < TEST_DATA_LEN; i++) {
+        buf[i] = (uint8_t)(time * 13 + i);
+    }
+}
+
+static void FlashLog_TestAppend(uint32_t time)
+{
+    uint8_t buf[TEST_DATA_LEN];
+
+    FlashLog_TestPattern(buf, time);
+    TEST_ASSERT_TRUE(FlashLog_Append(time, buf));
+}
+
+/**
+ * Read records from given time, verify order and content
+ *
+ * @return Amount of records read
+ */
+static uint32_t FlashLog_TestRead(uint32_t from, uint32_t *first, uint32_t *last)
+{
+    flashlog_cursor_t cursor;
+    uint8_t buf[TEST_DATA_LEN], expected[TEST_DATA_LEN];
+    uint32_t time, prev = 0, count = 0;
+
+    TEST_ASSERT_TRUE(FlashLog_Find(from, &cursor));
+    while (FlashLog_ReadNext(&cursor, &time, buf)) {
+        FlashLog_TestPattern(expected, time);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, TEST_DATA_LEN);
+        TEST_ASSERT_GREATER_OR_EQUAL(prev, time);
+        if (count == 0 && first != NULL) {
+            *first = time;
+        }
+        prev = time;
+        count++;
+    }
+    if (last != NULL) {
+        *last = prev;
+    }
+    return count;
+}
+
+void setUp(void)
+{
+    Flash_Reset();
+    TEST_ASSERT_TRUE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, TEST_DATA_LEN));
+}
+
+void tearDown(void) {}
+
+void test_Empty(void)
+{
+    flashlog_cursor_t cursor;
+    uint32_t first, last, time;
+    uint8_t buf[TEST_DATA_LEN];
+
+    TEST_ASSERT_FALSE(FlashLog_GetRange(&first, &last));
+    TEST_ASSERT_TRUE(FlashLog_Find(0, &cursor));
+    TEST_ASSERT_FALSE(FlashLog_ReadNext(&cursor, &time, buf));
+
+    TEST_ASSERT_FALSE(FlashLog_Init(&flash_desc, TEST_START, 1, TEST_DATA_LEN));
+    TEST_ASSERT_FALSE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, 0));
+    TEST_ASSERT_FALSE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, 4096));
+    TEST_ASSERT_FALSE(FlashLog_Append(1, buf));
+}
+
+void test_AppendRead(void)
+{
+    uint32_t first, last;
+
+    for (uint32_t i = 1; i <= 1000; i++) {
+        FlashLog_TestAppend(i * 2);
+    }
+    TEST_ASSERT_TRUE(FlashLog_GetRange(&first, &last));
+    TEST_ASSERT_EQUAL(2, first);
+    TEST_ASSERT_EQUAL(2000, last);
+
+    TEST_ASSERT_EQUAL(1000, FlashLog_TestRead(0, &first, &last));
+    TEST_ASSERT_EQUAL(2, first);
+    TEST_ASSERT_EQUAL(2000, last);
+
+    /* Times decreasing or reserved are refused, equal times are fine */
+    TEST_ASSERT_FALSE(FlashLog_Append(1999, flash_mem));
+    TEST_ASSERT_FALSE(FlashLog_Append(0xffffffff, flash_mem));
+    FlashLog_TestAppend(2000);
+    TEST_ASSERT_EQUAL(1001, FlashLog_TestRead(0, NULL, NULL));
+}
+
+void test_Find(void)
+{
+    flashlog_cursor_t cursor;
+    uint32_t first, last;
+
+    for (uint32_t i = 1; i <= 1000; i++) {
+        FlashLog_TestAppend(i * 2);
+    }
+
+    for (uint32_t from = 0; from <= 2002; from += 7) {
+        uint32_t expected = from <= 2 ? 1000 : 1000 - (from - 1) / 2;
+
+        TEST_ASSERT_EQUAL(expected, FlashLog_TestRead(from, &first, &last));
+        if (expected != 0) {
+            TEST_ASSERT_EQUAL(from <= 2 ? 2 : (from + 1) / 2 * 2, first);
+        }
+    }
+
+    /* Binary search, no full scan */
+    flash_reads = 0;
+    TEST_ASSERT_TRUE(FlashLog_Find(1234, &cursor));
+    TEST_ASSERT_LESS_THAN(25, flash_reads);
+}
+
+void test_Wrap(void)
+{
+    uint32_t first, last, total = TEST_SECTORS * TEST_SLOTS * 3 + 5;
+
+    for (uint32_t i = 1; i <= total; i++) {
+        FlashLog_TestAppend(i);
+    }
+
+    /* Head sector with 5 records replaced the oldest one */
+    TEST_ASSERT_TRUE(FlashLog_GetRange(&first, &last));
+    TEST_ASSERT_EQUAL(total, last);
+    TEST_ASSERT_EQUAL(total - (TEST_SECTORS - 1) * TEST_SLOTS - 5 + 1, first);
+    TEST_ASSERT_EQUAL((TEST_SECTORS - 1) * TEST_SLOTS + 5, FlashLog_TestRead(0, NULL, NULL));
+
+    TEST_ASSERT_EQUAL(101, FlashLog_TestRead(total - 100, &first, NULL));
+    TEST_ASSERT_EQUAL(total - 100, first);
+}
+
+void test_OverwrittenWhileReading(void)
+{
+    flashlog_cursor_t cursor;
+    uint8_t buf[TEST_DATA_LEN];
+    uint32_t time, i;
+
+    for (i = 1; i <= TEST_SECTORS * TEST_SLOTS; i++) {
+        FlashLog_TestAppend(i);
+    }
+    TEST_ASSERT_TRUE(FlashLog_Find(0, &cursor));
+    TEST_ASSERT_TRUE(FlashLog_ReadNext(&cursor, &time, buf));
+    TEST_ASSERT_EQUAL(1, time);
+
+    /* Two more sectors written, reading continues at the oldest record */
+    for (; i <= (TEST_SECTORS + 2) * TEST_SLOTS; i++) {
+        FlashLog_TestAppend(i);
+    }
+    TEST_ASSERT_TRUE(FlashLog_ReadNext(&cursor, &time, buf));
+    TEST_ASSERT_EQUAL(2 * TEST_SLOTS + 1, time);
+
+    /* Records appended to the head are readable by existing cursor */
+    TEST_ASSERT_TRUE(FlashLog_Find(i - 1, &cursor));
+    TEST_ASSERT_TRUE(FlashLog_ReadNext(&cursor, &time, buf));
+    TEST_ASSERT_FALSE(FlashLog_ReadNext(&cursor, &time, buf));
+    FlashLog_TestAppend(i);
+    TEST_ASSERT_TRUE(FlashLog_ReadNext(&cursor, &time, buf));
+    TEST_ASSERT_EQUAL(i, time);
+}
+
+void test_Remount(void)
+{
+    uint32_t first, last;
+
+    for (uint32_t i = 1; i <= 500; i++) {
+        FlashLog_TestAppend(i);
+    }
+    TEST_ASSERT_TRUE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, TEST_DATA_LEN));
+    TEST_ASSERT_TRUE(FlashLog_GetRange(&first, &last));
+    TEST_ASSERT_EQUAL(1, first);
+    TEST_ASSERT_EQUAL(500, last);
+    TEST_ASSERT_FALSE(FlashLog_Append(499, flash_mem));
+
+    for (uint32_t i = 501; i <= 600; i++) {
+        FlashLog_TestAppend(i);
+    }
+    TEST_ASSERT_TRUE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, TEST_DATA_LEN));
+    TEST_ASSERT_EQUAL(600, FlashLog_TestRead(0, NULL, NULL));
+}
+
+void test_PowerLoss(void)
+{
+    uint8_t buf[TEST_DATA_LEN];
+    uint32_t first, last, written, read;
+
+    for (uint32_t ops = 1; ops < 120; ops++) {
+        setUp();
+        for (written = 1; written <= TEST_SLOTS - 10; written++) {
+            FlashLog_TestAppend(written);
+        }
+
+        /* Power lost in the middle of appends including sector switch */
+        flash_ops_left = ops;
+        for (; !flash_dead; written++) {
+            FlashLog_TestPattern(buf, written);
+            FlashLog_Append(written, buf);
+        }
+        flash_dead = false;
+        flash_ops_left = 0;
+
+        /* All records except the interrupted one are kept */
+        TEST_ASSERT_TRUE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, TEST_DATA_LEN));
+        read = FlashLog_TestRead(0, &first, &last);
+        TEST_ASSERT_EQUAL(1, first);
+        TEST_ASSERT_EQUAL(read, last);
+        TEST_ASSERT_GREATER_OR_EQUAL(written - 2, read);
+
+        /* And still usable */
+        for (uint32_t i = 0; i < TEST_SLOTS; i++) {
+            FlashLog_TestAppend(written + i);
+        }
+        TEST_ASSERT_EQUAL(read + TEST_SLOTS, FlashLog_TestRead(0, NULL, NULL));
+    }
+}
+
+void test_ReadFailure(void)
+{
+    flashlog_cursor_t cursor;
+    uint32_t first, last, time;
+    uint8_t buf[TEST_DATA_LEN];
+
+    for (uint32_t i = 1; i <= TEST_SLOTS + 10; i++) {
+        FlashLog_TestAppend(i);
+    }
+    TEST_ASSERT_TRUE(FlashLog_Find(0, &cursor));
+    TEST_ASSERT_TRUE(FlashLog_ReadNext(&cursor, &time, buf));
+    TEST_ASSERT_EQUAL(1, time);
+
+    flash_read_fail = true;
+    TEST_ASSERT_FALSE(FlashLog_ReadNext(&cursor, &time, buf));
+    TEST_ASSERT_FALSE(FlashLog_GetRange(&first, &last));
+    TEST_ASSERT_FALSE(FlashLog_Find(0, &cursor));
+
+    /* Cursor doesn't skip the record that failed */
+    flash_read_fail = false;
+    TEST_ASSERT_TRUE(FlashLog_Find(0, &cursor));
+    TEST_ASSERT_TRUE(FlashLog_ReadNext(&cursor, &time, buf));
+    flash_read_fail = true;
+    TEST_ASSERT_FALSE(FlashLog_ReadNext(&cursor, &time, buf));
+    flash_read_fail = false;
+    TEST_ASSERT_TRUE(FlashLog_ReadNext(&cursor, &time, buf));
+    TEST_ASSERT_EQUAL(2, time);
+
+    /* Log is not mounted from unreadable flash */
+    flash_read_fail = true;
+    TEST_ASSERT_FALSE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, TEST_DATA_LEN));
+    TEST_ASSERT_FALSE(FlashLog_Append(TEST_SLOTS + 11, buf));
+    flash_read_fail = false;
+    TEST_ASSERT_TRUE(FlashLog_Init(&flash_desc, TEST_START, TEST_SECTORS, TEST_DATA_LEN));
+    TEST_ASSERT_EQUAL(TEST_SLOTS + 10, FlashLog_TestRead(0, NULL, NULL));
+}
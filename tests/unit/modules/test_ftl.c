@@ -0,0 +1,216 @@
+#include <string.h>
+#include <unity.h>
+#include "modules/ftl.c"
+
+#define TEST_BLOCKS  16
+#define TEST_START   8192
+#define TEST_SECTORS ((TEST_BLOCKS - FTL_SPARE_BLOCKS) * SLOTS_PER_BLOCK)
+
+#define FAKE_FLASH_SIZE       (TEST_START + TEST_BLOCKS * BLOCK_SIZE)
+#define FAKE_FLASH_ERASE_SIZE BLOCK_SIZE
+#include "fake_flash.h"
+
+static spiflash_desc_t flash_desc;
+static uint8_t shadow[TEST_SECTORS][FTL_SECTOR_SIZE];
+
+static void Ftl_TestPattern(uint8_t *buf, uint32_t sector, uint32_t version)
+{
+    for (uint16_t i = 0; i < FTL_SECTOR_SIZE; i++) {
+        buf[i] = (uint8_t)(sector * 31 + version * 7 + i);
+    }
+}
+
+static void Ftl_TestVerify(void)
+{
+    uint8_t buf[FTL_SECTOR_SIZE];
+
+    for (uint32_t i = 0; i < TEST_SECTORS; i++) {
+        TEST_ASSERT_TRUE(Ftl_Read(i, buf));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(shadow[i], buf, FTL_SECTOR_SIZE);
+    }
+}
+
+static void Ftl_TestWrite(uint32_t sector, uint32_t version)
+{
+    Ftl_TestPattern(shadow[sector], sector, version);
+    TEST_ASSERT_TRUE(Ftl_Write(sector, shadow[sector]));
+}
+
+void setUp(void)
+{
+    Flash_Reset();
+    memset(shadow, 0xff, sizeof(shadow));
+    TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+}
+
+void tearDown(void) {}
+
+void test_Format(void)
+{
+    uint32_t min, max;
+
+    TEST_ASSERT_EQUAL(TEST_SECTORS, Ftl_GetSectors());
+    Ftl_TestVerify();
+    Ftl_GetWear(&min, &max);
+    TEST_ASSERT_EQUAL(1, min);
+    TEST_ASSERT_EQUAL(1, max);
+
+    /* Region outside is untouched */
+    TEST_ASSERT_EACH_EQUAL_HEX8(0xff, flash_mem, TEST_START);
+    TEST_ASSERT_FALSE(Ftl_Init(&flash_desc, TEST_START, FTL_MAX_BLOCKS + 1));
+}
+
+void test_ReadWrite(void)
+{
+    uint8_t buf[FTL_SECTOR_SIZE];
+
+    Ftl_TestWrite(0, 0);
+    Ftl_TestWrite(5, 0);
+    Ftl_TestWrite(TEST_SECTORS - 1, 0);
+    Ftl_TestWrite(5, 1);
+    Ftl_TestVerify();
+
+    TEST_ASSERT_FALSE(Ftl_Read(TEST_SECTORS, buf));
+    TEST_ASSERT_FALSE(Ftl_Write(TEST_SECTORS, buf));
+}
+
+void test_Remount(void)
+{
+    for (uint32_t i = 0; i < TEST_SECTORS; i += 3) {
+        Ftl_TestWrite(i, 0);
+    }
+    Ftl_TestWrite(3, 1);
+    Ftl_TestWrite(3, 2);
+
+    TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+    Ftl_TestVerify();
+
+    /* Writes continue after remount */
+    Ftl_TestWrite(3, 3);
+    Ftl_TestWrite(4, 3);
+    TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+    Ftl_TestVerify();
+}
+
+void test_ReadFailure(void)
+{
+    uint8_t buf[FTL_SECTOR_SIZE];
+
+    Ftl_TestWrite(2, 0);
+
+    /* Unreadable flash is not formatted again */
+    flash_read_fail = true;
+    TEST_ASSERT_FALSE(Ftl_Read(2, buf));
+    TEST_ASSERT_FALSE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+    TEST_ASSERT_EQUAL(0, Ftl_GetSectors());
+    TEST_ASSERT_FALSE(Ftl_Write(2, buf));
+
+    flash_read_fail = false;
+    TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+    Ftl_TestVerify();
+}
+
+void test_GarbageCollection(void)
+{
+    uint32_t seed = 1;
+
+    for (uint32_t i = 0; i < TEST_SECTORS; i++) {
+        Ftl_TestWrite(i, 0);
+    }
+    /* Several times more data than the flash capacity */
+    for (uint32_t i = 0; i < 3000; i++) {
+        seed = seed * 1103515245 + 12345;
+        Ftl_TestWrite((seed >> 16) % TEST_SECTORS, i);
+    }
+    Ftl_TestVerify();
+
+    TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+    Ftl_TestVerify();
+}
+
+void test_WearLevelling(void)
+{
+    uint32_t min, max;
+
+    /* Static data in most of the sectors, single sector rewritten often */
+    for (uint32_t i = 0; i < TEST_SECTORS; i++) {
+        Ftl_TestWrite(i, 0);
+    }
+    for (uint32_t i = 0; i < 5000; i++) {
+        Ftl_TestWrite(0, i);
+    }
+    Ftl_TestVerify();
+
+    Ftl_GetWear(&min, &max);
+    TEST_ASSERT_LESS_OR_EQUAL(FTL_WEAR_LEVEL_THRESHOLD + 2, max - min);
+}
+
+void test_TornSequence(void)
+{
+    ftl_header_t *header = NULL;
+
+    for (uint32_t i = 0; i < TEST_SECTORS; i += 2) {
+        Ftl_TestWrite(i, 0);
+    }
+
+    /* Opening of a free block interrupted, only part of the sequence programmed */
+    for (uint32_t i = 0; i < TEST_BLOCKS && header == NULL; i++) {
+        if (ftli_blocks[i].seq == SEQ_NONE) {
+            header = (ftl_header_t *)&flash_mem[Ftli_BlockAddr(i)];
+        }
+    }
+    TEST_ASSERT_NOT_NULL(header);
+    header->seq = 0xffff0005UL;
+
+    /* Block is erased again and sequence numbers continue from valid blocks */
+    TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+    TEST_ASSERT_EQUAL_HEX32(SEQ_NONE, header->seq);
+    TEST_ASSERT_EQUAL_HEX32(SEQ_NONE, header->seq_check);
+    TEST_ASSERT_LESS_THAN(0x10000, ftli_state.seq);
+    Ftl_TestVerify();
+
+    for (uint32_t i = 0; i < 200; i++) {
+        Ftl_TestWrite((i * 3) % TEST_SECTORS, i);
+    }
+    TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+    Ftl_TestVerify();
+}
+
+void test_PowerLoss(void)
+{
+    uint8_t old[TEST_SECTORS][FTL_SECTOR_SIZE];
+    uint8_t buf[FTL_SECTOR_SIZE];
+
+    for (uint32_t ops = 1; ops < 150; ops++) {
+        setUp();
+        for (uint32_t i = 0; i < TEST_SECTORS; i++) {
+            Ftl_TestWrite(i, 0);
+        }
+        memcpy(old, shadow, sizeof(old));
+
+        /* Power lost in the middle of writes including garbage collection */
+        flash_ops_left = ops;
+        for (uint32_t i = 0; i < 50 && !flash_dead; i++) {
+            Ftl_TestWrite((i * 5) % TEST_SECTORS, 1);
+        }
+        flash_dead = false;
+        flash_ops_left = 0;
+
+        TEST_ASSERT_TRUE(Ftl_Init(&flash_desc, TEST_START, TEST_BLOCKS));
+        for (uint32_t i = 0; i < TEST_SECTORS; i++) {
+            TEST_ASSERT_TRUE(Ftl_Read(i, buf));
+            if (memcmp(buf, shadow[i], FTL_SECTOR_SIZE) != 0) {
+                TEST_ASSERT_EQUAL_HEX8_ARRAY(old[i], buf, FTL_SECTOR_SIZE);
+            }
+        }
+
+        /* And still usable */
+        for (uint32_t i = 0; i < TEST_SECTORS; i++) {
+            Ftl_Read(i, shadow[i]);
+        }
+        for (uint32_t i = 0; i < 100; i++) {
+            Ftl_TestWrite((i * 7) % TEST_SECTORS, 2);
+        }
+        Ftl_TestVerify();
+    }
+}
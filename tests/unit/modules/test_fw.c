@@ -0,0 +1,424 @@
+#include <string.h>
+#include <unity.h>
+
+#define TEST_PAGE_SIZE 1024
+#define TEST_SLOT_SIZE (8 * TEST_PAGE_SIZE)
+#define TEST_DATA_LEN  6000
+#define TEST_LZSS_BITS 10
+
+#define FW_MAGIC           0x46574931
+#define FW_USE_DUALSLOT
+#define FW_USE_LZSS
+#define FW_USE_RESUME
+#define FW_RESUME_INTERVAL TEST_PAGE_SIZE
+
+#include "utils/crc.c"
+#include "utils/lzss.c"
+#include "modules/kvstore.c"
+#include "modules/fw.c"
+#include "lzss_encoder.h"
+
+#define FAKE_FLASH_INTERNAL
+#define FAKE_FLASH_SIZE       (2 * TEST_SLOT_SIZE + 2 * TEST_PAGE_SIZE)
+#define FAKE_FLASH_ERASE_SIZE TEST_PAGE_SIZE
+#include "fake_flash.h"
+
+#define TEST_STR(x)  #x
+#define TEST_XSTR(x) TEST_STR(x)
+
+/*
+ * Slots are the fake flash areas, placed like by the linker. Addresses are
+ * 32 bit in the module, the test is linked without PIE (see project.yml).
+ */
+__asm__(".globl _fw_runtime_addr\n.set _fw_runtime_addr, flash_mem\n"
+        ".globl _fw_upgrade_addr\n"
+        ".set _fw_upgrade_addr, flash_mem + " TEST_XSTR(TEST_SLOT_SIZE) "\n"
+        ".globl _fw_slot_size\n.set _fw_slot_size, " TEST_XSTR(TEST_SLOT_SIZE) "\n");
+
+#define TEST_RUNTIME (&flash_mem[0])
+#define TEST_UPGRADE (&flash_mem[TEST_SLOT_SIZE])
+#define TEST_KV1     (&flash_mem[2 * TEST_SLOT_SIZE])
+#define TEST_KV2     (&flash_mem[2 * TEST_SLOT_SIZE + TEST_PAGE_SIZE])
+
+/** Image data, header is not included */
+static uint8_t image[TEST_DATA_LEN];
+/** Update image as sent to the device */
+static uint8_t update[FW_HDR_SIZE + TEST_DATA_LEN + TEST_DATA_LEN / 8 + 1];
+static uint32_t update_len;
+
+uint32_t Flashd_GetPageSize(void)
+{
+    return TEST_PAGE_SIZE;
+}
+
+/** Address of the started firmware, 0 if not started */
+static uint32_t run_addr;
+
+void Reloc_RunFwBinary(uint32_t addr)
+{
+    run_addr = addr;
+}
+
+/**
+ * Prepare update image with given header flags
+ */
+static void Fw_TestImage(uint16_t flags)
+{
+    fw_hdr_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = FW_MAGIC;
+    hdr.len = sizeof(image);
+    hdr.crc = CRC16(image, sizeof(image));
+    hdr.flags = flags;
+    hdr.validated = 0xffff;
+    memcpy(update, &hdr, sizeof(hdr));
+
+    if (flags & FW_FLAG_LZSS_BITS) {
+        update_len = FW_HDR_SIZE + Lzss_TestEncode(image, sizeof(image), flags & FW_FLAG_LZSS_BITS,
+            &update[FW_HDR_SIZE]);
+    } else {
+        memcpy(&update[FW_HDR_SIZE], image, sizeof(image));
+        update_len = FW_HDR_SIZE + sizeof(image);
+    }
+}
+
+/**
+ * Store the image directly to the runtime slot
+ *
+ * @param validated     Value of the validated field
+ */
+static void Fw_TestRuntime(uint16_t validated)
+{
+    fw_hdr_t *hdr = (fw_hdr_t *)TEST_RUNTIME;
+
+    Fw_TestImage(0);
+    memcpy(TEST_RUNTIME, update, update_len);
+    hdr->validated = validated;
+}
+
+/**
+ * Run the firmware after reset, check the runtime image was started
+ */
+static void Fw_TestRun(powerd_rst_t reset)
+{
+    run_addr = 0;
+    TEST_ASSERT_TRUE(Fw_Run(reset));
+    TEST_ASSERT_EQUAL_HEX32(FW_RUNTIME_ADDR + FW_HDR_SIZE, run_addr);
+}
+
+/**
+ * Send part of the update image in chunks
+ */
+static void Fw_TestSend(uint32_t from, uint32_t to, uint32_t chunk)
+{
+    while (from < to) {
+        uint32_t len = (to - from) < chunk ? (to - from) : chunk;
+        TEST_ASSERT_TRUE(Fw_Update(&update[from], len));
+        from += len;
+    }
+}
+
+/**
+ * Lose power, RAM content is gone and key-value store is mounted again
+ */
+static void Fw_TestPowerLoss(void)
+{
+    memset(&update_state, 0, sizeof(update_state));
+    memset(update_window, 0, sizeof(update_window));
+    Flashd_WriteDisable();
+    TEST_ASSERT_TRUE(Kv_Init(TEST_KV1, TEST_KV2, TEST_PAGE_SIZE));
+}
+
+/**
+ * Check there is no progress record to resume the update from
+ */
+static void Fw_TestNoProgress(void)
+{
+    uint16_t len;
+
+    TEST_ASSERT_TRUE(Kv_Get(FW_RESUME_KV_KEY, &len) == NULL || len == 0);
+}
+
+/**
+ * Check the upgrade slot contains the complete image
+ */
+static void Fw_TestVerifyUpgrade(void)
+{
+    const fw_hdr_t *hdr = (const fw_hdr_t *)TEST_UPGRADE;
+
+    TEST_ASSERT_TRUE(isImgValid(FW_UPGRADE_ADDR));
+    TEST_ASSERT_EQUAL_HEX16(0, hdr->flags);
+    TEST_ASSERT_EQUAL_HEX16(0xffff, hdr->validated);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(image, &TEST_UPGRADE[FW_HDR_SIZE], sizeof(image));
+    Fw_TestNoProgress();
+}
+
+/**
+ * Interrupt the update after given amount of update data, resume and finish it
+ */
+static void Fw_TestResume(uint32_t cut, uint32_t chunk)
+{
+    const fw_hdr_t *hdr = (const fw_hdr_t *)update;
+    uint32_t offset;
+
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, cut, chunk);
+
+    /* Connection lost only, update continues where it ended */
+    TEST_ASSERT_EQUAL(cut, Fw_UpdateResume());
+
+    Fw_TestPowerLoss();
+    offset = Fw_UpdateResume();
+    TEST_ASSERT_TRUE(Fw_UpdateIsRunning());
+    TEST_ASSERT_LESS_OR_EQUAL(cut, offset);
+    TEST_ASSERT_EQUAL(0, update_state.written % FW_RESUME_INTERVAL);
+    if (hdr->flags == 0) {
+        TEST_ASSERT_EQUAL(cut - (cut % FW_RESUME_INTERVAL), offset);
+    }
+    if (update_state.written != 0) {
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(image, &TEST_UPGRADE[FW_HDR_SIZE],
+            update_state.written - FW_HDR_SIZE);
+    }
+
+    /* Data before the save point are not sent again, they must be kept in flash */
+    Fw_TestSend(offset, update_len, chunk);
+    TEST_ASSERT_TRUE(Fw_UpdateFinish());
+    Fw_TestVerifyUpgrade();
+}
+
+void setUp(void)
+{
+    Flash_Reset();
+    TEST_ASSERT_TRUE(Kv_Init(TEST_KV1, TEST_KV2, TEST_PAGE_SIZE));
+    memset(&update_state, 0, sizeof(update_state));
+
+    /* Compressible data with some noise */
+    for (uint32_t i = 0; i < sizeof(image); i++) {
+        image[i] = (i % 97) * 3 + (i / 1000);
+        if ((i % 53) == 0) {
+            image[i] = (i * 2654435761U) >> 24;
+        }
+    }
+}
+
+void tearDown(void)
+{
+    TEST_ASSERT_FALSE(flash_unlocked);
+}
+
+void test_Update(void)
+{
+    Fw_TestImage(0);
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    TEST_ASSERT_FALSE(Fw_UpdateInit());
+    Fw_TestSend(0, update_len, 333);
+    TEST_ASSERT_TRUE(Fw_UpdateFinish());
+    Fw_TestVerifyUpgrade();
+
+    Fw_TestImage(TEST_LZSS_BITS);
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, update_len, 17);
+    TEST_ASSERT_TRUE(Fw_UpdateFinish());
+    Fw_TestVerifyUpgrade();
+}
+
+void test_Resume(void)
+{
+    Fw_TestImage(0);
+    /* Within header, before and at the first save point, last chunk */
+    Fw_TestResume(100, 333);
+    Fw_TestResume(1000, 333);
+    Fw_TestResume(1024, 256);
+    Fw_TestResume(3333, 333);
+    Fw_TestResume(update_len - 1, 333);
+}
+
+void test_ResumeCompressed(void)
+{
+    Fw_TestImage(TEST_LZSS_BITS);
+    TEST_ASSERT_LESS_THAN(FW_HDR_SIZE + TEST_DATA_LEN / 2, update_len);
+
+    /* Window is restored from flash, back references reach before the save point */
+    for (uint32_t cut = 100; cut < update_len; cut += 97) {
+        Fw_TestResume(cut, 17);
+    }
+}
+
+void test_ResumeNoRecord(void)
+{
+    Fw_TestImage(0);
+
+    /* Nothing saved yet, new update is started */
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, 1000, 100);
+    Fw_TestPowerLoss();
+    TEST_ASSERT_EQUAL(0, Fw_UpdateResume());
+    TEST_ASSERT_TRUE(Fw_UpdateIsRunning());
+    Fw_TestSend(0, update_len, 100);
+    TEST_ASSERT_TRUE(Fw_UpdateFinish());
+    Fw_TestVerifyUpgrade();
+
+    /* Finished update can't be resumed */
+    Fw_TestPowerLoss();
+    TEST_ASSERT_EQUAL(0, Fw_UpdateResume());
+    TEST_ASSERT_FALSE(Fw_UpdateFinish());
+}
+
+void test_WriteAt(void)
+{
+    uint32_t start = 2 * TEST_PAGE_SIZE + 100;
+    uint32_t chunk = 256;
+    uint32_t offset;
+
+    Fw_TestImage(0);
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, start, chunk);
+
+    /* Remaining chunks from the end, the header is written again as well */
+    offset = start + ((update_len - start - 1) / chunk) * chunk;
+    while (offset >= start) {
+        uint32_t len = (update_len - offset) < chunk ? (update_len - offset) : chunk;
+        TEST_ASSERT_TRUE(Fw_UpdateWriteAt(offset, &update[offset], len));
+        offset -= chunk;
+    }
+    TEST_ASSERT_TRUE(Fw_UpdateWriteAt(0, update, FW_HDR_SIZE));
+    TEST_ASSERT_TRUE(update_state.unordered);
+    Fw_TestNoProgress();
+    TEST_ASSERT_TRUE(Fw_UpdateFinish());
+    Fw_TestVerifyUpgrade();
+
+    /* Chunks must be 2 bytes aligned */
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, FW_HDR_SIZE, chunk);
+    TEST_ASSERT_FALSE(Fw_UpdateWriteAt(FW_HDR_SIZE + 1001, &update[FW_HDR_SIZE + 1001], 100));
+    TEST_ASSERT_FALSE(Fw_UpdateFinish());
+}
+
+void test_WriteAtNotResumable(void)
+{
+    Fw_TestImage(0);
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, 2500, 500);
+    TEST_ASSERT_TRUE(Fw_UpdateWriteAt(4000, &update[4000], 500));
+    Fw_TestNoProgress();
+
+    /* Progress saved before was discarded, the update starts again */
+    Fw_TestPowerLoss();
+    TEST_ASSERT_EQUAL(0, Fw_UpdateResume());
+    TEST_ASSERT_FALSE(update_state.unordered);
+    Fw_TestSend(0, update_len, 500);
+    TEST_ASSERT_TRUE(Fw_UpdateFinish());
+    Fw_TestVerifyUpgrade();
+}
+
+void test_WriteAtCompressed(void)
+{
+    /* Compressed data can't be placed */
+    Fw_TestImage(TEST_LZSS_BITS);
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, FW_HDR_SIZE + 64, 32);
+    TEST_ASSERT_FALSE(Fw_UpdateWriteAt(FW_HDR_SIZE + 128, &update[FW_HDR_SIZE + 128], 64));
+    TEST_ASSERT_FALSE(Fw_Update(&update[FW_HDR_SIZE + 64], 64));
+    TEST_ASSERT_FALSE(Fw_UpdateFinish());
+}
+
+void test_RunValidated(void)
+{
+    const fw_hdr_t *runtime = (const fw_hdr_t *)TEST_RUNTIME;
+
+    Fw_TestImage(0);
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, update_len, 512);
+    TEST_ASSERT_TRUE(Fw_UpdateFinish());
+
+    /* Copied from upgrade slot and marked after the full check */
+    Fw_TestRun(POWERD_RST_POR);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(image, &TEST_RUNTIME[FW_HDR_SIZE], sizeof(image));
+    TEST_ASSERT_EQUAL_HEX16(FW_VALIDATED, runtime->validated);
+    TEST_ASSERT_EQUAL_HEX16(0xffff, ((const fw_hdr_t *)TEST_UPGRADE)->validated);
+
+    /* Marked already, the field can't be programmed again */
+    Fw_TestRun(POWERD_RST_POR);
+    TEST_ASSERT_EQUAL_HEX16(FW_VALIDATED, runtime->validated);
+
+    /* Damaged image is not checked after regular reset */
+    TEST_RUNTIME[FW_HDR_SIZE + 100] ^= 0x01;
+    Fw_TestRun(POWERD_RST_NRST);
+
+    /* Full check forced by watchdog reset, image is restored from upgrade slot */
+    Fw_TestRun(POWERD_RST_WDG);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(image, &TEST_RUNTIME[FW_HDR_SIZE], sizeof(image));
+    TEST_ASSERT_EQUAL_HEX16(FW_VALIDATED, runtime->validated);
+}
+
+void test_RunForcedCheck(void)
+{
+    Fw_TestRuntime(FW_VALIDATED);
+    Fw_TestRun(POWERD_RST_WDG);
+    Fw_TestRun(POWERD_RST_LOW_POWER);
+
+    /* No upgrade image to restore the damaged one from */
+    TEST_RUNTIME[FW_HDR_SIZE + sizeof(image) - 1] ^= 0x80;
+    Fw_TestRun(POWERD_RST_POR);
+    run_addr = 0;
+    TEST_ASSERT_FALSE(Fw_Run(POWERD_RST_WDG));
+    TEST_ASSERT_FALSE(Fw_Run(POWERD_RST_LOW_POWER));
+    TEST_ASSERT_EQUAL_HEX32(0, run_addr);
+}
+
+void test_RunLegacy(void)
+{
+    const fw_hdr_t *runtime = (const fw_hdr_t *)TEST_RUNTIME;
+
+    /* Description of legacy image is never overwritten by the marker */
+    Fw_TestRuntime(0x6261);
+    Fw_TestRun(POWERD_RST_POR);
+    TEST_ASSERT_EQUAL_HEX16(0x6261, runtime->validated);
+
+    /* Checked on every boot */
+    TEST_RUNTIME[FW_HDR_SIZE] ^= 0x01;
+    TEST_ASSERT_FALSE(Fw_Run(POWERD_RST_POR));
+
+    /* Not validated image is checked as well */
+    Fw_TestRuntime(0xffff);
+    TEST_RUNTIME[FW_HDR_SIZE] ^= 0x01;
+    TEST_ASSERT_FALSE(Fw_Run(POWERD_RST_POR));
+    TEST_ASSERT_EQUAL_HEX16(0xffff, runtime->validated);
+}
+
+void test_CrcMismatch(void)
+{
+    fw_hdr_t *hdr = (fw_hdr_t *)update;
+    uint32_t chunk = 256;
+
+    /* Streamed crc */
+    Fw_TestImage(0);
+    hdr->crc ^= 0x0100;
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, update_len, chunk);
+    TEST_ASSERT_FALSE(Fw_UpdateFinish());
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, ((const fw_hdr_t *)TEST_UPGRADE)->magic);
+
+    /* Damaged compressed data */
+    Fw_TestImage(TEST_LZSS_BITS);
+    update[update_len - 1] ^= 0x01;
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    Fw_TestSend(0, update_len, chunk);
+    TEST_ASSERT_FALSE(Fw_UpdateFinish());
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, ((const fw_hdr_t *)TEST_UPGRADE)->magic);
+
+    /* Crc read back from flash for data written out of order */
+    Fw_TestImage(0);
+    hdr->crc ^= 0x0100;
+    TEST_ASSERT_TRUE(Fw_UpdateInit());
+    /* From the last chunk down, offset wraps around after the first one */
+    for (uint32_t offset = update_len - (update_len % chunk); offset < update_len;
+         offset -= chunk) {
+        uint32_t len = (update_len - offset) < chunk ? (update_len - offset) : chunk;
+        TEST_ASSERT_TRUE(Fw_UpdateWriteAt(offset, &update[offset], len));
+    }
+    TEST_ASSERT_FALSE(Fw_UpdateFinish());
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, ((const fw_hdr_t *)TEST_UPGRADE)->magic);
+    TEST_ASSERT_FALSE(Fw_Run(POWERD_RST_POR));
+}
@@ -0,0 +1,196 @@
+#include <string.h>
+#include <unity.h>
+#include "utils/crc.c"
+#include "modules/kvstore.c"
+
+#define TEST_PAGE_SIZE 1024
+#define TEST_KEYS      8
+
+#define FAKE_FLASH_INTERNAL
+#define FAKE_FLASH_SIZE       (2 * TEST_PAGE_SIZE)
+#define FAKE_FLASH_ERASE_SIZE TEST_PAGE_SIZE
+#include "fake_flash.h"
+
+#define TEST_PAGE1 (&flash_mem[0])
+#define TEST_PAGE2 (&flash_mem[TEST_PAGE_SIZE])
+
+static uint32_t shadow[TEST_KEYS];
+
+static void Kv_TestWrite(uint16_t key, uint32_t value)
+{
+    shadow[key] = value;
+    TEST_ASSERT_TRUE(Kv_Write(key, &value, sizeof(value)));
+}
+
+static void Kv_TestVerify(void)
+{
+    uint32_t value;
+
+    for (uint16_t i = 0; i < TEST_KEYS; i++) {
+        TEST_ASSERT_EQUAL(sizeof(value), Kv_Read(i, &value, sizeof(value)));
+        TEST_ASSERT_EQUAL_HEX32(shadow[i], value);
+    }
+}
+
+void setUp(void)
+{
+    Flash_Reset();
+    TEST_ASSERT_TRUE(Kv_Init(TEST_PAGE1, TEST_PAGE2, TEST_PAGE_SIZE));
+}
+
+void tearDown(void)
+{
+    TEST_ASSERT_FALSE(flash_unlocked);
+}
+
+void test_Empty(void)
+{
+    uint16_t len;
+    uint8_t buf[4];
+
+    TEST_ASSERT_EQUAL(1, flash_erases);
+    TEST_ASSERT_NULL(Kv_Get(0, &len));
+    TEST_ASSERT_EQUAL(-1, Kv_Read(0, buf, sizeof(buf)));
+    TEST_ASSERT_NULL(Kv_Get(KV_MAX_KEYS, &len));
+
+    /* Already formatted */
+    TEST_ASSERT_TRUE(Kv_Init(TEST_PAGE1, TEST_PAGE2, TEST_PAGE_SIZE));
+    TEST_ASSERT_EQUAL(1, flash_erases);
+}
+
+void test_ReadWrite(void)
+{
+    const char *text = "Hello world";
+    char buf[32];
+    const uint8_t *value;
+    uint16_t len;
+
+    TEST_ASSERT_TRUE(Kv_Write(1, text, strlen(text) + 1));
+    TEST_ASSERT_TRUE(Kv_Write(2, "abc", 3));
+    TEST_ASSERT_TRUE(Kv_Write(3, NULL, 0));
+
+    TEST_ASSERT_EQUAL(strlen(text) + 1, Kv_Read(1, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING(text, buf);
+    value = Kv_Get(2, &len);
+    TEST_ASSERT_EQUAL(3, len);
+    TEST_ASSERT_EQUAL_MEMORY("abc", value, 3);
+    TEST_ASSERT_EQUAL(0, (uintptr_t)value % 4);
+    TEST_ASSERT_NOT_NULL(Kv_Get(3, &len));
+    TEST_ASSERT_EQUAL(0, len);
+
+    /* Truncated read */
+    memset(buf, 0, sizeof(buf));
+    TEST_ASSERT_EQUAL(strlen(text) + 1, Kv_Read(1, buf, 5));
+    TEST_ASSERT_EQUAL_STRING("Hello", buf);
+
+    /* Update */
+    TEST_ASSERT_TRUE(Kv_Write(1, "x", 2));
+    TEST_ASSERT_EQUAL(2, Kv_Read(1, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("x", buf);
+
+    TEST_ASSERT_TRUE(Kv_Init(TEST_PAGE1, TEST_PAGE2, TEST_PAGE_SIZE));
+    TEST_ASSERT_EQUAL(2, Kv_Read(1, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("x", buf);
+    TEST_ASSERT_EQUAL(3, Kv_Read(2, buf, sizeof(buf)));
+
+    TEST_ASSERT_FALSE(Kv_Write(KV_MAX_KEYS, "abc", 3));
+}
+
+void test_Unchanged(void)
+{
+    uint32_t pos;
+
+    Kv_TestWrite(0, 1234);
+    pos = kvi_state.pos;
+    Kv_TestWrite(0, 1234);
+    TEST_ASSERT_EQUAL(pos, kvi_state.pos);
+}
+
+void test_Compaction(void)
+{
+    for (uint16_t i = 0; i < TEST_KEYS; i++) {
+        Kv_TestWrite(i, i);
+    }
+    /* Frequently updated counter */
+    for (uint32_t i = 0; i < 2000; i++) {
+        Kv_TestWrite(i % 3, i);
+    }
+    Kv_TestVerify();
+
+    /* Page erased only when full, 12 B records in 1 kB page */
+    TEST_ASSERT_LESS_OR_EQUAL(2000 * 12 / (TEST_PAGE_SIZE - 8 - TEST_KEYS * 12) + 2, flash_erases);
+
+    TEST_ASSERT_TRUE(Kv_Init(TEST_PAGE1, TEST_PAGE2, TEST_PAGE_SIZE));
+    Kv_TestVerify();
+}
+
+void test_Full(void)
+{
+    static uint8_t big[TEST_PAGE_SIZE / 2];
+    uint8_t buf[TEST_PAGE_SIZE / 2];
+
+    memset(big, 0xa5, sizeof(big));
+    TEST_ASSERT_TRUE(Kv_Write(0, big, 448));
+    TEST_ASSERT_TRUE(Kv_Write(1, big, 400));
+
+    /* Does not fit even after compaction, old value of the key must fit too */
+    big[0] = 0;
+    TEST_ASSERT_FALSE(Kv_Write(0, big, 448));
+    big[0] = 0xa5;
+
+    /* Compaction drops old values */
+    TEST_ASSERT_TRUE(Kv_Write(1, big, 100));
+    TEST_ASSERT_EQUAL(1, flash_erases);
+    TEST_ASSERT_TRUE(Kv_Write(2, big, 64));
+    TEST_ASSERT_EQUAL(2, flash_erases);
+
+    TEST_ASSERT_EQUAL(448, Kv_Read(0, buf, sizeof(buf)));
+    TEST_ASSERT_EACH_EQUAL_HEX8(0xa5, buf, 448);
+    TEST_ASSERT_EQUAL(100, Kv_Read(1, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(64, Kv_Read(2, buf, sizeof(buf)));
+}
+
+void test_PowerLoss(void)
+{
+    uint32_t old[TEST_KEYS];
+    uint32_t value;
+    uint32_t i;
+
+    for (uint32_t ops = 1; ops < 200; ops++) {
+        setUp();
+        for (i = 0; i < TEST_KEYS; i++) {
+            Kv_TestWrite(i, i);
+        }
+        for (i = 0; i < 50; i++) {
+            Kv_TestWrite(i % TEST_KEYS, i * 3);
+        }
+
+        /* Power lost in the middle of writes including compaction */
+        flash_ops_left = ops;
+        for (i = 0; !flash_dead; i++) {
+            memcpy(old, shadow, sizeof(old));
+            value = i * 7 + 1;
+            shadow[i % TEST_KEYS] = value;
+            Kv_Write(i % TEST_KEYS, &value, sizeof(value));
+        }
+        flash_dead = false;
+        flash_ops_left = 0;
+        Flashd_WriteDisable();
+
+        /* Interrupted key holds old or new value, others are unchanged */
+        TEST_ASSERT_TRUE(Kv_Init(TEST_PAGE1, TEST_PAGE2, TEST_PAGE_SIZE));
+        TEST_ASSERT_EQUAL(sizeof(value), Kv_Read((i - 1) % TEST_KEYS, &value, sizeof(value)));
+        if (value != shadow[(i - 1) % TEST_KEYS]) {
+            TEST_ASSERT_EQUAL_HEX32(old[(i - 1) % TEST_KEYS], value);
+            shadow[(i - 1) % TEST_KEYS] = value;
+        }
+        Kv_TestVerify();
+
+        /* And still usable */
+        for (i = 0; i < 200; i++) {
+            Kv_TestWrite(i % TEST_KEYS, i);
+        }
+        TEST_ASSERT_TRUE(Kv_Init(TEST_PAGE1, TEST_PAGE2, TEST_PAGE_SIZE));
+        Kv_TestVerify();
+    }
+}
@@ -29,8 +29,7 @@ void test_PayloadEncrypt(void)
     uint8_t data[] = { 1, 2, 3, 4 };
     uint8_t exp[] = { 0xCF, 0xF3, 0x0B, 0x4E };
 
-    lorai_AppSkey = key;
-    lorai_DevAddr = dev;
+    Lora_SetAbpKeys(dev, NULL, key);
 
     Lorai_PayloadEncrypt(data, sizeof(data), 1, 1);
     TEST_ASSERT_EQUAL_HEX8_ARRAY(exp, data, sizeof(data));
@@ -45,8 +44,7 @@ void test_GetMIC(void)
     uint8_t mic[4];
     uint8_t mic_exp[] = { 0x3B, 0x07, 0x31, 0x82 };
 
-    lorai_NwkSkey = key;
-    lorai_DevAddr = dev;
+    Lora_SetAbpKeys(dev, key, NULL);
 
     Lorai_GetMIC(mic, data, sizeof(data), 1, true);
     TEST_ASSERT_EQUAL_HEX8_ARRAY(mic_exp, mic, 4);
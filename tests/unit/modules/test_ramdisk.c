@@ -2,6 +2,8 @@
 #include <string.h>
 #include <time.h>
 #include <unity.h>
+#define RAMDISK_CACHE_SECTORS 4
+#define RAMDISK_USE_STREAM
 #include "modules/ramdisk.c"
 
 #define RAMDISK_NAME "name"
@@ -17,6 +19,8 @@ Sed sagittis ipsum rhoncus nibh luctus convallis. Vestibulum ante ipsum primis i
 
 static uint8_t data_written[512];
 static uint32_t data_offset;
+static size_t data_size;
+static const ramdisk_write_file_t *data_file;
 
 static void Ramdisk_File1(uint32_t offset, uint8_t *buf, size_t len)
 {
@@ -30,11 +34,52 @@ static void Ramdisk_File2(uint32_t offset, uint8_t *buf, size_t len)
     memset(buf, 'b', len);
 }
 
-static void Ramdisk_WriteTest(const uint8_t *buf, size_t size, uint32_t offset)
+static void Ramdisk_WriteTest(const ramdisk_write_file_t *file, const uint8_t *buf, size_t size,
+    uint32_t offset)
 {
-    TEST_ASSERT_EQUAL(512, size);
+    TEST_ASSERT_LESS_OR_EQUAL(512, size);
     memcpy(data_written, buf, size);
     data_offset = offset;
+    data_size = size;
+    data_file = file;
+}
+
+static uint32_t records_generated;
+
+static size_t Ramdisk_StreamRecord(uint32_t record, char *line)
+{
+    return sprintf(line, "%u,%u\n", (unsigned)record, (unsigned)(record * 7));
+}
+
+static void Ramdisk_Stream(ramdisk_cursor_t *cursor, uint32_t offset, uint8_t *buf, size_t len)
+{
+    char line[32];
+    size_t line_len;
+
+    while (cursor->offset < offset + len) {
+        line_len = Ramdisk_StreamRecord(cursor->record, line);
+        records_generated++;
+        for (size_t i = 0; i < line_len; i++) {
+            if (cursor->offset + i >= offset && cursor->offset + i < offset + len) {
+                buf[cursor->offset + i - offset] = line[i];
+            }
+        }
+        /* Record continues in the next read, resume from its start */
+        if (cursor->offset + line_len > offset + len) {
+            break;
+        }
+        cursor->offset += line_len;
+        cursor->record++;
+    }
+}
+
+static void Ramdisk_SetDirEntry(uint8_t *entry, const char *name, uint16_t cluster, uint32_t size)
+{
+    memset(entry, 0, DIR_ENTRY_SIZE);
+    memcpy(entry, name, 11);
+    entry[0x0b] = 0x20;
+    Ramdiski_To2Bytes(cluster, &entry[0x1a]);
+    Ramdiski_To4Bytes(size, &entry[0x1c]);
 }
 
 void setUp(void)
@@ -43,6 +88,8 @@ void setUp(void)
 
     memset(data_written, 0xab, 512);
     data_offset = (uint32_t)-1;
+    data_size = 0;
+    data_file = NULL;
 
     /* 16 MB ramdisk */
     Ramdisk_Init(0, RAMDISK_NAME);
@@ -181,6 +228,59 @@ void test_GetFile(void)
     TEST_ASSERT_EACH_EQUAL_HEX8('b', buf, SECTOR_SIZE);
 }
 
+void test_ReadPtr(void)
+{
+    uint8_t buf[SECTOR_SIZE];
+    const uint8_t *data;
+    uint32_t text_lba = DATA_START_SECTOR + (ramdiski_files[2].cluster - 2) * SECTORS_PER_CLUSTER;
+    uint32_t last_lba = text_lba + (sizeof(RAMDISK_TEXT) - 1) / SECTOR_SIZE;
+
+    /* Full sector of the text file is served from memory directly */
+    data = Ramdisk_ReadPtr(text_lba + 1, buf);
+    TEST_ASSERT_TRUE(data == (const uint8_t *)&RAMDISK_TEXT[SECTOR_SIZE]);
+
+    /* Last sector is incomplete, must be copied and padded */
+    data = Ramdisk_ReadPtr(last_lba, buf);
+    TEST_ASSERT_TRUE(data == buf);
+    TEST_ASSERT_EQUAL_STRING_LEN(&RAMDISK_TEXT[(last_lba - text_lba) * SECTOR_SIZE], buf,
+        (sizeof(RAMDISK_TEXT) - 1) % SECTOR_SIZE);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0, &buf[(sizeof(RAMDISK_TEXT) - 1) % SECTOR_SIZE],
+        SECTOR_SIZE - (sizeof(RAMDISK_TEXT) - 1) % SECTOR_SIZE);
+
+    /* Generated content */
+    data = Ramdisk_ReadPtr(DATA_START_SECTOR, buf);
+    TEST_ASSERT_TRUE(data == buf);
+    TEST_ASSERT_EACH_EQUAL_HEX8('a', buf, SECTOR_SIZE);
+}
+
+void test_MetadataCache(void)
+{
+    uint8_t buf[SECTOR_SIZE];
+    uint8_t cached[SECTOR_SIZE];
+    uint32_t lba = ROOT_START_SECTOR;
+
+    Ramdisk_Read(lba, buf);
+    Ramdisk_Read(lba, cached);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(buf, cached, SECTOR_SIZE);
+
+    /* Both FAT copies share the same content */
+    Ramdisk_Read(FAT1_START_SECTOR, buf);
+    Ramdisk_Read(FAT2_START_SECTOR, cached);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(buf, cached, SECTOR_SIZE);
+
+    /* Renaming the file must invalidate cached root directory */
+    TEST_ASSERT_TRUE(Ramdisk_RenameFile(0, "new", "bin"));
+    Ramdisk_Read(lba, buf);
+    TEST_ASSERT_EQUAL_STRING_LEN("new     bin", &buf[32], 11);
+
+    /* Clearing the ramdisk as well */
+    Ramdisk_Clear();
+    Ramdisk_Read(lba, buf);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0, &buf[32], SECTOR_SIZE - 32);
+    Ramdisk_Read(FAT1_START_SECTOR, buf);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0, &buf[4], SECTOR_SIZE - 4);
+}
+
 void test_Write(void)
 {
     uint16_t last_cluster = 0;
@@ -195,9 +295,9 @@ void test_Write(void)
             break;
         }
 
-        end_cluster = ramdiski_files[id].cluster + ramdiski_files[id].size / CLUSTER_SIZE;
-        if (end_cluster > last_cluster) {
-            last_cluster = end_cluster;
+        end_cluster = ramdiski_files[id].cluster + Ramdiski_ClusterCount(ramdiski_files[id].size);
+        if (end_cluster - 1 > last_cluster) {
+            last_cluster = end_cluster - 1;
         }
     }
     lba = DATA_START_SECTOR + (last_cluster + 1 - 2) * SECTORS_PER_CLUSTER;
@@ -209,6 +309,8 @@ void test_Write(void)
 
     TEST_ASSERT_EQUAL(0, Ramdisk_Write(lba + 5, buf));
     TEST_ASSERT_EQUAL(5 * 512, data_offset);
+    TEST_ASSERT_EQUAL(512, data_size);
+    TEST_ASSERT_NULL(data_file);
     TEST_ASSERT_EQUAL_HEX8_ARRAY(buf, data_written, 512);
 
     /* Beginning of the user area */
@@ -221,6 +323,253 @@ void test_Write(void)
     TEST_ASSERT_EQUAL_HEX(0xdeadbeef, data_offset);
 }
 
+void test_ClusterAligned(void)
+{
+    uint32_t cluster, lba;
+    uint8_t buf[SECTOR_SIZE];
+
+    Ramdisk_Clear();
+    Ramdisk_Init(0, RAMDISK_NAME);
+    TEST_ASSERT_EQUAL(0, Ramdisk_AddFile("Foo", "bin", 0, 2 * CLUSTER_SIZE, Ramdisk_File1));
+    TEST_ASSERT_EQUAL(1, Ramdisk_AddFile("bar", "bin", 0, 1, Ramdisk_File2));
+    cluster = ramdiski_files[0].cluster;
+    TEST_ASSERT_EQUAL(cluster + 2, ramdiski_files[1].cluster);
+
+    /* Chain of the aligned file ends in its last cluster */
+    Ramdisk_Read(FAT1_START_SECTOR, buf);
+    TEST_ASSERT_EQUAL_HEX16(cluster + 1, buf[cluster * 2] | buf[cluster * 2 + 1] << 8);
+    TEST_ASSERT_EQUAL_HEX16(0xffff, buf[cluster * 2 + 2] | buf[cluster * 2 + 3] << 8);
+    TEST_ASSERT_EQUAL_HEX16(0xffff, buf[cluster * 2 + 4] | buf[cluster * 2 + 5] << 8);
+
+    /* User area starts right after the last file */
+    Ramdisk_RegisterWriteCb(Ramdisk_WriteTest);
+    lba = DATA_START_SECTOR + (cluster + 3 - 2) * SECTORS_PER_CLUSTER;
+    TEST_ASSERT_EQUAL(0, Ramdisk_Write(lba, buf));
+    TEST_ASSERT_EQUAL(0, data_offset);
+    data_offset = 0xdeadbeef;
+    TEST_ASSERT_EQUAL(0, Ramdisk_Write(lba - 1, buf));
+    TEST_ASSERT_EQUAL_HEX(0xdeadbeef, data_offset);
+}
+
+void test_WriteFiles(void)
+{
+    static uint8_t fat[SECTOR_SIZE * 32];
+    uint8_t root[SECTOR_SIZE];
+    uint8_t buf[SECTOR_SIZE];
+    uint32_t free_cluster = Ramdiski_GetFreeCluster();
+    uint32_t data_lba = DATA_START_SECTOR + (free_cluster - 2) * SECTORS_PER_CLUSTER;
+
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(fat) / SECTOR_SIZE, ramdiski_info.fat_sectors);
+    Ramdisk_RegisterWriteCb(Ramdisk_WriteTest);
+    memset(buf, 0x5a, sizeof(buf));
+
+    /* fragmented file A in clusters 0, 1, 4 and file B in 2, 3 (relative to free cluster) */
+    for (uint16_t i = 0; i < ramdiski_info.fat_sectors; i++) {
+        Ramdisk_Read(FAT1_START_SECTOR + i, &fat[i * SECTOR_SIZE]);
+    }
+    Ramdiski_To2Bytes(free_cluster + 1, &fat[free_cluster * 2]);
+    Ramdiski_To2Bytes(free_cluster + 4, &fat[(free_cluster + 1) * 2]);
+    Ramdiski_To2Bytes(free_cluster + 3, &fat[(free_cluster + 2) * 2]);
+    Ramdiski_To2Bytes(0xffff, &fat[(free_cluster + 3) * 2]);
+    Ramdiski_To2Bytes(0xffff, &fat[(free_cluster + 4) * 2]);
+
+    Ramdisk_Read(ROOT_START_SECTOR, root);
+    Ramdisk_SetDirEntry(&root[4 * DIR_ENTRY_SIZE], "FW      BIN", free_cluster,
+        3 * CLUSTER_SIZE - 100);
+    Ramdisk_SetDirEntry(&root[5 * DIR_ENTRY_SIZE], "LOG     TXT", free_cluster + 2,
+        CLUSTER_SIZE + 10);
+    /* Deleted entry */
+    Ramdisk_SetDirEntry(&root[6 * DIR_ENTRY_SIZE], "\xe5OLD    TXT", free_cluster + 5, 10);
+
+    /* Data written before the metadata can't be assigned to a file */
+    Ramdisk_Write(data_lba + SECTORS_PER_CLUSTER, buf);
+    TEST_ASSERT_NULL(data_file);
+    TEST_ASSERT_EQUAL(CLUSTER_SIZE, data_offset);
+
+    Ramdisk_Write(ROOT_START_SECTOR, root);
+    for (uint16_t i = 0; i < ramdiski_info.fat_sectors; i++) {
+        Ramdisk_Write(FAT1_START_SECTOR + i, &fat[i * SECTOR_SIZE]);
+    }
+
+    /* Last sector of file A, only used part is passed */
+    Ramdisk_Write(data_lba + 5 * SECTORS_PER_CLUSTER - 1, buf);
+    TEST_ASSERT_NOT_NULL(data_file);
+    TEST_ASSERT_EQUAL_STRING("FW", data_file->name);
+    TEST_ASSERT_EQUAL_STRING("BIN", data_file->extension);
+    TEST_ASSERT_EQUAL(3 * CLUSTER_SIZE - SECTOR_SIZE, data_offset);
+    TEST_ASSERT_EQUAL(SECTOR_SIZE - 100, data_size);
+
+    /* File B */
+    Ramdisk_Write(data_lba + 3 * SECTORS_PER_CLUSTER, buf);
+    TEST_ASSERT_NOT_NULL(data_file);
+    TEST_ASSERT_EQUAL_STRING("LOG", data_file->name);
+    TEST_ASSERT_EQUAL_STRING("TXT", data_file->extension);
+    TEST_ASSERT_EQUAL(CLUSTER_SIZE, data_offset);
+    TEST_ASSERT_EQUAL(10, data_size);
+
+    /* Slack space after end of file is not passed */
+    data_file = NULL;
+    Ramdisk_Write(data_lba + 3 * SECTORS_PER_CLUSTER + 1, buf);
+    TEST_ASSERT_NULL(data_file);
+
+    /* Second cluster of the file A */
+    Ramdisk_Write(data_lba + SECTORS_PER_CLUSTER + 2, buf);
+    TEST_ASSERT_EQUAL_STRING("FW", data_file->name);
+    TEST_ASSERT_EQUAL(CLUSTER_SIZE + 2 * SECTOR_SIZE, data_offset);
+    TEST_ASSERT_EQUAL(SECTOR_SIZE, data_size);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(buf, data_written, SECTOR_SIZE);
+
+    /* File B deleted */
+    memset(&root[5 * DIR_ENTRY_SIZE], 0xe5, 1);
+    Ramdisk_Write(ROOT_START_SECTOR, root);
+    data_file = NULL;
+    Ramdisk_Write(data_lba + 2 * SECTORS_PER_CLUSTER, buf);
+    TEST_ASSERT_NULL(data_file);
+    TEST_ASSERT_EQUAL(2 * CLUSTER_SIZE, data_offset);
+}
+
+void test_Extents(void)
+{
+    Ramdisk_Clear();
+
+    /* Chain 100 -> 101 -> 102 -> 200 -> 201 -> end, added out of order */
+    TEST_ASSERT_TRUE(Ramdiski_ExtentsAdd(102, 200));
+    TEST_ASSERT_TRUE(Ramdiski_ExtentsAdd(100, 101));
+    TEST_ASSERT_TRUE(Ramdiski_ExtentsAdd(201, FAT_CHAIN_END));
+    TEST_ASSERT_TRUE(Ramdiski_ExtentsAdd(101, 102));
+    TEST_ASSERT_TRUE(Ramdiski_ExtentsAdd(200, 201));
+
+    TEST_ASSERT_EQUAL(100, Ramdiski_ExtentFind(101)->start);
+    TEST_ASSERT_EQUAL(3, Ramdiski_ExtentFind(101)->count);
+    TEST_ASSERT_EQUAL(200, Ramdiski_ExtentFind(102)->next);
+    TEST_ASSERT_EQUAL(2, Ramdiski_ExtentFind(200)->count);
+
+    /* Split the run */
+    Ramdiski_ExtentsRemove(101, 102);
+    TEST_ASSERT_EQUAL(1, Ramdiski_ExtentFind(100)->count);
+    TEST_ASSERT_EQUAL(101, Ramdiski_ExtentFind(100)->next);
+    TEST_ASSERT_NULL(Ramdiski_ExtentFind(101));
+    TEST_ASSERT_EQUAL(102, Ramdiski_ExtentFind(102)->start);
+
+    /* And join it again */
+    TEST_ASSERT_TRUE(Ramdiski_ExtentsAdd(101, 102));
+    TEST_ASSERT_EQUAL(3, Ramdiski_ExtentFind(102)->count);
+}
+
+void test_StreamFile(void)
+{
+    static char content[40000];
+    uint8_t buf[SECTOR_SIZE];
+    size_t size = 0;
+    uint32_t records;
+    uint32_t lba;
+    int id;
+
+    for (records = 0; size < sizeof(content) - 32; records++) {
+        size += Ramdisk_StreamRecord(records, &content[size]);
+    }
+    id = Ramdisk_AddStreamFile("log", "csv", 0, size, Ramdisk_Stream);
+    TEST_ASSERT_GREATER_THAN(-1, id);
+    lba = DATA_START_SECTOR + (ramdiski_files[id].cluster - 2) * SECTORS_PER_CLUSTER;
+
+    /* Random access near the end, has to start from the beginning */
+    records_generated = 0;
+    Ramdisk_Read(lba + 70, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&content[70 * SECTOR_SIZE], buf, SECTOR_SIZE);
+    TEST_ASSERT_GREATER_THAN(records / 2, records_generated);
+
+    /* Sequential read continues from the last position */
+    for (uint32_t i = 0; i < ceil_div(size, SECTOR_SIZE); i++) {
+        records_generated = 0;
+        Ramdisk_Read(lba + i, buf);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(&content[i * SECTOR_SIZE], buf,
+            size - i * SECTOR_SIZE < SECTOR_SIZE ? size - i * SECTOR_SIZE : SECTOR_SIZE);
+        TEST_ASSERT_LESS_THAN(SECTOR_SIZE / 4, records_generated);
+    }
+
+    /* Checkpoints limit the work done for random access */
+    records_generated = 0;
+    Ramdisk_Read(lba + 40, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&content[40 * SECTOR_SIZE], buf, SECTOR_SIZE);
+    TEST_ASSERT_LESS_THAN(records / RAMDISK_STREAM_CHECKPOINTS + SECTOR_SIZE / 4,
+        records_generated);
+    records_generated = 0;
+    Ramdisk_Read(lba + 3, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&content[3 * SECTOR_SIZE], buf, SECTOR_SIZE);
+    TEST_ASSERT_LESS_THAN(records / RAMDISK_STREAM_CHECKPOINTS + SECTOR_SIZE / 4,
+        records_generated);
+}
+
+void test_Fat32(void)
+{
+    uint8_t buf[SECTOR_SIZE];
+    uint32_t free_cluster;
+
+    Ramdisk_Clear();
+    /* 1 GB */
+    Ramdisk_Init(1000000000ULL, RAMDISK_NAME);
+    TEST_ASSERT_TRUE(ramdiski_info.fat32);
+    TEST_ASSERT_GREATER_OR_EQUAL(FAT32_MIN_CLUSTERS, ramdiski_info.clusters);
+    TEST_ASSERT_GREATER_OR_EQUAL(ramdiski_info.clusters + 2, ramdiski_info.fat_sectors * 128);
+    TEST_ASSERT_GREATER_THAN(-1, Ramdisk_AddTextFile("lorem", "txt", 0, RAMDISK_TEXT));
+    TEST_ASSERT_GREATER_THAN(-1, Ramdisk_AddFile("big", "bin", 0, 300000000, Ramdisk_File1));
+
+    Ramdisk_Read(0, buf);
+    /* Reserved sectors */
+    TEST_ASSERT_EQUAL(FAT32_RESERVED_SECTORS, buf[0x0e] | buf[0x0f] << 8);
+    /* Root entries, small number of sectors and FAT16 table size not used */
+    TEST_ASSERT_EQUAL(0, buf[0x11] | buf[0x12] << 8);
+    TEST_ASSERT_EQUAL(0, buf[0x13] | buf[0x14] << 8);
+    TEST_ASSERT_EQUAL(0, buf[0x16] | buf[0x17] << 8);
+    TEST_ASSERT_EQUAL(ramdiski_info.sectors_count, Ramdiski_From4Bytes(&buf[0x20]));
+    TEST_ASSERT_EQUAL(ramdiski_info.fat_sectors, Ramdiski_From4Bytes(&buf[0x24]));
+    /* Root directory cluster */
+    TEST_ASSERT_EQUAL(2, Ramdiski_From4Bytes(&buf[0x2c]));
+    TEST_ASSERT_EQUAL_STRING_LEN(RAMDISK_NAME "       ", &buf[0x47], 11);
+    TEST_ASSERT_EQUAL_STRING_LEN("FAT32   ", &buf[0x52], 8);
+    TEST_ASSERT_EQUAL_HEX8(0x55, buf[0x1fe]);
+    TEST_ASSERT_EQUAL_HEX8(0xaa, buf[0x1ff]);
+
+    /* FS info sector */
+    Ramdisk_Read(FAT32_FSINFO_SECTOR, buf);
+    TEST_ASSERT_EQUAL_HEX32(0x41615252, Ramdiski_From4Bytes(&buf[0]));
+    TEST_ASSERT_EQUAL_HEX32(0x61417272, Ramdiski_From4Bytes(&buf[484]));
+    TEST_ASSERT_EQUAL_HEX32(0xaa550000, Ramdiski_From4Bytes(&buf[508]));
+
+    /* FAT starts with root directory chain, followed by files */
+    Ramdisk_Read(FAT1_START_SECTOR, buf);
+    TEST_ASSERT_EQUAL_HEX32(0x0ffffff8, Ramdiski_From4Bytes(&buf[0]));
+    TEST_ASSERT_EQUAL_HEX32(0x0fffffff, Ramdiski_From4Bytes(&buf[4]));
+    TEST_ASSERT_EQUAL(3, Ramdiski_From4Bytes(&buf[2 * 4]));
+    TEST_ASSERT_EQUAL_HEX32(0x0fffffff, Ramdiski_From4Bytes(&buf[(FILES_START_CLUSTER - 1) * 4]));
+    TEST_ASSERT_EQUAL(FILES_START_CLUSTER, ramdiski_files[0].cluster);
+    TEST_ASSERT_EQUAL_HEX32(0x0fffffff, Ramdiski_From4Bytes(&buf[FILES_START_CLUSTER * 4]));
+    TEST_ASSERT_EQUAL(ramdiski_files[1].cluster + 1,
+        Ramdiski_From4Bytes(&buf[ramdiski_files[1].cluster * 4]));
+
+    /* Root directory in data area, second file over 65535 clusters */
+    Ramdisk_Read(ROOT_START_SECTOR, buf);
+    TEST_ASSERT_EQUAL_STRING_LEN(RAMDISK_NAME "       ", &buf[0], 11);
+    TEST_ASSERT_EQUAL_STRING_LEN("lorem   txt", &buf[32], 11);
+    TEST_ASSERT_EQUAL_STRING_LEN("big     bin", &buf[64], 11);
+    TEST_ASSERT_EQUAL(ramdiski_files[1].cluster,
+        Ramdiski_From2Bytes(&buf[64 + 0x1a]) | Ramdiski_From2Bytes(&buf[64 + 0x14]) << 16);
+
+    /* File content */
+    Ramdisk_Read(DATA_START_SECTOR + (FILES_START_CLUSTER - 2) * SECTORS_PER_CLUSTER, buf);
+    TEST_ASSERT_EQUAL_STRING_LEN(RAMDISK_TEXT, buf, SECTOR_SIZE);
+    Ramdisk_Read(DATA_START_SECTOR + (ramdiski_files[1].cluster - 2) * SECTORS_PER_CLUSTER, buf);
+    TEST_ASSERT_EACH_EQUAL_HEX8('a', buf, SECTOR_SIZE);
+
+    /* Host written file chain */
+    free_cluster = Ramdiski_GetFreeCluster();
+    memset(buf, 0, sizeof(buf));
+    Ramdiski_To4Bytes(0x0fffffff, &buf[(free_cluster % 128) * 4]);
+    Ramdisk_Write(FAT1_START_SECTOR + free_cluster / 128, buf);
+    TEST_ASSERT_NOT_NULL(Ramdiski_ExtentFind(free_cluster));
+    TEST_ASSERT_EQUAL(FAT_CHAIN_END, Ramdiski_ExtentFind(free_cluster)->next);
+}
+
 /*
  * Generate example ramdisk for optional checking with external tool
  */
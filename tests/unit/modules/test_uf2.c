@@ -1,5 +1,6 @@
 #include <unity.h>
 #include <string.h>
+#include "utils/crc.c"
 #include "modules/uf2.c"
 
 struct {
@@ -7,19 +8,24 @@ struct {
     uint8_t data[2048];
     uint32_t last_len;
     uint32_t len;
+    uint32_t writes;
+    uint32_t finished;
 } test_fw;
 
-bool Fw_Update(const uint8_t *buf, uint32_t len)
+bool Fw_UpdateWriteAt(uint32_t offset, const uint8_t *buf, uint32_t len)
 {
     if (!test_fw.running) {
         return false;
     }
-    if (test_fw.len + len > sizeof(test_fw.data)) {
+    if (offset + len > sizeof(test_fw.data)) {
         return false;
     }
-    memcpy(&test_fw.data[test_fw.len], buf, len);
+    memcpy(&test_fw.data[offset], buf, len);
     test_fw.last_len = len;
-    test_fw.len += len;
+    if (offset + len > test_fw.len) {
+        test_fw.len = offset + len;
+    }
+    test_fw.writes++;
     return true;
 }
 
@@ -37,6 +43,7 @@ bool Fw_UpdateInit(void)
 
 bool Fw_UpdateFinish(void)
 {
+    test_fw.finished++;
     test_fw.running = false;
     return true;
 }
@@ -87,6 +94,103 @@ void test_Write(void)
     TEST_ASSERT_EQUAL_HEX8_ARRAY(block.data, &test_fw.data[UF2_CHUNK_SIZE], 64);
 }
 
+/**
+ * Prepare block of the image, data are derived from the offset
+ */
+static void UF2_TestBlock(UF2_block_t *block, uint32_t blockNo, uint32_t numBlocks)
+{
+    block->magicStart0 = UF2_MAGIC_1;
+    block->magicStart1 = UF2_MAGIC_2;
+    block->magicEnd = UF2_MAGIC_FINAL;
+    block->flags = 0;
+    block->blockNo = blockNo;
+    block->numBlocks = numBlocks;
+    block->fileSize = numBlocks * UF2_CHUNK_SIZE;
+    block->targetAddr = blockNo * UF2_CHUNK_SIZE;
+    block->payloadSize = UF2_CHUNK_SIZE;
+    for (unsigned i = 0; i < UF2_CHUNK_SIZE; i++) {
+        block->data[i] = (uint8_t)(block->targetAddr / 7 + i);
+    }
+}
+
+void test_WriteOutOfOrder(void)
+{
+    const uint32_t order[] = { 3, 1, 1, 0, 3, 2, 0 };
+    uint8_t expected[4 * UF2_CHUNK_SIZE];
+    UF2_block_t block;
+
+    memset(&test_fw, 0, sizeof(test_fw));
+    for (unsigned i = 0; i < 4; i++) {
+        UF2_TestBlock(&block, i, 4);
+        memcpy(&expected[i * UF2_CHUNK_SIZE], block.data, UF2_CHUNK_SIZE);
+    }
+
+    /* Repeated blocks are written once, finished when all blocks are received */
+    for (unsigned i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        UF2_TestBlock(&block, order[i], 4);
+        TEST_ASSERT_TRUE(UF2_Write((uint8_t *)&block));
+        TEST_ASSERT_EQUAL(i == 5 || i == 6 ? 1 : 0, test_fw.finished);
+    }
+    TEST_ASSERT_FALSE(test_fw.running);
+    TEST_ASSERT_EQUAL(4, test_fw.writes);
+    TEST_ASSERT_EQUAL(sizeof(expected), test_fw.len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, test_fw.data, sizeof(expected));
+}
+
+void test_WriteSameSizeImages(void)
+{
+    UF2_block_t block;
+
+    memset(&test_fw, 0, sizeof(test_fw));
+    for (unsigned i = 0; i < 2; i++) {
+        UF2_TestBlock(&block, i, 2);
+        TEST_ASSERT_TRUE(UF2_Write((uint8_t *)&block));
+    }
+    TEST_ASSERT_EQUAL(1, test_fw.finished);
+
+    /* Blocks repeated after the image was written are ignored */
+    for (unsigned i = 0; i < 2; i++) {
+        UF2_TestBlock(&block, i, 2);
+        TEST_ASSERT_TRUE(UF2_Write((uint8_t *)&block));
+    }
+    TEST_ASSERT_FALSE(test_fw.running);
+    TEST_ASSERT_EQUAL(2, test_fw.writes);
+
+    /* Image of the same size with other content is written */
+    for (unsigned i = 0; i < 2; i++) {
+        UF2_TestBlock(&block, i, 2);
+        block.data[0] ^= 0xff;
+        TEST_ASSERT_TRUE(UF2_Write((uint8_t *)&block));
+        TEST_ASSERT_EQUAL_HEX8(block.data[0], test_fw.data[i * UF2_CHUNK_SIZE]);
+    }
+    TEST_ASSERT_FALSE(test_fw.running);
+    TEST_ASSERT_EQUAL(4, test_fw.writes);
+    TEST_ASSERT_EQUAL(2, test_fw.finished);
+}
+
+void test_WriteMixedImages(void)
+{
+    UF2_block_t block;
+
+    memset(&test_fw, 0, sizeof(test_fw));
+    UF2_TestBlock(&block, 2, 3);
+    TEST_ASSERT_TRUE(UF2_Write((uint8_t *)&block));
+    TEST_ASSERT_TRUE(test_fw.running);
+
+    /* Block of other image aborts the update */
+    UF2_TestBlock(&block, 0, 4);
+    TEST_ASSERT_FALSE(UF2_Write((uint8_t *)&block));
+    TEST_ASSERT_FALSE(test_fw.running);
+    TEST_ASSERT_EQUAL(1, test_fw.finished);
+
+    /* Invalid block numbers */
+    UF2_TestBlock(&block, 4, 4);
+    TEST_ASSERT_FALSE(UF2_Write((uint8_t *)&block));
+    UF2_TestBlock(&block, 0, UF2_MAX_BLOCKS + 1);
+    TEST_ASSERT_FALSE(UF2_Write((uint8_t *)&block));
+    TEST_ASSERT_FALSE(test_fw.running);
+}
+
 void test_Read(void)
 {
     UF2_block_t block;
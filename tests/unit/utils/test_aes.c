@@ -513,3 +513,59 @@ void test_AES128_CMAC(void)
     AES128_CMAC(data2, sizeof(data2), key, tag);
     TEST_ASSERT_EQUAL_HEX8_ARRAY(expected[2], tag, 16);
 }
+
+void test_AES128_EncryptCtx(void)
+{
+    uint8_t key[] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09,
+        0xcf, 0x4f, 0x3c };
+    /* input followed by expected output, from
+     * https://nvlpubs.nist.gov/nistpubs/Legacy/SP/nistspecialpublication800-38a.pdf */
+    uint8_t vector[][16] = {
+        { 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17,
+         0x2a },
+        { 0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef,
+         0x97 },
+        { 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e,
+         0x51 },
+        { 0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba,
+         0xaf },
+    };
+    uint8_t data[16], expected[16];
+    aes128_ctx_t ctx;
+
+    AES128_Init(&ctx, key);
+    for (uint8_t i = 0; i < sizeof(vector) / sizeof(vector[0]); i += 2) {
+        AES128_EncryptCtx(vector[i], &ctx);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(vector[i + 1], vector[i], 16);
+    }
+
+    /* Same results as the key schedule computed on the fly */
+    for (uint8_t i = 0; i < 16; i++) {
+        for (uint8_t j = 0; j < 16; j++) {
+            key[j] = i * 37 + j * 11;
+            data[j] = i * 13 + j * 101;
+        }
+        memcpy(expected, data, 16);
+        AES128_Encrypt(expected, key);
+        AES128_Init(&ctx, key);
+        AES128_EncryptCtx(data, &ctx);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data, 16);
+    }
+}
+
+void test_AES128_CMACGetKeysCtx(void)
+{
+    uint8_t key[] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09,
+        0xcf, 0x4f, 0x3c };
+    uint8_t exp1[] = { 0xfb, 0xee, 0xd6, 0x18, 0x35, 0x71, 0x33, 0x66, 0x7c, 0x85, 0xe0, 0x8f, 0x72,
+        0x36, 0xa8, 0xde };
+    uint8_t exp2[] = { 0xf7, 0xdd, 0xac, 0x30, 0x6a, 0xe2, 0x66, 0xcc, 0xf9, 0x0b, 0xc1, 0x1e, 0xe4,
+        0x6d, 0x51, 0x3b };
+    uint8_t k1[16], k2[16];
+    aes128_ctx_t ctx;
+
+    AES128_Init(&ctx, key);
+    AES128_CMACGetKeysCtx(k1, k2, &ctx);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(exp1, k1, 16);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(exp2, k2, 16);
+}
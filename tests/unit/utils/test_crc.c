@@ -24,3 +24,53 @@ void test_CRC8(void)
     uint8_t buf[] = { 0xbe, 0xef };
     TEST_ASSERT_EQUAL_HEX8(0x92, CRC8(buf, sizeof(buf)));
 }
+
+void test_CRC16_Update(void)
+{
+    uint8_t buf[] = { 0xab, 0xcd, 0xef, 0x12 };
+    uint16_t crc = CRC16_Update(CRC16_INITIAL_VALUE, buf, 1);
+
+    TEST_ASSERT_EQUAL_HEX16(0xe571, crc);
+    TEST_ASSERT_EQUAL_HEX16(0x26f0, CRC16_Update(crc, &buf[1], sizeof(buf) - 1));
+    TEST_ASSERT_EQUAL_HEX16(crc, CRC16_Update(crc, NULL, 0));
+}
+
+void test_CRC32_Add(void)
+{
+    TEST_ASSERT_EQUAL_HEX32(0x83dcefb7, CRC32_Add('1', CRC32_INITIAL_VALUE));
+    TEST_ASSERT_EQUAL_HEX32(0x4f5344cd, CRC32_Add('2', 0x83dcefb7));
+}
+
+void test_CRC32(void)
+{
+    const uint8_t buf[] = "123456789";
+    uint32_t crc = CRC32_INITIAL_VALUE;
+
+    TEST_ASSERT_EQUAL_HEX32(0xcbf43926, CRC32(buf, 9));
+    TEST_ASSERT_EQUAL_HEX32(0x00000000, CRC32(buf, 0));
+
+    for (uint8_t i = 0; i < 9; i += 3) {
+        crc = CRC32_Update(crc, &buf[i], 3);
+    }
+    TEST_ASSERT_EQUAL_HEX32(0xcbf43926, crc);
+}
+
+void test_CRC16_UpdateBulk(void)
+{
+    uint8_t buf[300];
+    uint16_t expected;
+
+    for (uint32_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = i * 7919 >> 3;
+    }
+    /* Sliced processing of all alignments and lengths around the threshold */
+    for (uint32_t offset = 0; offset < 8; offset++) {
+        for (uint32_t len = 0; len < sizeof(buf) - offset; len += (len < 40 ? 1 : 37)) {
+            expected = CRC16_INITIAL_VALUE;
+            for (uint32_t i = 0; i < len; i++) {
+                expected = CRC16_Add(buf[offset + i], expected);
+            }
+            TEST_ASSERT_EQUAL_HEX16(expected, CRC16(&buf[offset], len));
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#include <unity.h>
+#include <string.h>
+#include "utils/crc.c"
+#include "utils/delta.c"
+#include "utils/lzss.c"
+#include "delta_fixture.h"
+
+/* Layout of the fw image header, see modules/fw.c */
+#define TEST_HDR_SIZE       128
+#define TEST_HDR_LEN        4
+#define TEST_HDR_CRC        8
+#define TEST_HDR_FLAGS      124
+#define TEST_FLAG_LZSS_BITS 0x000fU
+#define TEST_FLAG_DELTA     0x0010U
+
+static delta_t delta;
+static lzss_t lz;
+
+/**
+ * Apply patch fed in chunks into output buffer of given size
+ */
+static uint32_t Delta_TestPatch(const uint8_t *in, uint32_t len, uint32_t chunk, uint32_t out_size,
+                                uint8_t *dest)
+{
+    uint8_t out[64];
+    uint32_t total = 0;
+
+    while (len != 0) {
+        uint32_t part = len < chunk ? len : chunk;
+        uint32_t n;
+
+        len -= part;
+        do {
+            n = Delta_Decode(&delta, &in, &part, out, out_size);
+            memcpy(&dest[total], out, n);
+            total += n;
+        } while (n != 0);
+        if (part != 0) {
+            break;
+        }
+    }
+    return total;
+}
+
+/**
+ * Check header of the update image and decompress the patch
+ *
+ * @return Length of the patch
+ */
+static uint32_t Delta_TestUnpack(const uint8_t *img, uint32_t img_len, uint8_t *patch,
+                                 uint32_t size)
+{
+    static uint8_t window[1 << LZSS_MAX_BITS];
+    const uint8_t *in = &img[TEST_HDR_SIZE];
+    uint32_t len = img_len - TEST_HDR_SIZE;
+    uint16_t flags;
+    uint32_t total;
+
+    memcpy(&flags, &img[TEST_HDR_FLAGS], sizeof(flags));
+    TEST_ASSERT_TRUE(flags & TEST_FLAG_DELTA);
+    TEST_ASSERT_TRUE(Lzss_Init(&lz, window, flags & TEST_FLAG_LZSS_BITS));
+    total = Lzss_Decode(&lz, &in, &len, patch, size);
+    TEST_ASSERT_EQUAL(0, len);
+    TEST_ASSERT_TRUE(Lzss_IsComplete(&lz));
+    return total;
+}
+
+/**
+ * Apply update image generated by tools/fw.py, fed in various chunks
+ */
+static void Delta_TestUpdate(const uint8_t *img, uint32_t img_len, const uint8_t *old,
+                             uint32_t old_len, const uint8_t *new, uint32_t new_len)
+{
+    static uint8_t patch[4096], result[4096];
+    const uint32_t chunks[] = { 1, 5, 476, sizeof(patch) };
+    const uint32_t outs[] = { 1, 64 };
+    uint32_t size = Delta_TestUnpack(img, img_len, patch, sizeof(patch));
+    uint32_t hdr_len;
+    uint16_t hdr_crc;
+
+    memcpy(&hdr_len, &img[TEST_HDR_LEN], sizeof(hdr_len));
+    memcpy(&hdr_crc, &img[TEST_HDR_CRC], sizeof(hdr_crc));
+    TEST_ASSERT_EQUAL(new_len, hdr_len);
+    /* Compressed patch is much smaller than the image */
+    TEST_ASSERT_LESS_THAN(new_len / 2, img_len - TEST_HDR_SIZE);
+
+    for (uint32_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        for (uint32_t o = 0; o < sizeof(outs) / sizeof(outs[0]); o++) {
+            memset(result, 0, sizeof(result));
+            Delta_Init(&delta, old, old_len, CRC16(old, old_len));
+            TEST_ASSERT_EQUAL(new_len, Delta_TestPatch(patch, size, chunks[c], outs[o], result));
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(new, result, new_len);
+            TEST_ASSERT_EQUAL_HEX16(hdr_crc, CRC16(result, new_len));
+            TEST_ASSERT_TRUE(Delta_IsComplete(&delta));
+        }
+    }
+
+    /* Patch can't be applied to other image */
+    Delta_Init(&delta, new, new_len, CRC16(new, new_len));
+    TEST_ASSERT_EQUAL(0, Delta_TestPatch(patch, size, sizeof(patch), 64, result));
+    TEST_ASSERT_FALSE(Delta_IsComplete(&delta));
+}
+
+void test_Decode(void)
+{
+    const uint8_t old[] = { 10, 20, 30, 40, 50 };
+    /* Base, diff 2 (+1, +2), extra "ab", seek +1, diff 2 (0, 0), no extra, no seek */
+    uint8_t patch[] = { 0, 0, 5, 0, 0, 0, 2, 1, 2, 2, 'a', 'b', 2, 2, 0, 0, 0, 0 };
+    const uint8_t expected[] = { 11, 22, 'a', 'b', 40, 50 };
+    const uint8_t *in = patch;
+    uint32_t len = sizeof(patch);
+    uint8_t out[16];
+    uint16_t crc = CRC16(old, sizeof(old));
+
+    memcpy(patch, &crc, sizeof(crc));
+    Delta_Init(&delta, old, sizeof(old), crc);
+    TEST_ASSERT_EQUAL(sizeof(expected), Delta_Decode(&delta, &in, &len, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+    TEST_ASSERT_TRUE(Delta_IsComplete(&delta));
+
+    /* Truncated */
+    Delta_Init(&delta, old, sizeof(old), crc);
+    in = patch;
+    len = sizeof(patch) - 3;
+    TEST_ASSERT_EQUAL(5, Delta_Decode(&delta, &in, &len, out, sizeof(out)));
+    TEST_ASSERT_FALSE(Delta_IsComplete(&delta));
+
+    /* Other base */
+    Delta_Init(&delta, old, sizeof(old), crc + 1);
+    in = patch;
+    len = sizeof(patch);
+    TEST_ASSERT_EQUAL(0, Delta_Decode(&delta, &in, &len, out, sizeof(out)));
+    TEST_ASSERT_FALSE(Delta_IsComplete(&delta));
+    Delta_Init(&delta, old, sizeof(old) - 1, crc);
+    in = patch;
+    len = sizeof(patch);
+    TEST_ASSERT_EQUAL(0, Delta_Decode(&delta, &in, &len, out, sizeof(out)));
+    TEST_ASSERT_FALSE(Delta_IsComplete(&delta));
+}
+
+void test_OutOfBounds(void)
+{
+    const uint8_t old[] = { 10, 20, 30, 40, 50 };
+    /* Diff longer than old data */
+    uint8_t patch[] = { 0, 0, 5, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0 };
+    /* Seek before start */
+    uint8_t seek[] = { 0, 0, 5, 0, 0, 0, 0, 0, 1, 1, 0 };
+    const uint8_t *in = patch;
+    uint32_t len = sizeof(patch);
+    uint8_t out[16];
+    uint16_t crc = CRC16(old, sizeof(old));
+
+    memcpy(patch, &crc, sizeof(crc));
+    memcpy(seek, &crc, sizeof(crc));
+    Delta_Init(&delta, old, sizeof(old), crc);
+    TEST_ASSERT_EQUAL(0, Delta_Decode(&delta, &in, &len, out, sizeof(out)));
+    TEST_ASSERT_FALSE(Delta_IsComplete(&delta));
+
+    Delta_Init(&delta, old, sizeof(old), crc);
+    in = seek;
+    len = sizeof(seek);
+    Delta_Decode(&delta, &in, &len, out, sizeof(out));
+    TEST_ASSERT_FALSE(Delta_IsComplete(&delta));
+}
+
+void test_Upgrade(void)
+{
+    Delta_TestUpdate(delta_fixture_upgrade, sizeof(delta_fixture_upgrade), delta_fixture_old,
+                     sizeof(delta_fixture_old), delta_fixture_new, sizeof(delta_fixture_new));
+}
+
+void test_Downgrade(void)
+{
+    Delta_TestUpdate(delta_fixture_downgrade, sizeof(delta_fixture_downgrade), delta_fixture_new,
+                     sizeof(delta_fixture_new), delta_fixture_old, sizeof(delta_fixture_old));
+}
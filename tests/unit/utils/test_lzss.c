@@ -0,0 +1,94 @@
+#include <unity.h>
+#include <string.h>
+#include "utils/lzss.c"
+#include "lzss_encoder.h"
+
+static uint8_t window[1 << LZSS_MAX_BITS];
+static lzss_t lz;
+
+/**
+ * Decode stream fed in chunks into output buffer of given size
+ */
+static uint32_t Lzss_TestDecode(const uint8_t *in, uint32_t len, uint32_t chunk, uint32_t out_size,
+                                uint8_t *dest)
+{
+    uint8_t out[300];
+    uint32_t total = 0;
+
+    while (len != 0) {
+        uint32_t part = len < chunk ? len : chunk;
+        uint32_t n;
+
+        len -= part;
+        do {
+            n = Lzss_Decode(&lz, &in, &part, out, out_size);
+            memcpy(&dest[total], out, n);
+            total += n;
+        } while (n != 0);
+        TEST_ASSERT_EQUAL(0, part);
+    }
+    return total;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(Lzss_Init(&lz, window, 10));
+}
+
+void test_Init(void)
+{
+    TEST_ASSERT_FALSE(Lzss_Init(&lz, window, LZSS_MIN_BITS - 1));
+    TEST_ASSERT_FALSE(Lzss_Init(&lz, window, LZSS_MAX_BITS + 1));
+    TEST_ASSERT_TRUE(Lzss_Init(&lz, window, LZSS_MIN_BITS));
+    TEST_ASSERT_TRUE(Lzss_IsComplete(&lz));
+}
+
+void test_Decode(void)
+{
+    /* "abc", then reference 3 back, 7 long (overlapping), then "d" */
+    const uint8_t stream[] = { 0x17, 'a', 'b', 'c', 0x00, 0x84, 'd' };
+    const uint8_t *in = stream;
+    uint32_t len = sizeof(stream);
+    uint8_t out[16];
+
+    TEST_ASSERT_EQUAL(11, Lzss_Decode(&lz, &in, &len, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY("abcabcabcad", out, 11);
+    TEST_ASSERT_EQUAL(0, len);
+    TEST_ASSERT_TRUE(Lzss_IsComplete(&lz));
+
+    /* Truncated reference */
+    TEST_ASSERT_TRUE(Lzss_Init(&lz, window, 10));
+    in = stream;
+    len = 5;
+    TEST_ASSERT_EQUAL(3, Lzss_Decode(&lz, &in, &len, out, sizeof(out)));
+    TEST_ASSERT_FALSE(Lzss_IsComplete(&lz));
+}
+
+void test_RoundTrip(void)
+{
+    static uint8_t data[3000], compressed[3500], result[3000];
+    const uint32_t chunks[] = { 1, 7, 476, sizeof(compressed) };
+    const uint32_t outs[] = { 1, 64, 300 };
+    uint32_t size;
+
+    /* Compressible data with repeating and random parts */
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        data[i] = (i / 200) % 2 ? (uint8_t)(i * 7919 >> 3) : (uint8_t)(i % 17);
+    }
+
+    for (uint8_t bits = LZSS_MIN_BITS; bits <= LZSS_MAX_BITS; bits += 2) {
+        size = Lzss_TestEncode(data, sizeof(data), bits, compressed);
+        TEST_ASSERT_LESS_THAN(sizeof(data), size);
+
+        for (uint32_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            for (uint32_t o = 0; o < sizeof(outs) / sizeof(outs[0]); o++) {
+                memset(result, 0, sizeof(result));
+                TEST_ASSERT_TRUE(Lzss_Init(&lz, window, bits));
+                TEST_ASSERT_EQUAL(sizeof(data),
+                                  Lzss_TestDecode(compressed, size, chunks[c], outs[o], result));
+                TEST_ASSERT_EQUAL_HEX8_ARRAY(data, result, sizeof(data));
+                TEST_ASSERT_TRUE(Lzss_IsComplete(&lz));
+            }
+        }
+    }
+}
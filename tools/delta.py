@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+# Binary patch generator compatible with sources/utils/delta.c
+
+import argparse
+import crcmod
+
+SEED = 8
+MAX_CANDIDATES = 16
+# Approximate match is given up after this many mismatches over the best score
+GIVE_UP = 16
+
+
+def varint(value: int) -> bytes:
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value: int) -> int:
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def extend(old: bytes, new: bytes, old_pos: int, new_pos: int) -> tuple:
+    '''
+    Approximate match length, differing bytes are allowed (e.g. moved pointers)
+
+    Returns (length, score), score is amount of equal bytes minus the differing ones
+    '''
+    score = 0
+    best = (0, 0)
+    i = 0
+    while old_pos + i < len(old) and new_pos + i < len(new):
+        score += 1 if old[old_pos + i] == new[new_pos + i] else -1
+        i += 1
+        if score > best[1]:
+            best = (i, score)
+        elif score < best[1] - GIVE_UP:
+            break
+    return best
+
+
+def diff(old: bytes, new: bytes) -> bytes:
+    '''
+    Generate patch reconstructing new data from old ones
+    '''
+    crcfunc = crcmod.mkCrcFun(0x11021, rev=False, initCrc=0xffff, xorOut=0)
+    index = {}
+    for i in range(len(old) - SEED + 1):
+        candidates = index.setdefault(old[i:i + SEED], [])
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(i)
+
+    # (new position, old position, length) of approximate matches
+    matches = []
+    old_next = 0
+    pos = 0
+    while pos < len(new):
+        # Continue with the same offset, data are often just shifted
+        best = (old_next, *extend(old, new, old_next, pos))
+        for cand in index.get(new[pos:pos + SEED], []):
+            match = (cand, *extend(old, new, cand, pos))
+            if match[2] > best[2]:
+                best = match
+        if best[2] >= SEED:
+            matches.append((pos, best[0], best[1]))
+            pos += best[1]
+            old_next = best[0] + best[1]
+        else:
+            pos += 1
+
+    patch = bytearray()
+    patch += crcfunc(old).to_bytes(2, 'little')
+    patch += len(old).to_bytes(4, 'little')
+    # Empty match at start for data preceding the first one
+    matches.insert(0, (0, 0, 0))
+    for i, (new_pos, old_pos, length) in enumerate(matches):
+        if i + 1 < len(matches):
+            next_new, next_old, _ = matches[i + 1]
+        else:
+            next_new, next_old = len(new), old_pos + length
+        patch += varint(length)
+        patch += bytes((new[new_pos + j] - old[old_pos + j]) & 0xff for j in range(length))
+        patch += varint(next_new - new_pos - length) + new[new_pos + length:next_new]
+        patch += varint(zigzag(next_old - old_pos - length))
+    return bytes(patch)
+
+
+def patch(old: bytes, data: bytes) -> bytes:
+    '''
+    Apply patch, reference implementation for testing
+    '''
+    def read_varint() -> int:
+        nonlocal pos
+        value = 0
+        shift = 0
+        while True:
+            byte = data[pos]
+            pos += 1
+            value |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    crcfunc = crcmod.mkCrcFun(0x11021, rev=False, initCrc=0xffff, xorOut=0)
+    if int.from_bytes(data[0:2], 'little') != crcfunc(old) or \
+            int.from_bytes(data[2:6], 'little') != len(old):
+        raise ValueError('Patch generated for different data')
+
+    out = bytearray()
+    pos = 6
+    old_pos = 0
+    while pos < len(data):
+        length = read_varint()
+        out += bytes((old[old_pos + j] + data[pos + j]) & 0xff for j in range(length))
+        pos += length
+        old_pos += length
+        length = read_varint()
+        out += data[pos:pos + length]
+        pos += length
+        seek = read_varint()
+        old_pos += (seek >> 1) ^ -(seek & 1)
+    return bytes(out)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Binary patch generator")
+    parser.add_argument('old', type=argparse.FileType('rb'), help="Old binary")
+    parser.add_argument('new', type=argparse.FileType('rb'), help="New binary")
+    parser.add_argument('dest', type=argparse.FileType('wb'), help="Destination patch file")
+    args = parser.parse_args()
+
+    old = args.old.read()
+    new = args.new.read()
+    result = diff(old, new)
+    if patch(old, result) != new:
+        raise ValueError('Patch generation failed, internal error...')
+    args.dest.write(result)
+    print(f'Patch {len(result)} B for {len(new)} B image')
@@ -15,9 +15,12 @@ import argparse
 import subprocess
 from typing import Optional
 from bin2uf2 import bin2uf2
+from lzss import compress
+from delta import diff
 
 
 FW_HDR_SIZE = 0x80
+FW_FLAG_DELTA = 0x0010
 
 
 class FwMetaData(ctypes.Structure):
@@ -27,7 +30,7 @@ class FwMetaData(ctypes.Structure):
         ('minor', ctypes.c_uint8),
         ('patch', ctypes.c_uint8),
         ('git_hash', ctypes.c_char * 47),
-        ('description', ctypes.c_char * 68),
+        ('description', ctypes.c_char * 64),
     ]
 
 
@@ -38,6 +41,8 @@ class FwHdr(ctypes.Structure):
         ('len', ctypes.c_uint32),
         ('crc', ctypes.c_uint16),
         ('meta', FwMetaData),
+        ('flags', ctypes.c_uint16),
+        ('validated', ctypes.c_uint16),
     ]
 
 
@@ -74,9 +79,10 @@ def get_git_hash() -> str:
         raise ValueError('Unable to read latest git commit hash')
 
 
-def gen_header(binary: bytes, version: Version, magic: int, description: str) -> bytes:
+def gen_header(binary: bytes, version: Version, magic: int, description: str,
+               flags: int = 0) -> bytes:
     '''
-    Generate fw image header
+    Generate fw image header, length and crc are calculated from uncompressed binary
     '''
     crcfunc = crcmod.mkCrcFun(0x11021, rev=False, initCrc=0xffff, xorOut=0)
 
@@ -89,6 +95,9 @@ def gen_header(binary: bytes, version: Version, magic: int, description: str) ->
     hdr.meta.patch = version.patch
     hdr.meta.git_hash = bytes(get_git_hash(), encoding='ascii')
     hdr.meta.description = bytes(description, encoding='ascii')
+    hdr.flags = flags
+    # Erased flash value, set by bootloader once the image crc is checked
+    hdr.validated = 0xffff
 
     data = bytes(hdr)
     if len(data) > FW_HDR_SIZE:
@@ -123,6 +132,10 @@ if __name__ == "__main__":
                         help='Address of the image in the flash (after bootloader)')
     parser.add_argument('--description', type=str, default='devel',
                         help='FW image textual description')
+    parser.add_argument('--lzss', type=int, choices=range(8, 13), metavar='WINDOW_BITS',
+                        help='Compress update image data, window size as log2 (e.g. 10)')
+    parser.add_argument('--delta', type=argparse.FileType('rb'), metavar='OLD_BIN',
+                        help='Generate patch against currently running .bin file, needs --lzss')
 
     excl_group = parser.add_mutually_exclusive_group(required=True)
     excl_group.add_argument('--bl', type=argparse.FileType('rb'),
@@ -133,12 +146,28 @@ if __name__ == "__main__":
     excl_group.add_argument('--uf2', action="store_true",
                             help="Build a UF2 update image")
     args = parser.parse_args()
+    if args.lzss is not None and args.bl is not None:
+        parser.error('Flashable image with bootloader can\'t be compressed')
+    if args.delta is not None and (args.lzss is None or args.bl is not None):
+        parser.error('Delta image must be compressed (--lzss) update image')
 
     # generate fw image
     binary = args.source.read()
-    header = gen_header(binary, args.version, args.magic, args.description)
-    image = header + binary
     args.source.close()
+    if args.delta is not None:
+        old = args.delta.read()
+        args.delta.close()
+        header = gen_header(binary, args.version, args.magic, args.description,
+                            args.lzss | FW_FLAG_DELTA)
+        image = header + compress(diff(old, binary), args.lzss)
+        print(f'Patch for {len(binary)} B image is {len(image) - FW_HDR_SIZE} B long')
+    elif args.lzss is not None:
+        header = gen_header(binary, args.version, args.magic, args.description, args.lzss)
+        image = header + compress(binary, args.lzss)
+        print(f'Image compressed from {len(binary)} B to {len(image) - FW_HDR_SIZE} B')
+    else:
+        header = gen_header(binary, args.version, args.magic, args.description)
+        image = header + binary
 
     # Process outputs
     if args.image:
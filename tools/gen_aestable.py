@@ -0,0 +1,73 @@
+#!/usr/bin/python
+# Calculate AES encryption T-tables (SubBytes and MixColumns combined)
+#
+# Columns are stored in little endian words, first row in the lowest byte.
+
+import argparse
+
+
+def mul2(num):
+    num <<= 1
+    return (num ^ 0x11b) if num & 0x100 else num
+
+
+def gen_sbox():
+    sbox = [0 for i in range(256)]
+    for i in range(256):
+        # Multiplicative inverse by brute force, affine transformation
+        inv = 0
+        for j in range(1, 256):
+            product = 0
+            a, b = i, j
+            while b:
+                if b & 1:
+                    product ^= a
+                a = mul2(a)
+                b >>= 1
+            if product == 1:
+                inv = j
+                break
+        s = inv
+        for shift in range(1, 5):
+            s ^= ((inv << shift) | (inv >> (8 - shift))) & 0xff
+        sbox[i] = s ^ 0x63
+    return sbox
+
+
+def gen_tables():
+    sbox = gen_sbox()
+    table = []
+    for s in sbox:
+        s2 = mul2(s)
+        table.append(s2 | (s << 8) | (s << 16) | ((s2 ^ s) << 24))
+    tables = [table]
+    for k in range(1, 4):
+        tables.append([((item << (8 * k)) | (item >> (32 - 8 * k))) & 0xffffffff
+                       for item in table])
+    return tables
+
+
+def print_table(table, name):
+    out = "static const uint32_t %s[256] = {" % name
+    linelen = len(out)
+
+    for item in table:
+        text = " 0x%08x," % item
+        if linelen + len(text) > 100:
+            out += '\n   '
+            linelen = 3
+        out += text
+        linelen += len(text)
+    out = out[:-1]
+    out += ' };\n'
+    print(out)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="AES T-table generator")
+    parser.add_argument('--tables', type=int, default=4, choices=[1, 4],
+                        help="Amount of tables, others are rotations of the first one")
+    args = parser.parse_args()
+
+    for k, table in enumerate(gen_tables()[:args.tables]):
+        print_table(table, "AESi_T%d" % k)
@@ -1,7 +1,7 @@
 #!/usr/bin/python
 # Calculate crc lookup table for given polynomial
 
-import sys
+import argparse
 
 
 def gen_table(polynomial, length):
@@ -18,11 +18,41 @@ def gen_table(polynomial, length):
     return table
 
 
-def print_table(table, length):
+def gen_table_reflected(polynomial, length):
+    # Polynomial is given in normal form, bits are processed LSB first
+    reversed_poly = int(format(polynomial, '0%db' % length)[::-1], 2)
+    table = [0 for i in range(256)]
+
+    for i in range(256):
+        remainder = i
+        for bit in range(8):
+            if remainder & 1:
+                remainder = (remainder >> 1) ^ reversed_poly
+            else:
+                remainder >>= 1
+        table[i] = remainder
+    return table
+
+
+def gen_slice_tables(table, length, slices):
+    '''
+    Tables for slicing-by-N, table k is the crc of a byte followed by k zero bytes
+    '''
+    mask = 2**length-1
+    tables = [table]
+    for k in range(1, slices):
+        prev = tables[-1]
+        tables.append([((item << 8) & mask) ^ table[item >> (length-8)] for item in prev])
+    return tables[1:]
+
+
+def print_table(table, length, name=None):
     linelen = 80
     out = ""
     itemlen = 2+length/4+2
-    out = "static const uint%d_t crc%di_lut_table[256] = {" % (length, length)
+    if name is None:
+        name = "crc%di_lut_table[256]" % length
+    out = "static const uint%d_t %s = {" % (length, name)
 
     for item in table:
         if linelen + itemlen > 80:
@@ -36,12 +66,19 @@ def print_table(table, length):
 
 
 if __name__ == "__main__":
-    if len(sys.argv) != 3:
-        print("Lookup table generator for CRC")
-        print("Usage: %s polynomial bytes_len" % (sys.argv[0]))
-        exit(0)
-
-    polynomial = int(sys.argv[1], 0)
-    len = int(sys.argv[2])
+    parser = argparse.ArgumentParser(description="Lookup table generator for CRC")
+    parser.add_argument('polynomial', type=lambda x: int(x, 0), help="CRC polynomial")
+    parser.add_argument('length', type=int, help="CRC length in bits")
+    parser.add_argument('reflected', nargs='?', choices=['reflected'],
+                        help="Process bits from LSB")
+    parser.add_argument('--slices', type=int, default=1,
+                        help="Also print tables for slicing-by-N (not reflected only)")
+    args = parser.parse_args()
 
-    print_table(gen_table(polynomial, len), len)
+    if args.reflected:
+        print_table(gen_table_reflected(args.polynomial, args.length), args.length)
+    else:
+        table = gen_table(args.polynomial, args.length)
+        print_table(table, args.length)
+        for k, item in enumerate(gen_slice_tables(table, args.length, args.slices)):
+            print_table(item, args.length, "crc%di_slice%d_table[256]" % (args.length, k + 1))
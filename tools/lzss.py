@@ -0,0 +1,101 @@
+#!/usr/bin/env python
+# LZSS compression compatible with sources/utils/lzss.c
+
+import argparse
+
+MIN_MATCH = 3
+MAX_CHAIN = 256
+
+
+def compress(data: bytes, window_bits: int = 10) -> bytes:
+    '''
+    Compress data, greedy parsing with hash chains
+    '''
+    window = 1 << window_bits
+    max_match = (0xffff >> window_bits) + MIN_MATCH
+    out = bytearray()
+    chains = {}
+    flags_pos = 0
+    flag_bit = 8
+    pos = 0
+
+    def insert(i: int):
+        if i + MIN_MATCH <= len(data):
+            chains.setdefault(data[i:i + MIN_MATCH], []).append(i)
+
+    while pos < len(data):
+        if flag_bit == 8:
+            flags_pos = len(out)
+            out.append(0)
+            flag_bit = 0
+
+        best_len = 0
+        best_dist = 0
+        candidates = chains.get(data[pos:pos + MIN_MATCH], [])
+        limit = min(max_match, len(data) - pos)
+        for cand in reversed(candidates[-MAX_CHAIN:]):
+            if pos - cand > window:
+                break
+            length = MIN_MATCH
+            while length < limit and data[cand + length] == data[pos + length]:
+                length += 1
+            if length > best_len:
+                best_len = length
+                best_dist = pos - cand
+                if length == limit:
+                    break
+
+        if best_len >= MIN_MATCH:
+            ref = ((best_dist - 1) << (16 - window_bits)) | (best_len - MIN_MATCH)
+            out += ref.to_bytes(2, 'big')
+            for i in range(pos, pos + best_len):
+                insert(i)
+            pos += best_len
+        else:
+            out[flags_pos] |= 1 << flag_bit
+            out.append(data[pos])
+            insert(pos)
+            pos += 1
+        flag_bit += 1
+
+    return bytes(out)
+
+
+def decompress(data: bytes, window_bits: int = 10) -> bytes:
+    '''
+    Decompress data, reference implementation for testing
+    '''
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        flags = data[pos]
+        pos += 1
+        for bit in range(8):
+            if pos >= len(data):
+                break
+            if flags & (1 << bit):
+                out.append(data[pos])
+                pos += 1
+            else:
+                ref = int.from_bytes(data[pos:pos + 2], 'big')
+                pos += 2
+                dist = (ref >> (16 - window_bits)) + 1
+                for _ in range((ref & (0xffff >> window_bits)) + MIN_MATCH):
+                    out.append(out[-dist])
+    return bytes(out)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="LZSS compression")
+    parser.add_argument('source', type=argparse.FileType('rb'), help="Source file")
+    parser.add_argument('dest', type=argparse.FileType('wb'), help="Destination file")
+    parser.add_argument('-w', '--window-bits', type=int, default=10, choices=range(8, 13),
+                        help="log2 of the window size")
+    args = parser.parse_args()
+
+    source = args.source.read()
+    compressed = compress(source, args.window_bits)
+    if decompress(compressed, args.window_bits) != source:
+        raise ValueError('Compression failed, internal error...')
+    args.dest.write(compressed)
+    print(f'Compressed {len(source)} B to {len(compressed)} B')